@@ -15,14 +15,26 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/program_options.hpp>
+#include <boost/ref.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
 
 #include <yaml-cpp/yaml.h>
 
+#include <cnoid/BodyMotion>
+
 #include <roboptim/core/problem.hh>
 #include <roboptim/core/result.hh>
 #include <roboptim/core/result-with-warnings.hh>
@@ -30,7 +42,11 @@
 #include <roboptim/core/solver.hh>
 
 #include <roboptim/retargeting/problem/joint-problem-builder.hh>
+#include <roboptim/retargeting/resampling.hh>
+#include <roboptim/retargeting/temporal-consensus.hh>
+#include <roboptim/retargeting/temporal-multigrid.hh>
 #include <roboptim/retargeting/io/choreonoid-body-motion.hh>
+#include <roboptim/retargeting/worker-pool.hh>
 
 #include "path.hh"
 
@@ -55,7 +71,12 @@ static bool parseOptions
     ("trajectory-type,t",
      po::value<std::string>
      (&options.trajectoryType)->default_value ("discrete"),
-     "Trajectory type (discrete)")
+     "Trajectory type (discrete, spline, minimum-jerk)")
+    ("control-points-spacing",
+     po::value<int>
+     (&options.controlPointsSpacing)->default_value (10),
+     "Number of frames between two control points or knots"
+     " (spline and minimum-jerk trajectories)")
     ("robot-model,r",
      po::value<std::string> (&options.robotModel)->required (),
      "Robot Model (Choreonoid YAML file)")
@@ -65,9 +86,22 @@ static bool parseOptions
     ("plugin,p",
      po::value<std::string> (&options.plugin)->default_value ("cfsqp"),
      "RobOptim plug-in to be used")
+    ("jobs",
+     po::value<int> (&options.jobs)->default_value (1),
+     "Number of worker threads used to evaluate the functions")
+    ("sparse",
+     po::bool_switch (&options.sparse),
+     "Use sparse jacobians (the plug-in must support sparse problems)")
     ("cost,c",
      po::value<std::string> (&options.cost)->default_value ("lde"),
      "What cost function should be used?")
+    ("smoothness-scale",
+     po::value<double> (&options.smoothnessScale)->default_value (1.),
+     "Global weight of the acceleration and jerk costs")
+    ("smoothness-weight",
+     po::value<std::vector<std::string> > (&options.smoothnessWeights),
+     "Weight of a joint in the acceleration and jerk costs"
+     " (NAME=WEIGHT, 1 by default)")
     ("constraint,C",
      po::value<std::vector<std::string> > (&options.constraints),
      "Which constraints should be used?")
@@ -81,6 +115,52 @@ static bool parseOptions
     ("length",
      po::value<int> (&options.length)->default_value (-1),
      "How many frames will be considered? (-1 means all)")
+    ("resampling",
+     po::value<int> (&options.resampling)->default_value (1),
+     "Input frames per optimized frame: the joints trajectory is"
+     " low-pass filtered and decimated, the result is upsampled back"
+     " (1 means no resampling)")
+    ("levels",
+     po::value<int> (&options.levels)->default_value (1),
+     "Number of temporal multigrid levels (1 solves at full"
+     " resolution only)")
+    ("decimation-factor",
+     po::value<int> (&options.decimationFactor)->default_value (2),
+     "Decimation factor between two multigrid levels")
+    ("window",
+     po::value<int> (&options.window)->default_value (0),
+     "Solve the motion by windows of this number of frames, the"
+     " result is written as the windows are solved (0 solves the"
+     " whole motion at once)")
+    ("window-overlap",
+     po::value<int> (&options.windowOverlap)->default_value (10),
+     "Number of frames shared by two consecutive windows")
+    ("window-overlap-policy",
+     po::value<std::string>
+     (&options.windowOverlapPolicy)->default_value ("blend"),
+     "Overlapping frames handling (fix: keep the previous window"
+     " solution, blend: cross-fade both solutions)")
+    ("segments",
+     po::value<int> (&options.segments)->default_value (0),
+     "Split the motion into this number of overlapping segments solved"
+     " concurrently, the shared frames agree through ADMM iterations"
+     " (0 or 1 solves the whole motion at once)")
+    ("segment-overlap",
+     po::value<int> (&options.segmentOverlap)->default_value (5),
+     "Number of frames shared by two consecutive segments")
+    ("admm-penalty",
+     po::value<double> (&options.admmPenalty)->default_value (10.),
+     "ADMM penalty parameter (weight pulling the shared frames toward"
+     " their consensus)")
+    ("admm-iterations",
+     po::value<int> (&options.admmIterations)->default_value (20),
+     "Maximum number of ADMM iterations")
+    ("admm-tolerance",
+     po::value<double> (&options.admmTolerance)->default_value (1e-3),
+     "ADMM primal residual stopping criterion")
+    ("compare-monolithic",
+     po::bool_switch (&options.compareMonolithic),
+     "Also solve the whole motion at once and report the speed-up")
     ;
 
   po::variables_map vm;
@@ -113,43 +193,39 @@ static bool parseOptions
   return true;
 }
 
-int safeMain (int argc, const char* argv[])
+/// \brief Reduced trajectory parameters from the optimization variables.
+///
+/// Spline and minimum jerk trajectories are sampled at each frame,
+/// discrete trajectories are optimized directly.
+static roboptim::Function::vector_t
+trajectoryParameters (const roboptim::retargeting::JointFunctionData& data,
+		      const roboptim::Function::vector_t& x)
 {
-  typedef roboptim::retargeting::denseProblem_t problem_t;
-  typedef roboptim::Solver<
-    roboptim::GenericDifferentiableFunction<roboptim::EigenMatrixDense>,
-    boost::mpl::vector<
-      roboptim::GenericLinearFunction<roboptim::EigenMatrixDense>,
-      roboptim::GenericDifferentiableFunction<roboptim::EigenMatrixDense>
-      >
-    >
-    solver_t;
-
-  roboptim::retargeting::JointProblemOptions options;
-
-  if (!parseOptions (options, argc, argv))
-    return 0;
-
-  // Build problem.
-  roboptim::retargeting::JointProblemBuilder<problem_t>
-    builder (options);
-
-  boost::shared_ptr<problem_t> problem;
-  roboptim::retargeting::JointFunctionData data;
-  builder (problem, data);
-
-  if (!problem)
-    throw std::runtime_error ("failed to build problem");
+  if (data.parametrization)
+    return (*data.parametrization) (x);
+  return x;
+}
 
-  roboptim::SolverFactory<solver_t>
-    factory (options.plugin, *problem);
-  solver_t& solver = factory ();
+/// \brief Iteration callback counting the solver iterations.
+template <typename problem_t, typename solver_t>
+static void countIteration (std::size_t& nIterations,
+			    const problem_t&,
+			    typename solver_t::solverState_t&)
+{
+  ++nIterations;
+}
 
-  // Set solver parameters.
+/// \brief Set the solver parameters.
+///
+/// \param solver solver to be configured
+/// \param logFile Ipopt log file
+template <typename solver_t>
+static void
+setSolverParameters (solver_t& solver, const std::string& logFile)
+{
   solver.parameters ()["max-iterations"].value = 1000;
 
-  solver.parameters ()["ipopt.output_file"].value =
-    "/tmp/ipopt.log";
+  solver.parameters ()["ipopt.output_file"].value = logFile;
   solver.parameters ()["ipopt.print_level"].value = 5;
   solver.parameters ()["ipopt.expect_infeasible_problem"].value = "no";
   solver.parameters ()["ipopt.nlp_scaling_method"].value = "none";
@@ -160,65 +236,799 @@ int safeMain (int argc, const char* argv[])
   // first-order
   solver.parameters ()["ipopt.derivative_test"].value = "first-order";
   solver.parameters ()["nag.verify-level"].value = 0;
+}
 
-  std::cout << solver << std::endl;
-
-  const solver_t::result_t& result = solver.minimum ();
+/// \brief Count the solver iterations if the plug-in supports
+///        callbacks.
+///
+/// \param solver solver to be watched
+/// \param nIterations incremented at each iteration
+/// \param countIterations set to false if the plug-in does not
+///        report its iterations
+template <typename problem_t, typename solver_t>
+static void
+watchIterations (solver_t& solver,
+		 std::size_t& nIterations,
+		 bool& countIterations)
+{
+  try
+    {
+      solver.setIterationCallback
+	(boost::bind (&countIteration<problem_t, solver_t>,
+		      boost::ref (nIterations), _1, _2));
+    }
+  catch (const std::runtime_error&)
+    {
+      countIterations = false;
+    }
+}
 
-  boost::shared_ptr<roboptim::Trajectory<3> > finalTrajectoryFiltered =
-    boost::shared_ptr<roboptim::Trajectory<3> >
-    (data.filteredTrajectory->clone ());
+/// \brief Run the solver and retrieve the solution.
+///
+/// \param solver configured solver
+/// \param data problem data
+/// \param verbose print the solver result?
+/// \return reduced trajectory parameters solving the problem
+template <typename solver_t>
+static roboptim::Function::vector_t
+retrieveSolution (solver_t& solver,
+		  const roboptim::retargeting::JointFunctionData& data,
+		  bool verbose)
+{
+  const typename solver_t::result_t& result = solver.minimum ();
 
   if (result.which () == solver_t::SOLVER_VALUE_WARNINGS)
     {
-      std::cout << "Optimization finished. Warnings have been issued\n";
       roboptim::ResultWithWarnings result_ =
         boost::get<roboptim::ResultWithWarnings> (result);
-      std::cerr << result << std::endl;
-      finalTrajectoryFiltered->setParameters (result_.x);
+      if (verbose)
+	{
+	  std::cout << "Optimization finished. Warnings have been issued\n";
+	  std::cerr << result << std::endl;
+	}
+      return trajectoryParameters (data, result_.x);
     }
   else if (result.which () == solver_t::SOLVER_VALUE)
     {
-      std::cout << "Optimization finished successfully.\n";
       roboptim::Result result_ =
         boost::get<roboptim::Result> (result);
-      std::cerr << result << std::endl;
-      finalTrajectoryFiltered->setParameters (result_.x);
+      if (verbose)
+	{
+	  std::cout << "Optimization finished successfully.\n";
+	  std::cerr << result << std::endl;
+	}
+      return trajectoryParameters (data, result_.x);
+    }
+  throw std::runtime_error ("Optimization failed");
+}
+
+/// \brief Solve a problem built by the joint problem builder.
+///
+/// \param options problem description
+/// \param data problem data, filled by the builder
+/// \param problem problem to be solved
+/// \param nIterations incremented by the number of iterations
+/// \param countIterations set to false if the plug-in does not
+///        report its iterations
+/// \return reduced trajectory parameters solving the problem
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static roboptim::Function::vector_t
+minimize (const roboptim::retargeting::JointProblemOptions& options,
+	  const roboptim::retargeting::JointFunctionData& data,
+	  problem_t& problem,
+	  std::size_t& nIterations,
+	  bool& countIterations)
+{
+  roboptim::SolverFactory<solver_t>
+    factory (options.plugin, problem);
+  solver_t& solver = factory ();
+
+  setSolverParameters (solver, "/tmp/ipopt.log");
+  watchIterations<problem_t, solver_t> (solver, nIterations, countIterations);
+
+  std::cout << solver << std::endl;
+
+  return retrieveSolution (solver, data, true);
+}
+
+/// \brief Build and solve the problem at one temporal resolution.
+///
+/// \param options problem description (decimation of this level)
+/// \param data problem data, filled by the builder
+/// \param coarse reduced trajectory parameters solving the previous
+///        (coarser) level, empty to start from the input trajectory
+/// \param nIterations incremented by the number of iterations
+/// \param countIterations set to false if the plug-in does not
+///        report its iterations
+/// \return reduced trajectory parameters solving this level
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static roboptim::Function::vector_t
+solveLevel (const roboptim::retargeting::JointProblemOptions& options,
+	    roboptim::retargeting::JointFunctionData& data,
+	    const roboptim::Function::vector_t& coarse,
+	    std::size_t& nIterations,
+	    bool& countIterations)
+{
+  // Build problem.
+  roboptim::retargeting::JointProblemBuilder<problem_t>
+    builder (options);
+
+  boost::shared_ptr<problem_t> problem;
+  builder (problem, data);
+
+  if (!problem)
+    throw std::runtime_error ("failed to build problem");
+
+  // Start from the interpolated solution of the coarser level.
+  if (coarse.size () > 0)
+    {
+      roboptim::Function::vector_t trajectory =
+	roboptim::retargeting::interpolateFrames
+	(coarse, data.nDofsFiltered (), options.decimationFactor,
+	 data.nFrames ());
+      if (data.parametrization)
+	problem->startingPoint () = data.parametrization->fit (trajectory);
+      else
+	problem->startingPoint () = trajectory;
+    }
+
+  return minimize<problem_t, solver_t>
+    (options, data, *problem, nIterations, countIterations);
+}
+
+/// \brief Build and solve the problem on one window of the motion.
+///
+/// \param options problem description (start frame and length of
+///        the window)
+/// \param data problem data, filled by the builder
+/// \param overlap reduced configurations of the first frames of the
+///        window, as solved by the previous window (empty for the
+///        first window)
+/// \param nIterations incremented by the number of iterations
+/// \param countIterations set to false if the plug-in does not
+///        report its iterations
+/// \return reduced trajectory parameters solving the window
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static roboptim::Function::vector_t
+solveWindow (const roboptim::retargeting::JointProblemOptions& options,
+	     roboptim::retargeting::JointFunctionData& data,
+	     const roboptim::Function::vector_t& overlap,
+	     std::size_t& nIterations,
+	     bool& countIterations)
+{
+  // Build problem.
+  roboptim::retargeting::JointProblemBuilder<problem_t>
+    builder (options);
+
+  boost::shared_ptr<problem_t> problem;
+  builder (problem, data);
+
+  if (!problem)
+    throw std::runtime_error ("failed to build problem");
+
+  // Start the overlapping frames from the previous window solution.
+  if (overlap.size () > 0)
+    {
+      roboptim::Function::vector_t trajectory =
+	data.filteredTrajectory->parameters ();
+      trajectory.head (overlap.size ()) = overlap;
+      if (data.parametrization)
+	problem->startingPoint () = data.parametrization->fit (trajectory);
+      else
+	problem->startingPoint () = trajectory;
+
+      // Fixed frames: lower and upper bounds are the previous
+      // solution.
+      if (options.windowOverlapPolicy == "fix")
+	for (roboptim::Function::vector_t::Index i = 0;
+	     i < overlap.size (); ++i)
+	  problem->argumentBounds ()[static_cast<std::size_t> (i)] =
+	    roboptim::Function::makeInterval (overlap[i], overlap[i]);
+    }
+
+  return minimize<problem_t, solver_t>
+    (options, data, *problem, nIterations, countIterations);
+}
+
+/// \brief Solve the motion one window after the other.
+///
+/// Windows of options.window frames are solved in sequence, two
+/// consecutive windows sharing options.windowOverlap frames (see
+/// JointProblemOptions::windowOverlapPolicy). Once a window is
+/// solved, its frames preceding the next window are final: they are
+/// written and released. Only the input motion is kept entirely in
+/// memory, the problems and the written data are bounded by the
+/// window size.
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static int
+solveWindows (const roboptim::retargeting::JointProblemOptions& options)
+{
+  typedef roboptim::Function::vector_t::Index index_t;
+
+  if (options.windowOverlap < 0 || options.windowOverlap >= options.window)
+    throw std::runtime_error
+      ("the windows overlap must be smaller than the windows");
+  if (options.windowOverlapPolicy != "fix"
+      && options.windowOverlapPolicy != "blend")
+    throw std::runtime_error ("invalid windows overlap policy");
+  if (options.windowOverlapPolicy == "fix"
+      && options.trajectoryType != "discrete")
+    throw std::runtime_error
+      ("the overlapping frames can only be fixed for discrete trajectories");
+  if (options.levels != 1 || options.resampling != 1)
+    throw std::runtime_error
+      ("windows cannot be combined with multigrid levels or resampling");
+
+  // Load the motion once, every window is taken from it.
+  cnoid::BodyMotionPtr motion = boost::make_shared<cnoid::BodyMotion> ();
+  motion->loadStandardYAMLformat (options.jointsTrajectory);
+
+  const int first = options.startFrame;
+  const int end = options.length < 0
+    ? motion->numFrames ()
+    : std::min (motion->numFrames (), first + options.length);
+  const int stride = options.window - options.windowOverlap;
+  if (end - first < 1)
+    throw std::runtime_error ("no frame to be solved");
+
+  boost::shared_ptr<roboptim::retargeting::BodyMotionWriter> writer;
+  roboptim::Function::vector_t overlap;
+  // Disabled joints keep their value in the first frame of the
+  // motion, as in the monolithic problem.
+  roboptim::retargeting::ReducedCoordinatesMap::configuration_t
+    disabledJointsConfiguration;
+  std::size_t nIterations = 0;
+  bool countIterations = true;
+  int nWindows = 0;
+
+  const boost::posix_time::ptime start =
+    boost::posix_time::microsec_clock::universal_time ();
+  for (int windowStart = first; ; windowStart += stride)
+    {
+      roboptim::retargeting::JointProblemOptions windowOptions = options;
+      windowOptions.startFrame = windowStart;
+      windowOptions.length = std::min (options.window, end - windowStart);
+      windowOptions.decimation = 1;
+      const bool last = windowStart + windowOptions.length >= end;
+
+      std::cout
+	<< (boost::format ("Window %d: frames %d to %d")
+	    % nWindows % windowStart
+	    % (windowStart + windowOptions.length - 1)).str ()
+	<< std::endl;
+
+      roboptim::retargeting::JointFunctionData data;
+      data.jointsTrajectory = motion;
+      data.disabledJointsConfiguration = disabledJointsConfiguration;
+      roboptim::Function::vector_t solution =
+	solveWindow<problem_t, solver_t>
+	(windowOptions, data, overlap, nIterations, countIterations);
+      ++nWindows;
+      disabledJointsConfiguration = data.disabledJointsConfiguration;
+
+      const index_t n = data.nDofsFiltered ();
+      const index_t nOverlap = overlap.size () / n;
+
+      // Cross-fade the previous and the current solutions.
+      if (options.windowOverlapPolicy == "blend")
+	for (index_t frame = 0; frame < nOverlap; ++frame)
+	  {
+	    const double alpha =
+	      static_cast<double> (frame + 1)
+	      / static_cast<double> (nOverlap + 1);
+	    solution.segment (frame * n, n) =
+	      (1. - alpha) * overlap.segment (frame * n, n)
+	      + alpha * solution.segment (frame * n, n);
+	  }
+
+      if (!writer)
+	writer = boost::make_shared<roboptim::retargeting::BodyMotionWriter>
+	  (options.outputFile, end - first,
+	   static_cast<int> (data.nDofsFull ()), 1. / data.dt);
+
+      // Write the final frames (re-expend them).
+      const roboptim::retargeting::ReducedCoordinatesMap map
+	(data.disabledJointsConfiguration);
+      const index_t nFinal = last ? windowOptions.length : stride;
+      for (index_t frame = 0; frame < nFinal; ++frame)
+	writer->write (map.expand (solution.segment (frame * n, n)));
+
+      if (last)
+	{
+	  std::cout << *data.evaluationContexts << std::endl;
+	  break;
+	}
+      overlap = solution.segment (stride * n, options.windowOverlap * n);
+    }
+  writer->close ();
+
+  const boost::posix_time::time_duration solveTime =
+    boost::posix_time::microsec_clock::universal_time () - start;
+  std::cout
+    << (boost::format ("Windows: %d windows of %d frames (overlap: %d, %s),"
+		       " %s iterations, %g ms")
+	% nWindows % options.window % options.windowOverlap
+	% options.windowOverlapPolicy
+	% (countIterations
+	   ? boost::lexical_cast<std::string> (nIterations) : "n/a")
+	% (1e-3 * static_cast<double> (solveTime.total_microseconds ())))
+    .str () << std::endl;
+  return 0;
+}
+
+/// \brief One segment of the motion (see solveSegments).
+///
+/// Each segment owns its data (robot model, evaluation contexts),
+/// problem and solver: the segments can be solved concurrently.
+template <typename problem_t, typename solver_t>
+struct SegmentWorker
+{
+  SegmentWorker ()
+    : options (),
+      data (),
+      term (),
+      problem (),
+      factory (),
+      x (),
+      nIterations (0),
+      countIterations (true)
+  {}
+
+  /// \brief Problem description (segment frames).
+  roboptim::retargeting::JointProblemOptions options;
+  /// \brief Problem data.
+  roboptim::retargeting::JointFunctionData data;
+  /// \brief Proximal term of the segment cost.
+  roboptim::retargeting::ProximalTermShPtr term;
+  /// \brief Segment problem.
+  boost::shared_ptr<problem_t> problem;
+  /// \brief Solver factory (recreated at each ADMM iteration).
+  boost::shared_ptr<roboptim::SolverFactory<solver_t> > factory;
+  /// \brief Last segment solution.
+  roboptim::Function::vector_t x;
+  /// \brief Number of solver iterations.
+  std::size_t nIterations;
+  /// \brief Does the plug-in report its iterations?
+  bool countIterations;
+};
+
+/// \brief Segments to be solved by the worker threads.
+struct SegmentQueue
+{
+  explicit SegmentQueue (std::size_t size)
+    : size (size),
+      next (0),
+      error (),
+      mutex ()
+  {}
+
+  /// \brief Pop the next segment.
+  ///
+  /// \return false if there is no segment left or a worker failed
+  bool pop (std::size_t& segmentId)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    if (next >= size || !error.empty ())
+      return false;
+    segmentId = next++;
+    return true;
+  }
+
+  /// \brief Record a worker failure (the first one is kept).
+  void fail (const std::string& message)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    if (error.empty ())
+      error = message;
+  }
+
+  /// \brief Number of segments.
+  std::size_t size;
+  /// \brief Next segment to be solved.
+  std::size_t next;
+  /// \brief First error raised by a worker.
+  std::string error;
+  boost::mutex mutex;
+};
+
+/// \brief Worker thread body: solve segments until the queue is
+///        empty.
+template <typename problem_t, typename solver_t>
+static void
+runSegmentWorker
+(std::vector<boost::shared_ptr<SegmentWorker<problem_t, solver_t> > >&
+ workers,
+ SegmentQueue& queue)
+{
+  try
+    {
+      std::size_t segmentId;
+      while (queue.pop (segmentId))
+	{
+	  SegmentWorker<problem_t, solver_t>& worker = *workers[segmentId];
+	  worker.x = retrieveSolution ((*worker.factory) (), worker.data, false);
+	}
     }
-  else
+  catch (const std::exception& e)
     {
-      throw std::runtime_error ("Optimization failed");
+      queue.fail (e.what ());
     }
+  catch (...)
+    {
+      queue.fail ("unknown error");
+    }
+}
+
+/// \brief Solve overlapping segments of the motion concurrently.
+///
+/// The motion is split into options.segments segments sharing
+/// options.segmentOverlap frames. At each ADMM iteration, every
+/// segment is solved with a proximal term pulling its shared frames
+/// toward their consensus value, then the consensus and the dual
+/// variables are updated (see TemporalConsensus). The shared frames
+/// of the written motion are the consensus.
+///
+/// The cost functions are not convex: the iterations are not
+/// guaranteed to converge, the final residuals are reported.
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static int
+solveSegments (const roboptim::retargeting::JointProblemOptions& options)
+{
+  typedef roboptim::Function::vector_t::Index index_t;
+  typedef SegmentWorker<problem_t, solver_t> worker_t;
+
+  if (options.trajectoryType != "discrete")
+    throw std::runtime_error
+      ("segments can only be solved for discrete trajectories");
+  if (options.levels != 1 || options.resampling != 1 || options.window > 0)
+    throw std::runtime_error
+      ("segments cannot be combined with multigrid levels, resampling"
+       " or windows");
+  if (options.segmentOverlap < 1)
+    throw std::runtime_error ("segments must share at least one frame");
+  if (options.admmIterations < 1)
+    throw std::runtime_error ("at least one ADMM iteration is required");
+
+  // Load the motion once, every segment is taken from it.
+  cnoid::BodyMotionPtr motion = boost::make_shared<cnoid::BodyMotion> ();
+  motion->loadStandardYAMLformat (options.jointsTrajectory);
 
+  const int first = options.startFrame;
+  const int end = options.length < 0
+    ? motion->numFrames ()
+    : std::min (motion->numFrames (), first + options.length);
+  if (end - first < 1)
+    throw std::runtime_error ("no frame to be solved");
+  const index_t nFrames = end - first;
 
-  // Re-expend trajectory.
-  boost::shared_ptr<roboptim::Trajectory<3> > finalTrajectory =
-    boost::shared_ptr<roboptim::Trajectory<3> >
-    (data.trajectory->clone ());
+  const std::vector<std::pair<index_t, index_t> > segments =
+    roboptim::retargeting::overlappingSegments
+    (nFrames, options.segments, options.segmentOverlap);
 
-  roboptim::Function::vector_t finalTrajectoryParameters =
-    finalTrajectory->parameters ();
-  for (roboptim::Function::vector_t::Index frameId = 0;
-       frameId < data.nFrames (); ++frameId)
+  // Segments are built sequentially: loading the models and the
+  // solver plug-in is not thread-safe.
+  std::vector<boost::shared_ptr<worker_t> > workers;
+  for (std::size_t segmentId = 0; segmentId < segments.size (); ++segmentId)
     {
-      roboptim::Function::vector_t::Index jointIdReduced = 0;
-      for (roboptim::Function::vector_t::Index jointId = 0;
-	   jointId < data.nDofsFull (); ++jointId)
-        {
-          if (data.disabledJointsConfiguration
-	      [static_cast<std::size_t> (jointId)])
-	    finalTrajectoryParameters[frameId * data.nDofsFull () + jointId] =
-              finalTrajectoryFiltered->parameters ()
-	      [frameId * data.nDofsFiltered () + jointIdReduced++];
-        }
+      boost::shared_ptr<worker_t> worker = boost::make_shared<worker_t> ();
+      worker->options = options;
+      worker->options.startFrame =
+	first + static_cast<int> (segments[segmentId].first);
+      worker->options.length =
+	static_cast<int> (segments[segmentId].second
+			  - segments[segmentId].first);
+      worker->options.decimation = 1;
+
+      worker->data.jointsTrajectory = motion;
+      worker->term = boost::make_shared<roboptim::retargeting::ProximalTerm> ();
+      worker->data.proximalTerm = worker->term;
+      // Disabled joints keep their value in the first frame of the
+      // motion, as in the monolithic problem.
+      if (segmentId > 0)
+	worker->data.disabledJointsConfiguration =
+	  workers[0]->data.disabledJointsConfiguration;
+
+      roboptim::retargeting::JointProblemBuilder<problem_t>
+	builder (worker->options);
+      builder (worker->problem, worker->data);
+      if (!worker->problem)
+	throw std::runtime_error ("failed to build problem");
+
+      worker->x = worker->problem->startingPoint ();
+      workers.push_back (worker);
+    }
+
+  const roboptim::retargeting::JointFunctionData& data = workers[0]->data;
+  const index_t n = data.nDofsFiltered ();
+
+  // The consensus starts from the input trajectory.
+  roboptim::Function::vector_t initial (nFrames * n);
+  for (std::size_t segmentId = 0; segmentId < segments.size (); ++segmentId)
+    initial.segment (segments[segmentId].first * n,
+		     workers[segmentId]->x.size ()) = workers[segmentId]->x;
+
+  roboptim::retargeting::TemporalConsensus consensus
+    (segments, options.segmentOverlap, n, options.admmPenalty, initial);
+
+  const std::size_t nThreads =
+    std::min (static_cast<std::size_t> (std::max (options.jobs, 1)),
+	      workers.size ());
+  std::cout
+    << (boost::format ("Solving %d segments (overlap: %d frames)"
+		       " with %d threads...\n")
+	% workers.size () % options.segmentOverlap % nThreads).str ()
+    << std::flush;
+
+  std::vector<roboptim::Function::vector_t> solutions (workers.size ());
+  int nAdmmIterations = 0;
+
+  const boost::posix_time::ptime start =
+    boost::posix_time::microsec_clock::universal_time ();
+  while (nAdmmIterations < options.admmIterations)
+    {
+      // Update the proximal terms and restart each solver from the
+      // previous solution (the solver copies the problem).
+      for (std::size_t segmentId = 0; segmentId < workers.size (); ++segmentId)
+	{
+	  worker_t& worker = *workers[segmentId];
+	  worker.term->weights = consensus.weights (segmentId);
+	  worker.term->reference = consensus.reference (segmentId);
+	  worker.problem->startingPoint () = worker.x;
+
+	  worker.factory =
+	    boost::make_shared<roboptim::SolverFactory<solver_t> >
+	    (options.plugin, *worker.problem);
+	  solver_t& solver = (*worker.factory) ();
+	  setSolverParameters
+	    (solver, (boost::format ("/tmp/ipopt-%d.log") % segmentId).str ());
+	  watchIterations<problem_t, solver_t>
+	    (solver, worker.nIterations, worker.countIterations);
+	}
+
+      SegmentQueue queue (workers.size ());
+      boost::thread_group threads;
+      for (std::size_t threadId = 0; threadId < nThreads; ++threadId)
+	threads.create_thread
+	  (boost::bind (&runSegmentWorker<problem_t, solver_t>,
+			boost::ref (workers), boost::ref (queue)));
+      threads.join_all ();
+
+      if (!queue.error.empty ())
+	throw std::runtime_error (queue.error);
+
+      for (std::size_t segmentId = 0; segmentId < workers.size (); ++segmentId)
+	solutions[segmentId] = workers[segmentId]->x;
+      consensus.update (solutions);
+      ++nAdmmIterations;
+
+      std::cout
+	<< (boost::format ("ADMM iteration %d: primal residual %g,"
+			   " dual residual %g\n")
+	    % nAdmmIterations % consensus.primalResidual ()
+	    % consensus.dualResidual ()).str ()
+	<< std::flush;
+
+      if (consensus.primalResidual () < options.admmTolerance)
+	break;
     }
-  finalTrajectory->setParameters (finalTrajectoryParameters);
+  const boost::posix_time::time_duration solveTime =
+    boost::posix_time::microsec_clock::universal_time () - start;
 
-  roboptim::retargeting::writeBodyMotion
-    (options.outputFile, finalTrajectory);
+  // Write the assembled trajectory (re-expend it).
+  const roboptim::Function::vector_t x = consensus.assemble (solutions);
+  const roboptim::retargeting::ReducedCoordinatesMap map
+    (data.disabledJointsConfiguration);
+  roboptim::retargeting::BodyMotionWriter writer
+    (options.outputFile, static_cast<int> (nFrames),
+     static_cast<int> (data.nDofsFull ()), 1. / data.dt);
+  for (index_t frame = 0; frame < nFrames; ++frame)
+    writer.write (map.expand (x.segment (frame * n, n)));
+  writer.close ();
+
+  std::size_t nIterations = 0;
+  bool countIterations = true;
+  for (std::size_t segmentId = 0; segmentId < workers.size (); ++segmentId)
+    {
+      nIterations += workers[segmentId]->nIterations;
+      countIterations =
+	countIterations && workers[segmentId]->countIterations;
+    }
+
+  const double segmentsTime =
+    1e-3 * static_cast<double> (solveTime.total_microseconds ());
+  std::cout
+    << (boost::format ("Segments: %d segments (overlap: %d), %d ADMM"
+		       " iterations, %s iterations, primal residual %g,"
+		       " dual residual %g, %g ms")
+	% workers.size () % options.segmentOverlap % nAdmmIterations
+	% (countIterations
+	   ? boost::lexical_cast<std::string> (nIterations) : "n/a")
+	% consensus.primalResidual () % consensus.dualResidual ()
+	% segmentsTime)
+    .str () << std::endl;
+
+  if (!options.compareMonolithic)
+    return 0;
+
+  // The monolithic problem evaluates its functions with the worker
+  // pool instead.
+  roboptim::retargeting::WorkerPool::resizeShared
+    (static_cast<std::size_t> (std::max (options.jobs, 1)));
+
+  roboptim::retargeting::JointProblemOptions monolithicOptions = options;
+  monolithicOptions.decimation = 1;
+  roboptim::retargeting::JointFunctionData monolithicData;
+  monolithicData.jointsTrajectory = motion;
+  std::size_t nMonolithicIterations = 0;
+  bool countMonolithicIterations = true;
+
+  const boost::posix_time::ptime monolithicStart =
+    boost::posix_time::microsec_clock::universal_time ();
+  const roboptim::Function::vector_t monolithic =
+    solveLevel<problem_t, solver_t>
+    (monolithicOptions, monolithicData, roboptim::Function::vector_t (),
+     nMonolithicIterations, countMonolithicIterations);
+  const double monolithicTime =
+    1e-3 * static_cast<double>
+    ((boost::posix_time::microsec_clock::universal_time ()
+      - monolithicStart).total_microseconds ());
+
+  std::cout
+    << (boost::format ("Monolithic: %s iterations, %g ms (speed-up: %.2f,"
+		       " max deviation: %g)")
+	% (countMonolithicIterations
+	   ? boost::lexical_cast<std::string> (nMonolithicIterations) : "n/a")
+	% monolithicTime % (monolithicTime / segmentsTime)
+	% (monolithic - x).lpNorm<Eigen::Infinity> ())
+    .str () << std::endl;
+  return 0;
+}
+
+/// \brief Build and solve the problem.
+///
+/// With several levels, the problem is solved from the coarsest
+/// temporal resolution to the full one, each level starting from
+/// the interpolated solution of the previous one.
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static int solve (const roboptim::retargeting::JointProblemOptions& options)
+{
+  if (options.resampling < 1)
+    throw std::runtime_error ("invalid resampling factor");
+  if (options.levels < 1)
+    throw std::runtime_error ("at least one level is required");
+  if (options.decimationFactor < 2 && options.levels > 1)
+    throw std::runtime_error ("the decimation factor must be at least 2");
+
+  roboptim::retargeting::JointProblemOptions levelOptions = options;
+  levelOptions.decimation = 1;
+  for (int level = 1; level < options.levels; ++level)
+    levelOptions.decimation *= options.decimationFactor;
+
+  std::vector<std::string> report;
+  roboptim::Function::vector_t solution;
+  for (int level = options.levels - 1; level >= 0; --level)
+    {
+      roboptim::retargeting::JointFunctionData data;
+      std::size_t nIterations = 0;
+      bool countIterations = true;
+
+      const boost::posix_time::ptime start =
+	boost::posix_time::microsec_clock::universal_time ();
+      solution = solveLevel<problem_t, solver_t>
+	(levelOptions, data, solution, nIterations, countIterations);
+      const boost::posix_time::time_duration solveTime =
+	boost::posix_time::microsec_clock::universal_time () - start;
+
+      report.push_back
+	((boost::format
+	  ("level %d (decimation %d): %d frames, %s iterations, %g ms")
+	  % level % levelOptions.decimation % data.nFrames ()
+	  % (countIterations
+	     ? boost::lexical_cast<std::string> (nIterations) : "n/a")
+	  % (1e-3 * static_cast<double> (solveTime.total_microseconds ())))
+	 .str ());
+      levelOptions.decimation /= std::max (options.decimationFactor, 1);
+
+      if (level > 0)
+	continue;
+
+      std::cout << *data.evaluationContexts << std::endl;
+
+      // Re-expend trajectory.
+      boost::shared_ptr<roboptim::Trajectory<3> > finalTrajectory =
+	boost::shared_ptr<roboptim::Trajectory<3> >
+	(data.trajectory->clone ());
+
+      roboptim::retargeting::ReducedCoordinatesMap map
+	(data.disabledJointsConfiguration, data.nFrames ());
+      finalTrajectory->setParameters (map.expand (solution));
+
+      // Back to the input frame rate.
+      if (options.resampling != 1)
+	{
+	  std::cout
+	    << (boost::format ("Resampling: %d frames solved, %d frames"
+			       " written") % data.nFrames () % data.nInputFrames)
+	    .str () << std::endl;
+	  finalTrajectory =
+	    boost::make_shared<roboptim::VectorInterpolation>
+	    (roboptim::retargeting::upsampleFrames
+	     (finalTrajectory->parameters (), data.nDofsFull (),
+	      options.resampling, data.nInputFrames),
+	     data.nDofsFull (), 1. / data.jointsTrajectory->frameRate ());
+	}
+
+      roboptim::retargeting::writeBodyMotion
+	(options.outputFile, finalTrajectory);
+    }
+
+  if (options.levels > 1)
+    {
+      std::cout << "Temporal multigrid:\n";
+      std::vector<std::string>::const_iterator it;
+      for (it = report.begin (); it != report.end (); ++it)
+	std::cout << "\t" << *it << "\n";
+    }
   return 0;
 }
 
+int safeMain (int argc, const char* argv[])
+{
+  roboptim::retargeting::JointProblemOptions options;
+
+  if (!parseOptions (options, argc, argv))
+    return 0;
+
+  // Size the worker pool before any function is built. Segments are
+  // solved concurrently instead: each one evaluates its functions in
+  // its own thread.
+  roboptim::retargeting::WorkerPool::resizeShared
+    (options.segments > 1
+     ? 1 : static_cast<std::size_t> (std::max (options.jobs, 1)));
+
+  if (options.segments > 1)
+    {
+      if (options.sparse)
+	return solveSegments<roboptim::retargeting::sparseProblem_t,
+			     roboptim::retargeting::sparseSolver_t> (options);
+      return solveSegments<roboptim::retargeting::denseProblem_t,
+			   roboptim::retargeting::denseSolver_t> (options);
+    }
+
+  if (options.window > 0)
+    {
+      if (options.sparse)
+	return solveWindows<roboptim::retargeting::sparseProblem_t,
+			    roboptim::retargeting::sparseSolver_t> (options);
+      return solveWindows<roboptim::retargeting::denseProblem_t,
+			  roboptim::retargeting::denseSolver_t> (options);
+    }
+
+  if (options.sparse)
+    return solve<roboptim::retargeting::sparseProblem_t,
+		 roboptim::retargeting::sparseSolver_t> (options);
+  return solve<roboptim::retargeting::denseProblem_t,
+	       roboptim::retargeting::denseSolver_t> (options);
+}
+
 int main (int argc, const char* argv[])
 {
   try
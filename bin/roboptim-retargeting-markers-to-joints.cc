@@ -15,11 +15,23 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <fstream>
+#include <limits>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/format.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/program_options.hpp>
+#include <boost/ref.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 #include <cnoid/Body>
 #include <cnoid/BodyLoader>
@@ -39,7 +51,11 @@
 
 #include <roboptim/retargeting/exception.hh>
 #include <roboptim/retargeting/io/choreonoid-body-motion.hh>
+#include <roboptim/retargeting/io/marker-stream.hh>
+#include <roboptim/retargeting/levenberg-marquardt.hh>
 #include <roboptim/retargeting/problem/marker-to-joint-problem-builder.hh>
+#include <roboptim/retargeting/resampling.hh>
+#include <roboptim/retargeting/worker-pool.hh>
 
 #include "path.hh"
 
@@ -91,7 +107,48 @@ static bool parseOptions
      "What cost function should be used?")
     ("plugin,p",
      po::value<std::string> (&options.plugin)->default_value ("cfsqp"),
-     "RobOptim plug-in to be used")
+     "RobOptim plug-in to be used"
+     " (or lm for the built-in Levenberg-Marquardt solver)")
+    ("jobs",
+     po::value<int> (&options.jobs)->default_value (1),
+     "Number of worker threads used to evaluate the functions"
+     " (or to solve the chunks, see --chunks)")
+    ("warm-start",
+     po::value<std::string> (&options.warmStart)->default_value ("previous"),
+     "Starting configuration of each frame: previous (previous frame"
+     " solution), velocity or acceleration (extrapolation of the last"
+     " solved frames)")
+    ("warm-solver-parameters",
+     po::bool_switch (&options.warmSolverParameters),
+     "With an extrapolated warm start, start IPOPT with a small"
+     " barrier parameter and bound push (the multipliers are not"
+     " warm started)")
+    ("chunks",
+     po::value<int> (&options.chunks)->default_value (0),
+     "Split the motion in N chunks solved concurrently"
+     " (0 means all frames are solved one after another)")
+
+    ("stream",
+     po::value<std::string> (&options.stream)->default_value (""),
+     "Solve the markers frames received from a pipe (-), a UNIX socket"
+     " (unix:PATH) or a growing file as soon as they arrive."
+     " The markers trajectory only provides the markers layout."
+     " Joint frames (time, then configuration) are written to the"
+     " output file (- for the standard output)")
+    ("stream-deadline",
+     po::value<double> (&options.streamDeadline)->default_value (5e-3),
+     "Time allowed to solve one streamed frame (in seconds)")
+    ("stream-max-iterations",
+     po::value<int> (&options.streamMaxIterations)->default_value (20),
+     "Maximum number of solver iterations per streamed frame")
+    ("stream-scale",
+     po::value<double> (&options.streamScale)->default_value (1.),
+     "Factor applied to the streamed positions"
+     " (e.g. 0.001 for millimeters)")
+    ("stream-timeout",
+     po::value<double> (&options.streamTimeout)->default_value (2.),
+     "Stop when no frame has been received during this duration"
+     " (in seconds, 0 means never)")
 
     ("start-frame,S",
      po::value<int> (&options.startFrame)->default_value (0),
@@ -100,6 +157,11 @@ static bool parseOptions
      po::value<int> (&options.length)->default_value (0),
      "How many frames? (0 means all frames, "
      "negative number means exclude N last frames)")
+    ("resampling",
+     po::value<int> (&options.resampling)->default_value (1),
+     "Input frames per solved frame: the markers are low-pass"
+     " filtered and decimated, the joints trajectory is upsampled"
+     " back (1 means no resampling)")
 
     ;
 
@@ -135,86 +197,258 @@ static bool parseOptions
 }
 
 
-int safeMain (int argc, const char* argv[])
+typedef roboptim::retargeting::denseProblem_t problem_t;
+typedef roboptim::retargeting::denseSolver_t solver_t;
+typedef roboptim::retargeting::MarkerToJointIncrementalProblemBuilder<problem_t>
+builder_t;
+
+/// \brief Set the parameters used to solve one frame.
+///
+/// \param solver solver to be configured
+/// \param logFile IPOPT log file
+static void setSolverParameters (solver_t& solver, const std::string& logFile)
 {
-  typedef roboptim::retargeting::denseProblem_t problem_t;
-  typedef roboptim::Solver<
-    roboptim::GenericDifferentiableFunction<roboptim::EigenMatrixDense>,
-    boost::mpl::vector<
-      roboptim::GenericLinearFunction<roboptim::EigenMatrixDense>,
-      roboptim::GenericDifferentiableFunction<roboptim::EigenMatrixDense>
-      >
-    >
-    solver_t;
+  solver.parameters ()["max-iterations"].value = 1000;
+
+  solver.parameters ()["ipopt.output_file"].value = logFile;
+  solver.parameters ()["ipopt.print_level"].value = 5;
+  solver.parameters ()["ipopt.expect_infeasible_problem"].value = "no";
+  solver.parameters ()["ipopt.nlp_scaling_method"].value = "none";
+  solver.parameters ()["ipopt.tol"].value = 1e-3;
+  solver.parameters ()["ipopt.dual_inf_tol"].value = 1.;
+  solver.parameters ()["ipopt.constr_viol_tol"].value = 1e-3;
+
+  // first-order
+  solver.parameters ()["ipopt.derivative_test"].value = "first-order";
+  solver.parameters ()["nag.verify-level"].value = 0;
+}
 
-  roboptim::retargeting::MarkerToJointProblemOptions options;
+/// \brief Relax the solver parameters for a quick, coarse solve.
+static void setCoarseSolverParameters (solver_t& solver)
+{
+  solver.parameters ()["max-iterations"].value = 50;
+  solver.parameters ()["ipopt.tol"].value = 1e-1;
+  solver.parameters ()["ipopt.dual_inf_tol"].value = 10.;
+  solver.parameters ()["ipopt.constr_viol_tol"].value = 1e-2;
+  solver.parameters ()["ipopt.derivative_test"].value = "none";
+}
 
-  if (!parseOptions (options, argc, argv))
-    return 0;
+/// \brief Tune the solver for frames starting close to their
+///        solution (--warm-solver-parameters).
+///
+/// The starting point being accurate, the barrier parameter starts
+/// small and the starting point is not pushed away from the bounds.
+/// The multipliers still start from IPOPT defaults, which may make
+/// the solve slower: this is therefore not enabled by default.
+static void setWarmSolverParameters (solver_t& solver)
+{
+  solver.parameters ()["ipopt.mu_init"].value = 1e-4;
+  solver.parameters ()["ipopt.bound_push"].value = 1e-6;
+  solver.parameters ()["ipopt.bound_frac"].value = 1e-6;
+}
 
-  // Build problem.
-  roboptim::retargeting::MarkerToJointProblemBuilder<problem_t>
-    builder (options);
+/// \brief Iteration callback counting the solver iterations.
+static void countIteration (std::size_t& nIterations,
+			    const problem_t&, solver_t::solverState_t&)
+{
+  ++nIterations;
+}
 
-  boost::shared_ptr<problem_t> problem;
-  roboptim::retargeting::MarkerToJointFunctionData data;
-  data.initialized = false;
-  options.frameId = 0;
-  builder (problem, data);
+/// \brief Solve the current frame.
+///
+/// \param solver solver, the problem being set to the frame to solve
+/// \param builder builder of the solved problem
+/// \param verbose print the solver result
+/// \return robot configuration (reduced)
+static roboptim::Function::vector_t
+solveFrame (solver_t& solver, const builder_t& builder, bool verbose)
+{
+  // Forget the previous frame solution.
+  solver.reset ();
 
-  roboptim::Function::vector_t::Index nFrames =
-    static_cast<roboptim::Function::vector_t::Index>
-    (data.markersTrajectory.numFrames ());
+  const solver_t::result_t& result = solver.minimum ();
 
-  if (options.length == 0)
-    options.length = static_cast<int> (nFrames);
-  else if (options.length < 0)
-    options.length = static_cast<int> (nFrames) - options.length;
-  if (options.length <= 0)
+  if (result.which () == solver_t::SOLVER_VALUE_WARNINGS)
+    {
+      roboptim::ResultWithWarnings result_ =
+	boost::get<roboptim::ResultWithWarnings> (result);
+      if (verbose)
+	{
+	  std::cout << "Optimization finished. Warnings have been issued\n";
+	  std::cerr << result << roboptim::iendl;
+	}
+      return builder.configuration (result_.x);
+    }
+  else if (result.which () == solver_t::SOLVER_VALUE)
+    {
+      roboptim::Result result_ =
+	boost::get<roboptim::Result> (result);
+      if (verbose)
+	{
+	  std::cout << "Optimization finished successfully.\n";
+	  std::cerr << result << roboptim::iendl;
+	}
+      return builder.configuration (result_.x);
+    }
+  throw std::runtime_error ("Optimization failed");
+}
+
+/// \brief Build the Levenberg-Marquardt solver of the
+///        markers-to-joints problem (--plugin lm).
+///
+/// Only the distance-to-marker cost and the joints-limits constraint
+/// are supported: the residual is the markers positions computed by
+/// JointToMarkerPositionChoreonoid and the joints limits are the
+/// solver bounds.
+static roboptim::retargeting::LevenbergMarquardtShPtr
+buildLevenbergMarquardt
+(const roboptim::retargeting::MarkerToJointProblemOptions& options,
+ const roboptim::retargeting::MarkerToJointFunctionData& data)
+{
+  if (options.cost != "distance-to-marker")
     throw std::runtime_error
-      ("less than 0 frame or zero frame have been selected");
+      ("the lm solver only supports the distance-to-marker cost");
+
+  const roboptim::Function::vector_t::Index n = data.nDofsFiltered ();
+  const double inf = std::numeric_limits<double>::infinity ();
+  roboptim::Function::vector_t lower =
+    roboptim::Function::vector_t::Constant (n, -inf);
+  roboptim::Function::vector_t upper =
+    roboptim::Function::vector_t::Constant (n, inf);
+
+  roboptim::retargeting::MarkerToJointFunctionFactory factory (data);
+  std::vector<std::string>::const_iterator it;
+  for (it = options.constraints.begin ();
+       it != options.constraints.end (); ++it)
+    {
+      if (*it != "joints-limits")
+	throw std::runtime_error
+	  ((boost::format ("the lm solver does not support the %s constraint")
+	    % *it).str ());
+
+      const roboptim::Function::intervals_t limits = factory.jointsLimits ();
+      for (roboptim::Function::vector_t::Index i = 0; i < n; ++i)
+	{
+	  lower[i] = limits[static_cast<std::size_t> (i)].first;
+	  upper[i] = limits[static_cast<std::size_t> (i)].second;
+	}
+    }
+
+  // markers positions as a function of the enabled joints
+  boost::shared_ptr<roboptim::DifferentiableFunction> jointToMarker =
+    roboptim::retargeting::reduceCoordinates
+    (boost::shared_ptr<roboptim::DifferentiableFunction>
+     (boost::make_shared<
+       roboptim::retargeting::JointToMarkerPositionChoreonoid<
+	 roboptim::EigenMatrixDense> >
+      (data.evaluationContexts, data.morphing)),
+     data.disabledJointsConfiguration);
+  ROBOPTIM_RETARGETING_ASSERT (jointToMarker->inputSize () == n);
+  if (jointToMarker->outputSize ()
+      != roboptim::retargeting::safeGet (data.inputTrajectory).outputSize ())
+    throw std::runtime_error
+      ("the morphing data does not map all the markers");
+
+  return boost::make_shared<roboptim::retargeting::LevenbergMarquardt>
+    (jointToMarker, lower, upper);
+}
+
+/// \brief Solve one frame with the Levenberg-Marquardt solver.
+///
+/// \param solver Levenberg-Marquardt solver
+/// \param markers markers positions of the frame
+/// \param start starting configuration (reduced)
+/// \param nIterations incremented by the number of iterations
+/// \return robot configuration (reduced)
+static roboptim::Function::vector_t
+solveFrame (roboptim::retargeting::LevenbergMarquardt& solver,
+	    const roboptim::Function::vector_t& markers,
+	    const roboptim::Function::vector_t& start,
+	    std::size_t& nIterations)
+{
+  solver.target () = markers;
+  roboptim::Function::vector_t x = start;
+  solver.solve (x);
+  nIterations += static_cast<std::size_t> (solver.iterations ());
+  return x;
+}
+
+/// \brief First and past-the-end solved frames.
+///
+/// The start frame and length options count input frames whereas
+/// one frame out of resampling is solved (see --resampling).
+static std::pair<int, int>
+solvedFrames (const roboptim::retargeting::MarkerToJointProblemOptions&
+	      options)
+{
+  return std::make_pair
+    ((options.startFrame + options.resampling - 1) / options.resampling,
+     (options.length + options.resampling - 1) / options.resampling);
+}
+
+/// \brief Solve the frames one after another, each frame starting
+///        from the previous frame solution.
+static void
+solveSequentially (roboptim::retargeting::MarkerToJointProblemOptions& options,
+		   builder_t& builder,
+		   problem_t& problem,
+		   roboptim::retargeting::MarkerToJointFunctionData& data)
+{
+  const int order =
+    roboptim::retargeting::markerToJointWarmStartOrder (options.warmStart);
+  const std::pair<int, int> frames = solvedFrames (options);
+
+  std::size_t nIterations = 0;
+  bool countIterations = true;
+
+  // Create the solver once.
+  roboptim::retargeting::LevenbergMarquardtShPtr lm;
+  boost::shared_ptr<roboptim::SolverFactory<solver_t> > factory;
+  solver_t* solver = 0;
+  if (options.plugin == "lm")
+    lm = buildLevenbergMarquardt (options, data);
+  else
+    {
+      factory = boost::make_shared<roboptim::SolverFactory<solver_t> >
+	(options.plugin, problem);
+      solver = &(*factory) ();
+      setSolverParameters (*solver, "/tmp/ipopt.log");
+
+      // Count the iterations if the plug-in supports callbacks.
+      try
+	{
+	  solver->setIterationCallback
+	    (boost::bind (&countIteration, boost::ref (nIterations), _1, _2));
+	}
+      catch (const std::runtime_error&)
+	{
+	  countIterations = false;
+	}
+    }
+
+  boost::posix_time::time_duration solveTime;
 
   std::ostream& o = std::cout;
 
-  for (options.frameId = options.startFrame;
-       options.frameId < options.length; ++options.frameId)
+  for (options.frameId = frames.first;
+       options.frameId < frames.second; ++options.frameId)
     {
       o << "╔═════════════════════╤═════════════════╗" << roboptim::iendl
 	<< (boost::format
 	    ("║ Optimizing Frame... │ %-6d / %-6d ║")
 	    % options.frameId
-	    % (options.length - 1)).str () << roboptim::iendl
+	    % (frames.second - 1)).str () << roboptim::iendl
 	<< "╚═════════════════════╧═════════════════╝" << roboptim::iendl
 	;
 
-      builder (problem, data);
-
-      if (!problem)
-	throw std::runtime_error ("failed to build problem");
-
-      roboptim::SolverFactory<solver_t>
-	factory (options.plugin, *problem);
-      solver_t& solver = factory ();
-
-      // Set solver parameters.
-      solver.parameters ()["max-iterations"].value = 1000;
-
-      solver.parameters ()["ipopt.output_file"].value =
-	"/tmp/ipopt.log";
-      solver.parameters ()["ipopt.print_level"].value = 5;
-      solver.parameters ()["ipopt.expect_infeasible_problem"].value = "no";
-      solver.parameters ()["ipopt.nlp_scaling_method"].value = "none";
-      solver.parameters ()["ipopt.tol"].value = 1e-3;
-      solver.parameters ()["ipopt.dual_inf_tol"].value = 1.;
-      solver.parameters ()["ipopt.constr_viol_tol"].value = 1e-3;
-
-      // first-order
-      solver.parameters ()["ipopt.derivative_test"].value = "first-order";
-      solver.parameters ()["nag.verify-level"].value = 0;
-
-      std::cout << solver << roboptim::resetindent << roboptim::iendl;
-
-      const solver_t::result_t& result = solver.minimum ();
+      roboptim::Function::vector_t startingConfiguration =
+	order > 0 && options.frameId > frames.first
+	? roboptim::retargeting::markerToJointExtrapolatedConfiguration
+	(data.outputTrajectoryReduced->parameters (),
+	 data.nDofsFiltered (), options.frameId,
+	 options.frameId - frames.first, order)
+	: roboptim::retargeting::markerToJointStartingConfiguration
+	(data, options.frameId);
 
       roboptim::Function::vector_t parameters =
 	data.outputTrajectoryReduced->parameters ();
@@ -224,29 +458,34 @@ int safeMain (int argc, const char* argv[])
 	static_cast<roboptim::Function::vector_t::Index>
 	(options.frameId * length);
 
-
-      if (result.which () == solver_t::SOLVER_VALUE_WARNINGS)
-	{
-	  std::cout << "Optimization finished. Warnings have been issued\n";
-	  roboptim::ResultWithWarnings result_ =
-	    boost::get<roboptim::ResultWithWarnings> (result);
-	  std::cerr << result << roboptim::iendl;
-
-	  parameters.segment (start, length) = result_.x;
-	}
-      else if (result.which () == solver_t::SOLVER_VALUE)
+      const boost::posix_time::ptime solveStart =
+	boost::posix_time::microsec_clock::universal_time ();
+      if (lm)
 	{
-	  std::cout << "Optimization finished successfully.\n";
-	  roboptim::Result result_ =
-	    boost::get<roboptim::Result> (result);
-	  std::cerr << result << roboptim::iendl;
-
-	  parameters.segment (start, length) = result_.x;
+	  const roboptim::Function::vector_t::Index size =
+	    data.inputTrajectory->outputSize ();
+	  data.frameId = options.frameId;
+	  parameters.segment (start, length) =
+	    solveFrame (*lm, data.inputTrajectory->parameters ().segment
+			(options.frameId * size, size),
+			startingConfiguration, nIterations);
 	}
       else
 	{
-	  throw std::runtime_error ("Optimization failed");
+	  // Swap the markers reference positions and the starting
+	  // configuration.
+	  builder.setFrame (options.frameId, data, startingConfiguration);
+	  if (options.warmSolverParameters
+	      && order > 0 && options.frameId == frames.first + 1)
+	    setWarmSolverParameters (*solver);
+
+	  std::cout << *solver << roboptim::resetindent << roboptim::iendl;
+
+	  parameters.segment (start, length) =
+	    solveFrame (*solver, builder, true);
 	}
+      solveTime += boost::posix_time::microsec_clock::universal_time ()
+	- solveStart;
 
       data.outputTrajectoryReduced->setParameters (parameters);
 
@@ -256,30 +495,471 @@ int safeMain (int argc, const char* argv[])
 	data.outputTrajectoryReduced->normalizeAngles (3 + dofId);
     }
 
-  // Re-expend trajectory.
-  roboptim::Function::vector_t finalTrajectoryParameters =
-    data.outputTrajectory->parameters ();
-  for (roboptim::Function::vector_t::Index frameId = 0;
-       frameId < nFrames; ++frameId)
+  const int nSolved = frames.second - frames.first;
+  if (nSolved <= 0)
+    return;
+  if (countIterations)
+    o << (boost::format
+	  ("Solver iterations: %d (%g per frame, warm start: %s)")
+	  % nIterations
+	  % (static_cast<double> (nIterations) / nSolved)
+	  % options.warmStart).str () << roboptim::iendl;
+  o << (boost::format ("Solve time: %g ms per frame")
+	% (1e-3 * static_cast<double> (solveTime.total_microseconds ())
+	   / nSolved)).str () << roboptim::iendl;
+}
+
+/// \brief Problem and solver owned by one chunk worker.
+///
+/// Each worker loads its own robot model and marker data so that
+/// no state is shared with the other workers.
+struct ChunkWorker
+{
+  ChunkWorker (const roboptim::retargeting::MarkerToJointProblemOptions&
+	       options_, std::size_t id)
+    : options (options_),
+      data (),
+      builder (options),
+      problem (),
+      factory (),
+      solver (),
+      logFile ()
+  {
+    data.initialized = false;
+    options.frameId = 0;
+    builder (problem, data);
+    if (!problem)
+      throw std::runtime_error ("failed to build problem");
+
+    factory = boost::make_shared<roboptim::SolverFactory<solver_t> >
+      (options.plugin, *problem);
+    solver = &(*factory) ();
+    logFile = (boost::format ("/tmp/ipopt-%d.log") % id).str ();
+    setSolverParameters (*solver, logFile);
+  }
+
+  roboptim::retargeting::MarkerToJointProblemOptions options;
+  roboptim::retargeting::MarkerToJointFunctionData data;
+  builder_t builder;
+  boost::shared_ptr<problem_t> problem;
+  boost::shared_ptr<roboptim::SolverFactory<solver_t> > factory;
+  solver_t* solver;
+  std::string logFile;
+};
+
+/// \brief Chunks left to be solved, shared by the workers.
+struct ChunkQueue
+{
+  typedef roboptim::Function::vector_t::Index index_t;
+
+  ChunkQueue ()
+    : chunks (),
+      next (0),
+      error (),
+      mutex ()
+  {}
+
+  /// \brief Pop the next chunk.
+  ///
+  /// \return false if there is no chunk left or a worker failed
+  bool pop (std::pair<index_t, index_t>& chunk)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    if (next >= chunks.size () || !error.empty ())
+      return false;
+    chunk = chunks[next++];
+    return true;
+  }
+
+  /// \brief Record a worker failure (the first one is kept).
+  void fail (const std::string& message)
+  {
+    boost::lock_guard<boost::mutex> lock (mutex);
+    if (error.empty ())
+      error = message;
+  }
+
+  /// \brief First and past-the-end frames of each chunk.
+  std::vector<std::pair<index_t, index_t> > chunks;
+  /// \brief Next chunk to be solved.
+  std::size_t next;
+  /// \brief First error raised by a worker.
+  std::string error;
+  boost::mutex mutex;
+};
+
+/// \brief Solve one chunk.
+///
+/// The first frame is seeded by a coarse solve starting from the
+/// reference pose, the other frames start from the previous frames
+/// solutions (see --warm-start). Only the chunk frames are written
+/// in parameters.
+static void
+solveChunk (ChunkWorker& worker,
+	    const std::pair<ChunkQueue::index_t, ChunkQueue::index_t>& chunk,
+	    roboptim::Function::vector_t& parameters)
+{
+  typedef roboptim::Function::vector_t::Index index_t;
+  const index_t n = worker.data.nDofsFiltered ();
+
+  roboptim::Function::vector_t start =
+    roboptim::retargeting::markerToJointStartingConfiguration
+    (worker.data, 0);
+
+  if (chunk.first > 0)
+    {
+      worker.builder.setFrame (chunk.first, worker.data, start);
+      setCoarseSolverParameters (*worker.solver);
+      start = solveFrame (*worker.solver, worker.builder, false);
+      setSolverParameters (*worker.solver, worker.logFile);
+    }
+
+  const int order =
+    roboptim::retargeting::markerToJointWarmStartOrder
+    (worker.options.warmStart);
+
+  for (index_t frameId = chunk.first; frameId < chunk.second; ++frameId)
+    {
+      if (frameId > chunk.first)
+	start = roboptim::retargeting::markerToJointExtrapolatedConfiguration
+	  (parameters, n, frameId, frameId - chunk.first, order);
+      worker.builder.setFrame (frameId, worker.data, start);
+      parameters.segment (frameId * n, n) =
+	solveFrame (*worker.solver, worker.builder, false);
+    }
+}
+
+/// \brief Worker thread body: solve chunks until the queue is empty.
+static void
+runChunkWorker (ChunkWorker& worker, ChunkQueue& queue,
+		roboptim::Function::vector_t& parameters)
+{
+  try
+    {
+      std::pair<ChunkQueue::index_t, ChunkQueue::index_t> chunk;
+      while (queue.pop (chunk))
+	{
+	  solveChunk (worker, chunk, parameters);
+	  std::cout
+	    << (boost::format ("Chunk [%d, %d[ solved.\n")
+		% chunk.first % chunk.second).str () << std::flush;
+	}
+    }
+  catch (const std::exception& e)
+    {
+      queue.fail (e.what ());
+    }
+  catch (...)
+    {
+      queue.fail ("unknown error");
+    }
+}
+
+/// \brief Solve the motion in chunks of consecutive frames, the
+///        chunks being solved concurrently.
+///
+/// Each worker owns its robot model, problem and solver; chunks
+/// write disjoint segments of the trajectory parameters so no lock
+/// is needed on the output. The discontinuities at the chunks seams
+/// are reported at the end.
+static void
+solveChunks (roboptim::retargeting::MarkerToJointProblemOptions& options,
+	     roboptim::retargeting::MarkerToJointFunctionData& data)
+{
+  typedef roboptim::Function::vector_t::Index index_t;
+
+  const std::pair<int, int> frames = solvedFrames (options);
+  const index_t first = frames.first;
+  const index_t nSolvedFrames = frames.second - first;
+  const index_t nChunks = std::min<index_t> (options.chunks, nSolvedFrames);
+
+  ChunkQueue queue;
+  for (index_t chunkId = 0; chunkId < nChunks; ++chunkId)
+    queue.chunks.push_back
+      (std::make_pair (first + chunkId * nSolvedFrames / nChunks,
+		       first + (chunkId + 1) * nSolvedFrames / nChunks));
+
+  const std::size_t nWorkers =
+    std::min (static_cast<std::size_t> (std::max (options.jobs, 1)),
+	      queue.chunks.size ());
+
+  // Workers are built sequentially: loading the models and the
+  // solver plug-in is not thread-safe.
+  std::vector<boost::shared_ptr<ChunkWorker> > workers;
+  for (std::size_t workerId = 0; workerId < nWorkers; ++workerId)
+    workers.push_back (boost::make_shared<ChunkWorker> (options, workerId));
+
+  std::cout << (boost::format ("Solving %d chunks with %d workers...\n")
+		% queue.chunks.size () % nWorkers).str () << std::flush;
+
+  roboptim::Function::vector_t parameters =
+    data.outputTrajectoryReduced->parameters ();
+
+  boost::thread_group threads;
+  for (std::size_t workerId = 0; workerId < nWorkers; ++workerId)
+    threads.create_thread
+      (boost::bind (&runChunkWorker, boost::ref (*workers[workerId]),
+		    boost::ref (queue), boost::ref (parameters)));
+  threads.join_all ();
+
+  if (!queue.error.empty ())
+    throw std::runtime_error (queue.error);
+
+  data.outputTrajectoryReduced->setParameters (parameters);
+
+  // Normalize angles in the trajectory (except base position)
+  for (roboptim::Function::size_type dofId = 0;
+       dofId < data.nDofsFiltered () - 3; ++dofId)
+    data.outputTrajectoryReduced->normalizeAngles (3 + dofId);
+
+  // Report the seams discontinuities, compared to the average
+  // frame-to-frame variation inside the chunks.
+  const roboptim::Function::vector_t& x =
+    data.outputTrajectoryReduced->parameters ();
+  const index_t n = data.nDofsFiltered ();
+
+  // Frames are counted in solved (resampled) frames.
+  const index_t end = frames.second;
+  std::vector<bool> isSeam (static_cast<std::size_t> (end), false);
+  for (std::size_t chunkId = 1; chunkId < queue.chunks.size (); ++chunkId)
+    isSeam[static_cast<std::size_t> (queue.chunks[chunkId].first)] = true;
+
+  double meanStep = 0.;
+  index_t nSteps = 0;
+  for (index_t frameId = first + 1; frameId < end; ++frameId)
+    if (!isSeam[static_cast<std::size_t> (frameId)])
+      {
+	meanStep += (x.segment (frameId * n, n)
+		     - x.segment ((frameId - 1) * n, n))
+	  .lpNorm<Eigen::Infinity> ();
+	++nSteps;
+      }
+  if (nSteps > 0)
+    meanStep /= static_cast<double> (nSteps);
+
+  std::ostream& o = std::cout;
+  o << "Chunks seams (max. configuration jump):" << roboptim::incindent;
+  for (std::size_t chunkId = 1; chunkId < queue.chunks.size (); ++chunkId)
+    {
+      const index_t frameId = queue.chunks[chunkId].first;
+      const double step =
+	(x.segment (frameId * n, n) - x.segment ((frameId - 1) * n, n))
+	.lpNorm<Eigen::Infinity> ();
+      o << roboptim::iendl
+	<< (boost::format ("frame %d: %g (%g times the mean step)")
+	    % frameId % step % (meanStep > 0. ? step / meanStep : 0.)).str ();
+    }
+  o << roboptim::decindent << roboptim::iendl;
+}
+
+/// \brief Percentile of sorted values.
+static double percentile (const std::vector<double>& values, double p)
+{
+  if (values.empty ())
+    return 0.;
+  std::size_t id = static_cast<std::size_t>
+    (p * static_cast<double> (values.size () - 1) + .5);
+  return values[std::min (id, values.size () - 1)];
+}
+
+/// \brief Solve the markers frames received on a stream, one frame
+///        at a time, as soon as they arrive.
+///
+/// Each frame is solved under a deadline (IPOPT CPU time limit) and
+/// an iterations cap (the only limit of the lm solver), starting
+/// from the previous frame solution. If
+/// the solver fails, the previous configuration is kept. When the
+/// frames arrive faster than they are solved, the oldest ones are
+/// dropped.
+///
+/// The configurations are written as soon as they are computed, one
+/// text line per frame: time, then the robot configuration.
+static void
+solveStream (const roboptim::retargeting::MarkerToJointProblemOptions& options,
+	     builder_t& builder,
+	     problem_t& problem,
+	     roboptim::retargeting::MarkerToJointFunctionData& data)
+{
+  roboptim::retargeting::MarkerStream stream
+    (options.stream,
+     roboptim::retargeting::safeGet (data.inputTrajectory).outputSize () / 3,
+     options.streamScale, options.streamTimeout);
+
+  roboptim::retargeting::LevenbergMarquardtShPtr lm;
+  boost::shared_ptr<roboptim::SolverFactory<solver_t> > factory;
+  solver_t* solver = 0;
+  if (options.plugin == "lm")
     {
-      roboptim::Function::vector_t::Index jointIdReduced = 0;
-      for (roboptim::Function::vector_t::Index jointId = 0;
-	   jointId < data.nDofsFull (); ++jointId)
-        {
-          if (data.disabledJointsConfiguration
-	      [static_cast<std::size_t> (jointId)])
-	    finalTrajectoryParameters[frameId * data.nDofsFull () + jointId] =
-	      *(data.disabledJointsConfiguration)
-	      [static_cast<std::size_t> (jointId)];
+      lm = buildLevenbergMarquardt (options, data);
+      lm->setMaxIterations (options.streamMaxIterations);
+    }
+  else
+    {
+      factory = boost::make_shared<roboptim::SolverFactory<solver_t> >
+	(options.plugin, problem);
+      solver = &(*factory) ();
+      setSolverParameters (*solver, "/tmp/ipopt.log");
+      solver->parameters ()["max-iterations"].value =
+	options.streamMaxIterations;
+      solver->parameters ()["ipopt.max_cpu_time"].value =
+	options.streamDeadline;
+      solver->parameters ()["ipopt.print_level"].value = 0;
+      solver->parameters ()["ipopt.derivative_test"].value = "none";
+    }
+  std::size_t nIterations = 0;
+
+  std::ofstream file;
+  std::ostream* output = &std::cout;
+  if (options.outputFile != "-")
+    {
+      file.open (options.outputFile.c_str ());
+      if (!file)
+	throw std::runtime_error
+	  ((boost::format ("failed to open %s") % options.outputFile).str ());
+      output = &file;
+    }
+
+  roboptim::Function::vector_t configuration =
+    roboptim::retargeting::markerToJointStartingConfiguration (data, 0);
+  // add the disabled joints to the written configurations
+  const roboptim::retargeting::ReducedCoordinatesMap map
+    (data.disabledJointsConfiguration);
+
+  std::vector<double> latencies;
+  std::size_t nDropped = 0;
+  std::size_t nFailed = 0;
+  std::size_t nLate = 0;
+
+  roboptim::retargeting::MarkerStreamFrame frame;
+  while (stream.read (frame, true))
+    {
+      nDropped += frame.dropped;
+
+      try
+	{
+	  if (lm)
+	    configuration =
+	      solveFrame (*lm, frame.positions, configuration, nIterations);
 	  else
 	    {
-	      finalTrajectoryParameters[frameId * data.nDofsFull () + jointId] =
-		data.outputTrajectoryReduced->parameters ()
-		[frameId * data.nDofsFiltered () + jointIdReduced++];
+	      builder.setMarkers (frame.positions, configuration);
+	      configuration = solveFrame (*solver, builder, false);
 	    }
-        }
+	}
+      catch (const std::runtime_error&)
+	{
+	  ++nFailed;
+	}
+
+      *output << frame.time;
+      roboptim::Function::vector_t full = map.expand (configuration);
+      for (roboptim::Function::vector_t::Index i = 0; i < full.size (); ++i)
+	*output << ' ' << full[i];
+      *output << std::endl;
+
+      const double latency = 1e-6 * static_cast<double>
+	((boost::posix_time::microsec_clock::universal_time ()
+	  - frame.received).total_microseconds ());
+      if (latency > options.streamDeadline)
+	++nLate;
+      latencies.push_back (latency);
     }
-  data.outputTrajectory->setParameters (finalTrajectoryParameters);
+
+  std::sort (latencies.begin (), latencies.end ());
+
+  std::ostream& o = std::cerr;
+  o << (boost::format ("%d frames solved, %d dropped, %d failed,"
+		       " %d over the deadline (%g ms)")
+	% latencies.size () % nDropped % nFailed % nLate
+	% (1e3 * options.streamDeadline)).str () << roboptim::iendl
+    << "Latency (ms):" << roboptim::incindent << roboptim::iendl
+    << (boost::format ("p50: %g") % (1e3 * percentile (latencies, .5))).str ()
+    << roboptim::iendl
+    << (boost::format ("p90: %g") % (1e3 * percentile (latencies, .9))).str ()
+    << roboptim::iendl
+    << (boost::format ("p99: %g") % (1e3 * percentile (latencies, .99))).str ()
+    << roboptim::iendl
+    << (boost::format ("max: %g") % (1e3 * percentile (latencies, 1.))).str ()
+    << roboptim::decindent << roboptim::iendl;
+}
+
+int safeMain (int argc, const char* argv[])
+{
+  roboptim::retargeting::MarkerToJointProblemOptions options;
+
+  if (!parseOptions (options, argc, argv))
+    return 0;
+
+  // Size the worker pool before any function is built. When solving
+  // chunks, the threads solve the chunks instead of evaluating the
+  // functions.
+  roboptim::retargeting::WorkerPool::resizeShared
+    (options.chunks > 1
+     ? 1 : static_cast<std::size_t> (std::max (options.jobs, 1)));
+
+  if (options.resampling < 1)
+    throw std::runtime_error ("invalid resampling factor");
+  if (options.resampling != 1 && !options.stream.empty ())
+    throw std::runtime_error ("streamed frames cannot be resampled");
+
+  // Build problem (once, it is then updated for each frame).
+  builder_t builder (options);
+
+  boost::shared_ptr<problem_t> problem;
+  roboptim::retargeting::MarkerToJointFunctionData data;
+  data.initialized = false;
+  options.frameId = 0;
+  builder (problem, data);
+
+  roboptim::Function::vector_t::Index nFrames =
+    static_cast<roboptim::Function::vector_t::Index>
+    (data.markersTrajectory.numFrames ());
+
+  if (options.length == 0)
+    options.length = static_cast<int> (nFrames);
+  else if (options.length < 0)
+    options.length = static_cast<int> (nFrames) - options.length;
+  if (options.length <= 0)
+    throw std::runtime_error
+      ("less than 0 frame or zero frame have been selected");
+
+  if (!problem)
+    throw std::runtime_error ("failed to build problem");
+
+  if (!options.stream.empty ())
+    {
+      solveStream (options, builder, *problem, data);
+      return 0;
+    }
+
+  if (options.chunks > 1 && options.plugin == "lm")
+    throw std::runtime_error
+      ("solving chunks requires a RobOptim solver plug-in");
+
+  if (options.chunks > 1)
+    solveChunks (options, data);
+  else
+    solveSequentially (options, builder, *problem, data);
+
+  std::ostream& o = std::cout;
+
+  o << *data.evaluationContexts << roboptim::iendl;
+
+  // Re-expend trajectory.
+  roboptim::retargeting::ReducedCoordinatesMap map
+    (data.disabledJointsConfiguration, data.nFrames ());
+  data.outputTrajectory->setParameters
+    (map.expand (data.outputTrajectoryReduced->parameters ()));
+
+  // Back to the input frame rate.
+  if (options.resampling != 1)
+    data.outputTrajectory =
+      boost::make_shared<roboptim::VectorInterpolation>
+      (roboptim::retargeting::upsampleFrames
+       (data.outputTrajectory->parameters (), data.nDofsFull (),
+	options.resampling, nFrames),
+       data.nDofsFull (), 1. / data.markersTrajectory.dataRate ());
+
   roboptim::retargeting::writeBodyMotion
     (options.outputFile, data.outputTrajectory);
   return 0;
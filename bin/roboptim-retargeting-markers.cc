@@ -15,6 +15,7 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 #include <string>
@@ -31,6 +32,8 @@
 #include <roboptim/retargeting/exception.hh>
 #include <roboptim/retargeting/io/trc.hh>
 #include <roboptim/retargeting/problem/marker-problem-builder.hh>
+#include <roboptim/retargeting/resampling.hh>
+#include <roboptim/retargeting/worker-pool.hh>
 
 #include "path.hh"
 
@@ -77,9 +80,22 @@ static bool parseOptions
     ("plugin,p",
      po::value<std::string> (&options.plugin)->default_value ("cfsqp"),
      "RobOptim plug-in to be used")
+    ("jobs",
+     po::value<int> (&options.jobs)->default_value (1),
+     "Number of worker threads used to evaluate the functions")
+    ("sparse",
+     po::bool_switch (&options.sparse),
+     "Use sparse jacobians (the plug-in must support sparse problems)")
     ("cost,c",
      po::value<std::string> (&options.cost)->default_value ("lde"),
      "What cost function should be used?")
+    ("smoothness-scale",
+     po::value<double> (&options.smoothnessScale)->default_value (1.),
+     "Global weight of the acceleration and jerk costs")
+    ("smoothness-weight",
+     po::value<std::vector<std::string> > (&options.smoothnessWeights),
+     "Weight of a marker in the acceleration and jerk costs"
+     " (NAME=WEIGHT, 1 by default)")
     ("constraint,C",
      po::value<std::vector<std::string> > (&options.constraints),
      "Which constraints should be used?")
@@ -90,6 +106,11 @@ static bool parseOptions
     ("length",
      po::value<int> (&options.length)->default_value (-1),
      "How many frames will be considered? (-1 means all)")
+    ("resampling",
+     po::value<int> (&options.resampling)->default_value (1),
+     "Input frames per optimized frame: the markers trajectory is"
+     " low-pass filtered and decimated, the result is upsampled back"
+     " (1 means no resampling)")
     ;
 
   po::variables_map vm;
@@ -123,26 +144,15 @@ static bool parseOptions
   return true;
 }
 
-int safeMain (int argc, const char* argv[])
+/// \brief Build and solve the problem.
+///
+/// \tparam problem_t problem type (dense or sparse)
+/// \tparam solver_t solver type matching the problem type
+template <typename problem_t, typename solver_t>
+static int solve (const roboptim::retargeting::MarkerProblemOptions& options)
 {
-  typedef roboptim::retargeting::denseProblem_t problem_t;
-  typedef roboptim::Solver<
-    roboptim::GenericDifferentiableFunction<roboptim::EigenMatrixDense>,
-    boost::mpl::vector<
-      roboptim::GenericLinearFunction<roboptim::EigenMatrixDense>,
-      roboptim::GenericDifferentiableFunction<roboptim::EigenMatrixDense>
-      >
-    >
-    solver_t;
-
-  roboptim::retargeting::MarkerProblemOptions options;
-
-  if (!parseOptions (options, argc, argv))
-    return 0;
-
   // Build problem.
-  roboptim::retargeting::MarkerProblemBuilder<
-    roboptim::retargeting::denseProblem_t>
+  roboptim::retargeting::MarkerProblemBuilder<problem_t>
     builder (options);
 
   boost::shared_ptr<problem_t> problem;
@@ -174,7 +184,7 @@ int safeMain (int argc, const char* argv[])
 
   std::cout << solver << std::endl;
 
-  const solver_t::result_t& result = solver.minimum ();
+  const typename solver_t::result_t& result = solver.minimum ();
 
   //FIXME: does not work with splines.
   roboptim::Function::size_type numFrames =
@@ -208,12 +218,40 @@ int safeMain (int argc, const char* argv[])
       throw std::runtime_error ("Optimization failed");
     }
 
+  // Back to the input frame rate.
+  if (options.resampling != 1)
+    finalTrajectory =
+      boost::make_shared<roboptim::VectorInterpolation>
+      (roboptim::retargeting::upsampleFrames
+       (finalTrajectory->parameters (), finalTrajectory->outputSize (),
+	options.resampling, data.nInputFrames),
+       finalTrajectory->outputSize (),
+       1. / data.markersTrajectory.dataRate ());
+
   roboptim::retargeting::writeTRC
     (options.outputFile, *finalTrajectory, safeGet (data.mapping));
 
   return 0;
 }
 
+int safeMain (int argc, const char* argv[])
+{
+  roboptim::retargeting::MarkerProblemOptions options;
+
+  if (!parseOptions (options, argc, argv))
+    return 0;
+
+  // Size the worker pool before any function is built.
+  roboptim::retargeting::WorkerPool::resizeShared
+    (static_cast<std::size_t> (std::max (options.jobs, 1)));
+
+  if (options.sparse)
+    return solve<roboptim::retargeting::sparseProblem_t,
+		 roboptim::retargeting::sparseSolver_t> (options);
+  return solve<roboptim::retargeting::denseProblem_t,
+	       roboptim::retargeting::denseSolver_t> (options);
+}
+
 int main (int argc, const char* argv[])
 {
   try
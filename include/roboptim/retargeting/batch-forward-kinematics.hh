@@ -0,0 +1,314 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_BATCH_FORWARD_KINEMATICS_HH
+# define ROBOPTIM_RETARGETING_BATCH_FORWARD_KINEMATICS_HH
+# include <stdexcept>
+# include <vector>
+
+# include <boost/format.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <Eigen/Core>
+
+# include <cnoid/Body>
+# include <cnoid/Link>
+
+# include <roboptim/retargeting/eigen-rigid-body.hh>
+# include <roboptim/retargeting/utility.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (BatchForwardKinematics);
+
+    /// \brief Forward kinematics for many configurations at once.
+    ///
+    /// Choreonoid propagates the link transforms of one
+    /// configuration at a time. This class propagates the
+    /// transforms of K configurations link by link instead: every
+    /// quantity is stored as a column of K values (structure of
+    /// arrays) so that each operation is a coefficient-wise
+    /// operation on contiguous arrays, vectorized by Eigen.
+    ///
+    /// Input layout: K x (6 + number of joints) matrix, row k being
+    /// the configuration k (free-floating translation, Euler angles
+    /// and joints values, see updateRobotConfiguration).
+    ///
+    /// Output layout, for each link:
+    /// - position: K x 3 block, column d being the coordinate d,
+    /// - rotation: K x 9 block, column r + 3 c being the rotation
+    ///   matrix coefficient (r, c).
+    ///
+    /// Only revolute, slide and fixed joints are supported, which
+    /// is enough for the humanoid models used here. The robot model
+    /// is read once at construction and the robot itself is never
+    /// modified.
+    class BatchForwardKinematics
+    {
+    public:
+      typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> matrix_t;
+      typedef Eigen::Array<double, Eigen::Dynamic, 1> array_t;
+      typedef Eigen::Block<const matrix_t> constBlock_t;
+
+      explicit BatchForwardKinematics (cnoid::BodyPtr robot)
+	: robot_ (robot),
+	  links_ (),
+	  positions_ (),
+	  rotations_ (),
+	  jointRotation_ (),
+	  cos_ (),
+	  sin_ (),
+	  oneMinusCos_ ()
+      {
+	links_.resize (static_cast<std::size_t> (robot->numLinks ()));
+	for (int linkId = 0; linkId < robot->numLinks (); ++linkId)
+	  {
+	    const cnoid::Link* link = robot->link (linkId);
+	    LinkData& data = links_[static_cast<std::size_t> (linkId)];
+
+	    data.parent = link->parent () ? link->parent ()->index () : -1;
+	    if (linkId > 0 && (data.parent < 0 || data.parent >= linkId))
+	      {
+		boost::format fmt
+		  ("link %d (%s) is not sorted after its parent");
+		fmt % linkId % link->name ();
+		throw std::runtime_error (fmt.str ());
+	      }
+
+	    switch (link->jointType ())
+	      {
+	      case cnoid::Link::ROTATIONAL_JOINT:
+		data.type = REVOLUTE;
+		break;
+	      case cnoid::Link::SLIDE_JOINT:
+		data.type = SLIDE;
+		break;
+	      default:
+		data.type = FIXED;
+		break;
+	      }
+	    if (data.type != FIXED && link->jointId () < 0)
+	      data.type = FIXED;
+
+	    data.column = 6 + link->jointId ();
+	    data.b = link->b ();
+	    data.a = link->a ();
+
+	    // Rodrigues formula: R = I + sin (q) K + (1 - cos (q)) K^2
+	    data.K <<
+	      0., -data.a[2], data.a[1],
+	      data.a[2], 0., -data.a[0],
+	      -data.a[1], data.a[0], 0.;
+	    data.K2 = data.K * data.K;
+	  }
+      }
+
+      ~BatchForwardKinematics ()
+      {}
+
+      /// \brief Robot model.
+      const cnoid::BodyPtr& robot () const
+      {
+	return robot_;
+      }
+
+      /// \brief Number of configurations of the last computation.
+      matrix_t::Index size () const
+      {
+	return positions_.rows ();
+      }
+
+      /// \brief Compute links positions and rotations.
+      ///
+      /// \param configurations K x (6 + number of joints) matrix, one
+      ///        configuration per row
+      template <typename Derived>
+      void compute (const Eigen::MatrixBase<Derived>& configurations)
+      {
+	if (configurations.cols () != 6 + robot_->numJoints ())
+	  {
+	    boost::format fmt
+	      ("invalid configurations size (%d columns, %d expected)");
+	    fmt % configurations.cols () % (6 + robot_->numJoints ());
+	    throw std::runtime_error (fmt.str ());
+	  }
+
+	const matrix_t::Index K = configurations.rows ();
+	const matrix_t::Index nLinks =
+	  static_cast<matrix_t::Index> (links_.size ());
+	positions_.resize (K, 3 * nLinks);
+	rotations_.resize (K, 9 * nLinks);
+	jointRotation_.resize (K, 9);
+	cos_.resize (K);
+	sin_.resize (K);
+	oneMinusCos_.resize (K);
+
+	// Root link: free-floating joint.
+	positions_.leftCols (3) = configurations.leftCols (3);
+	Eigen::Matrix<double, 3, 3> R;
+	for (matrix_t::Index k = 0; k < K; ++k)
+	  {
+	    eulerToTransform
+	      (R, configurations.row (k).template segment<3> (3).transpose ());
+	    for (int e = 0; e < 9; ++e)
+	      rotations_ (k, e) = R (e % 3, e / 3);
+	  }
+
+	for (matrix_t::Index linkId = 1; linkId < nLinks; ++linkId)
+	  {
+	    const LinkData& link = links_[static_cast<std::size_t> (linkId)];
+	    const matrix_t::Index p = link.parent;
+
+	    switch (link.type)
+	      {
+	      case REVOLUTE:
+		cos_ = configurations.col (link.column).array ().cos ();
+		sin_ = configurations.col (link.column).array ().sin ();
+		oneMinusCos_ = 1. - cos_;
+		for (int e = 0; e < 9; ++e)
+		  jointRotation_.col (e).array () =
+		    (e % 4 == 0 ? 1. : 0.)
+		    + link.K (e % 3, e / 3) * sin_
+		    + link.K2 (e % 3, e / 3) * oneMinusCos_;
+		multiplyRotations (linkId, p);
+		translate (linkId, p, link.b);
+		break;
+
+	      case SLIDE:
+		rotations_.middleCols (9 * linkId, 9) =
+		  rotations_.middleCols (9 * p, 9);
+		translate (linkId, p, link.b);
+		// p += R_parent * a * q
+		for (int r = 0; r < 3; ++r)
+		  positions_.col (3 * linkId + r).array () +=
+		    (link.a[0] * rotations_.col (9 * p + r).array ()
+		     + link.a[1] * rotations_.col (9 * p + r + 3).array ()
+		     + link.a[2] * rotations_.col (9 * p + r + 6).array ())
+		    * configurations.col (link.column).array ();
+		break;
+
+	      case FIXED:
+		rotations_.middleCols (9 * linkId, 9) =
+		  rotations_.middleCols (9 * p, 9);
+		translate (linkId, p, link.b);
+		break;
+	      }
+	  }
+      }
+
+      /// \brief Positions of a link (K x 3).
+      constBlock_t position (int linkId) const
+      {
+	return positions_.block (0, 3 * linkId, positions_.rows (), 3);
+      }
+
+      /// \brief Rotations of a link (K x 9, column-major coefficients).
+      constBlock_t rotation (int linkId) const
+      {
+	return rotations_.block (0, 9 * linkId, rotations_.rows (), 9);
+      }
+
+      /// \brief Position of a link for one configuration.
+      Eigen::Vector3d position (int linkId, matrix_t::Index k) const
+      {
+	return positions_.block<1, 3> (k, 3 * linkId).transpose ();
+      }
+
+      /// \brief Rotation of a link for one configuration.
+      Eigen::Matrix3d rotation (int linkId, matrix_t::Index k) const
+      {
+	Eigen::Matrix3d R;
+	for (int e = 0; e < 9; ++e)
+	  R (e % 3, e / 3) = rotations_ (k, 9 * linkId + e);
+	return R;
+      }
+
+    private:
+      enum JointType
+	{
+	  FIXED,
+	  REVOLUTE,
+	  SLIDE
+	};
+
+      /// \brief Constant data of one link.
+      struct LinkData
+      {
+	/// \brief Parent link index (-1 for the root link).
+	int parent;
+	/// \brief Joint type.
+	JointType type;
+	/// \brief Joint value column in the configurations matrix.
+	matrix_t::Index column;
+	/// \brief Translation from the parent link.
+	Eigen::Vector3d b;
+	/// \brief Joint axis.
+	Eigen::Vector3d a;
+	/// \brief Cross product matrix of the joint axis and its square.
+	Eigen::Matrix3d K, K2;
+      };
+
+      /// \brief R_link = R_parent * jointRotation_
+      void multiplyRotations (matrix_t::Index linkId, matrix_t::Index p)
+      {
+	for (int c = 0; c < 3; ++c)
+	  for (int r = 0; r < 3; ++r)
+	    rotations_.col (9 * linkId + r + 3 * c).array () =
+	      rotations_.col (9 * p + r).array ()
+	      * jointRotation_.col (3 * c).array ()
+	      + rotations_.col (9 * p + r + 3).array ()
+	      * jointRotation_.col (3 * c + 1).array ()
+	      + rotations_.col (9 * p + r + 6).array ()
+	      * jointRotation_.col (3 * c + 2).array ();
+      }
+
+      /// \brief p_link = p_parent + R_parent * b
+      void translate (matrix_t::Index linkId, matrix_t::Index p,
+		      const Eigen::Vector3d& b)
+      {
+	for (int r = 0; r < 3; ++r)
+	  positions_.col (3 * linkId + r).array () =
+	    positions_.col (3 * p + r).array ()
+	    + b[0] * rotations_.col (9 * p + r).array ()
+	    + b[1] * rotations_.col (9 * p + r + 3).array ()
+	    + b[2] * rotations_.col (9 * p + r + 6).array ();
+      }
+
+      /// \brief Robot model.
+      cnoid::BodyPtr robot_;
+      /// \brief Links data, indexed as the robot links.
+      std::vector<LinkData> links_;
+
+      /// \brief Links positions (K x 3 per link).
+      matrix_t positions_;
+      /// \brief Links rotations (K x 9 per link).
+      matrix_t rotations_;
+
+      /// \name Buffers.
+      /// \{
+      matrix_t jointRotation_;
+      array_t cos_;
+      array_t sin_;
+      array_t oneMinusCos_;
+      /// \}
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_BATCH_FORWARD_KINEMATICS_HH
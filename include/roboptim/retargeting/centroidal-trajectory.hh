@@ -0,0 +1,304 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_CENTROIDAL_TRAJECTORY_HH
+# define ROBOPTIM_RETARGETING_CENTROIDAL_TRAJECTORY_HH
+# include <algorithm>
+# include <stdexcept>
+# include <vector>
+
+# include <boost/bind.hpp>
+# include <boost/format.hpp>
+# include <boost/make_shared.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <Eigen/Geometry>
+
+# include <cnoid/Body>
+
+# include <roboptim/retargeting/choreonoid.hh>
+# include <roboptim/retargeting/eigen-rigid-body.hh>
+# include <roboptim/retargeting/evaluation-context.hh>
+# include <roboptim/retargeting/utility.hh>
+# include <roboptim/retargeting/worker-pool.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (CentroidalTrajectory);
+
+    /// \brief Centroidal quantities of a whole discrete trajectory.
+    ///
+    /// Computes the center of mass, linear momentum and angular
+    /// momentum of every frame of a trajectory in one pass. The
+    /// velocities required by the momenta are obtained by central
+    /// differences between the neighboring frames (one-sided
+    /// differences for the first and last frames).
+    ///
+    /// Results are kept until the trajectory parameters change so
+    /// that all the functions reading them during one solver
+    /// iteration (ZMP, CoM, etc.) share the same computation.
+    ///
+    /// Trajectory layout: nFrames consecutive robot configurations
+    /// (free-floating then joints values, see
+    /// updateRobotConfiguration).
+    class CentroidalTrajectory
+    {
+    public:
+      typedef Eigen::Matrix<double, Eigen::Dynamic, 1> vector_t;
+      typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> matrix_t;
+      typedef vector_t::Index index_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param contexts robots used for the computations (frames are
+      ///        distributed among the workers of the shared pool if
+      ///        there is one context per worker)
+      /// \param nFrames number of frames of the trajectory
+      /// \param dt time between two frames
+      CentroidalTrajectory (EvaluationContextPoolShPtr contexts,
+			    index_t nFrames, double dt)
+	: contexts_ (contexts),
+	  nFrames_ (nFrames),
+	  nDofs_ (6 + safeGet (contexts).robot ()->numJoints ()),
+	  dt_ (dt),
+	  mass_ (contexts->robot ()->mass ()),
+	  valid_ (false),
+	  x_ (nFrames * nDofs_),
+	  com_ (nFrames, 3),
+	  linearMomentum_ (nFrames, 3),
+	  angularMomentum_ (nFrames, 3),
+	  dq_ ()
+      {
+	if (nFrames < 1)
+	  throw std::runtime_error
+	    ("centroidal trajectory requires at least one frame");
+	if (dt <= 0.)
+	  throw std::runtime_error
+	    ("centroidal trajectory requires a positive time step");
+
+	for (std::size_t id = 0; id < contexts_->size (); ++id)
+	  dq_.push_back (vector_t (nDofs_ - 6));
+      }
+
+      ~CentroidalTrajectory ()
+      {}
+
+      const EvaluationContextPoolShPtr& contexts () const
+      {
+	return contexts_;
+      }
+
+      index_t nFrames () const
+      {
+	return nFrames_;
+      }
+
+      /// \brief Configuration size (6 + number of joints).
+      index_t nDofs () const
+      {
+	return nDofs_;
+      }
+
+      double dt () const
+      {
+	return dt_;
+      }
+
+      /// \brief Robot total mass.
+      double mass () const
+      {
+	return mass_;
+      }
+
+      /// \brief Compute the quantities of all the frames.
+      ///
+      /// \param x trajectory parameters (nFrames x nDofs)
+      /// \return true if the quantities were already up-to-date
+      template <typename Derived>
+      bool update (const Eigen::MatrixBase<Derived>& x)
+      {
+	if (x.size () != nFrames_ * nDofs_)
+	  {
+	    boost::format fmt
+	      ("invalid trajectory size (%d, %d expected)");
+	    fmt % x.size () % (nFrames_ * nDofs_);
+	    throw std::runtime_error (fmt.str ());
+	  }
+
+	if (valid_ && x_ == x)
+	  return true;
+
+	valid_ = false;
+	x_ = x;
+
+	const std::size_t nFrames = static_cast<std::size_t> (nFrames_);
+	WorkerPool& pool = WorkerPool::shared ();
+	if (pool.size () > 1 && pool.size () <= contexts_->size ())
+	  pool.run (nFrames, boost::bind
+		    (&CentroidalTrajectory::updateFrame, this, _1));
+	else
+	  for (std::size_t frame = 0; frame < nFrames; ++frame)
+	    updateFrame (frame);
+
+	valid_ = true;
+	return false;
+      }
+
+      /// \brief Forget the last computed quantities.
+      void invalidate ()
+      {
+	valid_ = false;
+      }
+
+      /// \name Quantities (one row per frame).
+      /// \{
+
+      const matrix_t& com () const
+      {
+	return com_;
+      }
+
+      const matrix_t& linearMomentum () const
+      {
+	return linearMomentum_;
+      }
+
+      /// \brief Angular momentum of each frame about the world origin.
+      const matrix_t& angularMomentum () const
+      {
+	return angularMomentum_;
+      }
+
+      /// \}
+
+      /// \brief Compute the quantities of one frame.
+      ///
+      /// Only the frame and its neighbors are read from x. The robot
+      /// of the evaluation context associated with the current
+      /// thread is used, this method can therefore be called
+      /// concurrently by the workers of the shared pool.
+      ///
+      /// \param frame frame index
+      /// \param x trajectory parameters
+      /// \param com center of mass
+      /// \param P linear momentum
+      /// \param L angular momentum about the world origin (as
+      ///        returned by calcTotalMomentum, this is the moment
+      ///        expected by the ZMP formula)
+      template <typename Derived>
+      void computeFrame (index_t frame, const Eigen::MatrixBase<Derived>& x,
+			 cnoid::Vector3& com,
+			 cnoid::Vector3& P,
+			 cnoid::Vector3& L) const
+      {
+	std::size_t contextId = contexts_->localId ();
+	EvaluationContext& context = (*contexts_)[contextId];
+	const cnoid::BodyPtr& robot = context.robot ();
+	vector_t& dq = dq_[contextId];
+
+	const index_t previous = std::max<index_t> (frame - 1, 0);
+	const index_t next = std::min<index_t> (frame + 1, nFrames_ - 1);
+
+	updateRobotConfiguration (robot, x.segment (frame * nDofs_, nDofs_));
+
+	cnoid::Link* root = robot->rootLink ();
+	if (next == previous)
+	  {
+	    dq.setZero ();
+	    root->v ().setZero ();
+	    root->w ().setZero ();
+	  }
+	else
+	  {
+	    const double h = static_cast<double> (next - previous) * dt_;
+
+	    dq = (x.segment (next * nDofs_ + 6, nDofs_ - 6)
+		  - x.segment (previous * nDofs_ + 6, nDofs_ - 6)) / h;
+
+	    root->v () = (x.template segment<3> (next * nDofs_)
+			  - x.template segment<3> (previous * nDofs_)) / h;
+
+	    Eigen::Matrix3d Rprevious;
+	    Eigen::Matrix3d Rnext;
+	    eulerToTransform
+	      (Rprevious, x.template segment<3> (previous * nDofs_ + 3));
+	    eulerToTransform
+	      (Rnext, x.template segment<3> (next * nDofs_ + 3));
+	    Eigen::AngleAxisd rotation (Rnext * Rprevious.transpose ());
+	    root->w () = rotation.axis () * (rotation.angle () / h);
+	  }
+
+	for (int dofId = 0; dofId < robot->numJoints (); ++dofId)
+	  {
+	    robot->joint (dofId)->dq () = dq[dofId];
+	    robot->joint (dofId)->ddq () = 0.;
+	  }
+
+	// The robot is modified directly, the forward kinematics
+	// cache of the context is not valid anymore.
+	context.robotState ().invalidate ();
+	robot->calcForwardKinematics (true);
+
+	com = robot->calcCenterOfMass ();
+	robot->calcTotalMomentum (P, L);
+      }
+
+    private:
+      void updateFrame (std::size_t frame)
+      {
+	index_t frame_ = static_cast<index_t> (frame);
+	cnoid::Vector3 com;
+	cnoid::Vector3 P;
+	cnoid::Vector3 L;
+	computeFrame (frame_, x_, com, P, L);
+	com_.row (frame_) = com.transpose ();
+	linearMomentum_.row (frame_) = P.transpose ();
+	angularMomentum_.row (frame_) = L.transpose ();
+      }
+
+      /// \brief Robots (one per worker).
+      EvaluationContextPoolShPtr contexts_;
+      /// \brief Number of frames.
+      index_t nFrames_;
+      /// \brief Configuration size.
+      index_t nDofs_;
+      /// \brief Time between two frames.
+      double dt_;
+      /// \brief Robot total mass.
+      double mass_;
+
+      /// \brief Are the quantities up-to-date?
+      bool valid_;
+      /// \brief Trajectory used for the last update.
+      vector_t x_;
+
+      /// \brief Center of mass (one row per frame).
+      matrix_t com_;
+      /// \brief Linear momentum (one row per frame).
+      matrix_t linearMomentum_;
+      /// \brief Angular momentum (one row per frame).
+      matrix_t angularMomentum_;
+
+      /// \brief Joints velocities buffers (one per context).
+      mutable std::vector<vector_t> dq_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_CENTROIDAL_TRAJECTORY_HH
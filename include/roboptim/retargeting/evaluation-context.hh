@@ -0,0 +1,219 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_EVALUATION_CONTEXT_HH
+# define ROBOPTIM_RETARGETING_EVALUATION_CONTEXT_HH
+# include <iostream>
+# include <stdexcept>
+# include <vector>
+
+# include <boost/format.hpp>
+# include <boost/make_shared.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <cnoid/Body>
+
+# include <roboptim/core/indent.hh>
+
+# include <roboptim/retargeting/robot-state.hh>
+# include <roboptim/retargeting/utility.hh>
+# include <roboptim/retargeting/worker-pool.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (EvaluationContext);
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (EvaluationContextPool);
+
+    /// \brief Data owned by one worker thread during evaluations.
+    ///
+    /// A context contains a robot which is used only by one worker
+    /// thread and the associated forward kinematics cache.
+    class EvaluationContext
+    {
+    public:
+      EvaluationContext (std::size_t id, RobotStateShPtr robotState)
+	: id_ (id),
+	  robotState_ (robotState)
+      {}
+
+      ~EvaluationContext ()
+      {}
+
+      /// \brief Context id (i.e. worker id).
+      std::size_t id () const
+      {
+	return id_;
+      }
+
+      /// \brief Robot owned by this context.
+      const cnoid::BodyPtr& robot () const
+      {
+	return robotState_->robot ();
+      }
+
+      /// \brief Forward kinematics cache of this context robot.
+      RobotState& robotState () const
+      {
+	return *robotState_;
+      }
+
+    private:
+      /// \brief Context id.
+      std::size_t id_;
+      /// \brief Robot state.
+      RobotStateShPtr robotState_;
+    };
+
+    /// \brief One evaluation context per worker thread.
+    ///
+    /// Functions relying on a robot model hold a shared pointer to a
+    /// pool and look up the context of the current thread through
+    /// EvaluationContextPool::local. Their scratch buffers are
+    /// indexed the same way so that different workers never share
+    /// mutable data.
+    ///
+    /// The first context wraps the robot (or robot state) passed to
+    /// the constructor, the other ones use clones of this robot.
+    class EvaluationContextPool
+    {
+    public:
+      /// \brief Build the pool from a robot.
+      ///
+      /// \param robot robot used by the first context
+      /// \param nContexts number of contexts, one per worker of the
+      ///        shared worker pool by default
+      explicit EvaluationContextPool
+      (cnoid::BodyPtr robot,
+       std::size_t nContexts = WorkerPool::shared ().size ())
+	: contexts_ ()
+      {
+	initialize (boost::make_shared<RobotState> (robot), nContexts);
+      }
+
+      /// \brief Build the pool from an existing robot state.
+      ///
+      /// \param robotState robot state used by the first context
+      /// \param nContexts number of contexts, one per worker of the
+      ///        shared worker pool by default
+      explicit EvaluationContextPool
+      (RobotStateShPtr robotState,
+       std::size_t nContexts = WorkerPool::shared ().size ())
+	: contexts_ ()
+      {
+	initialize (robotState, nContexts);
+      }
+
+      ~EvaluationContextPool ()
+      {}
+
+      /// \brief Number of contexts.
+      std::size_t size () const
+      {
+	return contexts_.size ();
+      }
+
+      /// \brief Robot of the first context.
+      ///
+      /// Only use this robot to read the model (number of joints,
+      /// limits, etc.).
+      const cnoid::BodyPtr& robot () const
+      {
+	return contexts_[0]->robot ();
+      }
+
+      EvaluationContext& operator[] (std::size_t id) const
+      {
+	ROBOPTIM_RETARGETING_ASSERT (id < contexts_.size ());
+	return *contexts_[id];
+      }
+
+      /// \brief Id of the context associated with the current thread.
+      std::size_t localId () const
+      {
+	std::size_t id = WorkerPool::workerId ();
+	if (id >= contexts_.size ())
+	  {
+	    boost::format fmt
+	      ("no evaluation context for worker %d"
+	       " (%d contexts have been allocated)");
+	    fmt % id % contexts_.size ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	return id;
+      }
+
+      /// \brief Context associated with the current thread.
+      EvaluationContext& local () const
+      {
+	return *contexts_[localId ()];
+      }
+
+      std::ostream& print (std::ostream& o) const
+      {
+	std::size_t hits = 0;
+	std::size_t misses = 0;
+	for (std::size_t id = 0; id < contexts_.size (); ++id)
+	  {
+	    hits += contexts_[id]->robotState ().hits ();
+	    misses += contexts_[id]->robotState ().misses ();
+	  }
+
+	o << "Evaluation contexts (" << contexts_.size () << ")"
+	  << incindent
+	  << iendl << "forward kinematics cache hits: " << hits
+	  << iendl << "forward kinematics cache misses: " << misses;
+	for (std::size_t id = 0; id < contexts_.size (); ++id)
+	  o << iendl << id << ": " << contexts_[id]->robotState ();
+	o << decindent;
+	return o;
+      }
+
+    private:
+      void initialize (RobotStateShPtr robotState, std::size_t nContexts)
+      {
+	if (nContexts == 0)
+	  nContexts = 1;
+
+	const cnoid::BodyPtr& robot = safeGet (robotState).robot ();
+
+	contexts_.reserve (nContexts);
+	contexts_.push_back
+	  (boost::make_shared<EvaluationContext> (0, robotState));
+	for (std::size_t id = 1; id < nContexts; ++id)
+	  {
+	    cnoid::BodyPtr clone (robot->clone ());
+	    contexts_.push_back
+	      (boost::make_shared<EvaluationContext>
+	       (id, boost::make_shared<RobotState> (clone)));
+	  }
+      }
+
+      /// \brief Contexts, indexed by worker id.
+      std::vector<EvaluationContextShPtr> contexts_;
+    };
+
+    inline std::ostream&
+    operator<< (std::ostream& o, const EvaluationContextPool& pool)
+    {
+      return pool.print (o);
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_EVALUATION_CONTEXT_HH
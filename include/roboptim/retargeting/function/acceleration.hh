@@ -17,22 +17,167 @@
 
 #ifndef ROBOPTIM_RETARGETING_ACCELERATION_HH
 # define ROBOPTIM_RETARGETING_ACCELERATION_HH
+# include <cmath>
+# include <stdexcept>
+# include <vector>
 
+# include <boost/format.hpp>
+
+# include <Eigen/SparseCore>
+
+# include <roboptim/core/quadratic-function.hh>
+
+# include <roboptim/retargeting/jacobian.hh>
 
 namespace roboptim
 {
   namespace retargeting
   {
-    /// \brief Compute acceleration from position.
+    /// \brief Weighted squared acceleration (or jerk) of a discrete
+    ///        trajectory.
+    ///
+    /// Input: discrete trajectory parameters (size: number of frames
+    /// * number of DOFs)
+    ///
+    /// Output: \f$ \sum_k \sum_d w_d (\Delta^n q_{k,d} / dt^n)^2 \f$
+    /// (size: 1) where \f$ \Delta^n \f$ is the forward finite
+    /// difference of order n (2: acceleration, 3: jerk).
     ///
-    /// Use second derivative as acceleration.
+    /// This is the quadratic function \f$ \frac{1}{2} x^T H x \f$,
+    /// its Hessian H is constant and banded: frame k only interacts
+    /// with frames k - n to k + n. H is computed once, the value
+    /// and the gradient (H x) then cost one sparse product.
     ///
-    /// VectorInterpolation should be used here for implementation.
+    /// \tparam T function traits
     template <typename T>
-    boost::shared_ptr<GenericDifferentiableFunction<T> >
-    acceleration ()
+    class SquaredAcceleration : public GenericQuadraticFunction<T>
     {
-    }
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericQuadraticFunction<T>);
+
+      typedef typename vector_t::Index index_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param nFrames number of frames
+      /// \param weights weight of each DOF (size: number of DOFs)
+      /// \param dt time step between two frames
+      /// \param order finite difference order (2: acceleration,
+      ///        3: jerk)
+      SquaredAcceleration (index_t nFrames,
+			   const vector_t& weights,
+			   value_type dt,
+			   index_t order = 2)
+	: GenericQuadraticFunction<T>
+	  (nFrames * weights.size (), 1,
+	   order == 3 ? "squared jerk" : "squared acceleration"),
+	  hessian_ (nFrames * weights.size (), nFrames * weights.size ()),
+	  hessianTriplets_ (),
+	  buffer_ (nFrames * weights.size ())
+      {
+	const index_t nDofs = weights.size ();
+
+	if (order < 1)
+	  throw std::runtime_error ("invalid finite difference order");
+	if (nFrames <= order)
+	  {
+	    boost::format fmt
+	      ("not enough frames (%d) for a finite difference of order %d");
+	    fmt % nFrames % order;
+	    throw std::runtime_error (fmt.str ());
+	  }
+	if (dt <= 0.)
+	  throw std::runtime_error ("invalid time step");
+
+	// Finite difference coefficients: (-1)^(n - i) C(n, i).
+	std::vector<value_type> coefficients
+	  (static_cast<std::size_t> (order + 1));
+	value_type binomial = 1.;
+	for (index_t i = 0; i <= order; ++i)
+	  {
+	    coefficients[static_cast<std::size_t> (i)] =
+	      ((order - i) % 2 == 0 ? 1. : -1.) * binomial;
+	    binomial = binomial * static_cast<value_type> (order - i)
+	      / static_cast<value_type> (i + 1);
+	  }
+
+	// H = 2 D^T W D / dt^(2n)
+	const value_type scale =
+	  2. / std::pow (dt, 2. * static_cast<value_type> (order));
+
+	std::vector<triplet_t> triplets;
+	triplets.reserve
+	  (static_cast<std::size_t>
+	   ((nFrames - order) * nDofs * (order + 1) * (order + 1)));
+	for (index_t frame = 0; frame + order < nFrames; ++frame)
+	  for (index_t dof = 0; dof < nDofs; ++dof)
+	    for (index_t i = 0; i <= order; ++i)
+	      for (index_t j = 0; j <= order; ++j)
+		triplets.push_back
+		  (triplet_t
+		   ((frame + i) * nDofs + dof,
+		    (frame + j) * nDofs + dof,
+		    scale * weights[dof]
+		    * coefficients[static_cast<std::size_t> (i)]
+		    * coefficients[static_cast<std::size_t> (j)]));
+	hessian_.setFromTriplets (triplets.begin (), triplets.end ());
+
+	// keep the (summed) non-zeros to fill the Hessian of the
+	// function traits
+	hessianTriplets_.reserve
+	  (static_cast<std::size_t> (hessian_.nonZeros ()));
+	for (index_t k = 0; k < hessian_.outerSize (); ++k)
+	  for (typename hessianMatrix_t::InnerIterator it (hessian_, k);
+	       it; ++it)
+	    hessianTriplets_.push_back
+	      (triplet_t (it.row (), it.col (), it.value ()));
+      }
+
+      virtual ~SquaredAcceleration ()
+      {}
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	buffer_ = hessian_ * x;
+	result[0] = .5 * x.dot (buffer_);
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t& x,
+		     size_type) const
+      {
+	buffer_ = hessian_ * x;
+	assignDense (gradient, buffer_);
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x) const
+      {
+	buffer_ = hessian_ * x;
+	assignDense (jacobian, buffer_.transpose ());
+      }
+
+      void
+      impl_hessian (hessian_t& hessian, const argument_t&,
+		    size_type) const
+      {
+	assignTriplets (hessian, hessianTriplets_);
+      }
+
+    private:
+      typedef Eigen::Triplet<value_type> triplet_t;
+      typedef Eigen::SparseMatrix<value_type> hessianMatrix_t;
+
+      /// \brief Constant (banded) Hessian.
+      hessianMatrix_t hessian_;
+      /// \brief Hessian non-zeros.
+      std::vector<triplet_t> hessianTriplets_;
+      /// \brief Gradient buffer.
+      mutable vector_t buffer_;
+    };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
 
@@ -0,0 +1,192 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_BONE_LENGTH_TRAJECTORY_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_BONE_LENGTH_TRAJECTORY_HH
+# include <stdexcept>
+# include <utility>
+# include <vector>
+
+# include <boost/format.hpp>
+
+# include <Eigen/SparseCore>
+
+# include <roboptim/core/differentiable-function.hh>
+
+# include <roboptim/retargeting/jacobian.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Bone lengths errors of a whole markers trajectory.
+    ///
+    /// Input: markers positions of every frame (size: number of
+    /// frames * number of markers * 3)
+    ///
+    /// Output: for each frame and each bone (pair of markers):
+    ///
+    /// \f$ ||p_{\text{start}} - p_{\text{end}}||^2 - l^2 \f$
+    ///
+    /// (size: number of frames * number of bones, frame-major).
+    ///
+    /// Each output only depends on the six coordinates of its two
+    /// markers: the jacobian has six non-zeros per row.
+    ///
+    /// \tparam T Function traits type
+    template <typename T>
+    class BoneLengthTrajectoryError : public GenericDifferentiableFunction<T>
+    {
+    public:
+      ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericDifferentiableFunction<T>);
+
+      typedef typename vector_t::Index index_t;
+      /// \brief Bone (start marker index, end marker index).
+      typedef std::pair<index_t, index_t> bone_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param nMarkers number of markers of each frame
+      /// \param nFrames number of frames
+      /// \param bones markers indices of each bone
+      /// \param lengths desired length of each bone
+      BoneLengthTrajectoryError (index_t nMarkers,
+				 index_t nFrames,
+				 const std::vector<bone_t>& bones,
+				 const std::vector<value_type>& lengths)
+	: GenericDifferentiableFunction<T>
+	  (3 * nMarkers * nFrames,
+	   nFrames * static_cast<index_t> (bones.size ()),
+	   "BoneLengthTrajectoryError"),
+	  nMarkers_ (nMarkers),
+	  nFrames_ (nFrames),
+	  bones_ (bones),
+	  squaredLengths_ (lengths.size ()),
+	  triplets_ ()
+      {
+	if (bones.empty ())
+	  throw std::runtime_error ("no bone");
+	if (lengths.size () != bones.size ())
+	  {
+	    boost::format fmt
+	      ("invalid bone lengths size (%d, %d expected)");
+	    fmt % lengths.size () % bones.size ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	for (std::size_t i = 0; i < bones.size (); ++i)
+	  {
+	    if (bones[i].first < 0 || bones[i].first >= nMarkers
+		|| bones[i].second < 0 || bones[i].second >= nMarkers)
+	      {
+		boost::format fmt ("invalid bone (markers %d and %d)");
+		fmt % bones[i].first % bones[i].second;
+		throw std::runtime_error (fmt.str ());
+	      }
+	    squaredLengths_[i] = lengths[i] * lengths[i];
+	  }
+	triplets_.reserve
+	  (static_cast<std::size_t> (6 * this->outputSize ()));
+      }
+
+      virtual ~BoneLengthTrajectoryError ()
+      {}
+
+      /// \brief Number of bones.
+      index_t nBones () const
+      {
+	return static_cast<index_t> (bones_.size ());
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	index_t row = 0;
+	for (index_t frame = 0; frame < nFrames_; ++frame)
+	  for (std::size_t i = 0; i < bones_.size (); ++i, ++row)
+	    result[row] =
+	      (x.template segment<3> (start (frame, bones_[i].first))
+	       - x.template segment<3> (start (frame, bones_[i].second)))
+	      .squaredNorm ()
+	      - squaredLengths_[i];
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t& x,
+		     size_type functionId) const
+      {
+	const index_t frame = functionId / nBones ();
+	const bone_t& bone =
+	  bones_[static_cast<std::size_t> (functionId % nBones ())];
+	const index_t s = start (frame, bone.first);
+	const index_t e = start (frame, bone.second);
+
+	// coefficient-wise to support sparse vectors
+	gradient.setZero ();
+	for (index_t k = 0; k < 3; ++k)
+	  {
+	    const value_type d = 2. * (x[s + k] - x[e + k]);
+	    gradient.coeffRef (s + k) += d;
+	    gradient.coeffRef (e + k) -= d;
+	  }
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x) const
+      {
+	triplets_.clear ();
+	index_t row = 0;
+	for (index_t frame = 0; frame < nFrames_; ++frame)
+	  for (std::size_t i = 0; i < bones_.size (); ++i, ++row)
+	    {
+	      const index_t s = start (frame, bones_[i].first);
+	      const index_t e = start (frame, bones_[i].second);
+	      for (index_t k = 0; k < 3; ++k)
+		{
+		  const value_type d = 2. * (x[s + k] - x[e + k]);
+		  triplets_.push_back (triplet_t (row, s + k, d));
+		  triplets_.push_back (triplet_t (row, e + k, -d));
+		}
+	    }
+	assignTriplets (jacobian, triplets_);
+      }
+
+    private:
+      typedef Eigen::Triplet<value_type> triplet_t;
+
+      /// \brief Index of the x coordinate of a marker.
+      index_t start (index_t frame, index_t marker) const
+      {
+	return 3 * (frame * nMarkers_ + marker);
+      }
+
+      /// \brief Number of markers.
+      index_t nMarkers_;
+      /// \brief Number of frames.
+      index_t nFrames_;
+      /// \brief Markers indices of each bone.
+      std::vector<bone_t> bones_;
+      /// \brief Squared desired length of each bone.
+      std::vector<value_type> squaredLengths_;
+      /// \brief Jacobian non-zeros buffer.
+      mutable std::vector<triplet_t> triplets_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_BONE_LENGTH_TRAJECTORY_HH
@@ -42,6 +42,9 @@ namespace roboptim
     /// The desired bone length is the distance between the current
     /// body and its parent.
     ///
+    /// The marker problem uses BoneLengthTrajectoryError which
+    /// computes all the bones of all the frames at once.
+    ///
     /// \tparam T Function traits type
     template <typename T>
     class BoneLengthError : public GenericNumericQuadraticFunction<T>
@@ -78,6 +81,7 @@ namespace roboptim
 	  throw std::runtime_error
 	    ((boost::format ("start marker %s does not exist")
 	      % markerStart).str ());
+	markerStartId = it - markerTrajectory.markers ().begin ();
 
 	it = std::find (markerTrajectory.markers ().begin (),
 			markerTrajectory.markers ().end (),
@@ -86,21 +90,28 @@ namespace roboptim
 	  throw std::runtime_error
 	    ((boost::format ("end marker %s does not exist")
 	      % markerEnd).str ());
+	markerEndId = it - markerTrajectory.markers ().begin ();
 
 	assert (3 * markerStartId + 2 < this->A ().rows ()
 		&& 3 * markerEndId + 2 < this->A ().rows ());
 
 	this->A ().setZero ();
 
+	// Coefficients are set one by one to support sparse matrices.
+
 	// Put one in the diagonal elements matching the markers.
-	this->A ().diagonal ().template segment<3> (3 * markerStartId).setIdentity ();
-	this->A ().diagonal ().template segment<3> (3 * markerEndId).setIdentity ();
+	for (typename vector_t::Index i = 0; i < 3; ++i)
+	  {
+	    this->A ().coeffRef (3 * markerStartId + i, 3 * markerStartId + i) = 1.;
+	    this->A ().coeffRef (3 * markerEndId + i, 3 * markerEndId + i) = 1.;
+	  }
 
 	// Put minus one for cross multiplication.
-	this->A ().template block<3, 3>
-	  (3 * markerStartId, 3 * markerStartId).diagonal ().fill (-1.);
-	this->A ().template block<3, 3>
-	  (3 * markerEndId, 3 * markerEndId).diagonal ().fill (-1.);
+	for (typename vector_t::Index i = 0; i < 3; ++i)
+	  {
+	    this->A ().coeffRef (3 * markerStartId + i, 3 * markerEndId + i) = -1.;
+	    this->A ().coeffRef (3 * markerEndId + i, 3 * markerStartId + i) = -1.;
+	  }
 
 	// Compute desired bone length (value C).
 	cnoid::Link* link = robot->link (linkName);
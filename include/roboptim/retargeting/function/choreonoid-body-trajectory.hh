@@ -17,7 +17,10 @@
 
 #ifndef ROBOPTIM_RETARGETING_CHOREONOID_BODY_MOTION_HH
 # define ROBOPTIM_RETARGETING_CHOREONOID_BODY_MOTION_HH
+# include <stdexcept>
+
 # include <boost/array.hpp>
+# include <boost/format.hpp>
 # include <boost/shared_ptr.hpp>
 # include <roboptim/trajectory/vector-interpolation.hh>
 # include <roboptim/retargeting/utility.hh>
@@ -40,10 +43,25 @@ namespace roboptim
       (VectorInterpolation);
       ROBOPTIM_IMPLEMENT_CLONE (ChoreonoidBodyTrajectory);
 
+      /// \brief Constructor.
+      ///
+      /// Only the frames firstFrame to firstFrame + nFrames - 1 of
+      /// the motion are copied: the memory used by the trajectory
+      /// does not depend on the motion length.
+      ///
+      /// \param bodyMotion motion
+      /// \param addFreeFloating add the free-floating DOFs (base
+      ///        position and orientation)?
+      /// \param firstFrame first frame of the motion to be copied
+      /// \param nFrames number of frames to be copied (-1 means up
+      ///        to the end of the motion)
       explicit ChoreonoidBodyTrajectory (cnoid::BodyMotionPtr bodyMotion,
-					 bool addFreeFloating)
+					 bool addFreeFloating,
+					 int firstFrame = 0,
+					 int nFrames = -1)
 	: VectorInterpolation
-	  (computeParametersFromBodyMotion (bodyMotion, addFreeFloating),
+	  (computeParametersFromBodyMotion
+	   (bodyMotion, addFreeFloating, firstFrame, nFrames),
 	   (addFreeFloating ? 6 : 0) + bodyMotion->numJoints (),
 	   1. / bodyMotion->frameRate ()),
 	  bodyMotion_ (bodyMotion)
@@ -55,17 +73,29 @@ namespace roboptim
 
     private:
       static vector_t computeParametersFromBodyMotion
-      (cnoid::BodyMotionPtr bodyMotion, bool addFreeFloating)
+      (cnoid::BodyMotionPtr bodyMotion, bool addFreeFloating,
+       int firstFrame, int nFrames)
       {
+	if (firstFrame < 0 || firstFrame >= bodyMotion->getNumFrames ())
+	  {
+	    boost::format fmt ("invalid first frame (%d, %d frames)");
+	    fmt % firstFrame % bodyMotion->getNumFrames ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	if (nFrames < 0
+	    || firstFrame + nFrames > bodyMotion->getNumFrames ())
+	  nFrames = bodyMotion->getNumFrames () - firstFrame;
+
 	vector_t::Index freeFloatingOffset = 0;
 	if (addFreeFloating)
 	  freeFloatingOffset = 6;
-	vector_t x
-	  (bodyMotion->getNumFrames ()
-	   * (freeFloatingOffset + bodyMotion->numJoints ()));
+	const vector_t::Index nDofs =
+	  freeFloatingOffset + bodyMotion->numJoints ();
+	vector_t x (nFrames * nDofs);
 	x.setZero ();
-	for (int frameId = 0; frameId < bodyMotion->getNumFrames (); ++frameId)
+	for (int i = 0; i < nFrames; ++i)
 	  {
+	    const int frameId = firstFrame + i;
 	    if (addFreeFloating &&
 		frameId < bodyMotion->linkPosSeq ()->numFrames ())
 	      {
@@ -78,16 +108,13 @@ namespace roboptim
 		if (!&frame)
 		  throw std::runtime_error ("invalid link frame");
 
-		x.segment
-		  (frameId * (freeFloatingOffset + bodyMotion->numJoints ()),
-		   3) = frame[0].translation ();
+		x.segment (i * nDofs, 3) = frame[0].translation ();
 
 		Eigen::AngleAxisd angleAxis =
 		  angleAxis.fromRotationMatrix
 		  (frame[0].rotation ().toRotationMatrix ());
-		x.segment
-		  (frameId * (freeFloatingOffset + bodyMotion->numJoints ()) + 3,
-		   3) = angleAxis.angle () * angleAxis.axis ();
+		x.segment (i * nDofs + 3, 3) =
+		  angleAxis.angle () * angleAxis.axis ();
 	      }
 		if (addFreeFloating &&
 		    frameId >= bodyMotion->linkPosSeq ()->numFrames ())
@@ -101,9 +128,7 @@ namespace roboptim
 		  throw std::runtime_error ("invalid joint frame");
 
 		for (int dofId = 0; dofId < bodyMotion->numJoints (); ++dofId)
-		  x[frameId * (freeFloatingOffset + bodyMotion->numJoints ())
-		    + freeFloatingOffset + dofId] =
-		    frame[dofId];
+		  x[i * nDofs + freeFloatingOffset + dofId] = frame[dofId];
 	  }
 	return x;
       }
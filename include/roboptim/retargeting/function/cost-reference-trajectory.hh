@@ -17,22 +17,44 @@
 
 #ifndef ROBOPTIM_RETARGETING_FUNCTION_COST_REFERENCE_TRAJECTORY_HH
 # define ROBOPTIM_RETARGETING_FUNCTION_COST_REFERENCE_TRAJECTORY_HH
+# include <cmath>
 # include <string>
+# include <vector>
 
-# include <roboptim/core/differentiable-function.hh>
+# include <boost/make_shared.hpp>
+
+# include <roboptim/core/twice-differentiable-function.hh>
 # include <roboptim/trajectory/trajectory.hh>
 # include <roboptim/trajectory/vector-interpolation.hh>
 
+# include <roboptim/retargeting/jacobian.hh>
+
 namespace roboptim
 {
   namespace retargeting
   {
+    /// \brief Tracking cost of one DOF w.r.t. a reference trajectory.
+    ///
+    /// Input: discrete trajectory parameters (same size as the
+    /// reference trajectory parameters)
+    ///
+    /// Output: \f$ \frac{1}{2} \sum_t (q_d(t) - r_d(t))^2 \f$ (size: 1)
+    /// where t samples the reference time range every dt.
+    ///
+    /// When the reference trajectory is a VectorInterpolation whose
+    /// frames are dt apart, the samples are the frames: the cost,
+    /// its gradient and its (diagonal) Hessian are then computed
+    /// directly on the parameters blocks. Otherwise, the trajectory
+    /// is evaluated at each sample.
+    ///
+    /// \tparam T function traits
     template <typename T>
-    class CostReferenceTrajectory : public GenericDifferentiableFunction<T>
+    class CostReferenceTrajectory
+      : public GenericTwiceDifferentiableFunction<T>
     {
     public:
-      ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
-      (GenericDifferentiableFunction<T>);
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericTwiceDifferentiableFunction<T>);
 
       /// \brief Import discrete interval type.
       typedef typename parent_t::discreteInterval_t discreteInterval_t;
@@ -40,24 +62,46 @@ namespace roboptim
       typedef typename parent_t::interval_t interval_t;
 
       typedef Trajectory<3> trajectory_t;
+      typedef Eigen::Triplet<value_type> triplet_t;
 
       explicit CostReferenceTrajectory
       (boost::shared_ptr<Trajectory<3> > referenceTrajectory,
        size_type dofId,
        value_type dt)
 
-	: GenericDifferentiableFunction<T>
+	: GenericTwiceDifferentiableFunction<T>
 	  (referenceTrajectory->parameters ().size (), 1, "CostReferenceTrajectory"),
 	  vectorInterpolation_
 	  (boost::make_shared<VectorInterpolation>
 	   (vector_t::Zero (referenceTrajectory->parameters ().size ()),
-	    referenceTrajectory->outputSize (), dt)),
+	    referenceTrajectory->outputSize (),
+	    frameSpacing (*referenceTrajectory))),
 	  referenceTrajectory_ (referenceTrajectory),
 	  dofId_ (dofId),
 	  reference_ (referenceTrajectory->outputSize ()),
 	  value_ (referenceTrajectory->outputSize ()),
-	  dt_ (dt)
-      {}
+	  dt_ (dt),
+	  nSamples_ (0),
+	  discrete_ (false)
+      {
+	// Count the samples as the generic evaluation does.
+	const value_type min = referenceTrajectory_->timeRange ().first;
+	const value_type max = referenceTrajectory_->timeRange ().second;
+	for (value_type t = min; t < max; t += dt_)
+	  ++nSamples_;
+
+	// The samples are the frames of a discrete reference.
+	const size_type nFrames = referenceTrajectory_->parameters ().size ()
+	  / referenceTrajectory_->outputSize ();
+	discrete_ =
+	  !!boost::dynamic_pointer_cast<VectorInterpolation>
+	  (referenceTrajectory_)
+	  && min == 0.
+	  && nFrames > 1
+	  && nSamples_ <= nFrames
+	  && std::abs (frameSpacing (*referenceTrajectory_) - dt_)
+	  <= 1e-12 * dt_;
+      }
 
       virtual ~CostReferenceTrajectory ()
       {}
@@ -67,6 +111,19 @@ namespace roboptim
 				 const argument_t& p)
 	const
       {
+	result[0] = 0.;
+
+	if (discrete_)
+	  {
+	    // one strided pass over the tracked DOF
+	    const size_type stride = referenceTrajectory_->outputSize ();
+	    result[0] = .5 *
+	      (dof (p.data (), stride)
+	       - dof (referenceTrajectory_->parameters ().data (), stride))
+	      .squaredNorm ();
+	    return;
+	  }
+
 #ifndef ROBOPTIM_DO_NOT_CHECK_ALLOCATION
 	Eigen::internal::set_is_malloc_allowed (true);
 #endif //! ROBOPTIM_DO_NOT_CHECK_ALLOCATION
@@ -89,6 +146,21 @@ namespace roboptim
 				  size_type)
 	const
       {
+	gradient.setZero ();
+
+	if (discrete_)
+	  {
+	    // coefficient-wise to support sparse vectors
+	    const size_type stride = referenceTrajectory_->outputSize ();
+	    const vector_t& reference = referenceTrajectory_->parameters ();
+	    for (size_type k = 0; k < nSamples_; ++k)
+	      {
+		const size_type i = k * stride + dofId_;
+		gradient.coeffRef (i) = p[i] - reference[i];
+	      }
+	    return;
+	  }
+
 #ifndef ROBOPTIM_DO_NOT_CHECK_ALLOCATION
 	Eigen::internal::set_is_malloc_allowed (true);
 #endif //! ROBOPTIM_DO_NOT_CHECK_ALLOCATION
@@ -98,24 +170,105 @@ namespace roboptim
 	const value_type min = referenceTrajectory_->timeRange ().first;
 	const value_type max = referenceTrajectory_->timeRange ().second;
 
+	Function::vector_t dense (this->inputSize ());
+	dense.setZero ();
 	for (value_type t = min; t < max; t += dt_)
 	  {
 	    (*vectorInterpolation_) (value_, t);
 	    (*referenceTrajectory_) (reference_, t);
 
-	    gradient +=
+	    dense +=
 	      (value_[dofId_] - reference_[dofId_])
-	      * vectorInterpolation_->variationStateWrtParam (t, 1).row (dofId_);
+	      * vectorInterpolation_->variationStateWrtParam (t, 1)
+	      .row (dofId_).transpose ();
+	  }
+	assignDense (gradient, dense);
+      }
+
+      /// \brief Hessian of the cost.
+      ///
+      /// The interpolation is linear w.r.t. the parameters: the
+      /// Hessian is the sum of the outer products of the samples
+      /// variations, i.e. a diagonal matrix in the discrete case and
+      /// a block-diagonal one otherwise.
+      virtual void impl_hessian (hessian_t& hessian,
+				 const argument_t&,
+				 size_type)
+	const
+      {
+	hessian.setZero ();
+
+	if (discrete_)
+	  {
+	    // coefficient-wise to support sparse matrices
+	    const size_type stride = referenceTrajectory_->outputSize ();
+	    for (size_type k = 0; k < nSamples_; ++k)
+	      hessian.coeffRef (k * stride + dofId_, k * stride + dofId_) = 1.;
+	    return;
+	  }
+
+#ifndef ROBOPTIM_DO_NOT_CHECK_ALLOCATION
+	Eigen::internal::set_is_malloc_allowed (true);
+#endif //! ROBOPTIM_DO_NOT_CHECK_ALLOCATION
+
+	// One block per sample: the outer product of the parameters
+	// the sample depends on (the neighbouring frames).
+	std::vector<triplet_t> triplets;
+	std::vector<size_type> nonZeros;
+
+	const value_type min = referenceTrajectory_->timeRange ().first;
+	const value_type max = referenceTrajectory_->timeRange ().second;
+	for (value_type t = min; t < max; t += dt_)
+	  {
+	    const Function::vector_t variation =
+	      vectorInterpolation_->variationConfigWrtParam (t)
+	      .row (dofId_).transpose ();
+
+	    nonZeros.clear ();
+	    for (size_type i = 0; i < variation.size (); ++i)
+	      if (variation[i] != 0.)
+		nonZeros.push_back (i);
+
+	    for (std::size_t i = 0; i < nonZeros.size (); ++i)
+	      for (std::size_t j = 0; j < nonZeros.size (); ++j)
+		triplets.push_back
+		  (triplet_t (nonZeros[i], nonZeros[j],
+			      variation[nonZeros[i]] * variation[nonZeros[j]]));
 	  }
+	assignTriplets (hessian, triplets);
       }
 
     private:
+      typedef Eigen::Map<const vector_t, 0, Eigen::InnerStride<> >
+      dofMap_t;
+
+      /// \brief Time between two frames of a discrete trajectory.
+      static value_type frameSpacing (const Trajectory<3>& trajectory)
+      {
+	const size_type nFrames =
+	  trajectory.parameters ().size () / trajectory.outputSize ();
+	if (nFrames < 2)
+	  return 1.;
+	return trajectory.length () / static_cast<value_type> (nFrames - 1);
+      }
+
+      /// \brief Tracked DOF of each sampled frame.
+      dofMap_t dof (const value_type* parameters, size_type stride) const
+      {
+	return dofMap_t
+	  (parameters + dofId_, nSamples_, Eigen::InnerStride<> (stride));
+      }
+
       boost::shared_ptr<VectorInterpolation > vectorInterpolation_;
       boost::shared_ptr<Trajectory<3> > referenceTrajectory_;
       size_type dofId_;
       mutable result_t reference_;
       mutable result_t value_;
       value_type dt_;
+      /// \brief Number of samples of the reference time range.
+      size_type nSamples_;
+      /// \brief Are the samples the reference frames?
+      bool discrete_;
     };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
@@ -0,0 +1,113 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_CUBIC_B_SPLINE_PARAMETRIZATION_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_CUBIC_B_SPLINE_PARAMETRIZATION_HH
+# include <stdexcept>
+# include <utility>
+
+# include <roboptim/trajectory/cubic-b-spline.hh>
+
+# include <roboptim/retargeting/function/linear-trajectory-parametrization.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Sample a cubic B-spline at every frame of a discrete
+    ///        trajectory.
+    ///
+    /// Input: control points (size: number of control points *
+    /// number of DOFs)
+    ///
+    /// Output: discrete trajectory parameters (size: number of
+    /// frames * number of DOFs)
+    ///
+    /// The control points are uniformly spaced (one every
+    /// controlPointsSpacing frames), the basis is computed once by
+    /// roboptim-trajectory CubicBSpline. Each frame depends on four
+    /// control points at most: the jacobian has (at most) four
+    /// non-zeros per row.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class CubicBSplineParametrization
+      : public LinearTrajectoryParametrization<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (LinearTrajectoryParametrization<T>);
+
+      typedef typename LinearTrajectoryParametrization<T>::index_t index_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param nFrames number of frames
+      /// \param nDofs number of DOFs of each frame
+      /// \param controlPointsSpacing number of frames between two
+      ///        control points
+      CubicBSplineParametrization (index_t nFrames,
+				   index_t nDofs,
+				   index_t controlPointsSpacing)
+	: LinearTrajectoryParametrization<T>
+	  (nFrames, nDofs, nControlPoints (nFrames, controlPointsSpacing),
+	   "cubic B-spline parametrization")
+      {
+	this->sample
+	  (CubicBSpline
+	   (std::make_pair (0., static_cast<value_type> (nFrames - 1)), 1,
+	    Function::vector_t::Zero (this->basis ().cols ()),
+	    "cubic B-spline basis"));
+      }
+
+      /// \brief Copy a parametrization using other function traits.
+      template <typename U>
+      explicit CubicBSplineParametrization
+      (const CubicBSplineParametrization<U>& other)
+	: LinearTrajectoryParametrization<T> (other)
+      {}
+
+      virtual ~CubicBSplineParametrization ()
+      {}
+
+      /// \brief Number of control points required to cover nFrames.
+      ///
+      /// Each spline segment spans controlPointsSpacing frames at
+      /// most, a cubic B-spline with n segments has n + 3 control
+      /// points.
+      static index_t nControlPoints (index_t nFrames,
+				     index_t controlPointsSpacing)
+      {
+	if (nFrames < 2)
+	  throw std::runtime_error
+	    ("a spline trajectory requires two frames at least");
+	if (controlPointsSpacing < 1)
+	  throw std::runtime_error ("invalid control points spacing");
+	return
+	  (nFrames - 2) / controlPointsSpacing + 1 + 3;
+      }
+
+      /// \brief Number of control points.
+      index_t nControlPoints () const
+      {
+	return this->basis ().cols ();
+      }
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_CUBIC_B_SPLINE_PARAMETRIZATION_HH
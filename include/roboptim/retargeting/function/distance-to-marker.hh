@@ -17,14 +17,18 @@
 
 #ifndef ROBOPTIM_RETARGETING_FUNCTION_DISTANCE_TO_MARKER_HH
 # define ROBOPTIM_RETARGETING_FUNCTION_DISTANCE_TO_MARKER_HH
+# include <stdexcept>
 # include <string>
 
+# include <boost/format.hpp>
+# include <boost/make_shared.hpp>
+
 # include <roboptim/core/differentiable-function.hh>
 # include <roboptim/core/finite-difference-gradient.hh>
-# include <roboptim/core/numeric-quadratic-function.hh>
 # include <roboptim/core/filter/chain.hh>
 
 # include <roboptim/retargeting/function/joint-to-marker/choreonoid.hh>
+# include <roboptim/retargeting/function/squared-distance-to-reference.hh>
 
 namespace roboptim
 {
@@ -32,54 +36,12 @@ namespace roboptim
   {
     namespace detail
     {
-      /// \brief Quadratic function computing the distance between a
-      ///        vector and a reference.
-      ///
-      /// This formula is widely used as a cost function. In this
-      /// particular case, it will be used by DistanceToMarker class
-      /// (by chaining JointToMarker and this class).
-      ///
-      /// Input: x (size: reference vector size)
-      /// Output: \f$ \sum (x_i - r_i)^2 \f$ (size: 1)
-      ///
-      /// This should be probably promoted as a generic class in
-      /// RobOptim Core at some point.
-      ///
-      /// \tparam T function trait
-      template <typename T>
-      class DistanceToReference : public GenericNumericQuadraticFunction<T>
-      {
-      public:
-	ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
-	(GenericNumericQuadraticFunction<T>);
-
-	/// \brief Constructor
-	///
-	/// Build the quadratic function from the reference vector.
-	///
-	/// \param[in] reference vector
-	explicit DistanceToReference (const vector_t& reference)
-	  : GenericNumericQuadraticFunction<T>
-	    (matrix_t (reference.size (), reference.size ()),
-	     vector_t (reference.size ()),
-	     vector_t (1))
-	{
-	  this->A ().setIdentity ();
-	  this->b () = -2. * reference;
-	  this->c ()[0] = reference.squaredNorm ();
-	}
-      };
-
       template <typename T>
       boost::shared_ptr<GenericDifferentiableFunction<T> >
       distanceToMarkerInternal
-      (const typename GenericDifferentiableFunction<T>::vector_t& references,
+      (boost::shared_ptr<GenericDifferentiableFunction<T> > distanceToRef,
        boost::shared_ptr<GenericDifferentiableFunction<T> > jointToMarker)
       {
-	boost::shared_ptr<GenericDifferentiableFunction<T> >
-	  distanceToRef =
-	  boost::make_shared<DistanceToReference<T> > (references);
-
 	boost::shared_ptr<GenericDifferentiableFunction<T> >
 	  f = chain (distanceToRef, jointToMarker);
 	return f;
@@ -112,7 +74,7 @@ namespace roboptim
       ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
       (GenericDifferentiableFunction<T>);
 
-      typedef boost::shared_ptr<JointToMarkerPositionChoreonoid<T> >
+      typedef boost::shared_ptr<GenericDifferentiableFunction<T> >
       JointToMarkerShPtr_t;
 
 
@@ -121,7 +83,9 @@ namespace roboptim
       /// \param[in] jointToMarker Shared pointer to a JointToMarker
       ///                      function (necessary to compute the
       ///                      relative position of markers w.r.t
-      ///                      robot bodies)
+      ///                      robot bodies), possibly evaluated on
+      ///                      the enabled joints only (see
+      ///                      ReducedCoordinates)
       ///
       /// \param[in] markersReferencePosition Expected markers
       ///                      positions (size: 3 * number of markers)
@@ -130,8 +94,11 @@ namespace roboptim
        const vector_t& markersReferencePosition)
 	: GenericDifferentiableFunction<T>
 	  (jointToMarker->inputSize (), 1, "DistanceToMarker"),
+	  distanceToReference_
+	  (boost::make_shared<SquaredDistanceToReference<T> >
+	   (markersReferencePosition)),
 	  f_ (detail::distanceToMarkerInternal<T>
-	      (markersReferencePosition, jointToMarker)),
+	      (distanceToReference_, jointToMarker)),
 	  nMarkers_
 	  (static_cast<typename vector_t::Index>
 	   (jointToMarker->outputSize () / 3))
@@ -140,6 +107,31 @@ namespace roboptim
       virtual ~DistanceToMarker ()
       {}
 
+      /// \brief Number of markers.
+      typename vector_t::Index nMarkers () const
+      {
+	return nMarkers_;
+      }
+
+      /// \brief Change the markers reference positions.
+      ///
+      /// This allows reusing the same function (and therefore the
+      /// same problem) for several frames.
+      ///
+      /// \param[in] markersReferencePosition Expected markers
+      ///                      positions (size: 3 * number of markers)
+      void setReference (const vector_t& markersReferencePosition)
+      {
+	if (markersReferencePosition.size () != 3 * nMarkers_)
+	  {
+	    boost::format fmt
+	      ("invalid markers reference positions size (%d, %d expected)");
+	    fmt % markersReferencePosition.size () % (3 * nMarkers_);
+	    throw std::runtime_error (fmt.str ());
+	  }
+	distanceToReference_->setReference (markersReferencePosition);
+      }
+
     protected:
       void
       impl_compute
@@ -161,6 +153,7 @@ namespace roboptim
       }
 
     private:
+      boost::shared_ptr<SquaredDistanceToReference<T> > distanceToReference_;
       boost::shared_ptr<GenericDifferentiableFunction<T> > f_;
       typename vector_t::Index nMarkers_;
     };
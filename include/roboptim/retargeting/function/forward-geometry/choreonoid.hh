@@ -29,10 +29,11 @@
 # include <roboptim/retargeting/choreonoid.hh>
 # include <roboptim/retargeting/eigen-rigid-body.hh>
 # include <roboptim/retargeting/function/forward-geometry.hh>
+# include <roboptim/retargeting/evaluation-context.hh>
+# include <roboptim/retargeting/parallel-finite-difference.hh>
+# include <roboptim/retargeting/robot-state.hh>
 # include <roboptim/retargeting/utility.hh>
 
-# include <roboptim/core/finite-difference-gradient.hh>
-
 
 namespace roboptim
 {
@@ -50,42 +51,79 @@ namespace roboptim
     public:
       ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_ (ForwardGeometry<T>);
 
+      // Temporary - finite difference gradient.
+      typedef ParallelFiniteDifference<T> fdFunction_t;
+
       explicit ForwardGeometryChoreonoid
       (cnoid::BodyPtr robot, int bodyId)
 	: ForwardGeometry<T> (6 + robot->numJoints (), "choreonoid"),
-	  robot_ (robot),
+	  contexts_ (boost::make_shared<EvaluationContextPool> (robot, 1)),
 	  bodyId_ (bodyId),
-	  jointPath_ (robot->rootLink ()),
-	  angleAxis_ (),
-	  J_ (),
-	  dR_ (),
-	  fd_ (boost::make_shared<fdFunction_t> (*this))
+	  workspaces_ (),
+	  fd_ ()
       {
-	if (bodyId >= robot->numLinks () || robot->link (bodyId_) == 0)
-	  {
-	    boost::format fmt
-	      ("failed to construct ForwardGeometryChoreonoid function:"
-	       " invalid body id %d (robot contains %d bodies)");
-	    fmt % bodyId % robot->numLinks ();
-	    throw std::runtime_error (fmt.str ());
-	  }
-
-	jointPath_.setPath (robot->rootLink (), robot->link (bodyId_));
-	J_.resize(6, jointPath_.numJoints ());
-	dR_[0].setZero ();
-	dR_[1].setZero ();
-	dR_[2].setZero ();
+	initialize ();
       }
 
       explicit ForwardGeometryChoreonoid
       (cnoid::BodyPtr robot, const std::string& bodyName)
 	: ForwardGeometry<T> (6 + robot->numJoints (), "choreonoid"),
-	  robot_ (robot),
-	  bodyId_ (0),
-	  jointPath_ (robot->rootLink ()),
-	  J_ (),
-	  dR_ (),
-	  fd_ (boost::make_shared<fdFunction_t> (*this))
+	  contexts_ (boost::make_shared<EvaluationContextPool> (robot, 1)),
+	  bodyId_ (bodyIdFromName (robot, bodyName)),
+	  workspaces_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a shared robot state.
+      ///
+      /// Functions sharing the same robot state share the forward
+      /// kinematics cache.
+      explicit ForwardGeometryChoreonoid
+      (RobotStateShPtr robotState, const std::string& bodyName)
+	: ForwardGeometry<T>
+	  (6 + safeGet (robotState).robot ()->numJoints (), "choreonoid"),
+	  contexts_
+	  (boost::make_shared<EvaluationContextPool> (robotState, 1)),
+	  bodyId_ (bodyIdFromName (robotState->robot (), bodyName)),
+	  workspaces_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a pool of evaluation contexts.
+      ///
+      /// The function can then be evaluated concurrently by the
+      /// workers of the shared worker pool.
+      explicit ForwardGeometryChoreonoid
+      (EvaluationContextPoolShPtr contexts, const std::string& bodyName)
+	: ForwardGeometry<T>
+	  (6 + safeGet (contexts).robot ()->numJoints (), "choreonoid"),
+	  contexts_ (contexts),
+	  bodyId_ (bodyIdFromName (contexts->robot (), bodyName)),
+	  workspaces_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      virtual ~ForwardGeometryChoreonoid ()
+      {}
+
+      /// \brief Finite difference policy used for the derivatives.
+      ///
+      /// Columns are computed by the workers of the shared pool
+      /// when the function has one evaluation context per worker.
+      fdFunction_t& finiteDifference () const
+      {
+	return *fd_;
+      }
+
+    private:
+      static int bodyIdFromName (const cnoid::BodyPtr& robot,
+				 const std::string& bodyName)
       {
 	cnoid::Link* link = robot->link (bodyName.c_str ());
 	if (!link)
@@ -96,8 +134,12 @@ namespace roboptim
 	    fmt % bodyName;
 	    throw std::runtime_error (fmt.str ());
 	  }
+	return link->jointId ();
+      }
 
-	bodyId_ = link->jointId ();
+      void initialize ()
+      {
+	const cnoid::BodyPtr& robot = contexts_->robot ();
 	if (bodyId_ >= robot->numLinks () || robot->link (bodyId_) == 0)
 	  {
 	    boost::format fmt
@@ -107,16 +149,60 @@ namespace roboptim
 	    throw std::runtime_error (fmt.str ());
 	  }
 
-	jointPath_.setPath (robot->rootLink (), robot->link (bodyId_));
-	J_.resize(6, jointPath_.numJoints ());
-	dR_[0].setZero ();
-	dR_[1].setZero ();
-	dR_[2].setZero ();
-      }
+	workspaces_.reserve (contexts_->size ());
+	for (std::size_t id = 0; id < contexts_->size (); ++id)
+	  workspaces_.push_back
+	    (boost::make_shared<Workspace>
+	     ((*contexts_)[id].robot (), bodyId_));
 
+	fd_ = boost::make_shared<fdFunction_t> (*this, contexts_->size ());
+      }
 
-      virtual ~ForwardGeometryChoreonoid ()
-      {}
+      /// \brief Buffers used by one evaluation context.
+      struct Workspace
+      {
+	Workspace (const cnoid::BodyPtr& robot, int bodyId)
+	  : jointPath (robot->rootLink (), robot->link (bodyId)),
+	    J (6, jointPath.numJoints ()),
+	    dR ()
+	{
+	  dR[0].setZero ();
+	  dR[1].setZero ();
+	  dR[2].setZero ();
+	}
+
+	/// \brief Path from the root link to the body (context robot).
+	cnoid::JointPath jointPath;
+
+	/// \brief Jacobian computed by Choreonoid (buffer).
+	cnoid::MatrixXd J;
+
+	/// \brief Variation of the derivation w.r.t parameters.
+	///
+	/// Jacobian of the function which associates to the rotation
+	/// parameters the rotation matrix.
+	///
+	/// Jacobian value is expressed at R0 the rotation of the base
+	/// link (i.e. waist).
+	///
+	/// dR[0] is:
+	/// \f$\frac{\partial R_{0}}{\partial \theta}(\theta)\f$
+	///
+	/// \f$R_0\f$ is the rotation matrix first column.
+	boost::array<Eigen::Matrix<value_type, 3, 3>, 3> dR;
+      };
+      typedef boost::shared_ptr<Workspace> WorkspaceShPtr;
+
+      /// \brief Workspace associated with the current thread.
+      ///
+      /// Also updates the robot of the associated context.
+      template <typename Derived>
+      Workspace& localWorkspace (const Eigen::MatrixBase<Derived>& x) const
+      {
+	std::size_t id = contexts_->localId ();
+	(*contexts_)[id].robotState ().update (x);
+	return *workspaces_[id];
+      }
 
     protected:
       void
@@ -124,10 +210,9 @@ namespace roboptim
       (result_t& result, const argument_t& x)
 	const
       {
-	updateRobotConfiguration (robot_, x);
-	robot_->calcForwardKinematics ();
+	Workspace& w = localWorkspace (x);
 	transformToVector
-	  (result, jointPath_.endLink ()->position ());
+	  (result, w.jointPath.endLink ()->position ());
       }
 
 
@@ -165,11 +250,8 @@ namespace roboptim
 		     size_type functionId)
 	const
       {
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
-
-	// Update positions.
-	robot_->calcForwardKinematics ();
+	// Set the robot configuration and update positions.
+	Workspace& w = localWorkspace (x);
 
 	// Free floating (columns 0 to 5).
 
@@ -180,20 +262,20 @@ namespace roboptim
 
 	// columns 3 to 6 (rotation)
 	const typename cnoid::Position::LinearPart& R0 =
-	  jointPath_.baseLink ()->T ().linear ();
+	  w.jointPath.baseLink ()->T ().linear ();
 	const typename cnoid::Position::LinearPart& R =
-	  jointPath_.endLink ()->T ().linear ();
+	  w.jointPath.endLink ()->T ().linear ();
 	const typename cnoid::Position::TranslationPart& t0 =
-	  jointPath_.baseLink ()->T ().translation ();
+	  w.jointPath.baseLink ()->T ().translation ();
 	const typename cnoid::Position::TranslationPart& tk =
-	  jointPath_.endLink ()->T ().translation ();
+	  w.jointPath.endLink ()->T ().translation ();
 
-	updateDR (x.template segment<3> (3));
+	updateDR (w.dR, x.template segment<3> (3));
 
 	Eigen::Matrix<value_type, 3, 3> J_global =
-	  R0.col (2) * R0.col (1).transpose () * dR_[0] +
-	  R0.col (1) * R0.col (0).transpose () * dR_[2] +
-	  R0.col (0) * R0.col (2).transpose () * dR_[1];
+	  R0.col (2) * R0.col (1).transpose () * w.dR[0] +
+	  R0.col (1) * R0.col (0).transpose () * w.dR[2] +
+	  R0.col (0) * R0.col (2).transpose () * w.dR[1];
 
 	if (functionId < 3)
 	  {
@@ -216,12 +298,12 @@ namespace roboptim
 	// First we compute the jacobian for the current joint path.
 	//jointPath_.calcJacobian (J_);
 	cnoid::setJacobian<0x3f, 0, 0>
-	  (this->jointPath_, this->jointPath_.endLink (), J_);
+	  (w.jointPath, w.jointPath.endLink (), w.J);
 
-	for (std::size_t jacobianId = 0; jacobianId < jointPath_.numJoints (); ++jacobianId)
+	for (std::size_t jacobianId = 0; jacobianId < w.jointPath.numJoints (); ++jacobianId)
 	  {
-	    J_.template block <3, 1> (3, jacobianId) =
-	      R0.transpose() * J_.template block <3, 1> (3, jacobianId);
+	    w.J.template block <3, 1> (3, jacobianId) =
+	      R0.transpose() * w.J.template block <3, 1> (3, jacobianId);
 	  }
 
 	// And we replace at the right position. The jacobian of the
@@ -229,43 +311,40 @@ namespace roboptim
 	// the right location manually. All the joints which are not
 	// in the joint path will not have any effect.
 	std::size_t jointId = 0;
-	for (std::size_t jacobianId = 0; jacobianId < jointPath_.numJoints (); ++jacobianId)
+	for (std::size_t jacobianId = 0; jacobianId < w.jointPath.numJoints (); ++jacobianId)
 	  {
-	    jointId = jointPath_.joint (jacobianId)->index () + 6 - 1;
+	    jointId = w.jointPath.joint (jacobianId)->index () + 6 - 1;
 	    ROBOPTIM_RETARGETING_ASSERT (jointId < gradient.size ());
 	    ROBOPTIM_RETARGETING_ASSERT (jointId >= 6);
 
-	    gradient[jointId] = J_ (functionId, jacobianId);
+	    gradient[jointId] = w.J (functionId, jacobianId);
 	  }
       }
 
-      virtual void impl_jacobian2 (jacobian_t& J, const argument_t& x)
+      void impl_jacobian2 (jacobian_t& J, const argument_t& x)
 	const
       {
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
-
-	// Update positions.
-	robot_->calcForwardKinematics ();
+	// Set the robot configuration and update positions.
+	Workspace& w = localWorkspace (x);
 
 	// Free floating (columns 0 to 5).
 
 	// columns 3 to 6 (rotation)
 	const typename cnoid::Position::LinearPart& R0 =
-	  jointPath_.baseLink ()->T ().linear ();
+	  w.jointPath.baseLink ()->T ().linear ();
 	const typename cnoid::Position::LinearPart& R =
-	  jointPath_.endLink ()->T ().linear ();
+	  w.jointPath.endLink ()->T ().linear ();
 	const typename cnoid::Position::TranslationPart& t0 =
-	  jointPath_.baseLink ()->T ().translation ();
+	  w.jointPath.baseLink ()->T ().translation ();
 	const typename cnoid::Position::TranslationPart& tk =
-	  jointPath_.endLink ()->T ().translation ();
+	  w.jointPath.endLink ()->T ().translation ();
 
-	updateDR (x.template segment<3> (3));
+	updateDR (w.dR, x.template segment<3> (3));
 
 	Eigen::Matrix<value_type, 3, 3> J_global =
-	  R0.col (2) * R0.col (1).transpose () * dR_[0] +
-	  R0.col (1) * R0.col (0).transpose () * dR_[2] +
-	  R0.col (0) * R0.col (2).transpose () * dR_[1];
+	  R0.col (2) * R0.col (1).transpose () * w.dR[0] +
+	  R0.col (1) * R0.col (0).transpose () * w.dR[2] +
+	  R0.col (0) * R0.col (2).transpose () * w.dR[1];
 
 	Eigen::Matrix<value_type, 3, 1> p_;
 	Eigen::Matrix<value_type, 3, 1> p = tk + R * p_ - t0;
@@ -283,12 +362,12 @@ namespace roboptim
 	// First we compute the jacobian for the current joint path.
 	//jointPath_.calcJacobian (J_);
 	cnoid::setJacobian<0x3f, 0, 0>
-	  (this->jointPath_, this->jointPath_.endLink (), J_);
+	  (w.jointPath, w.jointPath.endLink (), w.J);
 
-	for (int jacobianId = 0; jacobianId < jointPath_.numJoints (); ++jacobianId)
+	for (int jacobianId = 0; jacobianId < w.jointPath.numJoints (); ++jacobianId)
 	  {
-	    J_.template block <3, 1> (3, jacobianId) =
-	      R0.transpose() * J_.template block <3, 1> (3, jacobianId);
+	    w.J.template block <3, 1> (3, jacobianId) =
+	      R0.transpose() * w.J.template block <3, 1> (3, jacobianId);
 	  }
 
 	// And we replace at the right position. The jacobian of the
@@ -296,13 +375,13 @@ namespace roboptim
 	// the right location manually. All the joints which are not
 	// in the joint path will not have any effect.
 	int jointId = 0;
-	for (int jacobianId = 0; jacobianId < jointPath_.numJoints (); ++jacobianId)
+	for (int jacobianId = 0; jacobianId < w.jointPath.numJoints (); ++jacobianId)
 	  {
-	    jointId = jointPath_.joint (jacobianId)->index () + 6 - 1;
+	    jointId = w.jointPath.joint (jacobianId)->index () + 6 - 1;
 	    ROBOPTIM_RETARGETING_ASSERT (jointId < J.cols ());
 	    ROBOPTIM_RETARGETING_ASSERT (jointId >= 6);
 
-	    J.col (jointId) = J_.col (jacobianId);
+	    J.col (jointId) = w.J.col (jacobianId);
 	  }
 
       }
@@ -317,21 +396,30 @@ namespace roboptim
 	fd_->gradient (gradient, x, functionId);
       }
 
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x)
+	const
+      {
+	fd_->jacobian (jacobian, x);
+      }
+
       // See doc/sympy/euler-angles.py
       template <typename Derived>
-      void updateDR (const typename Eigen::MatrixBase<Derived>& x) const
+      static void
+      updateDR (boost::array<Eigen::Matrix<value_type, 3, 3>, 3>& dR,
+		const typename Eigen::MatrixBase<Derived>& x)
       {
 	value_type cr, sr, cp, sp, cy, sy;
 	sincos (x[0], &sr, &cr);
 	sincos (x[1], &sp, &cp);
 	sincos (x[2], &sy, &cy);
 
-	dR_[0] <<
+	dR[0] <<
 	  0.,  -cy * sp,  -sy * cp,
 	  0.,  -sy * sp,  cy * cp,
 	  0.,  -cp,       0.;
 
-	dR_[1] <<
+	dR[1] <<
 	  cy * sp * cr + sy * sr,
 	  cy * cp * sr,
 	  -sy * sp * sr - cy * cr,
@@ -342,7 +430,7 @@ namespace roboptim
 
 	  cp * cr, -sp * sr, 0.;
 
-	dR_[2] <<
+	dR[2] <<
 	  -cy * sp * sr + sy * cr,
 	  cy * cp * cr,
 	  -sy * sp * cr + cy * sr,
@@ -355,36 +443,14 @@ namespace roboptim
       }
 
     private:
-      cnoid::BodyPtr robot_;
+      /// \brief Robots and forward kinematics caches (one per worker).
+      EvaluationContextPoolShPtr contexts_;
       int bodyId_;
 
-      mutable cnoid::JointPath jointPath_;
-      /// \brief Root link position
-      mutable cnoid::Position rootLinkPosition_;
-      /// \brief Temporary variable used for angle conversions.
-      mutable Eigen::AngleAxis<value_type> angleAxis_;
+      /// \brief Buffers, indexed by evaluation context.
+      std::vector<WorkspaceShPtr> workspaces_;
 
-      /// \brief Jacobian computed by Choreonoid (buffer).
-      mutable cnoid::MatrixXd J_;
-
-      /// \brief Variation of the derivation w.r.t parameters.
-      ///
-      /// Jacobian of the function which associates to the rotation
-      /// parameters the rotation matrix.
-      ///
-      /// Jacobian value is expressed at R0 the rotation of the base
-      /// link (i.e. waist).
-      ///
-      /// dR_[0] is:
-      /// \f$\frac{\partial R_{0}}{\partial \theta}(\theta)\f$
-      ///
-      /// \f$R_0\f$ is the rotation matrix first column.
-      mutable boost::array<Eigen::Matrix<value_type, 3, 3>, 3> dR_;
-
-      // Temporary - finite difference gradient.
-      typedef roboptim::GenericFiniteDifferenceGradient<
-	T, finiteDifferenceGradientPolicies::Simple<T> >
-      fdFunction_t;
+      /// \brief Finite differences (one workspace per context).
       boost::shared_ptr<fdFunction_t> fd_;
 
     public:
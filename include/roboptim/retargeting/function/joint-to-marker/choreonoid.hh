@@ -23,7 +23,11 @@
 
 # include <roboptim/core/differentiable-function.hh>
 
+# include <roboptim/retargeting/batch-forward-kinematics.hh>
+# include <roboptim/retargeting/evaluation-context.hh>
+# include <roboptim/retargeting/jacobian.hh>
 # include <roboptim/retargeting/morphing.hh>
+# include <roboptim/retargeting/robot-state.hh>
 
 // For update configuration function.
 # include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
@@ -51,6 +55,9 @@ namespace roboptim
     public:
       ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_ (GenericDifferentiableFunction<T>);
 
+      /// \brief Structure of arrays matrix (one row per configuration).
+      typedef BatchForwardKinematics::matrix_t batchMatrix_t;
+
       explicit JointToMarkerPositionChoreonoid
       (cnoid::BodyPtr robot,
        const MorphingData& morphing)
@@ -58,34 +65,152 @@ namespace roboptim
 	  (6 + robot->numJoints (),
 	   3 * static_cast<size_type> (morphing.markers.size ()),
 	   "JointToMarkerPosition"),
-	  robot_ (robot),
+	  contexts_ (boost::make_shared<EvaluationContextPool> (robot, 1)),
+	  morphing_ (morphing),
+	  workspaces_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a shared robot state.
+      ///
+      /// Functions sharing the same robot state share the forward
+      /// kinematics cache.
+      explicit JointToMarkerPositionChoreonoid
+      (RobotStateShPtr robotState,
+       const MorphingData& morphing)
+	: GenericDifferentiableFunction<T>
+	  (6 + safeGet (robotState).robot ()->numJoints (),
+	   3 * static_cast<size_type> (morphing.markers.size ()),
+	   "JointToMarkerPosition"),
+	  contexts_
+	  (boost::make_shared<EvaluationContextPool> (robotState, 1)),
 	  morphing_ (morphing),
-	  markerPositions_
-	  (static_cast<std::size_t> (3 * morphing.markers.size ())),
-	  jointPath_ (),
-	  J_ (),
-	  dR_ ()
+	  workspaces_ ()
       {
-	J_.resize (3, robot->numJoints ());
-	dR_[0].setZero ();
-	dR_[1].setZero ();
-	dR_[2].setZero ();
+	initialize ();
+      }
+
+      /// \brief Build the function from a pool of evaluation contexts.
+      ///
+      /// The function can then be evaluated concurrently by the
+      /// workers of the shared worker pool.
+      explicit JointToMarkerPositionChoreonoid
+      (EvaluationContextPoolShPtr contexts,
+       const MorphingData& morphing)
+	: GenericDifferentiableFunction<T>
+	  (6 + safeGet (contexts).robot ()->numJoints (),
+	   3 * static_cast<size_type> (morphing.markers.size ()),
+	   "JointToMarkerPosition"),
+	  contexts_ (contexts),
+	  morphing_ (morphing),
+	  workspaces_ ()
+      {
+	initialize ();
       }
 
       virtual ~JointToMarkerPositionChoreonoid ()
       {}
 
+      /// \brief Compute the markers positions for K configurations.
+      ///
+      /// Equivalent to K evaluations of the function but the forward
+      /// kinematics are computed for all the configurations at once
+      /// by BatchForwardKinematics.
+      ///
+      /// \param result K x (3 * number of markers) matrix, row k
+      ///        being the function value for the configuration k
+      /// \param configurations K x (6 + number of joints) matrix, one
+      ///        configuration per row
+      template <typename Derived>
+      void computeBatch (batchMatrix_t& result,
+			 const Eigen::MatrixBase<Derived>& configurations)
+	const
+      {
+	BatchForwardKinematics& batch =
+	  *workspaces_[contexts_->localId ()]->batch;
+	batch.compute (configurations);
+	const cnoid::BodyPtr& robot = batch.robot ();
+
+	result.resize (configurations.rows (), this->outputSize ());
+
+	typedef std::vector<std::string>::const_iterator const_iterator;
+
+	batchMatrix_t::Index markerIndex = 0;
+	for (const_iterator it = morphing_.markers.begin ();
+	     it != morphing_.markers.end ();
+	     ++it, ++markerIndex)
+	  {
+	    try
+	      {
+		const std::string& linkName = morphing_.attachedBody (*it);
+		cnoid::Link* link = robot->link (linkName);
+		if (!link)
+		  {
+		    result.middleCols (markerIndex * 3, 3).setZero ();
+		    continue;
+		  }
+
+		Eigen::Vector3d offset = morphing_.offset (linkName, *it);
+		result.middleCols (markerIndex * 3, 3) =
+		  batch.position (link->index ());
+		result.middleCols (markerIndex * 3, 3).rowwise () +=
+		  offset.transpose ();
+	      }
+	    catch (const std::exception&)
+	      {
+		result.middleCols (markerIndex * 3, 3).setZero ();
+	      }
+	  }
+      }
+
+    private:
+      /// \brief Buffers used by one evaluation context.
+      struct Workspace
+      {
+	explicit Workspace (const cnoid::BodyPtr& robot, size_type outputSize)
+	  : jointPath (),
+	    J (3, robot->numJoints ()),
+	    dR (),
+	    batch (boost::make_shared<BatchForwardKinematics> (robot)),
+	    gradient (6 + robot->numJoints ()),
+	    jacobian (outputSize, 6 + robot->numJoints ())
+	{
+	  dR[0].setZero ();
+	  dR[1].setZero ();
+	  dR[2].setZero ();
+	}
+
+	cnoid::JointPath jointPath;
+	cnoid::MatrixXd J;
+	boost::array<Eigen::Matrix<value_type, 3, 3>, 3> dR;
+	/// \brief Forward kinematics for batched evaluations.
+	BatchForwardKinematicsShPtr batch;
+	/// \brief Dense buffers used to fill sparse derivatives.
+	Eigen::Matrix<value_type, Eigen::Dynamic, 1> gradient;
+	Eigen::Matrix<value_type, Eigen::Dynamic, Eigen::Dynamic> jacobian;
+      };
+      typedef boost::shared_ptr<Workspace> WorkspaceShPtr;
+
+      void initialize ()
+      {
+	workspaces_.reserve (contexts_->size ());
+	for (std::size_t id = 0; id < contexts_->size (); ++id)
+	  workspaces_.push_back
+	    (boost::make_shared<Workspace>
+	     ((*contexts_)[id].robot (), this->outputSize ()));
+      }
+
     protected:
       void
       impl_compute
       (result_t& result, const argument_t& x)
 	const
       {
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
-
-	// Update body positions
-	robot_->calcForwardKinematics ();
+	// Set the robot configuration and update body positions.
+	EvaluationContext& context = contexts_->local ();
+	context.robotState ().update (x);
+	const cnoid::BodyPtr& robot = context.robot ();
 
 	// combine forward geometry with marker offset
 	typedef std::vector<std::string>::const_iterator const_iterator;
@@ -98,7 +223,7 @@ namespace roboptim
 	    try
 	      {
 		const std::string& linkName = morphing_.attachedBody (*it);
-		cnoid::Link* link = robot_->link (linkName);
+		cnoid::Link* link = robot->link (linkName);
 
 		result.segment (markerIndex * 3, 3) = link->p ();
 		result.segment (markerIndex * 3, 3) +=
@@ -117,7 +242,30 @@ namespace roboptim
 		     size_type functionId)
 	const
       {
-	cnoid::Link* rootLink = robot_->rootLink ();
+	computeGradient (gradient, x, functionId);
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian,
+		     const argument_t& x)
+	const
+      {
+	computeJacobian (jacobian, x);
+      }
+
+      /// \brief Compute one row of the jacobian (dense gradient).
+      template <typename Derived>
+      void
+      computeGradient (Eigen::MatrixBase<Derived>& gradient,
+		       const argument_t& x,
+		       size_type functionId)
+	const
+      {
+	std::size_t contextId = contexts_->localId ();
+	EvaluationContext& context = (*contexts_)[contextId];
+	Workspace& w = *workspaces_[contextId];
+	const cnoid::BodyPtr& robot = context.robot ();
+	cnoid::Link* rootLink = robot->rootLink ();
 
 	// Determine which marker matches this
 	//
@@ -138,7 +286,7 @@ namespace roboptim
 	try
 	  {
 	    linkName = morphing_.attachedBody (markerName);
-	    link = robot_->link (linkName);
+	    link = robot->link (linkName);
 	  }
 	catch (const std::exception& e)
 	  {
@@ -147,36 +295,33 @@ namespace roboptim
 	  }
 
 	// Update paths.
-	jointPath_.setPath (rootLink, link);
-
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
+	w.jointPath.setPath (rootLink, link);
 
-	// Update body positions
-	robot_->calcForwardKinematics ();
+	// Set the robot configuration and update body positions.
+	context.robotState ().update (x);
 
 	// Compute the jacobian.
 	Eigen::Vector3d localPos =
 	  morphing_.offset (linkName, markerName);
 
 	cnoid::setJacobian<0x7, 0, 0, true>
-	  (jointPath_, link, localPos, J_);
+	  (w.jointPath, link, localPos, w.J);
 
 	const typename cnoid::Position::LinearPart& R0 =
-	  jointPath_.baseLink ()->T ().linear ();
+	  w.jointPath.baseLink ()->T ().linear ();
 	const typename cnoid::Position::LinearPart& R =
-	  jointPath_.endLink ()->T ().linear ();
+	  w.jointPath.endLink ()->T ().linear ();
 	const typename cnoid::Position::TranslationPart& t0 =
-	  jointPath_.baseLink ()->T ().translation ();
+	  w.jointPath.baseLink ()->T ().translation ();
 	const typename cnoid::Position::TranslationPart& tk =
-	  jointPath_.endLink ()->T ().translation ();
+	  w.jointPath.endLink ()->T ().translation ();
 
-	updateDR (x.template segment<3> (3));
+	updateDR (w.dR, x.template segment<3> (3));
 
 	Eigen::Matrix<value_type, 3, 3> J_global =
-	  R0.col (2) * R0.col (1).transpose () * dR_[0] +
-	  R0.col (1) * R0.col (0).transpose () * dR_[2] +
-	  R0.col (0) * R0.col (2).transpose () * dR_[1];
+	  R0.col (2) * R0.col (1).transpose () * w.dR[0] +
+	  R0.col (1) * R0.col (0).transpose () * w.dR[2] +
+	  R0.col (0) * R0.col (2).transpose () * w.dR[1];
 
 	Eigen::Matrix<value_type, 3, 1> p = tk + R * localPos - t0;
 	Eigen::Matrix<value_type, 3, 3> hatp;
@@ -194,30 +339,46 @@ namespace roboptim
 	// in the joint path will not have any effect.
 	int jointId = 0;
 	for (int jacobianId = 0;
-	     jacobianId < jointPath_.numJoints (); ++jacobianId)
+	     jacobianId < w.jointPath.numJoints (); ++jacobianId)
 	  {
-	    jointId = jointPath_.joint (jacobianId)->index () + 6 - 1;
+	    jointId = w.jointPath.joint (jacobianId)->index () + 6 - 1;
 	    ROBOPTIM_RETARGETING_ASSERT (jointId < gradient.size ());
 	    ROBOPTIM_RETARGETING_ASSERT (jointId >= 6);
 
-	    gradient[jointId] = J_ (dim, jacobianId);
+	    gradient[jointId] = w.J (dim, jacobianId);
 	  }
 
       }
 
+      /// \brief Compute a sparse gradient through a dense buffer.
+      template <typename Derived>
       void
-      impl_jacobian (jacobian_t& jacobian,
-		     const argument_t& x)
+      computeGradient (Eigen::SparseMatrixBase<Derived>& gradient,
+		       const argument_t& x,
+		       size_type functionId)
 	const
       {
-	cnoid::Link* rootLink = robot_->rootLink ();
-	jacobian.setZero ();
+	Workspace& w = *workspaces_[contexts_->localId ()];
+	computeGradient (w.gradient, x, functionId);
+	assignDense (gradient, w.gradient);
+      }
 
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
+      /// \brief Compute the dense jacobian.
+      template <typename Derived>
+      void
+      computeJacobian (Eigen::MatrixBase<Derived>& jacobian,
+		       const argument_t& x)
+	const
+      {
+	std::size_t contextId = contexts_->localId ();
+	EvaluationContext& context = (*contexts_)[contextId];
+	Workspace& w = *workspaces_[contextId];
+	const cnoid::BodyPtr& robot = context.robot ();
+	cnoid::Link* rootLink = robot->rootLink ();
+	jacobian.setZero ();
 
-	// Update body positions
-	robot_->calcForwardKinematics ();
+	// Set the robot configuration and update body positions.
+	context.robotState ().update (x);
 
 	for (std::size_t markerId = 0;
 	     markerId < morphing_.markers.size (); ++markerId)
@@ -236,7 +397,7 @@ namespace roboptim
 	    {
 	      markerName = morphing_.markers[markerId];
 	      linkName = morphing_.attachedBody (markerName);
-	      link = robot_->link (linkName);
+	      link = robot->link (linkName);
 	    }
 	  catch (const std::exception&)
 	    {
@@ -245,30 +406,30 @@ namespace roboptim
 	    }
 
 
-	  jointPath_.setPath (rootLink, link);
+	  w.jointPath.setPath (rootLink, link);
 
 	  // Compute the jacobian.
 	  Eigen::Vector3d localPos =
 	    morphing_.offset (linkName, markerName);
 
 	  cnoid::setJacobian<0x7, 0, 0, true>
-	    (jointPath_, link, localPos, J_);
+	    (w.jointPath, link, localPos, w.J);
 
 	  const typename cnoid::Position::LinearPart& R0 =
-	    jointPath_.baseLink ()->T ().linear ();
+	    w.jointPath.baseLink ()->T ().linear ();
 	  const typename cnoid::Position::LinearPart& R =
-	    jointPath_.endLink ()->T ().linear ();
+	    w.jointPath.endLink ()->T ().linear ();
 	  const typename cnoid::Position::TranslationPart& t0 =
-	    jointPath_.baseLink ()->T ().translation ();
+	    w.jointPath.baseLink ()->T ().translation ();
 	  const typename cnoid::Position::TranslationPart& tk =
-	    jointPath_.endLink ()->T ().translation ();
+	    w.jointPath.endLink ()->T ().translation ();
 
-	  updateDR (x.template segment<3> (3));
+	  updateDR (w.dR, x.template segment<3> (3));
 
 	  Eigen::Matrix<value_type, 3, 3> J_global =
-	    R0.col (2) * R0.col (1).transpose () * dR_[0] +
-	    R0.col (1) * R0.col (0).transpose () * dR_[2] +
-	    R0.col (0) * R0.col (2).transpose () * dR_[1];
+	    R0.col (2) * R0.col (1).transpose () * w.dR[0] +
+	    R0.col (1) * R0.col (0).transpose () * w.dR[2] +
+	    R0.col (0) * R0.col (2).transpose () * w.dR[1];
 
 	  Eigen::Matrix<value_type, 3, 1> p = tk + R * localPos - t0;
 	  Eigen::Matrix<value_type, 3, 3> hatp;
@@ -286,33 +447,47 @@ namespace roboptim
 	  // in the joint path will not have any effect.
 	  int jointId = 0;
 	  for (int jacobianId = 0;
-	       jacobianId < jointPath_.numJoints (); ++jacobianId)
+	       jacobianId < w.jointPath.numJoints (); ++jacobianId)
 	    {
-	      jointId = jointPath_.joint (jacobianId)->index () + 6 - 1;
+	      jointId = w.jointPath.joint (jacobianId)->index () + 6 - 1;
 	      ROBOPTIM_RETARGETING_ASSERT (jointId < jacobian.cols ());
 	      ROBOPTIM_RETARGETING_ASSERT (jointId >= 6);
 
 	      jacobian.template block<3, 1> (markerId_ * 3, jointId) =
-		J_.col (jacobianId);
+		w.J.col (jacobianId);
 	    }
 	}
       }
 
+      /// \brief Compute a sparse jacobian through a dense buffer.
+      template <typename Derived>
+      void
+      computeJacobian (Eigen::SparseMatrixBase<Derived>& jacobian,
+		       const argument_t& x)
+	const
+      {
+	Workspace& w = *workspaces_[contexts_->localId ()];
+	computeJacobian (w.jacobian, x);
+	assignDense (jacobian, w.jacobian);
+      }
+
       // See doc/sympy/euler-angles.py
       template <typename Derived>
-      void updateDR (const typename Eigen::MatrixBase<Derived>& x) const
+      static void
+      updateDR (boost::array<Eigen::Matrix<value_type, 3, 3>, 3>& dR,
+		const typename Eigen::MatrixBase<Derived>& x)
       {
 	value_type cr, sr, cp, sp, cy, sy;
 	sincos (x[0], &sr, &cr);
 	sincos (x[1], &sp, &cp);
 	sincos (x[2], &sy, &cy);
 
-	dR_[0] <<
+	dR[0] <<
 	  0.,  -cy * sp,  -sy * cp,
 	  0.,  -sy * sp,  cy * cp,
 	  0.,  -cp,       0.;
 
-	dR_[1] <<
+	dR[1] <<
 	  cy * sp * cr + sy * sr,
 	  cy * cp * sr,
 	  -sy * sp * sr - cy * cr,
@@ -323,7 +498,7 @@ namespace roboptim
 
 	  cp * cr, -sp * sr, 0.;
 
-	dR_[2] <<
+	dR[2] <<
 	  -cy * sp * sr + sy * cr,
 	  cy * cp * cr,
 	  -sy * sp * cr + cy * sr,
@@ -336,18 +511,12 @@ namespace roboptim
       }
 
     private:
-      cnoid::BodyPtr robot_;
+      /// \brief Robots and forward kinematics caches (one per worker).
+      EvaluationContextPoolShPtr contexts_;
       const MorphingData& morphing_;
 
-      mutable std::vector<
-	cnoid::Vector3,
-	Eigen::aligned_allocator<cnoid::Vector3>
-	>
-	markerPositions_;
-
-      mutable cnoid::JointPath jointPath_;
-      mutable cnoid::MatrixXd J_;
-      mutable boost::array<Eigen::Matrix<value_type, 3, 3>, 3> dR_;
+      /// \brief Buffers, indexed by evaluation context.
+      std::vector<WorkspaceShPtr> workspaces_;
     };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
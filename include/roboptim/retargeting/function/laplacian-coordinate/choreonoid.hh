@@ -89,8 +89,8 @@ namespace roboptim
 		// two the weight.
 		size_type markerId = safeGet (markerMapping).markerIdEigen (itMarker->first);
 		size_type neighborId = safeGet (markerMapping).markerIdEigen (*itNeighbor);
-		A (std::min (markerId, neighborId),
-		   std::max (markerId, neighborId)) -= weight / 2.;
+		A.coeffRef (std::min (markerId, neighborId),
+			    std::max (markerId, neighborId)) -= weight / 2.;
 	      }
 	  }
 
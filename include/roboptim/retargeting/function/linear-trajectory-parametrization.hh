@@ -0,0 +1,263 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_LINEAR_TRAJECTORY_PARAMETRIZATION_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_LINEAR_TRAJECTORY_PARAMETRIZATION_HH
+# include <stdexcept>
+# include <string>
+# include <vector>
+
+# include <boost/format.hpp>
+
+# include <Eigen/Cholesky>
+# include <Eigen/SparseCore>
+
+# include <roboptim/core/linear-function.hh>
+
+# include <roboptim/retargeting/jacobian.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Sample a trajectory, linear in its parameters, at
+    ///        every frame of a discrete trajectory.
+    ///
+    /// Input: trajectory parameters (size: number of parameters per
+    /// DOF * number of DOFs)
+    ///
+    /// Output: discrete trajectory parameters, i.e. the
+    /// configuration of each frame (size: number of frames * number
+    /// of DOFs)
+    ///
+    /// Each DOF is parametrized independently by the same basis B
+    /// (one row per frame, one column per parameter): the
+    /// configuration of frame k is \f$ \sum_i B_{ki} p_i \f$ where
+    /// \f$ p_i \f$ is the i-th block of nDofs parameters.
+    ///
+    /// Chaining a function of the discrete trajectory with this
+    /// function makes it a function of the trajectory parameters.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class LinearTrajectoryParametrization : public GenericLinearFunction<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericLinearFunction<T>);
+
+      typedef typename vector_t::Index index_t;
+
+      /// \brief Trajectory basis (one row per frame, one column per
+      ///        parameter of each DOF).
+      typedef Eigen::SparseMatrix<value_type, Eigen::RowMajor> basis_t;
+
+      /// \brief Copy a parametrization using other function traits.
+      template <typename U>
+      explicit LinearTrajectoryParametrization
+      (const LinearTrajectoryParametrization<U>& other)
+	: GenericLinearFunction<T>
+	  (other.inputSize (), other.outputSize (), other.getName ()),
+	  nDofs_ (other.nDofs ()),
+	  basis_ (other.basis ()),
+	  triplets_ ()
+      {
+	triplets_.reserve
+	  (static_cast<std::size_t> (basis_.nonZeros () * nDofs_));
+      }
+
+      virtual ~LinearTrajectoryParametrization ()
+      {}
+
+      /// \brief Number of DOFs of each frame.
+      index_t nDofs () const
+      {
+	return nDofs_;
+      }
+
+      /// \brief Number of frames.
+      index_t nFrames () const
+      {
+	return basis_.rows ();
+      }
+
+      /// \brief Trajectory basis.
+      const basis_t& basis () const
+      {
+	return basis_;
+      }
+
+      /// \brief Bounds of the parameters from the bounds of one
+      ///        configuration.
+      ///
+      /// By default, the basis is assumed to be non-negative and to
+      /// sum to one (e.g. B-spline): each frame is then a convex
+      /// combination of the parameters and bounding them with the
+      /// configuration bounds bounds every frame.
+      ///
+      /// \param limits bounds of each DOF (size: number of DOFs)
+      /// \return bounds of each parameter (size: input size)
+      virtual Function::intervals_t
+      argumentBounds (const Function::intervals_t& limits) const
+      {
+	Function::intervals_t bounds
+	  (static_cast<std::size_t> (this->inputSize ()));
+	for (std::size_t i = 0; i < bounds.size (); ++i)
+	  bounds[i] = limits[i % limits.size ()];
+	return bounds;
+      }
+
+      /// \brief Parameters approximating a discrete trajectory.
+      ///
+      /// Least squares fit of all the DOFs at once:
+      /// \f$ (B^T B) P = B^T X \f$.
+      ///
+      /// \param trajectory discrete trajectory parameters (size:
+      ///        output size)
+      /// \return trajectory parameters (size: input size)
+      vector_t fit (const vector_t& trajectory) const
+      {
+	if (trajectory.size () != this->outputSize ())
+	  {
+	    boost::format fmt
+	      ("invalid trajectory size (%d, %d expected)");
+	    fmt % trajectory.size () % this->outputSize ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+
+	// One row per frame, one column per DOF.
+	Function::matrix_t frames =
+	  Eigen::Map<const Function::matrix_t>
+	  (trajectory.data (), nDofs_, nFrames ()).transpose ();
+
+	const Function::matrix_t basis = basis_;
+	Function::matrix_t parameters =
+	  (basis.transpose () * basis).ldlt ()
+	  .solve (basis.transpose () * frames);
+
+	Function::matrix_t transposed = parameters.transpose ();
+	return Eigen::Map<const vector_t>
+	  (transposed.data (), this->inputSize ());
+      }
+
+    protected:
+      /// \brief Constructor.
+      ///
+      /// The basis is filled by the derived classes (see sample).
+      ///
+      /// \param nFrames number of frames
+      /// \param nDofs number of DOFs of each frame
+      /// \param nParameters number of parameters of each DOF
+      /// \param name function name
+      LinearTrajectoryParametrization (index_t nFrames,
+				       index_t nDofs,
+				       index_t nParameters,
+				       const std::string& name)
+	: GenericLinearFunction<T>
+	  (nDofs * nParameters, nDofs * nFrames, name),
+	  nDofs_ (nDofs),
+	  basis_ (nFrames, nParameters),
+	  triplets_ ()
+      {
+	if (nParameters > nFrames)
+	  {
+	    boost::format fmt
+	      ("too many parameters (%d for %d frames),"
+	       " increase the spacing");
+	    fmt % nParameters % nFrames;
+	    throw std::runtime_error (fmt.str ());
+	  }
+      }
+
+      /// \brief Fill the basis by sampling a one dimensional
+      ///        trajectory at each frame.
+      ///
+      /// Frame k is sampled at time k: the variation of the
+      /// trajectory w.r.t. its parameters is the value of each
+      /// basis function.
+      ///
+      /// \param trajectory one dimensional trajectory (one
+      ///        parameter per basis column)
+      template <typename U>
+      void sample (const U& trajectory)
+      {
+	std::vector<triplet_t> triplets;
+	for (index_t frame = 0; frame < nFrames (); ++frame)
+	  {
+	    Function::matrix_t row =
+	      trajectory.variationConfigWrtParam
+	      (static_cast<value_type> (frame));
+	    for (index_t i = 0; i < row.cols (); ++i)
+	      if (row (0, i) != 0.)
+		triplets.push_back (triplet_t (frame, i, row (0, i)));
+	  }
+	basis_.setFromTriplets (triplets.begin (), triplets.end ());
+
+	triplets_.reserve
+	  (static_cast<std::size_t> (basis_.nonZeros () * nDofs_));
+      }
+
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	result.setZero ();
+	for (index_t frame = 0; frame < basis_.outerSize (); ++frame)
+	  for (typename basis_t::InnerIterator it (basis_, frame); it; ++it)
+	    result.segment (frame * nDofs_, nDofs_) +=
+	      it.value () * x.segment (it.col () * nDofs_, nDofs_);
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t&,
+		     size_type functionId) const
+      {
+	const index_t frame = functionId / nDofs_;
+	const index_t dof = functionId % nDofs_;
+
+	gradient.setZero ();
+	for (typename basis_t::InnerIterator it (basis_, frame); it; ++it)
+	  gradient.coeffRef (it.col () * nDofs_ + dof) = it.value ();
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t&) const
+      {
+	triplets_.clear ();
+	for (index_t frame = 0; frame < basis_.outerSize (); ++frame)
+	  for (typename basis_t::InnerIterator it (basis_, frame); it; ++it)
+	    for (index_t dof = 0; dof < nDofs_; ++dof)
+	      triplets_.push_back
+		(triplet_t (frame * nDofs_ + dof,
+			    it.col () * nDofs_ + dof,
+			    it.value ()));
+	assignTriplets (jacobian, triplets_);
+      }
+
+    private:
+      typedef Eigen::Triplet<value_type> triplet_t;
+
+      /// \brief Number of DOFs of each frame.
+      index_t nDofs_;
+      /// \brief Trajectory basis.
+      basis_t basis_;
+      /// \brief Jacobian non-zeros buffer.
+      mutable std::vector<triplet_t> triplets_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_LINEAR_TRAJECTORY_PARAMETRIZATION_HH
@@ -27,9 +27,10 @@
 # include <roboptim/core/numeric-quadratic-function.hh>
 # include <roboptim/core/util.hh>
 
-# include <roboptim/retargeting/function/rss.hh>
 # include <roboptim/retargeting/function/laplacian-coordinate/choreonoid.hh>
 # include <roboptim/retargeting/function/joint-to-marker/choreonoid.hh>
+# include <roboptim/retargeting/function/squared-distance-to-reference.hh>
+# include <roboptim/retargeting/jacobian.hh>
 # include <roboptim/retargeting/utility.hh>
 
 namespace roboptim
@@ -99,7 +100,8 @@ namespace roboptim
       typedef std::vector<LaplacianCoordinateShPtr_t>
       LaplacianCoordinatesShPtr_t;
 
-      typedef boost::shared_ptr<RSS<T> > LaplacianDeformationEnergy_t;
+      typedef boost::shared_ptr<SquaredDistanceToReference<T> >
+      LaplacianDeformationEnergy_t;
       typedef std::vector<LaplacianDeformationEnergy_t>
       LaplacianDeformationEnergies_t;
 
@@ -109,6 +111,8 @@ namespace roboptim
       typedef std::vector<DifferentiableFunctionShPtr_t>
       DifferentiableFunctionsShPtr_t;
 
+      typedef Eigen::Matrix<value_type, Eigen::Dynamic, 1> denseVector_t;
+
       /// \}
 
 
@@ -146,7 +150,9 @@ namespace roboptim
 	  lde_ (nDiscretizationPoints_),
 	  chain_ (nDiscretizationPoints_),
 
-	  markerPositions_ (safeGet (markerMapping).numMarkersEigen () * 3)
+	  markerPositions_ (safeGet (markerMapping).numMarkersEigen () * 3),
+	  denseGradient_ (),
+	  chainGradient_ ()
       {
 	// Fill array and create necessary functions for each
 	// discretization point.
@@ -164,7 +170,7 @@ namespace roboptim
 	      (markerMapping, mesh, p, markerPositions_);
 
 	    // Create the quadratic function computing ||A-X||^2
-	    lde_[p] = boost::make_shared<RSS<T> >
+	    lde_[p] = boost::make_shared<SquaredDistanceToReference<T> >
 	      ((*laplacianCoordinate_[p]) (markerPositions_));
 
 	    // Chain the three functions together.
@@ -262,20 +268,26 @@ namespace roboptim
 
 	trajectory_->setParameters (x);
 
-	gradient.setZero ();
+	// Per-frame gradients are accumulated in a dense buffer, the
+	// sparse gradient is only built once.
+	denseGradient_.resize (this->inputSize ());
+	denseGradient_.setZero ();
+	chainGradient_.resize (trajectory_->outputSize ());
 
 	typename vector_t::Index p = 0;
 	for (it = chain_.begin (); it != chain_.end (); ++it, ++p)
 	  {
 	    StableTimePoint t =
 	      static_cast<std::size_t> (p) / nDiscretizationPoints_ * tMax;
-	    gradient.segment
+	    copyToDense (chainGradient_,
+			 (*it)->gradient (safeGet (trajectory_) (t)));
+	    denseGradient_.segment
 	      (p * trajectory_->outputSize (), trajectory_->outputSize ())
-	      += (*it)->gradient
-	      (safeGet (trajectory_) (t));
+	      += chainGradient_;
 	  }
 
-	gradient *= .5;
+	denseGradient_ *= .5;
+	assignDense (gradient, denseGradient_);
 
 	ROBOPTIM_RETARGETING_ASSERT
 	  (static_cast<std::size_t> (p) == nDiscretizationPoints_);
@@ -366,6 +378,12 @@ namespace roboptim
       /// \brief Mutable buffer to store the marker position as
       ///        computed by jointToMarker for the current frame.
       mutable result_t markerPositions_;
+
+      /// \brief Mutable buffer accumulating the gradient.
+      mutable denseVector_t denseGradient_;
+
+      /// \brief Mutable buffer storing the gradient of one frame.
+      mutable denseVector_t chainGradient_;
     };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
@@ -19,6 +19,9 @@
 # define ROBOPTIM_RETARGETING_MINIMUM_JERK_TRAJECTORY_HH
 # include <boost/array.hpp>
 # include <boost/shared_ptr.hpp>
+
+# include <Eigen/Core>
+
 # include <roboptim/trajectory/trajectory.hh>
 
 namespace roboptim
@@ -33,8 +36,14 @@ namespace roboptim
     /// - velocity start
     /// - acceleration start
     ///
-    /// This class is a partial implementation of a Trajectory.
-    /// Some methods will return a runtime_error if called.
+    /// The final velocity and acceleration are zero. Outside of the
+    /// time range, the trajectory stays at the start (resp. end)
+    /// position: the time range bounds are the two singular points.
+    ///
+    /// The trajectory is linear w.r.t. its parameters, the
+    /// variations are computed analytically.
+    ///
+    /// See PiecewiseMinimumJerkTrajectory for several segments.
     template <typename T>
     class MinimumJerkTrajectory :
       public Trajectory<3>
@@ -46,12 +55,12 @@ namespace roboptim
       ROBOPTIM_IMPLEMENT_CLONE (MinimumJerkTrajectory<T>);
 
       explicit MinimumJerkTrajectory () ;
+      explicit MinimumJerkTrajectory (interval_t timeRange) ;
       virtual ~MinimumJerkTrajectory () ;
 
       /// \brief Store parameters and update coefficients.
       void setParameters (const vector_t&) ;
-    protected:
-      void impl_compute (result_t& result, double t) const ;
+
       jacobian_t variationConfigWrtParam (double t) const ;
       jacobian_t variationDerivWrtParam (double t, size_type order)
 	const ;
@@ -64,15 +73,27 @@ namespace roboptim
       jacobian_t
       variationDerivWrtParam (StableTimePoint tp, size_type order)
       const ;
+      Trajectory<3>* resize (interval_t timeRange)
+	const ;
+    protected:
+      void impl_compute (result_t& result, double t) const ;
       void impl_derivative (gradient_t& derivative,
 			    double argument,
 			    size_type order = 1) const ;
       void impl_derivative (gradient_t& g, StableTimePoint, size_type order)
 	const ;
-      Trajectory<3>* resize (interval_t timeRange)
-	const ;
     private:
+      /// \brief Derivative of the polynomial.
+      ///
+      /// \param s scaled time (0 at the start, 1 at the end)
+      /// \param order derivation order
+      value_type polynomialDerivative (value_type s, size_type order) const;
+
+      /// \brief Polynomial coefficients (w.r.t. the scaled time).
       boost::array<value_type, 6> coefficients_;
+
+      /// \brief Variation of the coefficients w.r.t. the parameters.
+      Eigen::Matrix<value_type, 6, 4> coefficientsJacobian_;
     };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
@@ -17,20 +17,54 @@
 
 #ifndef ROBOPTIM_RETARGETING_MINIMUM_JERK_TRAJECTORY_HXX
 # define ROBOPTIM_RETARGETING_MINIMUM_JERK_TRAJECTORY_HXX
+# include <cmath>
+
 # include <roboptim/retargeting/function/minimum-jerk-trajectory.hh>
 
 namespace roboptim
 {
   namespace retargeting
   {
+    namespace detail
+    {
+      /// \brief Factor of the order-th derivative of t^power.
+      ///
+      /// \f$ \frac{d^n}{dt^n} t^p = \frac{p!}{(p - n)!} t^{p - n} \f$
+      inline double
+      powerDerivativeFactor (std::size_t power, std::size_t order)
+      {
+	if (order > power)
+	  return 0.;
+	double factor = 1.;
+	for (std::size_t i = 0; i < order; ++i)
+	  factor *= static_cast<double> (power - i);
+	return factor;
+      }
+    } // end of namespace detail.
+
     template <typename T>
     MinimumJerkTrajectory<T>::MinimumJerkTrajectory
     ()
       : Trajectory<3> (makeInterval (0., 1.), 1,
 		       vector_t::Zero (4),
 		       "minimum jerk trajectory"),
-	coefficients_ ()
-    {}
+	coefficients_ (),
+	coefficientsJacobian_ ()
+    {
+      setParameters (vector_t::Zero (4));
+    }
+
+    template <typename T>
+    MinimumJerkTrajectory<T>::MinimumJerkTrajectory
+    (interval_t timeRange)
+      : Trajectory<3> (timeRange, 1,
+		       vector_t::Zero (4),
+		       "minimum jerk trajectory"),
+	coefficients_ (),
+	coefficientsJacobian_ ()
+    {
+      setParameters (vector_t::Zero (4));
+    }
 
     template <typename T>
     MinimumJerkTrajectory<T>::~MinimumJerkTrajectory ()
@@ -42,29 +76,44 @@ namespace roboptim
     {
       Trajectory<3>::setParameters (params);
 
-      value_type positionStart = params[0];
-      value_type positionEnd = params[1];
-      value_type velocityStart = params[2];
-      value_type accelerationStart = params[3];
-
+      // Parameters: position start, position end, velocity start,
+      // acceleration start. The polynomial is expressed w.r.t. the
+      // scaled time so velocity and acceleration are scaled by the
+      // trajectory length.
       value_type length = this->length ();
-      value_type delta = positionEnd - positionStart;
-
-      coefficients_[0] = positionStart;
-      coefficients_[1] = velocityStart;
-      coefficients_[2] = .5 * accelerationStart;
-      coefficients_[3] =
-	- 3. / 2. * length * length * accelerationStart
-	- 6. * length * velocityStart
-	+ 10 * delta;
-      coefficients_[4] =
-	3. / 2. * length * length * accelerationStart
-	+ 8 * length * velocityStart
-	- 15 * delta;
-      coefficients_[5] =
-	- 1. / 2. * length * length * accelerationStart
-	- 3. * length * velocityStart
-	+ 6 * delta;
+      value_type length2 = length * length;
+
+      coefficientsJacobian_ <<
+	1., 0., 0., 0.,
+	0., 0., length, 0.,
+	0., 0., 0., .5 * length2,
+	-10., 10., -6. * length, -3. / 2. * length2,
+	15., -15., 8. * length, 3. / 2. * length2,
+	-6., 6., -3. * length, -1. / 2. * length2;
+
+      Eigen::Matrix<value_type, 6, 1> coefficients =
+	coefficientsJacobian_ * params.head (4);
+      for (std::size_t i = 0; i < coefficients_.size (); ++i)
+	coefficients_[i] = coefficients[static_cast<int> (i)];
+    }
+
+    template <typename T>
+    typename MinimumJerkTrajectory<T>::value_type
+    MinimumJerkTrajectory<T>::polynomialDerivative (value_type s,
+						    size_type order) const
+    {
+      // accumulate the power of s
+      value_type accu = 1.;
+      value_type result = 0.;
+      std::size_t order_ = static_cast<std::size_t> (order);
+
+      for (std::size_t i = order_; i < coefficients_.size (); ++i)
+	{
+	  result +=
+	    detail::powerDerivativeFactor (i, order_) * coefficients_[i] * accu;
+	  accu *= s;
+	}
+      return result / std::pow (this->length (), static_cast<double> (order));
     }
 
     template <typename T>
@@ -83,67 +132,101 @@ namespace roboptim
 	  return;
 	}
 
-      // accumulate the power of t (t)
-      value_type accu = 1.;
       value_type tScaled = (t - timeRange ().first) / this->length ();
-
-      result[0] = 0.;
-      for (std::size_t i = 0; i < coefficients_.size (); ++i)
-	{
-	  result[0] += coefficients_[i] * accu;
-	  accu *= tScaled;
-	}
+      result[0] = polynomialDerivative (tScaled, 0);
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::jacobian_t
-    MinimumJerkTrajectory<T>::variationConfigWrtParam (double) const
+    MinimumJerkTrajectory<T>::variationConfigWrtParam (double t) const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      return variationDerivWrtParam (t, 0);
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::jacobian_t
-    MinimumJerkTrajectory<T>::variationDerivWrtParam (double, size_type)
+    MinimumJerkTrajectory<T>::variationDerivWrtParam (double t,
+						      size_type order)
       const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      jacobian_t jacobian (1, 4);
+      jacobian.setZero ();
+
+      // constant outside of the time range
+      if (t < timeRange ().first || t > timeRange ().second)
+	{
+	  if (order == 0)
+	    jacobian.coeffRef (0, t < timeRange ().first ? 0 : 1) = 1.;
+	  return jacobian;
+	}
+
+      // accumulate the power of t
+      value_type accu = 1.;
+      value_type tScaled = (t - timeRange ().first) / this->length ();
+      value_type scale =
+	1. / std::pow (this->length (), static_cast<double> (order));
+      std::size_t order_ = static_cast<std::size_t> (order);
+
+      for (std::size_t i = order_; i < coefficients_.size (); ++i)
+	{
+	  value_type factor =
+	    scale * detail::powerDerivativeFactor (i, order_) * accu;
+	  for (int j = 0; j < 4; ++j)
+	    jacobian.coeffRef (0, j) +=
+	      factor * coefficientsJacobian_ (static_cast<int> (i), j);
+	  accu *= tScaled;
+	}
+      return jacobian;
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::value_type
-    MinimumJerkTrajectory<T>::singularPointAtRank (size_type) const
+    MinimumJerkTrajectory<T>::singularPointAtRank (size_type rank) const
     {
-      return value_type (); // zero
+      // the trajectory is constant outside of its time range
+      return rank == 0 ? timeRange ().first : timeRange ().second;
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::vector_t
-    MinimumJerkTrajectory<T>::derivBeforeSingularPoint (size_type, size_type) const
+    MinimumJerkTrajectory<T>::derivBeforeSingularPoint (size_type rank,
+							size_type order) const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      vector_t result (1);
+      if (rank == 0)
+	result[0] = order == 0 ? parameters ()[0] : 0.;
+      else
+	result[0] = polynomialDerivative (1., order);
+      return result;
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::vector_t
-    MinimumJerkTrajectory<T>::derivAfterSingularPoint (size_type, size_type) const
+    MinimumJerkTrajectory<T>::derivAfterSingularPoint (size_type rank,
+						       size_type order) const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      vector_t result (1);
+      if (rank == 0)
+	result[0] = polynomialDerivative (0., order);
+      else
+	result[0] = order == 0 ? parameters ()[1] : 0.;
+      return result;
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::jacobian_t
-    MinimumJerkTrajectory<T>::variationConfigWrtParam (StableTimePoint) const
+    MinimumJerkTrajectory<T>::variationConfigWrtParam (StableTimePoint tp)
+      const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      return variationConfigWrtParam (tp.getTime (timeRange ()));
     }
 
     template <typename T>
     typename MinimumJerkTrajectory<T>::jacobian_t
     MinimumJerkTrajectory<T>::variationDerivWrtParam
-    (StableTimePoint, size_type) const
+    (StableTimePoint tp, size_type order) const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      return variationDerivWrtParam (tp.getTime (timeRange ()), order);
     }
 
     template <typename T>
@@ -153,54 +236,39 @@ namespace roboptim
 					       size_type order)
       const
     {
+      if (order == 0)
+	{
+	  this->operator () (gradient, t);
+	  return;
+	}
+
       gradient.setZero ();
       if (t < timeRange ().first || t > timeRange ().second)
 	return;
 
-      if (order == 0)
-	this->operator () (gradient, t);
-      else if (order == 1)
-	{
-	  // accumulate the power of t
-	  value_type accu = 1.;
-	  value_type tScaled = (t - timeRange ().first) / this->length ();
-	  value_type i = 1.;
-
-	  for (std::size_t idx = 1; idx < coefficients_.size (); ++idx, i += 1.)
-	    {
-	      gradient[0] += i * coefficients_[idx] * accu;
-	      accu *= tScaled;
-	    }
-	}
-      else if (order == 2)
-	{
-	  // accumulate the power of t
-	  value_type accu = 1.;
-	  value_type tScaled = (t - timeRange ().first) / this->length ();
-	  value_type i = 2.;
-
-	  for (std::size_t idx = 2; idx < coefficients_.size (); ++idx, i += 1.)
-	    {
-	      gradient[0] += i * (i - 1.) * coefficients_[idx] * accu;
-	      accu *= tScaled;
-	    }
-	}
+      value_type tScaled = (t - timeRange ().first) / this->length ();
+      gradient[0] = polynomialDerivative (tScaled, order);
     }
 
     template <typename T>
     void
-    MinimumJerkTrajectory<T>::impl_derivative (gradient_t&, StableTimePoint, size_type)
+    MinimumJerkTrajectory<T>::impl_derivative (gradient_t& gradient,
+					       StableTimePoint tp,
+					       size_type order)
       const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      impl_derivative (gradient, tp.getTime (timeRange ()), order);
     }
 
     template <typename T>
     Trajectory<3>*
-    MinimumJerkTrajectory<T>::resize (interval_t)
+    MinimumJerkTrajectory<T>::resize (interval_t timeRange)
       const
     {
-      throw std::runtime_error ("NOT IMPLEMENTED");
+      MinimumJerkTrajectory<T>* result =
+	new MinimumJerkTrajectory<T> (timeRange);
+      result->setParameters (this->parameters ());
+      return result;
     }
   } // end of namespace retargeting.
 } // end of namespace roboptim.
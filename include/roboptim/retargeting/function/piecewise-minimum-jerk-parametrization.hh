@@ -0,0 +1,116 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_PIECEWISE_MINIMUM_JERK_PARAMETRIZATION_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_PIECEWISE_MINIMUM_JERK_PARAMETRIZATION_HH
+# include <stdexcept>
+# include <utility>
+
+# include <roboptim/retargeting/function/linear-trajectory-parametrization.hh>
+# include <roboptim/retargeting/function/piecewise-minimum-jerk-trajectory.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Sample a piecewise minimum jerk trajectory at every
+    ///        frame of a discrete trajectory.
+    ///
+    /// Input: knots states (size: number of knots * 3 * number of
+    /// DOFs, see PiecewiseMinimumJerkTrajectory)
+    ///
+    /// Output: discrete trajectory parameters (size: number of
+    /// frames * number of DOFs)
+    ///
+    /// The knots are uniformly spaced (one every knotsSpacing
+    /// frames). Each frame depends on the six states of its
+    /// segment: the jacobian has (at most) six non-zeros per row.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class PiecewiseMinimumJerkParametrization
+      : public LinearTrajectoryParametrization<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (LinearTrajectoryParametrization<T>);
+
+      typedef typename LinearTrajectoryParametrization<T>::index_t index_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param nFrames number of frames
+      /// \param nDofs number of DOFs of each frame
+      /// \param knotsSpacing number of frames between two knots
+      PiecewiseMinimumJerkParametrization (index_t nFrames,
+					   index_t nDofs,
+					   index_t knotsSpacing)
+	: LinearTrajectoryParametrization<T>
+	  (nFrames, nDofs,
+	   PiecewiseMinimumJerkTrajectory<EigenMatrixDense>::numberOfParameters
+	   (nSegments (nFrames, knotsSpacing), 1),
+	   "piecewise minimum jerk parametrization")
+      {
+	this->sample
+	  (PiecewiseMinimumJerkTrajectory<EigenMatrixDense>
+	   (std::make_pair (0., static_cast<value_type> (nFrames - 1)), 1,
+	    Function::vector_t::Zero (this->basis ().cols ())));
+      }
+
+      /// \brief Copy a parametrization using other function traits.
+      template <typename U>
+      explicit PiecewiseMinimumJerkParametrization
+      (const PiecewiseMinimumJerkParametrization<U>& other)
+	: LinearTrajectoryParametrization<T> (other)
+      {}
+
+      virtual ~PiecewiseMinimumJerkParametrization ()
+      {}
+
+      /// \brief Number of segments required to cover nFrames.
+      static index_t nSegments (index_t nFrames, index_t knotsSpacing)
+      {
+	if (nFrames < 2)
+	  throw std::runtime_error
+	    ("a minimum jerk trajectory requires two frames at least");
+	if (knotsSpacing < 1)
+	  throw std::runtime_error ("invalid knots spacing");
+	return (nFrames - 2) / knotsSpacing + 1;
+      }
+
+      /// \brief Bound the knots positions only.
+      ///
+      /// Velocities and accelerations are free. A segment may
+      /// slightly overshoot its knots positions: the frames between
+      /// two knots are not strictly bounded.
+      virtual Function::intervals_t
+      argumentBounds (const Function::intervals_t& limits) const
+      {
+	Function::intervals_t bounds
+	  (static_cast<std::size_t> (this->inputSize ()),
+	   Function::makeInfiniteInterval ());
+	const std::size_t nDofs = static_cast<std::size_t> (this->nDofs ());
+	for (std::size_t i = 0; i < bounds.size (); ++i)
+	  if ((i / nDofs) % 3 == 0)
+	    bounds[i] = limits[i % nDofs];
+	return bounds;
+      }
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_PIECEWISE_MINIMUM_JERK_PARAMETRIZATION_HH
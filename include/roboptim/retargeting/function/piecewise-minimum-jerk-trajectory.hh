@@ -0,0 +1,129 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_PIECEWISE_MINIMUM_JERK_TRAJECTORY_HH
+# define ROBOPTIM_RETARGETING_PIECEWISE_MINIMUM_JERK_TRAJECTORY_HH
+# include <boost/array.hpp>
+
+# include <roboptim/trajectory/trajectory.hh>
+
+# include <roboptim/retargeting/function/minimum-jerk-trajectory.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Piecewise minimum jerk trajectory.
+    ///
+    /// The time range is split into uniform segments. The state
+    /// (position, velocity, acceleration) of each knot is a
+    /// parameter and each segment is the minimum jerk (quintic)
+    /// trajectory joining the states of its two knots. The
+    /// trajectory is then C2 by construction.
+    ///
+    /// The parameters are, for each knot: the positions, the
+    /// velocities then the accelerations of all the DOFs (size:
+    /// number of knots * 3 * dimension).
+    ///
+    /// The trajectory is linear w.r.t. its parameters, each point
+    /// depending on the six states of its segment. The variations
+    /// are computed analytically.
+    template <typename T>
+    class PiecewiseMinimumJerkTrajectory :
+      public Trajectory<3>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericTwiceDifferentiableFunction<T>);
+
+      ROBOPTIM_IMPLEMENT_CLONE (PiecewiseMinimumJerkTrajectory<T>);
+
+      /// \brief Constructor.
+      ///
+      /// \param timeRange trajectory time range
+      /// \param dimension number of DOFs
+      /// \param parameters knots states (two knots at least)
+      PiecewiseMinimumJerkTrajectory (interval_t timeRange,
+				      size_type dimension,
+				      const vector_t& parameters) ;
+      virtual ~PiecewiseMinimumJerkTrajectory () ;
+
+      /// \brief Number of parameters for a given number of segments.
+      static size_type
+      numberOfParameters (size_type nSegments, size_type dimension);
+
+      /// \brief Number of segments.
+      size_type numberOfSegments () const;
+
+      jacobian_t variationConfigWrtParam (double t) const ;
+      jacobian_t variationDerivWrtParam (double t, size_type order)
+	const ;
+      jacobian_t variationConfigWrtParam (StableTimePoint tp)
+      const ;
+      jacobian_t
+      variationDerivWrtParam (StableTimePoint tp, size_type order)
+      const ;
+
+      value_type singularPointAtRank (size_type rank) const;
+      vector_t derivBeforeSingularPoint (size_type rank, size_type order) const;
+      vector_t derivAfterSingularPoint (size_type rank, size_type order) const;
+
+      Trajectory<3>* resize (interval_t timeRange)
+	const ;
+    protected:
+      void impl_compute (result_t& result, double t) const ;
+      void impl_derivative (gradient_t& derivative,
+			    double argument,
+			    size_type order = 1) const ;
+      void impl_derivative (gradient_t& g, StableTimePoint, size_type order)
+	const ;
+
+    private:
+      /// \brief Weights of the six states (start position,
+      ///        velocity, acceleration, end position, velocity,
+      ///        acceleration) of a segment.
+      typedef boost::array<value_type, 6> weights_t;
+
+      /// \brief Segment containing a time.
+      ///
+      /// \param t time (clamped to the time range)
+      /// \param s scaled time in the segment (between 0 and 1)
+      /// \return segment index
+      size_type segment (double t, value_type& s) const;
+
+      /// \brief Weights of the segment states for one derivative.
+      void weights (weights_t& weights, value_type s, size_type order) const;
+
+      /// \brief Derivative of a segment at a scaled time.
+      void segmentDerivative (vector_t& result, size_type segment,
+			      value_type s, size_type order) const;
+
+      /// \brief Index of a parameter.
+      ///
+      /// \param knot knot index
+      /// \param state 0 (position), 1 (velocity), 2 (acceleration)
+      /// \param dof DOF index
+      size_type index (size_type knot, size_type state, size_type dof) const
+      {
+	return (3 * knot + state) * outputSize () + dof;
+      }
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+# include <roboptim/retargeting/function/piecewise-minimum-jerk-trajectory.hxx>
+#endif //! ROBOPTIM_RETARGETING_PIECEWISE_MINIMUM_JERK_TRAJECTORY_HH
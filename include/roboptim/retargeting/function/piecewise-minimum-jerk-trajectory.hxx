@@ -0,0 +1,306 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_PIECEWISE_MINIMUM_JERK_TRAJECTORY_HXX
+# define ROBOPTIM_RETARGETING_PIECEWISE_MINIMUM_JERK_TRAJECTORY_HXX
+# include <algorithm>
+# include <cmath>
+# include <stdexcept>
+
+# include <boost/format.hpp>
+
+# include <roboptim/retargeting/function/piecewise-minimum-jerk-trajectory.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    namespace detail
+    {
+      /// \brief Quintic Hermite basis, i.e. minimum jerk trajectory
+      ///        joining two states, w.r.t. the scaled time.
+      ///
+      /// One row per state (start position, velocity, acceleration,
+      /// end position, velocity, acceleration), one column per power
+      /// of the scaled time.
+      static const double minimumJerkBasis[6][6] = {
+	{1., 0., 0., -10., 15., -6.},
+	{0., 1., 0., -6., 8., -3.},
+	{0., 0., .5, -1.5, 1.5, -.5},
+	{0., 0., 0., 10., -15., 6.},
+	{0., 0., 0., -4., 7., -3.},
+	{0., 0., 0., .5, -1., .5}
+      };
+
+      /// \brief Time scaling power of each state.
+      static const double minimumJerkBasisScaling[6] =
+	{0., 1., 2., 0., 1., 2.};
+    } // end of namespace detail.
+
+    template <typename T>
+    PiecewiseMinimumJerkTrajectory<T>::PiecewiseMinimumJerkTrajectory
+    (interval_t timeRange, size_type dimension, const vector_t& parameters)
+      : Trajectory<3> (timeRange, dimension, parameters,
+		       "piecewise minimum jerk trajectory")
+    {
+      if (parameters.size () % (3 * dimension) != 0
+	  || parameters.size () < numberOfParameters (1, dimension))
+	{
+	  boost::format fmt
+	    ("invalid parameters size (%d), two knots of %d DOFs"
+	     " (position, velocity, acceleration) at least are expected");
+	  fmt % parameters.size () % dimension;
+	  throw std::runtime_error (fmt.str ());
+	}
+    }
+
+    template <typename T>
+    PiecewiseMinimumJerkTrajectory<T>::~PiecewiseMinimumJerkTrajectory ()
+    {}
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::size_type
+    PiecewiseMinimumJerkTrajectory<T>::numberOfParameters
+    (size_type nSegments, size_type dimension)
+    {
+      return 3 * (nSegments + 1) * dimension;
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::size_type
+    PiecewiseMinimumJerkTrajectory<T>::numberOfSegments () const
+    {
+      return parameters ().size () / (3 * outputSize ()) - 1;
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::size_type
+    PiecewiseMinimumJerkTrajectory<T>::segment (double t, value_type& s) const
+    {
+      const size_type nSegments = numberOfSegments ();
+      value_type u = (t - timeRange ().first) / this->length ()
+	* static_cast<value_type> (nSegments);
+      u = std::min (std::max (u, 0.), static_cast<value_type> (nSegments));
+
+      size_type result =
+	std::min (static_cast<size_type> (std::floor (u)), nSegments - 1);
+      s = u - static_cast<value_type> (result);
+      return result;
+    }
+
+    template <typename T>
+    void
+    PiecewiseMinimumJerkTrajectory<T>::weights
+    (weights_t& weights, value_type s, size_type order) const
+    {
+      const value_type h =
+	this->length () / static_cast<value_type> (numberOfSegments ());
+      const std::size_t order_ = static_cast<std::size_t> (order);
+
+      for (std::size_t j = 0; j < weights.size (); ++j)
+	{
+	  // accumulate the power of s
+	  value_type accu = 1.;
+	  weights[j] = 0.;
+	  for (std::size_t p = order_; p < 6; ++p)
+	    {
+	      weights[j] += detail::minimumJerkBasis[j][p]
+		* detail::powerDerivativeFactor (p, order_) * accu;
+	      accu *= s;
+	    }
+	  weights[j] *=
+	    std::pow (h, detail::minimumJerkBasisScaling[j]
+		      - static_cast<value_type> (order));
+	}
+    }
+
+    template <typename T>
+    void
+    PiecewiseMinimumJerkTrajectory<T>::segmentDerivative
+    (vector_t& result, size_type segment, value_type s, size_type order) const
+    {
+      weights_t w;
+      weights (w, s, order);
+
+      result.setZero ();
+      for (size_type j = 0; j < 6; ++j)
+	for (size_type dof = 0; dof < outputSize (); ++dof)
+	  result[dof] += w[static_cast<std::size_t> (j)]
+	    * parameters ()[index (segment + j / 3, j % 3, dof)];
+    }
+
+    template <typename T>
+    void
+    PiecewiseMinimumJerkTrajectory<T>::impl_compute (result_t& result,
+						     double t)
+      const
+    {
+      // the trajectory is constant outside of its time range
+      value_type s = 0.;
+      size_type segment_ = segment (t, s);
+
+      vector_t value (outputSize ());
+      segmentDerivative (value, segment_, s, 0);
+      result = value;
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::jacobian_t
+    PiecewiseMinimumJerkTrajectory<T>::variationConfigWrtParam (double t)
+      const
+    {
+      return variationDerivWrtParam (t, 0);
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::jacobian_t
+    PiecewiseMinimumJerkTrajectory<T>::variationDerivWrtParam
+    (double t, size_type order) const
+    {
+      jacobian_t jacobian (outputSize (), parameters ().size ());
+      jacobian.setZero ();
+
+      if (order > 0
+	  && (t < timeRange ().first || t > timeRange ().second))
+	return jacobian;
+
+      value_type s = 0.;
+      size_type segment_ = segment (t, s);
+      weights_t w;
+      weights (w, s, order);
+
+      // coefficient-wise to support sparse matrices
+      for (size_type j = 0; j < 6; ++j)
+	for (size_type dof = 0; dof < outputSize (); ++dof)
+	  jacobian.coeffRef (dof, index (segment_ + j / 3, j % 3, dof)) =
+	    w[static_cast<std::size_t> (j)];
+      return jacobian;
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::jacobian_t
+    PiecewiseMinimumJerkTrajectory<T>::variationConfigWrtParam
+    (StableTimePoint tp) const
+    {
+      return variationConfigWrtParam (tp.getTime (timeRange ()));
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::jacobian_t
+    PiecewiseMinimumJerkTrajectory<T>::variationDerivWrtParam
+    (StableTimePoint tp, size_type order) const
+    {
+      return variationDerivWrtParam (tp.getTime (timeRange ()), order);
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::value_type
+    PiecewiseMinimumJerkTrajectory<T>::singularPointAtRank (size_type rank)
+      const
+    {
+      // the knots (the jerk is not continuous)
+      return timeRange ().first + this->length ()
+	* static_cast<value_type> (rank)
+	/ static_cast<value_type> (numberOfSegments ());
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::vector_t
+    PiecewiseMinimumJerkTrajectory<T>::derivBeforeSingularPoint
+    (size_type rank, size_type order) const
+    {
+      vector_t result (outputSize ());
+      if (rank == 0)
+	{
+	  // constant before the time range
+	  result.setZero ();
+	  if (order == 0)
+	    for (size_type dof = 0; dof < outputSize (); ++dof)
+	      result[dof] = parameters ()[index (0, 0, dof)];
+	}
+      else
+	segmentDerivative (result, rank - 1, 1., order);
+      return result;
+    }
+
+    template <typename T>
+    typename PiecewiseMinimumJerkTrajectory<T>::vector_t
+    PiecewiseMinimumJerkTrajectory<T>::derivAfterSingularPoint
+    (size_type rank, size_type order) const
+    {
+      vector_t result (outputSize ());
+      if (rank >= numberOfSegments ())
+	{
+	  // constant after the time range
+	  result.setZero ();
+	  if (order == 0)
+	    for (size_type dof = 0; dof < outputSize (); ++dof)
+	      result[dof] =
+		parameters ()[index (numberOfSegments (), 0, dof)];
+	}
+      else
+	segmentDerivative (result, rank, 0., order);
+      return result;
+    }
+
+    template <typename T>
+    void
+    PiecewiseMinimumJerkTrajectory<T>::impl_derivative (gradient_t& gradient,
+							double t,
+							size_type order)
+      const
+    {
+      if (order == 0)
+	{
+	  this->operator () (gradient, t);
+	  return;
+	}
+
+      gradient.setZero ();
+      if (t < timeRange ().first || t > timeRange ().second)
+	return;
+
+      value_type s = 0.;
+      size_type segment_ = segment (t, s);
+
+      vector_t derivative (outputSize ());
+      segmentDerivative (derivative, segment_, s, order);
+      gradient = derivative;
+    }
+
+    template <typename T>
+    void
+    PiecewiseMinimumJerkTrajectory<T>::impl_derivative (gradient_t& gradient,
+							StableTimePoint tp,
+							size_type order)
+      const
+    {
+      impl_derivative (gradient, tp.getTime (timeRange ()), order);
+    }
+
+    template <typename T>
+    Trajectory<3>*
+    PiecewiseMinimumJerkTrajectory<T>::resize (interval_t timeRange)
+      const
+    {
+      return new PiecewiseMinimumJerkTrajectory<T>
+	(timeRange, outputSize (), parameters ());
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_PIECEWISE_MINIMUM_JERK_TRAJECTORY_HXX
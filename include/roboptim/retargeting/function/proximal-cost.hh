@@ -0,0 +1,163 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_PROXIMAL_COST_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_PROXIMAL_COST_HH
+# include <stdexcept>
+
+# include <boost/format.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <roboptim/core/differentiable-function.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Weighted proximal term added to a cost function.
+    ///
+    /// \f$ \frac{1}{2} \sum w_i (x_i - r_i)^2 \f$
+    ///
+    /// The term is shared between the cost function and the caller:
+    /// the weights and the reference can be changed between two
+    /// solves without rebuilding the problem (see
+    /// TemporalConsensus). A zero weight disables the term for this
+    /// argument.
+    struct ProximalTerm
+    {
+      /// \brief Weight of each argument.
+      Function::vector_t weights;
+
+      /// \brief Reference of each argument.
+      Function::vector_t reference;
+    };
+
+    typedef boost::shared_ptr<ProximalTerm> ProximalTermShPtr;
+
+    /// \brief Cost function plus a weighted proximal term.
+    ///
+    /// Input: x (size: f input size)
+    /// Output: \f$ f(x) + \frac{1}{2} \sum w_i (x_i - r_i)^2 \f$
+    /// (size: 1)
+    ///
+    /// The derivatives of the proximal term are added coefficient
+    /// by coefficient, only where the weight is not zero, so that
+    /// the sparsity pattern of f is mostly preserved.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class ProximalCost : public GenericDifferentiableFunction<T>
+    {
+    public:
+      ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericDifferentiableFunction<T>);
+
+      typedef boost::shared_ptr<GenericDifferentiableFunction<T> >
+      functionShPtr_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param f cost function (output size: 1)
+      /// \param term proximal term (weights and reference size: f
+      ///        input size)
+      ProximalCost (functionShPtr_t f, ProximalTermShPtr term)
+	: GenericDifferentiableFunction<T>
+	  (f->inputSize (), 1,
+	   (boost::format ("%s (proximal)") % f->getName ()).str ()),
+	  f_ (f),
+	  term_ (term)
+      {
+	if (f->outputSize () != 1)
+	  throw std::runtime_error ("the cost function must be scalar");
+	checkTerm ();
+      }
+
+      virtual ~ProximalCost ()
+      {}
+
+      /// \brief Cost function.
+      const functionShPtr_t& function () const
+      {
+	return f_;
+      }
+
+      /// \brief Proximal term.
+      const ProximalTermShPtr& term () const
+      {
+	return term_;
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	checkTerm ();
+	(*f_) (result, x);
+	result[0] += .5 * (term_->weights.array ()
+			   * (x - term_->reference).array ().square ()).sum ();
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t& x,
+		     size_type functionId) const
+      {
+	checkTerm ();
+	f_->gradient (gradient, x, functionId);
+	// coefficient-wise to support sparse gradients
+	for (size_type i = 0; i < this->inputSize (); ++i)
+	  if (term_->weights[i] != 0.)
+	    gradient.coeffRef (i) +=
+	      term_->weights[i] * (x[i] - term_->reference[i]);
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x) const
+      {
+	checkTerm ();
+	f_->jacobian (jacobian, x);
+	for (size_type i = 0; i < this->inputSize (); ++i)
+	  if (term_->weights[i] != 0.)
+	    jacobian.coeffRef (0, i) +=
+	      term_->weights[i] * (x[i] - term_->reference[i]);
+      }
+
+    private:
+      void checkTerm () const
+      {
+	if (!term_)
+	  throw std::runtime_error ("null proximal term");
+	if (term_->weights.size () != this->inputSize ()
+	    || term_->reference.size () != this->inputSize ())
+	  {
+	    boost::format fmt
+	      ("invalid proximal term size (weights: %d, reference: %d,"
+	       " %d expected)");
+	    fmt % term_->weights.size () % term_->reference.size ()
+	      % this->inputSize ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+      }
+
+      /// \brief Cost function.
+      functionShPtr_t f_;
+      /// \brief Proximal term (shared with the caller).
+      ProximalTermShPtr term_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_PROXIMAL_COST_HH
@@ -0,0 +1,595 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_REDUCED_COORDINATES_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_REDUCED_COORDINATES_HH
+# include <algorithm>
+# include <stdexcept>
+# include <string>
+# include <vector>
+
+# include <boost/format.hpp>
+# include <boost/make_shared.hpp>
+# include <boost/optional.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <Eigen/SparseCore>
+
+# include <roboptim/core/differentiable-function.hh>
+# include <roboptim/core/twice-differentiable-function.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Map between full and reduced coordinates.
+    ///
+    /// The configuration of one frame tells which DOFs are fixed
+    /// (defined value) and which ones are free (no value). It is
+    /// repeated for each frame: the reduced coordinates are the free
+    /// DOFs of all the frames, in the same order.
+    ///
+    /// The index of each free DOF in the full vector is computed
+    /// once, gathering or scattering a vector is then a single pass
+    /// over the free DOFs.
+    class ReducedCoordinatesMap
+    {
+    public:
+      typedef Function::value_type value_type;
+      typedef Function::vector_t vector_t;
+      typedef vector_t::Index index_t;
+      typedef std::vector<boost::optional<value_type> > configuration_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param configuration fixed DOFs of one frame (no value
+      ///        means the DOF is free)
+      /// \param nFrames number of frames
+      ReducedCoordinatesMap (const configuration_t& configuration,
+			     index_t nFrames = 1)
+	: indices_ (),
+	  reducedIndices_ (),
+	  fixed_ (static_cast<index_t> (configuration.size ()) * nFrames)
+      {
+	const index_t nDofs = static_cast<index_t> (configuration.size ());
+	if (nDofs < 1 || nFrames < 1)
+	  throw std::runtime_error ("empty configuration");
+
+	fixed_.setZero ();
+	reducedIndices_.resize
+	  (static_cast<std::size_t> (fixed_.size ()), -1);
+	for (index_t frame = 0; frame < nFrames; ++frame)
+	  for (index_t dof = 0; dof < nDofs; ++dof)
+	    {
+	      const boost::optional<value_type>& value =
+		configuration[static_cast<std::size_t> (dof)];
+	      const index_t i = frame * nDofs + dof;
+	      if (value)
+		fixed_[i] = *value;
+	      else
+		{
+		  reducedIndices_[static_cast<std::size_t> (i)] =
+		    static_cast<index_t> (indices_.size ());
+		  indices_.push_back (i);
+		}
+	    }
+
+	if (indices_.empty ())
+	  throw std::runtime_error ("all DOFs have been disabled");
+      }
+
+      /// \brief Full vector size.
+      index_t fullSize () const
+      {
+	return fixed_.size ();
+      }
+
+      /// \brief Reduced vector size.
+      index_t reducedSize () const
+      {
+	return static_cast<index_t> (indices_.size ());
+      }
+
+      /// \brief Is every DOF free?
+      bool identity () const
+      {
+	return reducedSize () == fullSize ();
+      }
+
+      /// \brief Index of each reduced coordinate in the full vector.
+      const std::vector<index_t>& indices () const
+      {
+	return indices_;
+      }
+
+      /// \brief Index of each full coordinate in the reduced vector
+      ///        (-1 for the fixed DOFs).
+      const std::vector<index_t>& reducedIndices () const
+      {
+	return reducedIndices_;
+      }
+
+      /// \brief Full vector whose free DOFs are zero.
+      const vector_t& fixed () const
+      {
+	return fixed_;
+      }
+
+      /// \brief Write the free DOFs of a full vector.
+      ///
+      /// The fixed DOFs of the full vector are left untouched.
+      template <typename Derived, typename OtherDerived>
+      void scatter (Eigen::MatrixBase<Derived>& full,
+		    const Eigen::MatrixBase<OtherDerived>& reduced) const
+      {
+	for (std::size_t i = 0; i < indices_.size (); ++i)
+	  full[indices_[i]] = reduced[static_cast<index_t> (i)];
+      }
+
+      /// \brief Read the free DOFs of a full vector.
+      template <typename Derived, typename OtherDerived>
+      void gather (Eigen::MatrixBase<Derived>& reduced,
+		   const Eigen::MatrixBase<OtherDerived>& full) const
+      {
+	for (std::size_t i = 0; i < indices_.size (); ++i)
+	  reduced[static_cast<index_t> (i)] = full[indices_[i]];
+      }
+
+      /// \brief Reduced vector from a full vector.
+      vector_t reduce (const vector_t& full) const
+      {
+	checkSize (full.size (), fullSize ());
+	vector_t reduced (reducedSize ());
+	gather (reduced, full);
+	return reduced;
+      }
+
+      /// \brief Full vector from a reduced vector.
+      ///
+      /// The fixed DOFs take their configuration value.
+      vector_t expand (const vector_t& reduced) const
+      {
+	checkSize (reduced.size (), reducedSize ());
+	vector_t full = fixed_;
+	scatter (full, reduced);
+	return full;
+      }
+
+    private:
+      static void checkSize (index_t size, index_t expected)
+      {
+	if (size == expected)
+	  return;
+	boost::format fmt ("invalid vector size (%d, %d expected)");
+	fmt % size % expected;
+	throw std::runtime_error (fmt.str ());
+      }
+
+      /// \brief Full index of each reduced coordinate.
+      std::vector<index_t> indices_;
+      /// \brief Reduced index of each full coordinate.
+      std::vector<index_t> reducedIndices_;
+      /// \brief Fixed DOFs values.
+      vector_t fixed_;
+    };
+
+    namespace detail
+    {
+      /// \brief Gather the free columns of a dense jacobian.
+      template <typename Derived, typename OtherDerived, typename Scalar>
+      void
+      gatherColumns (Eigen::MatrixBase<Derived>& dst,
+		     const Eigen::MatrixBase<OtherDerived>& src,
+		     const ReducedCoordinatesMap& map,
+		     std::vector<Eigen::Triplet<Scalar> >&)
+      {
+	const std::vector<ReducedCoordinatesMap::index_t>& indices =
+	  map.indices ();
+	for (std::size_t i = 0; i < indices.size (); ++i)
+	  dst.col (static_cast<ReducedCoordinatesMap::index_t> (i)) =
+	    src.col (indices[i]);
+      }
+
+      /// \brief Gather the free columns of a sparse jacobian.
+      ///
+      /// Only the non-zeros are visited, whatever the storage order.
+      template <typename Derived, typename OtherDerived, typename Scalar>
+      void
+      gatherColumns (Eigen::SparseMatrixBase<Derived>& dst,
+		     const Eigen::SparseMatrixBase<OtherDerived>& src,
+		     const ReducedCoordinatesMap& map,
+		     std::vector<Eigen::Triplet<Scalar> >& triplets)
+      {
+	const std::vector<ReducedCoordinatesMap::index_t>& reducedIndices =
+	  map.reducedIndices ();
+	triplets.clear ();
+	for (typename OtherDerived::Index k = 0;
+	     k < src.derived ().outerSize (); ++k)
+	  for (typename OtherDerived::InnerIterator it (src.derived (), k);
+	       it; ++it)
+	    {
+	      const ReducedCoordinatesMap::index_t col =
+		reducedIndices[static_cast<std::size_t> (it.col ())];
+	      if (col >= 0)
+		triplets.push_back
+		  (Eigen::Triplet<Scalar> (it.row (), col, it.value ()));
+	    }
+	dst.derived ().setFromTriplets (triplets.begin (), triplets.end ());
+      }
+
+      /// \brief Gather the free elements of a dense gradient.
+      template <typename Derived, typename OtherDerived>
+      void
+      gatherElements (Eigen::MatrixBase<Derived>& dst,
+		      const Eigen::MatrixBase<OtherDerived>& src,
+		      const ReducedCoordinatesMap& map)
+      {
+	map.gather (dst, src);
+      }
+
+      /// \brief Gather the free elements of a sparse gradient.
+      template <typename Derived, typename OtherDerived>
+      void
+      gatherElements (Eigen::SparseMatrixBase<Derived>& dst,
+		      const Eigen::SparseMatrixBase<OtherDerived>& src,
+		      const ReducedCoordinatesMap& map)
+      {
+	const std::vector<ReducedCoordinatesMap::index_t>& reducedIndices =
+	  map.reducedIndices ();
+	dst.derived ().setZero ();
+	for (typename OtherDerived::InnerIterator it (src.derived (), 0);
+	     it; ++it)
+	  {
+	    const ReducedCoordinatesMap::index_t i =
+	      reducedIndices[static_cast<std::size_t> (it.index ())];
+	    if (i >= 0)
+	      dst.derived ().coeffRef (i) = it.value ();
+	  }
+      }
+
+      /// \brief Gather the free rows and columns of a dense Hessian.
+      template <typename Derived, typename OtherDerived, typename Scalar>
+      void
+      gatherBlock (Eigen::MatrixBase<Derived>& dst,
+		   const Eigen::MatrixBase<OtherDerived>& src,
+		   const ReducedCoordinatesMap& map,
+		   std::vector<Eigen::Triplet<Scalar> >&)
+      {
+	const std::vector<ReducedCoordinatesMap::index_t>& indices =
+	  map.indices ();
+	for (std::size_t j = 0; j < indices.size (); ++j)
+	  for (std::size_t i = 0; i < indices.size (); ++i)
+	    dst (static_cast<ReducedCoordinatesMap::index_t> (i),
+		 static_cast<ReducedCoordinatesMap::index_t> (j)) =
+	      src (indices[i], indices[j]);
+      }
+
+      /// \brief Gather the free rows and columns of a sparse Hessian.
+      template <typename Derived, typename OtherDerived, typename Scalar>
+      void
+      gatherBlock (Eigen::SparseMatrixBase<Derived>& dst,
+		   const Eigen::SparseMatrixBase<OtherDerived>& src,
+		   const ReducedCoordinatesMap& map,
+		   std::vector<Eigen::Triplet<Scalar> >& triplets)
+      {
+	const std::vector<ReducedCoordinatesMap::index_t>& reducedIndices =
+	  map.reducedIndices ();
+	triplets.clear ();
+	for (typename OtherDerived::Index k = 0;
+	     k < src.derived ().outerSize (); ++k)
+	  for (typename OtherDerived::InnerIterator it (src.derived (), k);
+	       it; ++it)
+	    {
+	      const ReducedCoordinatesMap::index_t row =
+		reducedIndices[static_cast<std::size_t> (it.row ())];
+	      const ReducedCoordinatesMap::index_t col =
+		reducedIndices[static_cast<std::size_t> (it.col ())];
+	      if (row >= 0 && col >= 0)
+		triplets.push_back
+		  (Eigen::Triplet<Scalar> (row, col, it.value ()));
+	    }
+	dst.derived ().setFromTriplets (triplets.begin (), triplets.end ());
+      }
+    } // end of namespace detail.
+
+    /// \brief Evaluate a function of the full coordinates on the
+    ///        reduced coordinates.
+    ///
+    /// Input: reduced coordinates, i.e. the free DOFs (size: see
+    /// ReducedCoordinatesMap)
+    ///
+    /// Output: f output (size: f output size)
+    ///
+    /// The reduced argument is scattered into a full argument buffer
+    /// whose fixed DOFs are set once, the derivatives of f are then
+    /// computed in full-size buffers and their free columns are
+    /// gathered. No memory is allocated once the buffers are sized.
+    ///
+    /// The Hessian is not available: see
+    /// TwiceDifferentiableReducedCoordinates for twice differentiable
+    /// (e.g. quadratic) functions.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class ReducedCoordinates : public GenericDifferentiableFunction<T>
+    {
+    public:
+      ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericDifferentiableFunction<T>);
+
+      typedef boost::shared_ptr<GenericDifferentiableFunction<T> >
+      functionShPtr_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param f function of the full coordinates
+      /// \param configuration fixed DOFs of one frame, repeated to
+      ///        cover f input
+      ReducedCoordinates
+      (functionShPtr_t f,
+       const ReducedCoordinatesMap::configuration_t& configuration)
+	: GenericDifferentiableFunction<T>
+	  (reducedInputSize (f, configuration),
+	   f->outputSize (),
+	   (boost::format ("%s (reduced)") % f->getName ()).str ()),
+	  f_ (f),
+	  map_ (configuration, nFrames (f, configuration)),
+	  full_ (map_.fixed ()),
+	  fullGradient_ (f->inputSize ()),
+	  fullJacobian_ (f->outputSize (), f->inputSize ()),
+	  triplets_ ()
+      {}
+
+      virtual ~ReducedCoordinates ()
+      {}
+
+      /// \brief Function of the full coordinates.
+      const functionShPtr_t& function () const
+      {
+	return f_;
+      }
+
+      /// \brief Map between full and reduced coordinates.
+      const ReducedCoordinatesMap& coordinatesMap () const
+      {
+	return map_;
+      }
+
+      /// \brief Input size of f once reduced.
+      static size_type
+      reducedInputSize
+      (const functionShPtr_t& f,
+       const ReducedCoordinatesMap::configuration_t& configuration)
+      {
+	return nFree (configuration) * nFrames (f, configuration);
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	map_.scatter (full_, x);
+	(*f_) (result, full_);
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t& x,
+		     size_type functionId) const
+      {
+	map_.scatter (full_, x);
+	f_->gradient (fullGradient_, full_, functionId);
+	detail::gatherElements (gradient, fullGradient_, map_);
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x) const
+      {
+	map_.scatter (full_, x);
+	f_->jacobian (fullJacobian_, full_);
+	detail::gatherColumns (jacobian, fullJacobian_, map_, triplets_);
+      }
+
+    private:
+      /// \brief Number of frames covered by f input.
+      static size_type
+      nFrames (const functionShPtr_t& f,
+	       const ReducedCoordinatesMap::configuration_t& configuration)
+      {
+	const size_type nDofs = static_cast<size_type> (configuration.size ());
+	if (nDofs < 1 || f->inputSize () % nDofs != 0)
+	  {
+	    boost::format fmt
+	      ("invalid configuration size (%d) for function ``%s''"
+	       " (input size: %d)");
+	    fmt % nDofs % f->getName () % f->inputSize ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	return f->inputSize () / nDofs;
+      }
+
+      /// \brief Number of free DOFs of one frame.
+      static size_type
+      nFree (const ReducedCoordinatesMap::configuration_t& configuration)
+      {
+	return static_cast<size_type>
+	  (std::count (configuration.begin (), configuration.end (),
+		       boost::none));
+      }
+
+      /// \brief Function of the full coordinates.
+      functionShPtr_t f_;
+      /// \brief Map between full and reduced coordinates.
+      ReducedCoordinatesMap map_;
+      /// \brief Full argument buffer (fixed DOFs already set).
+      mutable vector_t full_;
+      /// \brief Full gradient buffer.
+      mutable gradient_t fullGradient_;
+      /// \brief Full jacobian buffer.
+      mutable jacobian_t fullJacobian_;
+      /// \brief Jacobian non-zeros buffer (sparse functions).
+      mutable std::vector<Eigen::Triplet<value_type> > triplets_;
+    };
+
+    /// \brief Evaluate a twice differentiable function of the full
+    ///        coordinates on the reduced coordinates.
+    ///
+    /// Same as ReducedCoordinates, the Hessian of f is also computed
+    /// in a full-size buffer and its free rows and columns are
+    /// gathered with the same index map. The fixed DOFs only add a
+    /// linear term: a quadratic function stays quadratic and keeps
+    /// its exact Hessian.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class TwiceDifferentiableReducedCoordinates
+      : public GenericTwiceDifferentiableFunction<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericTwiceDifferentiableFunction<T>);
+
+      typedef boost::shared_ptr<GenericTwiceDifferentiableFunction<T> >
+      functionShPtr_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param f function of the full coordinates
+      /// \param configuration fixed DOFs of one frame, repeated to
+      ///        cover f input
+      TwiceDifferentiableReducedCoordinates
+      (functionShPtr_t f,
+       const ReducedCoordinatesMap::configuration_t& configuration)
+	: GenericTwiceDifferentiableFunction<T>
+	  (ReducedCoordinates<T>::reducedInputSize (f, configuration),
+	   f->outputSize (),
+	   (boost::format ("%s (reduced)") % f->getName ()).str ()),
+	  f_ (f),
+	  reduced_ (f, configuration),
+	  full_ (reduced_.coordinatesMap ().fixed ()),
+	  fullHessian_ (f->inputSize (), f->inputSize ()),
+	  triplets_ ()
+      {}
+
+      virtual ~TwiceDifferentiableReducedCoordinates ()
+      {}
+
+      /// \brief Function of the full coordinates.
+      const functionShPtr_t& function () const
+      {
+	return f_;
+      }
+
+      /// \brief Map between full and reduced coordinates.
+      const ReducedCoordinatesMap& coordinatesMap () const
+      {
+	return reduced_.coordinatesMap ();
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	reduced_ (result, x);
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t& x,
+		     size_type functionId) const
+      {
+	reduced_.gradient (gradient, x, functionId);
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x) const
+      {
+	reduced_.jacobian (jacobian, x);
+      }
+
+      void
+      impl_hessian (hessian_t& hessian, const argument_t& x,
+		    size_type functionId) const
+      {
+	const ReducedCoordinatesMap& map = reduced_.coordinatesMap ();
+	map.scatter (full_, x);
+	f_->hessian (fullHessian_, full_, functionId);
+	detail::gatherBlock (hessian, fullHessian_, map, triplets_);
+      }
+
+    private:
+      /// \brief Function of the full coordinates.
+      functionShPtr_t f_;
+      /// \brief Value and first order derivatives.
+      ReducedCoordinates<T> reduced_;
+      /// \brief Full argument buffer (fixed DOFs already set).
+      mutable vector_t full_;
+      /// \brief Full Hessian buffer.
+      mutable hessian_t fullHessian_;
+      /// \brief Hessian non-zeros buffer (sparse functions).
+      mutable std::vector<Eigen::Triplet<value_type> > triplets_;
+    };
+
+    /// \brief Express a function of the full coordinates as a
+    ///        function of the free DOFs.
+    ///
+    /// The function is returned as is if no DOF is fixed.
+    ///
+    /// \param f function of the full coordinates
+    /// \param configuration fixed DOFs of one frame, repeated to
+    ///        cover f input
+    /// \tparam U function type (e.g. DifferentiableFunction)
+    template <typename U>
+    boost::shared_ptr<U>
+    reduceCoordinates
+    (boost::shared_ptr<U> f,
+     const ReducedCoordinatesMap::configuration_t& configuration)
+    {
+      typedef typename U::traits_t traits_t;
+
+      boost::shared_ptr<ReducedCoordinates<traits_t> > reduced =
+	boost::make_shared<ReducedCoordinates<traits_t> > (f, configuration);
+      if (reduced->coordinatesMap ().identity ())
+	return f;
+      return reduced;
+    }
+
+    /// \brief Express a twice differentiable function of the full
+    ///        coordinates as a function of the free DOFs.
+    ///
+    /// Quadratic functions should be passed through this overload to
+    /// keep their Hessian.
+    ///
+    /// \param f function of the full coordinates
+    /// \param configuration fixed DOFs of one frame, repeated to
+    ///        cover f input
+    /// \tparam T function traits
+    template <typename T>
+    boost::shared_ptr<GenericTwiceDifferentiableFunction<T> >
+    reduceCoordinates
+    (boost::shared_ptr<GenericTwiceDifferentiableFunction<T> > f,
+     const ReducedCoordinatesMap::configuration_t& configuration)
+    {
+      boost::shared_ptr<TwiceDifferentiableReducedCoordinates<T> > reduced =
+	boost::make_shared<TwiceDifferentiableReducedCoordinates<T> >
+	(f, configuration);
+      if (reduced->coordinatesMap ().identity ())
+	return f;
+      return reduced;
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_REDUCED_COORDINATES_HH
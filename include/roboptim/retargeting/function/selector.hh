@@ -0,0 +1,218 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_SELECTOR_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_SELECTOR_HH
+# include <stdexcept>
+
+# include <boost/format.hpp>
+
+# include <roboptim/core/linear-function.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Select a segment of the argument.
+    ///
+    /// Input: x (size: n)
+    /// Output: x[start], ..., x[start + size - 1] (size: size)
+    ///
+    /// Contrary to an equivalent GenericNumericLinearFunction, the
+    /// jacobian is not stored: this is used to constrain one frame
+    /// of a whole trajectory.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class Selector : public GenericLinearFunction<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericLinearFunction<T>);
+
+      /// \brief Constructor.
+      ///
+      /// \param inputSize argument size
+      /// \param start first selected element
+      /// \param size number of selected elements
+      Selector (size_type inputSize, size_type start, size_type size)
+	: GenericLinearFunction<T> (inputSize, size, "selector"),
+	  start_ (start)
+      {
+	if (start < 0 || start + size > inputSize)
+	  {
+	    boost::format fmt
+	      ("invalid selection (elements %d to %d of %d)");
+	    fmt % start % (start + size) % inputSize;
+	    throw std::runtime_error (fmt.str ());
+	  }
+      }
+
+      virtual ~Selector ()
+      {}
+
+      /// \brief First selected element.
+      size_type start () const
+      {
+	return start_;
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	result = x.segment (start_, this->outputSize ());
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t&,
+		     size_type functionId) const
+      {
+	gradient.setZero ();
+	gradient.coeffRef (start_ + functionId) = 1.;
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t&) const
+      {
+	// coefficient-wise to support sparse matrices
+	jacobian.setZero ();
+	for (size_type i = 0; i < this->outputSize (); ++i)
+	  jacobian.coeffRef (i, start_ + i) = 1.;
+      }
+
+    private:
+      /// \brief First selected element.
+      size_type start_;
+    };
+
+    /// \brief Null function.
+    ///
+    /// Input: x (size: n)
+    /// Output: 0 (size: m)
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class Zero : public GenericLinearFunction<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericLinearFunction<T>);
+
+      /// \brief Constructor.
+      ///
+      /// \param inputSize argument size
+      /// \param outputSize result size
+      explicit Zero (size_type inputSize, size_type outputSize = 1)
+	: GenericLinearFunction<T> (inputSize, outputSize, "zero")
+      {}
+
+      virtual ~Zero ()
+      {}
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t&) const
+      {
+	result.setZero ();
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t&,
+		     size_type) const
+      {
+	gradient.setZero ();
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t&) const
+      {
+	jacobian.setZero ();
+      }
+    };
+
+    /// \brief Translation of the argument.
+    ///
+    /// Input: x (size: n)
+    /// Output: x + offset (size: n)
+    ///
+    /// The offset can be modified in place.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class Identity : public GenericLinearFunction<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericLinearFunction<T>);
+
+      /// \brief Constructor.
+      ///
+      /// \param offset constant term (its size is the argument size)
+      explicit Identity (const vector_t& offset)
+	: GenericLinearFunction<T>
+	  (offset.size (), offset.size (), "identity"),
+	  offset_ (offset)
+      {}
+
+      virtual ~Identity ()
+      {}
+
+      /// \brief Constant term.
+      vector_t& offset ()
+      {
+	return offset_;
+      }
+
+      /// \brief Constant term.
+      const vector_t& offset () const
+      {
+	return offset_;
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	result = x + offset_;
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t&,
+		     size_type functionId) const
+      {
+	gradient.setZero ();
+	gradient.coeffRef (functionId) = 1.;
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t&) const
+      {
+	// coefficient-wise to support sparse matrices
+	jacobian.setZero ();
+	for (size_type i = 0; i < this->outputSize (); ++i)
+	  jacobian.coeffRef (i, i) = 1.;
+      }
+
+    private:
+      /// \brief Constant term.
+      vector_t offset_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_SELECTOR_HH
@@ -0,0 +1,123 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_SQUARED_DISTANCE_TO_REFERENCE_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_SQUARED_DISTANCE_TO_REFERENCE_HH
+# include <stdexcept>
+
+# include <boost/format.hpp>
+
+# include <roboptim/core/quadratic-function.hh>
+
+# include <roboptim/retargeting/jacobian.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Squared distance to a reference vector (Residual Sum
+    ///        of Squares).
+    ///
+    /// Input: x (size: reference size)
+    /// Output: \f$ ||x - r||^2 = \sum (x_i - r_i)^2 \f$ (size: 1)
+    ///
+    /// This is the quadratic function x^T I x - 2 r^T x + r^T r
+    /// but, contrary to a GenericNumericQuadraticFunction, the
+    /// identity matrix is not stored: the value and the derivatives
+    /// (2 (x - r), 2 I) are computed in closed form from the
+    /// reference only.
+    ///
+    /// \tparam T function traits
+    template <typename T>
+    class SquaredDistanceToReference : public GenericQuadraticFunction<T>
+    {
+    public:
+      ROBOPTIM_TWICE_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericQuadraticFunction<T>);
+
+      /// \brief Constructor.
+      ///
+      /// \param reference reference vector, this function reaches
+      ///        its minimum (zero) at this point
+      explicit SquaredDistanceToReference (const vector_t& reference)
+	: GenericQuadraticFunction<T>
+	  (reference.size (), 1, "squared distance to reference"),
+	  reference_ (reference)
+      {}
+
+      virtual ~SquaredDistanceToReference ()
+      {}
+
+      /// \brief Reference vector.
+      const vector_t& reference () const
+      {
+	return reference_;
+      }
+
+      /// \brief Change the reference vector.
+      ///
+      /// \param reference reference vector (same size)
+      void setReference (const vector_t& reference)
+      {
+	if (reference.size () != reference_.size ())
+	  {
+	    boost::format fmt
+	      ("invalid reference size (%d, %d expected)");
+	    fmt % reference.size () % reference_.size ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	reference_ = reference;
+      }
+
+    protected:
+      void
+      impl_compute (result_t& result, const argument_t& x) const
+      {
+	result[0] = (x - reference_).squaredNorm ();
+      }
+
+      void
+      impl_gradient (gradient_t& gradient, const argument_t& x,
+		     size_type) const
+      {
+	assignDense (gradient, 2. * (x - reference_));
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x) const
+      {
+	assignDense (jacobian, 2. * (x - reference_).transpose ());
+      }
+
+      void
+      impl_hessian (hessian_t& hessian, const argument_t&,
+		    size_type) const
+      {
+	// coefficient-wise to support sparse matrices
+	hessian.setZero ();
+	for (size_type i = 0; i < this->inputSize (); ++i)
+	  hessian.coeffRef (i, i) = 2.;
+      }
+
+    private:
+      /// \brief Reference vector.
+      vector_t reference_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_SQUARED_DISTANCE_TO_REFERENCE_HH
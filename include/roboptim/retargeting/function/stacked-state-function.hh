@@ -0,0 +1,341 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_STACKED_STATE_FUNCTION_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_STACKED_STATE_FUNCTION_HH
+# include <stdexcept>
+# include <string>
+# include <vector>
+
+# include <boost/format.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <Eigen/SparseCore>
+
+# include <roboptim/core/differentiable-function.hh>
+
+# include <roboptim/retargeting/jacobian.hh>
+# include <roboptim/retargeting/utility.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Evaluate a state function on every frame of a discrete
+    ///        trajectory.
+    ///
+    /// Input: the whole trajectory parameters (nFrames consecutive
+    /// configurations of nDofs values).
+    ///
+    /// Output: the state function values of each constrained frame,
+    /// stacked.
+    ///
+    /// The state of frame k is built directly from the parameters
+    /// blocks, without interpolation:
+    /// - q = x_k,
+    /// - dq = (x_{k+1} - x_{k-1}) / 2 dt (order >= 1),
+    /// - ddq = (x_{k+1} - 2 x_k + x_{k-1}) / dt^2 (order 2).
+    ///
+    /// Order 0 functions are therefore evaluated on every frame,
+    /// higher orders on every frame except the first and last ones.
+    ///
+    /// The jacobian rows of frame k only depend on the frames k - 1
+    /// to k + 1: only these coefficients are written which makes the
+    /// jacobian block-sparse.
+    ///
+    /// This replaces one roboptim::StateFunction per frame: only one
+    /// constraint is added to the problem.
+    ///
+    /// \tparam T Function traits type
+    template <typename T>
+    class StackedStateFunction : public GenericDifferentiableFunction<T>
+    {
+    public:
+      ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericDifferentiableFunction<T>);
+
+      typedef GenericDifferentiableFunction<T> stateFunction_t;
+      typedef boost::shared_ptr<stateFunction_t> stateFunctionShPtr_t;
+      typedef Eigen::Matrix<value_type, Eigen::Dynamic, Eigen::Dynamic>
+      denseJacobian_t;
+      typedef Eigen::Matrix<value_type, Eigen::Dynamic, 1> denseVector_t;
+      typedef typename denseVector_t::Index index_t;
+      typedef Eigen::Triplet<value_type> triplet_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param stateFunction function taking (order + 1) * nDofs
+      ///        values as input
+      /// \param nFrames number of frames of the trajectory
+      /// \param order state function order (0, 1 or 2)
+      /// \param dt time between two frames
+      StackedStateFunction (stateFunctionShPtr_t stateFunction,
+			    index_t nFrames,
+			    std::size_t order,
+			    value_type dt)
+	: GenericDifferentiableFunction<T>
+	  (static_cast<size_type>
+	   (nFrames * nDofs (safeGet (stateFunction), order)),
+	   static_cast<size_type>
+	   (nStackedFrames (nFrames, order) * stateFunction->outputSize ()),
+	   (boost::format ("%s (stacked)")
+	    % stateFunction->getName ()).str ()),
+	  stateFunction_ (stateFunction),
+	  nFrames_ (nFrames),
+	  nDofs_ (nDofs (*stateFunction, order)),
+	  order_ (static_cast<index_t> (order)),
+	  dt_ (dt),
+	  state_ (stateFunction->inputSize ()),
+	  stateResult_ (stateFunction->outputSize ()),
+	  stateJacobian_ (stateFunction->outputSize (),
+			  stateFunction->inputSize ()),
+	  stateGradient_ (stateFunction->inputSize ()),
+	  denseStateJacobian_ (stateFunction->outputSize (),
+			       stateFunction->inputSize ()),
+	  denseStateGradient_ (stateFunction->inputSize ()),
+	  triplets_ ()
+      {
+	if (order > 0 && dt <= 0.)
+	  throw std::runtime_error
+	    ("failed to construct stacked state function:"
+	     " the time step must be positive");
+      }
+
+      virtual ~StackedStateFunction ()
+      {}
+
+      const stateFunctionShPtr_t& stateFunction () const
+      {
+	return stateFunction_;
+      }
+
+      /// \brief Index of the first constrained frame.
+      index_t firstFrame () const
+      {
+	return order_ > 0 ? 1 : 0;
+      }
+
+      /// \brief Number of constrained frames.
+      index_t nStackedFrames () const
+      {
+	return nStackedFrames (nFrames_, static_cast<std::size_t> (order_));
+      }
+
+      /// \brief Repeat per-frame values (intervals, scales) for each
+      ///        constrained frame.
+      template <typename U>
+      std::vector<U> repeat (const std::vector<U>& values) const
+      {
+	std::vector<U> result;
+	result.reserve (values.size ()
+			* static_cast<std::size_t> (nStackedFrames ()));
+	for (index_t i = 0; i < nStackedFrames (); ++i)
+	  result.insert (result.end (), values.begin (), values.end ());
+	return result;
+      }
+
+    protected:
+      void
+      impl_compute
+      (result_t& result, const argument_t& x)
+	const
+      {
+	const index_t m = stateFunction_->outputSize ();
+	for (index_t i = 0; i < nStackedFrames (); ++i)
+	  {
+	    computeState (firstFrame () + i, x);
+	    (*stateFunction_) (stateResult_, state_);
+	    result.segment (i * m, m) = stateResult_;
+	  }
+      }
+
+      void
+      impl_gradient (gradient_t& gradient,
+		     const argument_t& x,
+		     size_type functionId)
+	const
+      {
+	const index_t m = stateFunction_->outputSize ();
+	const index_t i = static_cast<index_t> (functionId) / m;
+	const index_t frame = firstFrame () + i;
+
+	computeState (frame, x);
+	stateFunction_->gradient
+	  (stateGradient_, state_,
+	   static_cast<size_type> (static_cast<index_t> (functionId) - i * m));
+	copyToDense (denseStateGradient_, stateGradient_);
+
+	// coefficient-wise to support sparse gradients: the whole
+	// neighbor block is stored, even the zero entries, so that the
+	// sparsity pattern does not depend on x.
+	gradient.setZero ();
+	for (index_t offset = -1; offset <= 1; ++offset)
+	  {
+	    if (!isNeighbor (frame, offset))
+	      continue;
+	    for (index_t dof = 0; dof < nDofs_; ++dof)
+	      gradient.coeffRef ((frame + offset) * nDofs_ + dof) =
+		chainRule (denseStateGradient_.transpose (), 0, offset, dof);
+	  }
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x)
+	const
+      {
+	const index_t m = stateFunction_->outputSize ();
+	triplets_.clear ();
+	for (index_t i = 0; i < nStackedFrames (); ++i)
+	  {
+	    const index_t frame = firstFrame () + i;
+	    computeState (frame, x);
+	    stateFunction_->jacobian (stateJacobian_, state_);
+	    copyToDense (denseStateJacobian_, stateJacobian_);
+
+	    for (index_t offset = -1; offset <= 1; ++offset)
+	      {
+		if (!isNeighbor (frame, offset))
+		  continue;
+		// structural non-zeros: the whole neighbor block
+		for (index_t dof = 0; dof < nDofs_; ++dof)
+		  for (index_t row = 0; row < m; ++row)
+		    triplets_.push_back
+		      (triplet_t (i * m + row,
+				  (frame + offset) * nDofs_ + dof,
+				  chainRule (denseStateJacobian_, row, offset, dof)));
+	      }
+	  }
+	assignTriplets (jacobian, triplets_);
+      }
+
+    private:
+      static index_t nDofs (const stateFunction_t& stateFunction,
+			    std::size_t order)
+      {
+	if (order > 2)
+	  {
+	    boost::format fmt
+	      ("stacked state functions support orders 0 to 2 (order %d)");
+	    fmt % order;
+	    throw std::runtime_error (fmt.str ());
+	  }
+	const index_t n = stateFunction.inputSize ();
+	const index_t k = static_cast<index_t> (order) + 1;
+	if (n % k != 0)
+	  {
+	    boost::format fmt
+	      ("state function input size (%d) is not a multiple of %d");
+	    fmt % n % k;
+	    throw std::runtime_error (fmt.str ());
+	  }
+	return n / k;
+      }
+
+      static index_t nStackedFrames (index_t nFrames, std::size_t order)
+      {
+	const index_t n = order > 0 ? nFrames - 2 : nFrames;
+	if (n < 1)
+	  {
+	    boost::format fmt
+	      ("%d frames are not enough for an order %d state function");
+	    fmt % nFrames % order;
+	    throw std::runtime_error (fmt.str ());
+	  }
+	return n;
+      }
+
+      /// \brief Does the state of frame depend on frame + offset?
+      bool isNeighbor (index_t frame, index_t offset) const
+      {
+	return (order_ > 0 || offset == 0)
+	  && frame + offset >= 0 && frame + offset < nFrames_;
+      }
+
+      /// \brief Derivative of the state block of a given order with
+      ///        respect to the configuration of frame + offset.
+      value_type coefficient (index_t order, index_t offset) const
+      {
+	switch (order)
+	  {
+	  case 0:
+	    return offset == 0 ? 1. : 0.;
+	  case 1:
+	    return static_cast<value_type> (offset) / (2. * dt_);
+	  case 2:
+	    return (offset == 0 ? -2. : 1.) / (dt_ * dt_);
+	  default:
+	    ROBOPTIM_RETARGETING_ASSERT (0 && "should never happen");
+	    return 0.;
+	  }
+      }
+
+      /// \brief Derivative of one state function output with
+      ///        respect to one value of the frame + offset
+      ///        configuration.
+      template <typename Derived>
+      value_type chainRule (const Eigen::MatrixBase<Derived>& stateJacobian,
+			    index_t row, index_t offset, index_t dof) const
+      {
+	value_type value = 0.;
+	for (index_t order = 0; order <= order_; ++order)
+	  value += coefficient (order, offset)
+	    * stateJacobian (row, order * nDofs_ + dof);
+	return value;
+      }
+
+      /// \brief Build the state of a frame from the parameters.
+      void computeState (index_t frame, const argument_t& x) const
+      {
+	const index_t n = nDofs_;
+	state_.segment (0, n) = x.segment (frame * n, n);
+	if (order_ >= 1)
+	  state_.segment (n, n) =
+	    (x.segment ((frame + 1) * n, n)
+	     - x.segment ((frame - 1) * n, n)) / (2. * dt_);
+	if (order_ >= 2)
+	  state_.segment (2 * n, n) =
+	    (x.segment ((frame + 1) * n, n)
+	     - 2. * x.segment (frame * n, n)
+	     + x.segment ((frame - 1) * n, n)) / (dt_ * dt_);
+      }
+
+      /// \brief Function evaluated on each frame.
+      stateFunctionShPtr_t stateFunction_;
+      /// \brief Number of frames.
+      index_t nFrames_;
+      /// \brief Configuration size.
+      index_t nDofs_;
+      /// \brief State function order.
+      index_t order_;
+      /// \brief Time between two frames.
+      value_type dt_;
+
+      /// \name Buffers.
+      /// \{
+      mutable argument_t state_;
+      mutable result_t stateResult_;
+      mutable jacobian_t stateJacobian_;
+      mutable gradient_t stateGradient_;
+      mutable denseJacobian_t denseStateJacobian_;
+      mutable denseVector_t denseStateGradient_;
+      mutable std::vector<triplet_t> triplets_;
+      /// \}
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_STACKED_STATE_FUNCTION_HH
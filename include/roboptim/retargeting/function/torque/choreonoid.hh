@@ -17,12 +17,17 @@
 
 #ifndef ROBOPTIM_RETARGETING_FUNCTION_TORQUE_CHOREONOID_HH
 # define ROBOPTIM_RETARGETING_FUNCTION_TORQUE_CHOREONOID_HH
-# include <roboptim/core/finite-difference-gradient.hh>
+# include <vector>
+
+# include <boost/make_shared.hpp>
 
 # include <cnoid/Body>
 # include <cnoid/ForwardDynamics>
 
+# include <roboptim/retargeting/evaluation-context.hh>
 # include <roboptim/retargeting/function/torque.hh>
+# include <roboptim/retargeting/parallel-finite-difference.hh>
+# include <roboptim/retargeting/robot-state.hh>
 
 // For update configuration function.
 # include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
@@ -40,32 +45,68 @@ namespace roboptim
     public:
       ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_ (Torque<T>);
 
+      // Temporary - finite difference gradient.
+      typedef ParallelFiniteDifference<T> fdFunction_t;
+
       explicit TorqueChoreonoid (cnoid::BodyPtr robot)
 	// Add a fictional free floating joint at the beginning.
 	: Torque<T> (6 + robot->numJoints (), "choreonoid"),
-	  robot_ (robot),
+	  contexts_ (boost::make_shared<EvaluationContextPool> (robot, 1)),
 	  forwardDynamics_ (),
-	  fd_ (boost::make_shared<fdFunction_t> (*this))
-      {}
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a shared robot state.
+      ///
+      /// Functions sharing the same robot state share the forward
+      /// kinematics cache.
+      explicit TorqueChoreonoid (RobotStateShPtr robotState)
+	: Torque<T>
+	  (6 + safeGet (robotState).robot ()->numJoints (), "choreonoid"),
+	  contexts_
+	  (boost::make_shared<EvaluationContextPool> (robotState, 1)),
+	  forwardDynamics_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a pool of evaluation contexts.
+      ///
+      /// The function can then be evaluated concurrently by the
+      /// workers of the shared worker pool.
+      explicit TorqueChoreonoid (EvaluationContextPoolShPtr contexts)
+	: Torque<T>
+	  (6 + safeGet (contexts).robot ()->numJoints (), "choreonoid"),
+	  contexts_ (contexts),
+	  forwardDynamics_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
 
       virtual ~TorqueChoreonoid ()
       {}
 
+      /// \brief Finite difference policy used for the derivatives.
+      ///
+      /// Columns are computed by the workers of the shared pool
+      /// when the function has one evaluation context per worker.
+      fdFunction_t& finiteDifference () const
+      {
+	return *fd_;
+      }
+
       void
       impl_compute
       (result_t& result, const argument_t& x)
 	const
       {
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
-
-	// Set dq, ddq.
-	for(int dofId = 0; dofId < robot_->numJoints (); ++dofId)
-	  {
-	    robot_->joint (dofId)->q () = this->q (x, false)[dofId];
-	    robot_->joint (dofId)->dq () = this->dq (x, false)[dofId];
-	    robot_->joint (dofId)->ddq () = this->ddq (x, false)[dofId];
-	  }
+	// Set the robot configuration, dq, ddq.
+	contexts_->local ().robotState ().update
+	  (this->q (x), this->dq (x, false), this->ddq (x, false));
 
 	result.setZero ();
 
@@ -81,23 +122,27 @@ namespace roboptim
 	fd_->gradient (gradient, x, i);
       }
 
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x)
+	const
+      {
+	fd_->jacobian (jacobian, x);
+      }
+
     private:
-      /// \brief Pointer to loaded robot model
-      cnoid::BodyPtr robot_;
+      void initialize ()
+      {
+	fd_ = boost::make_shared<fdFunction_t> (*this, contexts_->size ());
+      }
 
-      /// \brief Root link position
-      mutable cnoid::Position rootLinkPosition_;
+      /// \brief Robots and forward kinematics caches (one per worker).
+      EvaluationContextPoolShPtr contexts_;
 
       /// \brief Choreonoid Forward Dynamics object implementing Roy
       ///        Featherstone's articulated body algorithm.
       boost::shared_ptr<cnoid::ForwardDynamics> forwardDynamics_;
 
-      // Temporary - finite difference gradient.
-      // Currently the simple policy generates precision errors,
-      // one may want to switch to five point rules.
-      typedef roboptim::GenericFiniteDifferenceGradient<
-	T, finiteDifferenceGradientPolicies::Simple<T> >
-      fdFunction_t;
+      /// \brief Finite differences (one workspace per context).
       boost::shared_ptr<fdFunction_t> fd_;
     };
   } // end of namespace retargeting.
@@ -17,16 +17,20 @@
 
 #ifndef ROBOPTIM_RETARGETING_FUNCTION_TORQUE_METAPOD_HH
 # define ROBOPTIM_RETARGETING_FUNCTION_TORQUE_METAPOD_HH
+# include <vector>
+
 # include <roboptim/core/function.hh>
 
+# include <boost/format.hpp>
 # include <boost/fusion/include/at_c.hpp>
+# include <boost/make_shared.hpp>
 # include <metapod/tools/joint.hh>
 # include <metapod/algos/rnea.hh>
 # include <metapod/tools/print.hh>
 
-# include <roboptim/core/finite-difference-gradient.hh>
-
 # include <roboptim/retargeting/function/torque.hh>
+# include <roboptim/retargeting/parallel-finite-difference.hh>
+# include <roboptim/retargeting/worker-pool.hh>
 
 namespace roboptim
 {
@@ -46,24 +50,41 @@ namespace roboptim
       ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_ (Torque<T>);
       typedef R robot_t;
 
+      // Temporary - finite difference gradient.
+      typedef ParallelFiniteDifference<T> fdFunction_t;
+
       explicit TorqueMetapod ()
 	: Torque<T> (robot_t::NBDOF, "metapod"),
-	  robot_ ()
-      {}
+	  workspaces_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
 
       virtual ~TorqueMetapod ()
       {}
 
+      /// \brief Finite difference policy used for the derivatives.
+      ///
+      /// Each worker of the shared pool evaluates the function with
+      /// its own robot.
+      fdFunction_t& finiteDifference () const
+      {
+	return *fd_;
+      }
+
       // see https://github.com/laas/metapod/issues/63
       void
       impl_compute
       (result_t& result, const argument_t& x)
 	const
       {
+	Workspace& w = localWorkspace ();
+
 	metapod::rnea<robot_t, true>::run
-	  (robot_, this->q (x), this->dq (x), this->ddq (x));
-	metapod::getTorques (robot_, torques_);
-	result = torques_;
+	  (w.robot, this->q (x), this->dq (x), this->ddq (x));
+	metapod::getTorques (w.robot, w.torques);
+	result = w.torques;
       }
 
       void
@@ -76,16 +97,63 @@ namespace roboptim
 	Eigen::internal::set_is_malloc_allowed (true);
 #endif //! ROBOPTIM_DO_NOT_CHECK_ALLOCATION
 
-	roboptim::GenericFiniteDifferenceGradient<
-	  T,
-	  finiteDifferenceGradientPolicies::Simple<T> >
-	  fdg (*this);
-	fdg.gradient (gradient, x, i);
+	fd_->gradient (gradient, x, i);
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x)
+	const
+      {
+#ifndef ROBOPTIM_DO_NOT_CHECK_ALLOCATION
+	Eigen::internal::set_is_malloc_allowed (true);
+#endif //! ROBOPTIM_DO_NOT_CHECK_ALLOCATION
+
+	fd_->jacobian (jacobian, x);
       }
 
     private:
-      mutable robot_t robot_;
-      mutable typename robot_t::confVector torques_;
+      /// \brief Robot and buffers used by one worker.
+      struct Workspace
+      {
+	robot_t robot;
+	typename robot_t::confVector torques;
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      };
+      typedef boost::shared_ptr<Workspace> WorkspaceShPtr;
+
+      /// \brief Allocate one workspace per worker of the shared pool.
+      void initialize ()
+      {
+	std::size_t nWorkers = WorkerPool::shared ().size ();
+	workspaces_.reserve (nWorkers);
+	for (std::size_t id = 0; id < nWorkers; ++id)
+	  workspaces_.push_back
+	    (boost::allocate_shared<Workspace>
+	     (Eigen::aligned_allocator<Workspace> ()));
+
+	fd_ = boost::make_shared<fdFunction_t> (*this, nWorkers);
+      }
+
+      Workspace& localWorkspace () const
+      {
+	std::size_t id = WorkerPool::workerId ();
+	if (id >= workspaces_.size ())
+	  {
+	    boost::format fmt
+	      ("no metapod robot for worker %d"
+	       " (%d robots have been allocated)");
+	    fmt % id % workspaces_.size ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	return *workspaces_[id];
+      }
+
+      /// \brief Robots and buffers, indexed by worker id.
+      std::vector<WorkspaceShPtr> workspaces_;
+
+      /// \brief Finite differences (one workspace per worker).
+      boost::shared_ptr<fdFunction_t> fd_;
     };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
@@ -0,0 +1,361 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_FUNCTION_ZMP_TRAJECTORY_CHOREONOID_HH
+# define ROBOPTIM_RETARGETING_FUNCTION_ZMP_TRAJECTORY_CHOREONOID_HH
+# include <algorithm>
+# include <stdexcept>
+# include <vector>
+
+# include <boost/bind.hpp>
+# include <boost/format.hpp>
+# include <boost/ref.hpp>
+
+# include <roboptim/core/differentiable-function.hh>
+
+# include <roboptim/retargeting/centroidal-trajectory.hh>
+# include <roboptim/retargeting/jacobian.hh>
+# include <roboptim/retargeting/worker-pool.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief ZMP of every frame of a discrete trajectory.
+    ///
+    /// Input: the whole trajectory parameters (nFrames
+    /// configurations).
+    ///
+    /// Output: the ZMP (x, y) of each frame, excluding the first
+    /// and last ones.
+    ///
+    /// Contrary to ZMPChoreonoid which perturbs one state to
+    /// estimate the accelerations, the center of mass acceleration
+    /// and the angular momentum variation are computed from the
+    /// neighboring frames quantities provided by a
+    /// CentroidalTrajectory.
+    ///
+    /// As the ZMP of one frame only depends on the two previous and
+    /// two next frames, the jacobian is banded: it is computed by
+    /// central finite differences, recomputing only the quantities
+    /// of the frames affected by each perturbation. Columns are
+    /// distributed among the workers of the shared pool.
+    ///
+    /// Only the band is stored (column by column). All its entries
+    /// are emitted, even the ones which are numerically zero, so that
+    /// the sparsity pattern does not depend on the argument.
+    ///
+    /// \tparam T Function traits type
+    template <typename T>
+    class ZMPTrajectoryChoreonoid : public GenericDifferentiableFunction<T>
+    {
+    public:
+      ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+      (GenericDifferentiableFunction<T>);
+
+      typedef CentroidalTrajectory::matrix_t quantities_t;
+      typedef CentroidalTrajectory::index_t index_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param centroidal centroidal quantities of the trajectory
+      ///        (may be shared with other functions)
+      /// \param epsilon finite differences perturbation
+      explicit ZMPTrajectoryChoreonoid (CentroidalTrajectoryShPtr centroidal,
+					value_type epsilon = 1e-6)
+	: GenericDifferentiableFunction<T>
+	  (static_cast<size_type>
+	   (safeGet (centroidal).nFrames () * centroidal->nDofs ()),
+	   static_cast<size_type>
+	   (2 * std::max<index_t> (centroidal->nFrames () - 2, 0)),
+	   "ZMP (trajectory)"),
+	  centroidal_ (centroidal),
+	  g_ (9.81),
+	  epsilon_ (epsilon),
+	  columnOffsets_ (),
+	  workspaces_ ()
+      {
+	if (centroidal->nFrames () < 3)
+	  throw std::runtime_error
+	    ("failed to construct ZMPTrajectoryChoreonoid function:"
+	     " the trajectory must contain at least three frames");
+
+	// Column j holds the rows of the ZMP frames firstZmp to
+	// lastZmp of its frame.
+	const index_t nDofs = centroidal->nDofs ();
+	columnOffsets_.resize (static_cast<std::size_t> (this->inputSize ()) + 1);
+	columnOffsets_[0] = 0;
+	for (index_t j = 0; j < this->inputSize (); ++j)
+	  columnOffsets_[static_cast<std::size_t> (j) + 1] =
+	    columnOffsets_[static_cast<std::size_t> (j)]
+	    + 2 * (lastZmp (j / nDofs) - firstZmp (j / nDofs) + 1);
+
+	for (std::size_t id = 0; id < centroidal->contexts ()->size (); ++id)
+	  {
+	    Workspace w;
+	    w.x.resize (this->inputSize ());
+	    w.lastX.resize (this->inputSize ());
+	    w.band.resize (columnOffsets_.back ());
+	    w.valid = false;
+	    workspaces_.push_back (w);
+	  }
+      }
+
+      virtual ~ZMPTrajectoryChoreonoid ()
+      {}
+
+      const CentroidalTrajectoryShPtr& centroidalTrajectory () const
+      {
+	return centroidal_;
+      }
+
+    protected:
+      void
+      impl_compute
+      (result_t& result, const argument_t& x)
+	const
+      {
+	centroidal_->update (x);
+
+	const quantities_t& com = centroidal_->com ();
+	const quantities_t& L = centroidal_->angularMomentum ();
+
+	cnoid::Vector3 c[3];
+	cnoid::Vector3 l[3];
+	for (index_t frame = 1; frame < centroidal_->nFrames () - 1; ++frame)
+	  {
+	    for (index_t i = 0; i < 3; ++i)
+	      {
+		c[i] = com.row (frame - 1 + i).transpose ();
+		l[i] = L.row (frame - 1 + i).transpose ();
+	      }
+	    result.template segment<2> (2 * (frame - 1)) = zmp (c, l);
+	  }
+      }
+
+      void
+      impl_gradient (gradient_t& gradient,
+		     const argument_t& x,
+		     size_type functionId)
+	const
+      {
+	const vector_t& band = updateBand (x);
+	const index_t nFrames = centroidal_->nFrames ();
+	const index_t nDofs = centroidal_->nDofs ();
+	const index_t zmpFrame = functionId / 2 + 1;
+
+	// coefficient-wise to support sparse gradients
+	gradient.setZero ();
+	for (index_t frame = std::max<index_t> (zmpFrame - 2, 0);
+	     frame <= std::min<index_t> (zmpFrame + 2, nFrames - 1); ++frame)
+	  for (index_t dof = 0; dof < nDofs; ++dof)
+	    {
+	      const index_t j = frame * nDofs + dof;
+	      gradient.coeffRef (j) =
+		band[columnOffsets_[static_cast<std::size_t> (j)]
+		     + 2 * (zmpFrame - firstZmp (frame)) + functionId % 2];
+	    }
+      }
+
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x)
+	const
+      {
+	const vector_t& band = updateBand (x);
+	const index_t nDofs = centroidal_->nDofs ();
+
+	Workspace& w = localWorkspace ();
+	w.triplets.clear ();
+	w.triplets.reserve (static_cast<std::size_t> (band.size ()));
+	for (index_t j = 0; j < this->inputSize (); ++j)
+	  {
+	    const index_t frame = j / nDofs;
+	    index_t k = columnOffsets_[static_cast<std::size_t> (j)];
+	    for (index_t row = 2 * (firstZmp (frame) - 1);
+		 row < 2 * lastZmp (frame); ++row, ++k)
+	      w.triplets.push_back
+		(Eigen::Triplet<value_type> (row, j, band[k]));
+	  }
+	assignTriplets (jacobian, w.triplets);
+      }
+
+    private:
+      /// \brief Buffers used by one worker.
+      struct Workspace
+      {
+	/// \brief Perturbed trajectory.
+	vector_t x;
+	/// \brief Argument used for the last jacobian.
+	vector_t lastX;
+	/// \brief Band of the last jacobian computed by this worker
+	///        (see columnOffsets_).
+	vector_t band;
+	/// \brief Is the last band valid?
+	bool valid;
+	/// \brief Jacobian non-zeros buffer.
+	std::vector<Eigen::Triplet<value_type> > triplets;
+      };
+
+      Workspace& localWorkspace () const
+      {
+	return workspaces_[centroidal_->contexts ()->localId ()];
+      }
+
+      /// \brief First ZMP frame depending on a frame.
+      index_t firstZmp (index_t frame) const
+      {
+	return std::max<index_t> (frame - 2, 1);
+      }
+
+      /// \brief Last ZMP frame depending on a frame.
+      index_t lastZmp (index_t frame) const
+      {
+	return std::min<index_t> (frame + 2, centroidal_->nFrames () - 2);
+      }
+
+      /// \brief ZMP from the previous, current and next frames
+      ///        quantities.
+      ///
+      /// \param c centers of mass
+      /// \param l angular momenta
+      Eigen::Matrix<value_type, 2, 1>
+      zmp (const cnoid::Vector3 c[3], const cnoid::Vector3 l[3]) const
+      {
+	const value_type dt = centroidal_->dt ();
+	const value_type m = centroidal_->mass ();
+
+	// Center of mass acceleration.
+	cnoid::Vector3 ddcom = (c[2] - 2. * c[1] + c[0]) / (dt * dt);
+	// Variation of the kinetic momentum.
+	cnoid::Vector3 dL = (l[2] - l[0]) / (2. * dt);
+
+	// alpha = \ddot{x_z} + g
+	const value_type alpha = ddcom[2] + g_;
+
+	Eigen::Matrix<value_type, 2, 1> result;
+	result[0] = c[1][0] - dL[1] / (m * alpha) - ddcom[0] * c[1][2] / alpha;
+	result[1] = c[1][1] - dL[0] / (m * alpha) - ddcom[1] * c[1][2] / alpha;
+	return result;
+      }
+
+      /// \brief Compute the jacobian band at x (cached).
+      const vector_t& updateBand (const argument_t& x) const
+      {
+	Workspace& w = localWorkspace ();
+	if (w.valid && w.lastX == x)
+	  return w.band;
+
+	w.valid = false;
+	w.lastX = x;
+
+	// Quantities at x, used for the frames not affected by a
+	// perturbation.
+	centroidal_->update (x);
+
+	const std::size_t nColumns = static_cast<std::size_t> (x.size ());
+	WorkerPool& pool = WorkerPool::shared ();
+	if (pool.size () > 1
+	    && pool.size () <= centroidal_->contexts ()->size ())
+	  pool.run (nColumns, boost::bind
+		    (&ZMPTrajectoryChoreonoid<T>::computeColumn, this, _1,
+		     boost::cref (x), boost::ref (w.band)));
+	else
+	  for (std::size_t column = 0; column < nColumns; ++column)
+	    computeColumn (column, x, w.band);
+
+	w.valid = true;
+	return w.band;
+      }
+
+      /// \brief Compute one column of the jacobian band.
+      ///
+      /// Perturbing frame j changes the velocities (hence momenta) of
+      /// frames j - 1 to j + 1, and therefore the ZMP of frames j - 2
+      /// to j + 2.
+      void computeColumn (std::size_t column, const argument_t& x,
+			  vector_t& band) const
+      {
+	Workspace& w = localWorkspace ();
+	const index_t nFrames = centroidal_->nFrames ();
+	const index_t nDofs = centroidal_->nDofs ();
+	const index_t j = static_cast<index_t> (column);
+	const index_t frame = j / nDofs;
+
+	const index_t firstFrame = std::max<index_t> (frame - 1, 0);
+	const index_t lastFrame = std::min<index_t> (frame + 1, nFrames - 1);
+
+	// Perturbed quantities of the affected frames (plus, minus).
+	cnoid::Vector3 com[2][3];
+	cnoid::Vector3 L[2][3];
+	cnoid::Vector3 P;
+
+	w.x = x;
+	for (int sign = 0; sign < 2; ++sign)
+	  {
+	    w.x[j] = x[j] + (sign == 0 ? epsilon_ : -epsilon_);
+	    for (index_t f = firstFrame; f <= lastFrame; ++f)
+	      centroidal_->computeFrame
+		(f, w.x, com[sign][f - firstFrame], P, L[sign][f - firstFrame]);
+	  }
+
+	const quantities_t& baseCom = centroidal_->com ();
+	const quantities_t& baseL = centroidal_->angularMomentum ();
+
+	cnoid::Vector3 c[2][3];
+	cnoid::Vector3 l[2][3];
+	index_t k = columnOffsets_[column];
+	for (index_t zmpFrame = firstZmp (frame); zmpFrame <= lastZmp (frame);
+	     ++zmpFrame, k += 2)
+	  {
+	    for (int sign = 0; sign < 2; ++sign)
+	      for (index_t i = 0; i < 3; ++i)
+		{
+		  index_t f = zmpFrame - 1 + i;
+		  if (f >= firstFrame && f <= lastFrame)
+		    {
+		      c[sign][i] = com[sign][f - firstFrame];
+		      l[sign][i] = L[sign][f - firstFrame];
+		    }
+		  else
+		    {
+		      c[sign][i] = baseCom.row (f).transpose ();
+		      l[sign][i] = baseL.row (f).transpose ();
+		    }
+		}
+
+	    band.template segment<2> (k) =
+	      (zmp (c[0], l[0]) - zmp (c[1], l[1])) / (2. * epsilon_);
+	  }
+      }
+
+      /// \brief Centroidal quantities of the trajectory.
+      CentroidalTrajectoryShPtr centroidal_;
+      /// \brief Gravitational constant
+      value_type g_;
+      /// \brief Finite differences perturbation.
+      value_type epsilon_;
+      /// \brief Offset of each column in the band (plus the band
+      ///        size).
+      std::vector<index_t> columnOffsets_;
+
+      /// \brief Buffers, indexed by evaluation context.
+      mutable std::vector<Workspace> workspaces_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_FUNCTION_ZMP_TRAJECTORY_CHOREONOID_HH
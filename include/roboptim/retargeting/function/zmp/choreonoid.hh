@@ -17,13 +17,17 @@
 
 #ifndef ROBOPTIM_RETARGETING_FUNCTION_ZMP_CHOREONOID_HH
 # define ROBOPTIM_RETARGETING_FUNCTION_ZMP_CHOREONOID_HH
-# include <boost/array.hpp>
+# include <vector>
 
-# include <roboptim/core/finite-difference-gradient.hh>
+# include <boost/array.hpp>
+# include <boost/make_shared.hpp>
 
 # include <cnoid/Body>
 
+# include <roboptim/retargeting/evaluation-context.hh>
 # include <roboptim/retargeting/function/zmp.hh>
+# include <roboptim/retargeting/parallel-finite-difference.hh>
+# include <roboptim/retargeting/robot-state.hh>
 
 // For update configuration function.
 # include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
@@ -41,6 +45,12 @@ namespace roboptim
     public:
       ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_ (ZMP<T>);
 
+      // Temporary - finite difference gradient.
+      // The simple policy generates precision errors as the ZMP is
+      // itself computed through finite differences, use the
+      // five-point rule instead.
+      typedef ParallelFiniteDifference<T> fdFunction_t;
+
       struct State
       {
 	vector_t x;
@@ -53,28 +63,60 @@ namespace roboptim
       explicit ZMPChoreonoid (cnoid::BodyPtr robot)
 	// Add a fictional free floating joint at the beginning.
 	: ZMP<T> (6 + robot->numJoints (), "choreonoid"),
-	  robot_ (robot),
+	  contexts_ (boost::make_shared<EvaluationContextPool> (robot, 1)),
 	  g_ (9.81),
 	  delta_ (1e-5),
 	  m_ (robot->mass ()),
-	  states_ (),
-	  fd_ (boost::make_shared<fdFunction_t> (*this))
+	  workspaces_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a shared robot state.
+      ///
+      /// Functions sharing the same robot state share the forward
+      /// kinematics cache.
+      explicit ZMPChoreonoid (RobotStateShPtr robotState)
+	: ZMP<T> (6 + safeGet (robotState).robot ()->numJoints (), "choreonoid"),
+	  contexts_
+	  (boost::make_shared<EvaluationContextPool> (robotState, 1)),
+	  g_ (9.81),
+	  delta_ (1e-5),
+	  m_ (robotState->robot ()->mass ()),
+	  workspaces_ (),
+	  fd_ ()
+      {
+	initialize ();
+      }
+
+      /// \brief Build the function from a pool of evaluation contexts.
+      ///
+      /// The function can then be evaluated concurrently by the
+      /// workers of the shared worker pool.
+      explicit ZMPChoreonoid (EvaluationContextPoolShPtr contexts)
+	: ZMP<T> (6 + safeGet (contexts).robot ()->numJoints (), "choreonoid"),
+	  contexts_ (contexts),
+	  g_ (9.81),
+	  delta_ (1e-5),
+	  m_ (contexts->robot ()->mass ()),
+	  workspaces_ (),
+	  fd_ ()
       {
-	for (std::size_t i = 0; i < states_.size (); ++i)
-	  states_[i].x.resize (6 + robot->numJoints ());
+	initialize ();
       }
 
       explicit ZMPChoreonoid (const ZMPChoreonoid<T>& zmp)
-	: ZMP<T> (6 + zmp.robot_->numJoints (), "choreonoid"),
-	  robot_ (zmp.robot_),
+	: ZMP<T> (6 + zmp.contexts_->robot ()->numJoints (), "choreonoid"),
+	  contexts_ (zmp.contexts_),
 	  g_ (zmp.g_),
 	  delta_ (zmp.delta_),
 	  m_ (zmp.m_),
-	  states_ (zmp.states_),
-	  fd_ (boost::make_shared<fdFunction_t> (*this))
+	  workspaces_ (),
+	  fd_ ()
       {
-	for (std::size_t i = 0; i < states_.size (); ++i)
-	  states_[i].x.resize (6 + robot_->numJoints ());
+	initialize ();
+	fd_->setRule (zmp.fd_->rule (), zmp.fd_->epsilon ());
       }
 
       ZMPChoreonoid<T>& operator= (const ZMPChoreonoid<T>& rhs)
@@ -82,100 +124,171 @@ namespace roboptim
 	if (this == &rhs)
 	  return *this;
 
-	this->robot_ = rhs.robot_;
+	this->contexts_ = rhs.contexts_;
 	this->g_ = rhs.g_;
 	this->delta_ = rhs.delta_;
 	this->m_ = rhs.m_;
-	this->states_ = rhs.states_;
-	this->fd_ = boost::make_shared<fdFunction_t> (*this);
+	this->workspaces_.clear ();
+	initialize ();
+	this->fd_->setRule (rhs.fd_->rule (), rhs.fd_->epsilon ());
 	return *this;
       }
 
       virtual ~ZMPChoreonoid ()
       {}
 
-      const State& states () const
+      /// \brief Finite difference policy used for the derivatives.
+      ///
+      /// Columns are computed by the workers of the shared pool
+      /// when the function has one evaluation context per worker.
+      fdFunction_t& finiteDifference () const
+      {
+	return *fd_;
+      }
+
+      /// \brief States computed by the last evaluation of the
+      ///        current thread.
+      const boost::array<State, 3>& states () const
       {
-	return states_;
+	return workspaces_[contexts_->localId ()]->states;
       }
 
       void printState (std::ostream& o, std::size_t i) const
       {
-	if (i >= states_.size ())
+	const boost::array<State, 3>& states = this->states ();
+	if (i >= states.size ())
 	  {
 	    o << "State does not exist" << decindent;
 	    return;
 	  }
 	o << "x: " << incindent << iendl
-	  << states_[i].x << decindent << iendl
-	  << "CoM: " << states_[i].com << iendl
-	  << "P: " << states_[i].P << iendl
-	  << "L: " << states_[i].L;
+	  << states[i].x << decindent << iendl
+	  << "CoM: " << states[i].com << iendl
+	  << "P: " << states[i].P << iendl
+	  << "L: " << states[i].L;
       }
 
       void printQuantities (std::ostream& o) const
       {
+	const Workspace& w = *workspaces_[contexts_->localId ()];
+
 	o << "g: " << g_ << iendl
 	  << "delta: " << delta_ << iendl
 	  << "m: " << m_ << iendl
 	  << "States: " << incindent << iendl;
-	for (std::size_t i = 0; i < states_.size (); ++i)
+	for (std::size_t i = 0; i < w.states.size (); ++i)
 	  {
 	    o << "State " << i << incindent << iendl;
 	    printState (o, i);
-	    if (i == states_.size () - 1)
+	    if (i == w.states.size () - 1)
 	      o << decindent;
 	    o << decindent << iendl;
 	  }
 	o  << "CoM acceleration: " << incindent << iendl
-	   << ddcom_ << decindent << iendl
+	   << w.ddcom << decindent << iendl
 	   << "Variation of the kinetic momentum:" << incindent << iendl
-	   << dL_ << decindent << iendl
+	   << w.dL << decindent << iendl
 	   << "Reordered variation of the kinetic momentum:" << incindent << iendl
-	   << dL_reordered_ << decindent << iendl;
+	   << w.dL_reordered << decindent << iendl;
       }
 
-    protected:
-      void fillStates (const argument_t& x) const
+    private:
+      /// \brief Buffers used by one evaluation context.
+      struct Workspace
       {
-	// Store q
-	states_[0].x = this->q (x, true);
-	assert (states_[0].x.size () == x.size () / 3);
+	explicit Workspace (size_type n)
+	  : states (),
+	    configuration (n),
+	    ddcom (),
+	    dL (),
+	    dL_reordered ()
+	{
+	  for (std::size_t i = 0; i < states.size (); ++i)
+	    states[i].x.resize (n);
+	}
+
+	/// \brief Set of computed quantities for
+	///        q, q + delta, q + 2 * delta
+	boost::array<State, 3> states;
+
+	/// \brief Buffer storing the configuration of the
+	///        intermediate states.
+	vector_t configuration;
+
+	/// \brief Center of mass acceleration.
+	///
+	/// \ddot{x}
+	cnoid::Vector3 ddcom;
+
+	/// \brief Variation of the kinetic momentum around the center
+	///        of mass.
+	///
+	/// \f$ \dot{L} \f$
+	cnoid::Vector3 dL;
+
+	/// \brief The equation need dL in another order, so reorder and
+	///        store it here for direct use in the final expression.
+	///
+	/// \f$ [ \dot{\delta_y}, \dot{\delta_x}] \f$
+	cnoid::Vector2 dL_reordered;
+
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      };
+      typedef boost::shared_ptr<Workspace> WorkspaceShPtr;
 
-	// Set the robot configuration.
-	updateRobotConfiguration (robot_, x);
+      void initialize ()
+      {
+	workspaces_.reserve (contexts_->size ());
+	for (std::size_t id = 0; id < contexts_->size (); ++id)
+	  workspaces_.push_back
+	    (boost::allocate_shared<Workspace>
+	     (Eigen::aligned_allocator<Workspace> (),
+	      this->inputSize () / 3));
+
+	fd_ = boost::make_shared<fdFunction_t>
+	  (*this, contexts_->size (), fdFunction_t::RULE_FIVE_POINTS, 1e-4);
+      }
 
-	// Set dq, ddq.
-	for(int dofId = 0; dofId < robot_->numJoints (); ++dofId)
-	  {
-	    robot_->joint (dofId)->q () = this->q (x, false)[dofId];
-	    robot_->joint (dofId)->dq () = this->dq (x, false)[dofId];
-	    robot_->joint (dofId)->ddq () = this->ddq (x, false)[dofId];
-	  }
+    protected:
+      void fillStates (const argument_t& x,
+		       EvaluationContext& context, Workspace& w) const
+      {
+	const cnoid::BodyPtr& robot = context.robot ();
+	boost::array<State, 3>& states = w.states;
+
+	// Store q
+	states[0].x = this->q (x, true);
+	assert (states[0].x.size () == x.size () / 3);
 
-	robot_->calcForwardKinematics (true, true);
-	states_[0].com = robot_->calcCenterOfMass ();
-	robot_->calcTotalMomentum (states_[0].P, states_[0].L);
+	// Set the robot configuration, dq, ddq and update the
+	// positions, velocities and accelerations.
+	context.robotState ().update
+	  (states[0].x, this->dq (x, false), this->ddq (x, false));
+	states[0].com = robot->calcCenterOfMass ();
+	robot->calcTotalMomentum (states[0].P, states[0].L);
 
-	for (std::size_t i = 1; i < states_.size (); ++i)
+	for (std::size_t i = 1; i < states.size (); ++i)
 	  {
 	    // Store q + delta * dq + .5 * ddq + delta^2
-	    states_[i].x = states_[i - 1].x;
-	    states_[i].x += delta_ * this->dq (x);
-	    states_[i].x += .5 * this->ddq (x) * delta_ * delta_;
+	    states[i].x = states[i - 1].x;
+	    states[i].x += delta_ * this->dq (x);
+	    states[i].x += .5 * this->ddq (x) * delta_ * delta_;
 
-	    // Update robot position (dq, ddq are unchanged).
-	    for(int dofId = 0; dofId < robot_->numJoints (); ++dofId)
-	      robot_->joint (dofId)->q () = states_[i].x[6 + dofId];
+	    // Update robot position (base, dq, ddq are unchanged).
+	    w.configuration.template segment<6> (0) =
+	      states[0].x.template segment<6> (0);
+	    w.configuration.segment (6, robot->numJoints ()) =
+	      states[i].x.segment (6, robot->numJoints ());
 
 	    // Compute quantities
-	    robot_->calcForwardKinematics (true, true);
+	    context.robotState ().update
+	      (w.configuration, this->dq (x, false), this->ddq (x, false));
 
 	    // Store CoM
-	    states_[i].com = robot_->calcCenterOfMass ();
+	    states[i].com = robot->calcCenterOfMass ();
 
 	    // Compute momentum and store it
-	    robot_->calcTotalMomentum (states_[i].P, states_[i].L);
+	    robot->calcTotalMomentum (states[i].P, states[i].L);
 	  }
       }
 
@@ -184,25 +297,29 @@ namespace roboptim
       (result_t& result, const argument_t& x)
 	const
       {
-	fillStates (x);
+	std::size_t contextId = contexts_->localId ();
+	Workspace& w = *workspaces_[contextId];
+	const boost::array<State, 3>& states = w.states;
+
+	fillStates (x, (*contexts_)[contextId], w);
 
 	// Compute center of mass acceleration
-	ddcom_ = states_[2].com - (2 * states_[1].com) + states_[0].com;
-	ddcom_ /= delta_ * delta_;
+	w.ddcom = states[2].com - (2 * states[1].com) + states[0].com;
+	w.ddcom /= delta_ * delta_;
 
 	// Compute variation of the kinetic momentum
-	dL_ = (states_[1].L - states_[0].L) / delta_;
+	w.dL = (states[1].L - states[0].L) / delta_;
 
 	// Reorder dL
-	dL_reordered_[0] = dL_[1];
-	dL_reordered_[1] = dL_[0];
+	w.dL_reordered[0] = w.dL[1];
+	w.dL_reordered[1] = w.dL[0];
 
 	// alpha = \ddot{x_z} + g
-	const double alpha = ddcom_[2] + g_;
+	const double alpha = w.ddcom[2] + g_;
 
-	result = this->states_[0].com.segment (0, 2);
-	result -= dL_reordered_ / (m_ * alpha);
-	result -= ddcom_.segment<2> (0) * (states_[0].com[2] / alpha);
+	result = states[0].com.segment (0, 2);
+	result -= w.dL_reordered / (m_ * alpha);
+	result -= w.ddcom.template segment<2> (0) * (states[0].com[2] / alpha);
       }
 
       void
@@ -214,9 +331,16 @@ namespace roboptim
 	fd_->gradient (gradient, x, i);
       }
 
+      void
+      impl_jacobian (jacobian_t& jacobian, const argument_t& x)
+	const
+      {
+	fd_->jacobian (jacobian, x);
+      }
+
     private:
-      /// \brief Pointer to loaded robot model
-      cnoid::BodyPtr robot_;
+      /// \brief Robots and forward kinematics caches (one per worker).
+      EvaluationContextPoolShPtr contexts_;
       /// \brief Gravitational constant
       value_type g_;
       /// \brief Delta used for finite differentiation
@@ -224,39 +348,12 @@ namespace roboptim
       /// \brief Robot total mass
       value_type m_;
 
-      /// \brief Root link position
-      mutable cnoid::Position rootLinkPosition_;
-
-      /// \brief Set of computed quantities for
-      ///        q, q + delta, q + 2 * delta
-      mutable boost::array<State, 3> states_;
-
-      /// \brief Center of mass acceleration.
-      ///
-      /// \ddot{x}
-      mutable cnoid::Vector3 ddcom_;
-
-      /// \brief Variation of the kinetic momentum around the center
-      ///        of mass.
-      ///
-      /// \f$ \dot{L} \f$
-      mutable cnoid::Vector3 dL_;
-
-      /// \brief The equation need dL in another order, so reorder and
-      ///        store it here for direct use in the final expression.
-      ///
-      /// \f$ [ \dot{\delta_y}, \dot{\delta_x}] \f$
-      mutable cnoid::Vector2 dL_reordered_;
+      /// \brief Buffers, indexed by evaluation context.
+      std::vector<WorkspaceShPtr> workspaces_;
 
-      // Temporary - finite difference gradient.
-      // Currently the simple policy generates precision errors,
-      // one may want to switch to five point rules.
-      typedef roboptim::GenericFiniteDifferenceGradient<
-	T, finiteDifferenceGradientPolicies::Simple<T> >
-      fdFunction_t;
+      /// \brief Finite differences (one workspace per context).
       boost::shared_ptr<fdFunction_t> fd_;
 
-
     public:
       EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     };
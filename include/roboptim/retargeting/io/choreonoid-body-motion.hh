@@ -17,8 +17,10 @@
 
 #ifndef ROBOPTIM_RETARGETING_IO_CHOREONOID_BODY_MOTION_HH
 # define ROBOPTIM_RETARGETING_IO_CHOREONOID_BODY_MOTION_HH
+# include <fstream>
 # include <string>
 
+# include <boost/noncopyable.hpp>
 # include <boost/shared_ptr.hpp>
 
 # include <roboptim/trajectory/trajectory.hh>
@@ -36,6 +38,65 @@ namespace roboptim
     ROBOPTIM_RETARGETING_DLLEXPORT void
     writeBodyMotion (const std::string& filename,
 		     boost::shared_ptr<roboptim::Trajectory<3> > trajectory);
+
+    /// \brief Write a Choreonoid body motion one frame at a time.
+    ///
+    /// Only the current frame is kept in memory. The joints
+    /// positions are written to the output file as soon as they are
+    /// received whereas the base positions (second component of the
+    /// motion) are written to a temporary file, appended to the
+    /// output when the writer is closed.
+    ///
+    /// The number of frames is part of the header: exactly this
+    /// number of frames must be written before closing the writer.
+    class ROBOPTIM_RETARGETING_DLLEXPORT BodyMotionWriter
+      : boost::noncopyable
+    {
+    public:
+      typedef Function::vector_t vector_t;
+
+      /// \brief Open the output file and write the header.
+      ///
+      /// \param filename output filename
+      /// \param numFrames number of frames of the motion
+      /// \param nDofs configuration size (free floating base
+      ///        position and orientation, then the joints)
+      /// \param frameRate frames per second
+      BodyMotionWriter (const std::string& filename,
+			int numFrames, int nDofs, double frameRate);
+
+      /// \brief Remove the temporary file.
+      ///
+      /// If the writer has not been closed, the output is
+      /// incomplete.
+      ~BodyMotionWriter ();
+
+      /// \brief Append one configuration.
+      ///
+      /// \param configuration robot configuration (size: nDofs)
+      void write (const vector_t& configuration);
+
+      /// \brief Append the base positions and close the output.
+      void close ();
+
+      /// \brief Number of frames written so far.
+      int numFramesWritten () const;
+
+    private:
+      /// \brief Output filename.
+      std::string filename_;
+      /// \brief Base positions temporary filename.
+      std::string baseFilename_;
+      /// \brief Output file (joints positions).
+      std::ofstream out_;
+      /// \brief Temporary file (base positions).
+      std::ofstream base_;
+      int numFrames_;
+      int nDofs_;
+      double frameRate_;
+      int numFramesWritten_;
+      bool closed_;
+    };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
 
@@ -0,0 +1,139 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_IO_MARKER_STREAM_HH
+# define ROBOPTIM_RETARGETING_IO_MARKER_STREAM_HH
+# include <cstddef>
+# include <string>
+
+# include <boost/date_time/posix_time/posix_time_types.hpp>
+# include <boost/noncopyable.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <Eigen/Core>
+
+# include <roboptim/retargeting/config.hh>
+# include <roboptim/retargeting/utility.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (MarkerStream);
+
+    /// \brief One frame read from a MarkerStream.
+    struct MarkerStreamFrame
+    {
+      /// \brief Frame time, as sent by the capture system.
+      double time;
+      /// \brief Markers positions (x, y, z for each marker).
+      Eigen::VectorXd positions;
+      /// \brief Reception time of the frame.
+      boost::posix_time::ptime received;
+      /// \brief Number of older frames skipped to return this one.
+      std::size_t dropped;
+    };
+
+    /// \brief Read markers frames incrementally.
+    ///
+    /// Frames are text lines, in the TRC data rows format:
+    ///
+    /// [frame number] time x1 y1 z1 ... xn yn zn
+    ///
+    /// the frame number being optional. Other lines (TRC header,
+    /// empty lines) are ignored.
+    ///
+    /// Supported sources:
+    /// - "-": standard input,
+    /// - "unix:PATH": UNIX domain socket (the capture system being
+    ///   the server),
+    /// - any other string: a named pipe or a regular file. Regular
+    ///   files are followed (as tail -f does) until no data is
+    ///   received during the idle timeout.
+    class ROBOPTIM_RETARGETING_DLLEXPORT MarkerStream : boost::noncopyable
+    {
+    public:
+      typedef Eigen::VectorXd vector_t;
+      typedef vector_t::Index index_t;
+
+      /// \brief Open a stream.
+      ///
+      /// \param source stream source (see class description)
+      /// \param nMarkers number of markers of each frame
+      /// \param scale factor applied to the positions (e.g. 1e-3 if
+      ///        the positions are sent in millimeters)
+      /// \param idleTimeout the stream ends if no data is received
+      ///        during this duration (in seconds, 0 means never)
+      MarkerStream (const std::string& source,
+		    index_t nMarkers,
+		    double scale = 1.,
+		    double idleTimeout = 0.);
+      ~MarkerStream ();
+
+      /// \brief Number of markers of each frame.
+      index_t nMarkers () const;
+
+      /// \brief Wait for the next frame.
+      ///
+      /// \param[out] frame read frame
+      /// \param[in] latest skip the frames already received but the
+      ///            last one (to keep the latency low when the
+      ///            frames are processed slower than they arrive)
+      /// \return false if the stream ended
+      bool read (MarkerStreamFrame& frame, bool latest = false);
+
+    private:
+      /// \brief Extract one line from the buffer.
+      bool popLine (std::string& line);
+
+      /// \brief Wait for data and append it to the buffer.
+      ///
+      /// \param timeout maximum waiting time in milliseconds
+      ///        (0 does not wait, -1 waits until the idle timeout)
+      /// \return true if data has been appended
+      bool fill (int timeout);
+
+      /// \brief Parse a line.
+      ///
+      /// \return false if the line does not contain a frame
+      bool parse (const std::string& line, MarkerStreamFrame& frame) const;
+
+      /// \brief File descriptor.
+      int fd_;
+      /// \brief Should the file descriptor be closed?
+      bool ownsFd_;
+      /// \brief Follow a regular file when its end is reached.
+      bool follow_;
+      /// \brief Did the stream end?
+      bool ended_;
+
+      /// \brief Number of markers.
+      index_t nMarkers_;
+      /// \brief Positions scale.
+      double scale_;
+      /// \brief Idle timeout (seconds).
+      double idleTimeout_;
+
+      /// \brief Data received but not parsed yet.
+      std::string buffer_;
+      /// \brief Reception time of the last data.
+      boost::posix_time::ptime received_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_IO_MARKER_STREAM_HH
@@ -0,0 +1,110 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_JACOBIAN_HH
+# define ROBOPTIM_RETARGETING_JACOBIAN_HH
+# include <vector>
+
+# include <Eigen/Core>
+# include <Eigen/SparseCore>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Copy a dense matrix (or vector) into a dense
+    ///        jacobian (or gradient).
+    ///
+    /// Functions computing their derivatives in dense buffers use
+    /// this helper (and its sparse overload) to fill the jacobian
+    /// type of their traits.
+    template <typename Derived, typename OtherDerived>
+    void
+    assignDense (Eigen::MatrixBase<Derived>& dst,
+		 const Eigen::MatrixBase<OtherDerived>& src)
+    {
+      dst = src;
+    }
+
+    /// \brief Copy a dense matrix (or vector) into a sparse
+    ///        jacobian (or gradient).
+    ///
+    /// Every coefficient is stored, even the zero ones: the sparsity
+    /// pattern only depends on the size of src, not on its values
+    /// (solvers fix the pattern at the first evaluation).
+    template <typename Derived, typename OtherDerived>
+    void
+    assignDense (Eigen::SparseMatrixBase<Derived>& dst,
+		 const Eigen::MatrixBase<OtherDerived>& src)
+    {
+      Derived& d = dst.derived ();
+      d.resize (src.rows (), src.cols ());
+      d.reserve (src.size ());
+      for (typename Derived::Index j = 0; j < src.cols (); ++j)
+	for (typename Derived::Index i = 0; i < src.rows (); ++i)
+	  d.insert (i, j) = src (i, j);
+    }
+
+    /// \brief Copy a dense jacobian (or gradient) into a dense
+    ///        buffer.
+    template <typename Derived, typename OtherDerived>
+    void
+    copyToDense (Eigen::MatrixBase<Derived>& dst,
+		 const Eigen::MatrixBase<OtherDerived>& src)
+    {
+      dst = src;
+    }
+
+    /// \brief Copy a sparse jacobian (or gradient) into a dense
+    ///        buffer.
+    template <typename Derived, typename OtherDerived>
+    void
+    copyToDense (Eigen::MatrixBase<Derived>& dst,
+		 const Eigen::SparseMatrixBase<OtherDerived>& src)
+    {
+      dst = src.toDense ();
+    }
+
+    /// \brief Fill a dense jacobian from a list of non-zero
+    ///        coefficients.
+    ///
+    /// The jacobian must already have its final size. Duplicated
+    /// coefficients are summed.
+    template <typename Derived, typename Scalar>
+    void
+    assignTriplets (Eigen::MatrixBase<Derived>& dst,
+		    const std::vector<Eigen::Triplet<Scalar> >& triplets)
+    {
+      dst.setZero ();
+      typename std::vector<Eigen::Triplet<Scalar> >::const_iterator it;
+      for (it = triplets.begin (); it != triplets.end (); ++it)
+	dst.derived ().coeffRef (it->row (), it->col ()) += it->value ();
+    }
+
+    /// \brief Fill a sparse jacobian from a list of non-zero
+    ///        coefficients.
+    template <typename Derived, typename Scalar>
+    void
+    assignTriplets (Eigen::SparseMatrixBase<Derived>& dst,
+		    const std::vector<Eigen::Triplet<Scalar> >& triplets)
+    {
+      dst.derived ().setFromTriplets (triplets.begin (), triplets.end ());
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_JACOBIAN_HH
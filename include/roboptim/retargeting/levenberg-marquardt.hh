@@ -0,0 +1,303 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_LEVENBERG_MARQUARDT_HH
+# define ROBOPTIM_RETARGETING_LEVENBERG_MARQUARDT_HH
+# include <algorithm>
+# include <stdexcept>
+# include <vector>
+
+# include <boost/format.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <Eigen/Cholesky>
+
+# include <roboptim/core/differentiable-function.hh>
+
+# include <roboptim/retargeting/utility.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (LevenbergMarquardt);
+
+    /// \brief Box-constrained Levenberg-Marquardt least-squares
+    ///        solver.
+    ///
+    /// Minimize 1/2 ||f (x) - target||^2 subject to
+    /// lower <= x <= upper.
+    ///
+    /// Each iteration solves the damped normal equations
+    ///
+    /// (J^T J + lambda diag (J^T J)) dx = -J^T r
+    ///
+    /// restricted to the free variables (a variable lying on a bound
+    /// while the gradient pushes it outside is fixed), then projects
+    /// x + dx onto the box. The step is accepted if it decreases the
+    /// cost, otherwise the damping lambda is increased.
+    ///
+    /// This is meant for the small dense problems solved once per
+    /// frame by the markers-to-joints conversion (f being
+    /// JointToMarkerPositionChoreonoid): the target can be changed
+    /// between two solves and no NLP has to be set up.
+    class LevenbergMarquardt
+    {
+    public:
+      typedef DifferentiableFunction function_t;
+      typedef boost::shared_ptr<function_t> functionShPtr_t;
+      typedef Function::value_type value_type;
+      typedef Function::vector_t vector_t;
+      typedef Function::matrix_t matrix_t;
+      typedef vector_t::Index index_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param f residual function
+      /// \param lower variables lower bounds (may be infinite)
+      /// \param upper variables upper bounds (may be infinite)
+      LevenbergMarquardt (functionShPtr_t f,
+			  const vector_t& lower,
+			  const vector_t& upper)
+	: f_ (f),
+	  lower_ (lower),
+	  upper_ (upper),
+	  target_ (vector_t::Zero (safeGet (f).outputSize ())),
+	  maxIterations_ (100),
+	  tolerance_ (1e-8),
+	  damping_ (1e-3),
+	  iterations_ (0),
+	  cost_ (0.),
+	  r_ (f->outputSize ()),
+	  rNew_ (f->outputSize ()),
+	  J_ (f->outputSize (), f->inputSize ()),
+	  g_ (f->inputSize ()),
+	  xNew_ (f->inputSize ()),
+	  free_ (),
+	  Jfree_ (),
+	  H_ (),
+	  A_ (),
+	  gFree_ (),
+	  dx_ (),
+	  ldlt_ ()
+      {
+	if (lower.size () != f->inputSize ()
+	    || upper.size () != f->inputSize ())
+	  {
+	    boost::format fmt
+	      ("invalid bounds size (%d and %d, %d expected)");
+	    fmt % lower.size () % upper.size () % f->inputSize ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	if ((lower.array () > upper.array ()).any ())
+	  throw std::runtime_error
+	    ("lower bounds must be smaller than upper bounds");
+	free_.reserve (static_cast<std::size_t> (f->inputSize ()));
+      }
+
+      ~LevenbergMarquardt ()
+      {}
+
+      /// \brief Target of the residual function.
+      vector_t& target ()
+      {
+	return target_;
+      }
+
+      /// \brief Target of the residual function.
+      const vector_t& target () const
+      {
+	return target_;
+      }
+
+      /// \brief Maximum number of iterations (jacobian evaluations).
+      void setMaxIterations (int maxIterations)
+      {
+	maxIterations_ = maxIterations;
+      }
+
+      /// \brief Relative tolerance on the step and the cost decrease.
+      void setTolerance (value_type tolerance)
+      {
+	tolerance_ = tolerance;
+      }
+
+      /// \brief Initial damping.
+      void setDamping (value_type damping)
+      {
+	damping_ = damping;
+      }
+
+      /// \brief Number of iterations of the last solve.
+      int iterations () const
+      {
+	return iterations_;
+      }
+
+      /// \brief Cost (1/2 ||f (x) - target||^2) at the last solution.
+      value_type cost () const
+      {
+	return cost_;
+      }
+
+      /// \brief Minimize the cost.
+      ///
+      /// \param[in,out] x starting point (projected onto the bounds),
+      ///                then solution
+      /// \return true if the solver converged, false if the
+      ///         iterations limit has been reached (x is then the best
+      ///         point found)
+      bool solve (vector_t& x)
+      {
+	if (x.size () != f_->inputSize ())
+	  {
+	    boost::format fmt
+	      ("invalid starting point size (%d, %d expected)");
+	    fmt % x.size () % f_->inputSize ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+
+	project (x);
+	cost_ = residual (r_, x);
+
+	value_type lambda = damping_;
+	for (iterations_ = 0; iterations_ < maxIterations_;)
+	  {
+	    ++iterations_;
+
+	    f_->jacobian (J_, x);
+	    g_.noalias () = J_.transpose () * r_;
+
+	    // Fix the variables stuck on their bounds.
+	    free_.clear ();
+	    for (index_t i = 0; i < x.size (); ++i)
+	      if (!((x[i] <= lower_[i] && g_[i] > 0.)
+		    || (x[i] >= upper_[i] && g_[i] < 0.)))
+		free_.push_back (i);
+	    if (free_.empty ())
+	      return true;
+
+	    const index_t nFree = static_cast<index_t> (free_.size ());
+	    Jfree_.resize (J_.rows (), nFree);
+	    gFree_.resize (nFree);
+	    for (index_t k = 0; k < nFree; ++k)
+	      {
+		Jfree_.col (k) = J_.col (free_[static_cast<std::size_t> (k)]);
+		gFree_[k] = g_[free_[static_cast<std::size_t> (k)]];
+	      }
+	    if (gFree_.lpNorm<Eigen::Infinity> () == 0.)
+	      return true;
+	    H_.noalias () = Jfree_.transpose () * Jfree_;
+
+	    // Increase the damping until the cost decreases.
+	    while (true)
+	      {
+		A_ = H_;
+		for (index_t k = 0; k < nFree; ++k)
+		  A_ (k, k) += lambda * std::max (H_ (k, k), 1e-9);
+		ldlt_.compute (A_);
+		dx_ = ldlt_.solve (gFree_);
+		dx_ = -dx_;
+
+		xNew_ = x;
+		for (index_t k = 0; k < nFree; ++k)
+		  xNew_[free_[static_cast<std::size_t> (k)]] += dx_[k];
+		project (xNew_);
+
+		value_type costNew = residual (rNew_, xNew_);
+		if (costNew < cost_)
+		  {
+		    const value_type step =
+		      (xNew_ - x).lpNorm<Eigen::Infinity> ();
+		    const value_type decrease = cost_ - costNew;
+
+		    x = xNew_;
+		    r_.swap (rNew_);
+		    cost_ = costNew;
+		    lambda = std::max (lambda / 3., 1e-12);
+
+		    if (step <= tolerance_ * (1. + x.lpNorm<Eigen::Infinity> ())
+			|| decrease <= tolerance_ * (cost_ + decrease))
+		      return true;
+		    break;
+		  }
+
+		// No decrease, even for tiny steps: local minimum.
+		lambda *= 4.;
+		if (lambda > 1e12)
+		  return true;
+	      }
+	  }
+	return false;
+      }
+
+    private:
+      /// \brief Project a point onto the bounds.
+      void project (vector_t& x) const
+      {
+	x = x.cwiseMax (lower_).cwiseMin (upper_);
+      }
+
+      /// \brief Compute the residual and return the cost.
+      value_type residual (vector_t& r, const vector_t& x) const
+      {
+	(*f_) (r, x);
+	r -= target_;
+	return .5 * r.squaredNorm ();
+      }
+
+      /// \brief Residual function.
+      functionShPtr_t f_;
+      /// \brief Lower bounds.
+      vector_t lower_;
+      /// \brief Upper bounds.
+      vector_t upper_;
+      /// \brief Residual function target.
+      vector_t target_;
+
+      /// \brief Maximum number of iterations.
+      int maxIterations_;
+      /// \brief Relative tolerance.
+      value_type tolerance_;
+      /// \brief Initial damping.
+      value_type damping_;
+
+      /// \brief Number of iterations of the last solve.
+      int iterations_;
+      /// \brief Cost of the last solution.
+      value_type cost_;
+
+      /// \name Buffers.
+      /// \{
+      vector_t r_;
+      vector_t rNew_;
+      matrix_t J_;
+      vector_t g_;
+      vector_t xNew_;
+      std::vector<index_t> free_;
+      matrix_t Jfree_;
+      matrix_t H_;
+      matrix_t A_;
+      vector_t gFree_;
+      vector_t dx_;
+      Eigen::LDLT<matrix_t> ldlt_;
+      /// \}
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_LEVENBERG_MARQUARDT_HH
@@ -0,0 +1,280 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_PARALLEL_FINITE_DIFFERENCE_HH
+# define ROBOPTIM_RETARGETING_PARALLEL_FINITE_DIFFERENCE_HH
+# include <algorithm>
+# include <stdexcept>
+# include <vector>
+
+# include <boost/bind.hpp>
+# include <boost/ref.hpp>
+# include <boost/format.hpp>
+
+# include <roboptim/core/function.hh>
+
+# include <roboptim/retargeting/jacobian.hh>
+# include <roboptim/retargeting/worker-pool.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Finite differences computed by the workers of the
+    ///        shared worker pool.
+    ///
+    /// The jacobian columns are distributed among the workers: each
+    /// worker perturbs its own copy of the argument and evaluates
+    /// the function. The function must therefore support concurrent
+    /// evaluations from up to nWorkers threads (see
+    /// EvaluationContextPool). If the shared pool is larger than
+    /// nWorkers, the columns are computed sequentially.
+    ///
+    /// The last jacobian computed by each worker is kept so that
+    /// computing the gradients of all the rows at the same point
+    /// only costs one jacobian evaluation.
+    ///
+    /// \tparam T Function traits type
+    template <typename T>
+    class ParallelFiniteDifference
+    {
+    public:
+      typedef GenericFunction<T> function_t;
+      typedef typename function_t::value_type value_type;
+      typedef typename function_t::size_type size_type;
+      typedef typename function_t::vector_t vector_t;
+      typedef typename function_t::argument_t argument_t;
+      typedef Eigen::Matrix<value_type, Eigen::Dynamic, Eigen::Dynamic>
+      denseJacobian_t;
+
+      /// \brief Finite difference rule.
+      enum Rule
+	{
+	  /// \brief (f(x + h) - f(x)) / h, one evaluation per column.
+	  RULE_SIMPLE,
+	  /// \brief (f(x + h) - f(x - h)) / 2h, two evaluations per
+	  ///        column.
+	  RULE_CENTRAL,
+	  /// \brief Five-point stencil, four evaluations per column.
+	  RULE_FIVE_POINTS
+	};
+
+      /// \brief Constructor.
+      ///
+      /// \param f function to differentiate (must outlive this object)
+      /// \param nWorkers number of threads which can evaluate f
+      ///        concurrently
+      /// \param rule finite difference rule
+      /// \param epsilon perturbation
+      ParallelFiniteDifference (const function_t& f,
+				std::size_t nWorkers,
+				Rule rule = RULE_SIMPLE,
+				value_type epsilon = 1e-8)
+	: f_ (f),
+	  rule_ (rule),
+	  epsilon_ (epsilon),
+	  workspaces_ (std::max<std::size_t> (nWorkers, 1))
+      {
+	for (std::size_t id = 0; id < workspaces_.size (); ++id)
+	  {
+	    Workspace& w = workspaces_[id];
+	    w.x.resize (f.inputSize ());
+	    w.fx.resize (f.outputSize ());
+	    w.f0.resize (f.outputSize ());
+	    w.f1.resize (f.outputSize ());
+	    w.f2.resize (f.outputSize ());
+	    w.f3.resize (f.outputSize ());
+	    w.lastX.resize (f.inputSize ());
+	    w.lastJacobian.resize (f.outputSize (), f.inputSize ());
+	    w.valid = false;
+	  }
+      }
+
+      Rule rule () const
+      {
+	return rule_;
+      }
+
+      value_type epsilon () const
+      {
+	return epsilon_;
+      }
+
+      void setRule (Rule rule, value_type epsilon)
+      {
+	rule_ = rule;
+	epsilon_ = epsilon;
+	invalidate ();
+      }
+
+      /// \brief Forget the jacobians kept by the workers.
+      ///
+      /// Must be called if the function changes without its
+      /// argument changing.
+      void invalidate () const
+      {
+	for (std::size_t id = 0; id < workspaces_.size (); ++id)
+	  workspaces_[id].valid = false;
+      }
+
+      /// \brief Compute the whole jacobian.
+      ///
+      /// \param jacobian dense or sparse jacobian
+      /// \param x point where the jacobian is computed
+      template <typename J>
+      void jacobian (J& jacobian, const argument_t& x) const
+      {
+	assignDense (jacobian, denseJacobian (x));
+      }
+
+      /// \brief Compute one row of the jacobian.
+      ///
+      /// \param gradient dense or sparse gradient
+      /// \param x point where the gradient is computed
+      /// \param functionId row to be computed
+      template <typename G>
+      void gradient (G& gradient, const argument_t& x,
+		     size_type functionId) const
+      {
+	assignDense
+	  (gradient, denseJacobian (x).row (functionId).transpose ());
+      }
+
+      /// \brief Compute the dense jacobian.
+      ///
+      /// The returned reference is valid until the next call from
+      /// the same thread.
+      const denseJacobian_t& denseJacobian (const argument_t& x) const
+      {
+	Workspace& w = localWorkspace ();
+	if (w.valid && w.lastX == x)
+	  return w.lastJacobian;
+
+	w.valid = false;
+	w.lastX = x;
+	if (rule_ == RULE_SIMPLE)
+	  f_ (w.fx, x);
+
+	const std::size_t nColumns = static_cast<std::size_t> (x.size ());
+	WorkerPool& pool = WorkerPool::shared ();
+	if (pool.size () > 1 && pool.size () <= workspaces_.size ())
+	  pool.run (nColumns, boost::bind
+		    (&ParallelFiniteDifference<T>::computeColumn, this, _1,
+		     boost::cref (x), boost::cref (w.fx),
+		     boost::ref (w.lastJacobian)));
+	else
+	  for (std::size_t column = 0; column < nColumns; ++column)
+	    computeColumn (column, x, w.fx, w.lastJacobian);
+
+	w.valid = true;
+	return w.lastJacobian;
+      }
+
+    private:
+      /// \brief Buffers used by one worker.
+      struct Workspace
+      {
+	/// \brief Perturbed argument.
+	vector_t x;
+	/// \brief Function value at the unperturbed point.
+	vector_t fx;
+	/// \brief Function values at the perturbed points.
+	vector_t f0, f1, f2, f3;
+	/// \brief Argument used for the last jacobian.
+	vector_t lastX;
+	/// \brief Last jacobian computed by this worker.
+	denseJacobian_t lastJacobian;
+	/// \brief Is the last jacobian valid?
+	bool valid;
+      };
+
+      Workspace& localWorkspace () const
+      {
+	std::size_t id = WorkerPool::workerId ();
+	if (id >= workspaces_.size ())
+	  {
+	    boost::format fmt
+	      ("no finite difference workspace for worker %d"
+	       " (%d workspaces have been allocated)");
+	    fmt % id % workspaces_.size ();
+	    throw std::runtime_error (fmt.str ());
+	  }
+	return workspaces_[id];
+      }
+
+      /// \brief Compute one column of the jacobian.
+      ///
+      /// \param column column index
+      /// \param x unperturbed argument
+      /// \param fx f (x), only used by the simple rule
+      /// \param result jacobian being computed
+      void computeColumn (std::size_t column,
+			  const argument_t& x,
+			  const vector_t& fx,
+			  denseJacobian_t& result) const
+      {
+	Workspace& w = localWorkspace ();
+	typename vector_t::Index j =
+	  static_cast<typename vector_t::Index> (column);
+	const value_type h = epsilon_;
+
+	w.x = x;
+	switch (rule_)
+	  {
+	  case RULE_SIMPLE:
+	    w.x[j] += h;
+	    f_ (w.f1, w.x);
+	    result.col (j) = (w.f1 - fx) / h;
+	    break;
+
+	  case RULE_CENTRAL:
+	    w.x[j] += h;
+	    f_ (w.f1, w.x);
+	    w.x[j] -= 2 * h;
+	    f_ (w.f0, w.x);
+	    result.col (j) = (w.f1 - w.f0) / (2 * h);
+	    break;
+
+	  case RULE_FIVE_POINTS:
+	    w.x[j] += 2 * h;
+	    f_ (w.f3, w.x);
+	    w.x[j] -= h;
+	    f_ (w.f2, w.x);
+	    w.x[j] -= 2 * h;
+	    f_ (w.f1, w.x);
+	    w.x[j] -= h;
+	    f_ (w.f0, w.x);
+	    result.col (j) =
+	      (w.f0 - 8 * w.f1 + 8 * w.f2 - w.f3) / (12 * h);
+	    break;
+	  }
+      }
+
+      /// \brief Differentiated function.
+      const function_t& f_;
+      /// \brief Finite difference rule.
+      Rule rule_;
+      /// \brief Perturbation.
+      value_type epsilon_;
+
+      /// \brief Buffers, indexed by worker id.
+      mutable std::vector<Workspace> workspaces_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_PARALLEL_FINITE_DIFFERENCE_HH
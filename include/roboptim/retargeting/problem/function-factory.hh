@@ -49,10 +49,13 @@ namespace roboptim
 	  CONSTRAINT_TYPE_ONCE = 0,
 
 	  /// \brief This constraint must be repeated for each frame
-	  /// excluding the first and last one.
+	  /// (excluding the first and last one if the state function
+	  /// order is not zero).
 	  ///
 	  /// This constraint function input size must be equal to the
-	  /// whole filtered trajectory parameters vector size.
+	  /// state size, i.e. (stateFunctionOrder + 1) times the
+	  /// configuration size. Builders evaluate it on all the frames
+	  /// at once using StackedStateFunction.
 	  CONSTRAINT_TYPE_PER_FRAME
 	};
 
@@ -68,7 +71,7 @@ namespace roboptim
       /// If the constraint is a "one time" constraint then it will be
       /// added in the problem as it is. If this is a per-frame
       /// constraint, it will be added for each frame of the problem
-      /// (excluding the first and last one).
+      /// (see CONSTRAINT_TYPE_PER_FRAME).
       ConstraintType type;
 
       /// \brief Which derivative order is required by this constraint?
@@ -80,7 +83,7 @@ namespace roboptim
       /// 2 means q, dq, ddq
       /// etc.
       ///
-      /// See roboptim-trajectory StateFunction for more information.
+      /// See StackedStateFunction for more information.
       ///
       /// \note This attribute is ignored if the constraint type is
       ///       set to CONSTRAINT_TYPE_ONCE.
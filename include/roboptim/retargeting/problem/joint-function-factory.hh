@@ -24,7 +24,12 @@
 
 # include <roboptim/trajectory/trajectory.hh>
 
+# include <roboptim/retargeting/centroidal-trajectory.hh>
 # include <roboptim/retargeting/marker-mapping.hh>
+# include <roboptim/retargeting/evaluation-context.hh>
+# include <roboptim/retargeting/function/linear-trajectory-parametrization.hh>
+# include <roboptim/retargeting/function/proximal-cost.hh>
+# include <roboptim/retargeting/function/reduced-coordinates.hh>
 # include <roboptim/retargeting/interaction-mesh.hh>
 # include <roboptim/retargeting/morphing.hh>
 # include <roboptim/retargeting/problem/function-factory.hh>
@@ -56,6 +61,22 @@ namespace roboptim
       /// velocities limits, etc.
       cnoid::BodyPtr robotModel;
 
+      /// \brief Evaluation contexts shared by all the robot-based
+      ///        functions
+      ///
+      /// One robot (and forward kinematics cache) per worker
+      /// thread. Functions built from the same data share these
+      /// contexts and therefore do not recompute the forward
+      /// kinematics when they are evaluated at the same
+      /// configuration.
+      EvaluationContextPoolShPtr evaluationContexts;
+
+      /// \brief Centroidal quantities of the whole trajectory
+      ///
+      /// Computed once per trajectory parameters change and shared
+      /// by the trajectory-level constraints (ZMP).
+      CentroidalTrajectoryShPtr centroidalTrajectory;
+
       /// \brief Morphing data
       ///
       /// Map robot bodies to markers (optionally with an offset)
@@ -71,26 +92,58 @@ namespace roboptim
       TrajectoryShPtr trajectory;
 
 
+      /// \brief Time between two frames of the optimized trajectory
+      ///
+      /// Frame period of the joints trajectory times the resampling
+      /// and decimation factors (see JointProblemOptions).
+      Function::value_type dt;
+
+      /// \brief Weights of the smoothness costs (acceleration, jerk)
+      ///
+      /// One weight per DOF of the reduced configuration, the
+      /// global scale included (see JointProblemOptions).
+      Function::vector_t smoothnessWeights;
+
+      /// \brief Number of frames of the trimmed joints trajectory
+      ///
+      /// I.e. before resampling: the solution is upsampled back to
+      /// this number of frames.
+      Function::vector_t::Index nInputFrames;
+
       /// \brief Reduced RobOptim trajectory
       ///
       /// This trajectory contained the reduce motion.
       /// I.e. this does not include the disabled joints.
       TrajectoryShPtr filteredTrajectory;
 
+      /// \brief Parametrization of the reduced trajectory
+      ///
+      /// Maps the optimization variables (spline control points,
+      /// minimum jerk knots states) to the reduced trajectory
+      /// parameters. Null for discrete trajectories: the
+      /// optimization variables are then the reduced trajectory
+      /// parameters themselves.
+      boost::shared_ptr<LinearTrajectoryParametrization<EigenMatrixDense> >
+      parametrization;
+
       /// \brief Interaction Mesh (loaded by Choreonoid)
       InteractionMeshShPtr interactionMesh;
 
       /// \brief Configuration of the disabled joints (one frame)
       ///
-      ///
+      /// Functions of the full trajectory are evaluated on the
+      /// reduced one through ReducedCoordinates, which repeats this
+      /// configuration for each frame.
       std::vector<boost::optional<Function::value_type> >
       disabledJointsConfiguration;
 
-      /// \brief Configuration of the disabled joints (all frames)
+      /// \brief Proximal term added to the cost function
       ///
-      ///
-      std::vector<boost::optional<Function::value_type> >
-      disabledJointsTrajectory;
+      /// Null by default. When solving the motion by overlapping
+      /// segments (see TemporalConsensus), it pulls the segment
+      /// shared frames toward their consensus value. Its size is the
+      /// number of optimization variables.
+      ProximalTermShPtr proximalTerm;
 
       /// \brief Shared pointer to cost function.
       ///
@@ -99,6 +152,10 @@ namespace roboptim
       /// pointer manually to dellocating it.
       boost::shared_ptr<DifferentiableFunction> cost;
 
+      /// \brief Shared pointer to cost function (sparse problems).
+      boost::shared_ptr<GenericDifferentiableFunction<EigenMatrixSparse> >
+      sparseCost;
+
 
       Function::vector_t::Index nDofsFull () const
       {
@@ -176,10 +233,20 @@ namespace roboptim
       template <typename T>
       Constraint<T> buildConstraint (const std::string& name);
 
+      /// \brief Joints limits of the optimization variables.
+      ///
+      /// The joints-limits constraint is not a function: the builders
+      /// pass these intervals to the solver as the problem argument
+      /// bounds. The free-floating DOFs are not bounded.
+      ///
+      /// \return one interval per DOF of the reduced robot configuration (one frame)
+      Function::intervals_t jointsLimits () const;
+
       /// \brief List supported functions.
       ///
       /// Each element of this string can be passed to buildFunction
-      /// method to create the corresponding function.
+      /// method to create the corresponding function, except
+      /// joints-limits (see jointsLimits).
       static std::vector<std::string>
       listFunctions ();
     private:
@@ -19,13 +19,12 @@
 # define  ROBOPTIM_RETARGETING_JOINT_FUNCTION_FACTORY_HXX
 # include <stdexcept>
 
-# include <roboptim/core/numeric-linear-function.hh>
-# include <roboptim/core/filter/bind.hh>
-
+# include <roboptim/retargeting/function/acceleration.hh>
 # include <roboptim/retargeting/function/body-laplacian-deformation-energy/choreonoid.hh>
 # include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
+# include <roboptim/retargeting/function/selector.hh>
 # include <roboptim/retargeting/function/torque/choreonoid.hh>
-# include <roboptim/retargeting/function/zmp/choreonoid.hh>
+# include <roboptim/retargeting/function/zmp-trajectory/choreonoid.hh>
 
 namespace roboptim
 {
@@ -45,68 +44,60 @@ namespace roboptim
 	    ("failed to create null function:"
 	     " empty parameters vector in joint trajectory");
 
-	typename T::matrix_t A
-	  (1, data.trajectory->parameters ().size ());
-	A.setZero ();
-	typename T::vector_t b (1);
-	b.setZero ();
-
-	return boost::make_shared<
-	  GenericNumericLinearFunction<typename T::traits_t> >
-	  (A, b);
+	return boost::make_shared<Zero<typename T::traits_t> >
+	  (data.trajectory->parameters ().size ());
       }
 
       template <typename T>
       boost::shared_ptr<T>
       freeze (const JointFunctionData& data)
       {
-	typename T::matrix_t A
-	  (data.nDofsFiltered (), data.nParametersFiltered ());
-	A.setZero ();
-	A.block
-	  (0, 0, data.nDofsFiltered (), data.nDofsFiltered ()).setIdentity ();
-
-	// extract configuration from first frame
-	typename T::vector_t b (data.nDofsFiltered ());
-	b = data.filteredTrajectory->parameters ().segment (0, data.nDofsFiltered ());
-	b *= -1;
-
-	return boost::make_shared<
-	  GenericNumericLinearFunction<typename T::traits_t> >
-	  (A, b);
+	// select the configuration of the first frame
+	return boost::make_shared<Selector<typename T::traits_t> >
+	  (data.nParametersFiltered (), 0, data.nDofsFiltered ());
       }
 
       template <typename T>
       boost::shared_ptr<T>
-      leftFoot (const JointFunctionData& data)
+      squaredFiniteDifference (const JointFunctionData& data,
+			       Function::vector_t::Index order)
       {
+	// smoothness of the enabled DOFs
 	return
-	  boost::make_shared<ForwardGeometryChoreonoid<typename T::traits_t> >
-	  (data.robotModel, "L_ANKLE_R");
+	  boost::make_shared<SquaredAcceleration<typename T::traits_t> >
+	  (data.nFrames (), data.smoothnessWeights, data.dt, order);
       }
 
       template <typename T>
       boost::shared_ptr<T>
-      rightFoot (const JointFunctionData& data)
+      acceleration (const JointFunctionData& data)
+      {
+	return squaredFiniteDifference<T> (data, 2);
+      }
+
+      template <typename T>
+      boost::shared_ptr<T>
+      jerk (const JointFunctionData& data)
+      {
+	return squaredFiniteDifference<T> (data, 3);
+      }
+
+      template <typename T>
+      boost::shared_ptr<T>
+      leftFoot (const JointFunctionData& data)
       {
 	return
 	  boost::make_shared<ForwardGeometryChoreonoid<typename T::traits_t> >
-	  (data.robotModel, "R_ANKLE_R");
+	  (data.evaluationContexts, "L_ANKLE_R");
       }
 
       template <typename T>
       boost::shared_ptr<T>
-      jointsLimits (const JointFunctionData& data)
+      rightFoot (const JointFunctionData& data)
       {
-	typename T::matrix_t A
-	  (data.nDofsFiltered () * 2, data.nDofsFiltered () * 2);
-	A.setIdentity ();
-	typename T::vector_t b (data.nDofsFiltered () * 2);
-	b.setZero ();
 	return
-	  boost::make_shared<
-	    GenericNumericLinearFunction<typename T::traits_t> >
-	  (A, b);
+	  boost::make_shared<ForwardGeometryChoreonoid<typename T::traits_t> >
+	  (data.evaluationContexts, "R_ANKLE_R");
       }
 
       template <typename T>
@@ -121,7 +112,7 @@ namespace roboptim
 	boost::shared_ptr<jointToMarker_t>
           jointToMarker =
           boost::make_shared<jointToMarker_t>
-	  (data.robotModel, data.morphing);
+	  (data.evaluationContexts, data.morphing);
 
 	// create the cost function using the full trajectory
 	boost::shared_ptr<T> cost =
@@ -132,10 +123,8 @@ namespace roboptim
 	   data.trajectory,
 	  jointToMarker);
 
-        // bind the joints that must not be taken into account
-	cost = bind (cost, data.disabledJointsTrajectory);
-
-        return cost;
+	// evaluate the cost on the enabled joints only
+	return reduceCoordinates (cost, data.disabledJointsConfiguration);
       }
 
       //FIXME: torque requires a select-by-id filter before being
@@ -147,16 +136,22 @@ namespace roboptim
 	throw std::runtime_error ("not supported yet");
 	return
 	  boost::make_shared<TorqueChoreonoid<typename T::traits_t> >
-	  (data.robotModel);
+	  (data.evaluationContexts);
       }
 
       template <typename T>
       boost::shared_ptr<T>
       zmp (const JointFunctionData& data)
       {
-	return
-	  boost::make_shared<ZMPChoreonoid<typename T::traits_t> >
-	  (data.robotModel);
+	// ZMP of all the frames (except the first and last ones),
+	// computed from the centroidal quantities of the whole
+	// trajectory.
+	boost::shared_ptr<T> zmp =
+	  boost::make_shared<ZMPTrajectoryChoreonoid<typename T::traits_t> >
+	  (data.centroidalTrajectory);
+
+	// evaluate the constraint on the enabled joints only
+	return reduceCoordinates (zmp, data.disabledJointsConfiguration);
       }
 
       /// \brief Map function name to the function used to allocate
@@ -180,11 +175,12 @@ namespace roboptim
       const typename JointFunctionFactoryMapping<T>::Mapping
       JointFunctionFactoryMapping<T>::map[] = {
 	{"null", &null<T>},
+	{"acceleration", &acceleration<T>},
 	{"freeze", &freeze<T>},
+	{"jerk", &jerk<T>},
 	{"lde", &laplacianDeformationEnergy<T>},
 	{"left-foot", &leftFoot},
 	{"right-foot", &rightFoot},
-	{"joint-limits", &jointsLimits},
 	{"torque", &torque},
 	{"zmp", &zmp},
 	{0, 0}
@@ -219,6 +215,11 @@ namespace roboptim
     Constraint<T>
     JointFunctionFactory::buildConstraint (const std::string& name)
     {
+      if (name == "joints-limits")
+	throw std::runtime_error
+	  ("joints limits are not a constraint function,"
+	   " use jointsLimits to bound the problem arguments");
+
       Constraint<T> constraint;
       constraint.function = this->buildFunction<T> (name);
 
@@ -233,9 +234,14 @@ namespace roboptim
 
       if (name == "freeze")
 	{
-	  std::fill (constraint.intervals.begin (),
-		     constraint.intervals.end (),
-		     Function::makeInterval (0., 0.));
+	  // keep the configuration of the first frame
+	  for (std::size_t i = 0; i < constraint.intervals.size (); ++i)
+	    {
+	      Function::value_type value =
+		data_.filteredTrajectory->parameters ()
+		[static_cast<Function::vector_t::Index> (i)];
+	      constraint.intervals[i] = Function::makeInterval (value, value);
+	    }
 	}
       else if (name == "left-foot" || name == "right-foot")
 	{
@@ -250,40 +256,6 @@ namespace roboptim
 	  constraint.type = Constraint<T>::CONSTRAINT_TYPE_PER_FRAME;
 	  constraint.stateFunctionOrder = 0;
 	}
-      else if (name == "joints-limits")
-	{
-	  std::size_t id = 0;
-	  for (std::size_t jointId = 0;
-	       jointId < static_cast<std::size_t> (data_.nDofsFull ()); ++jointId)
-	    {
-	      if (data_.disabledJointsConfiguration[jointId])
-		{
-		  int jointId_ = static_cast<int> (jointId);
-		  if (jointId < 6)
-		    constraint.intervals[id++] = Function::makeInfiniteInterval ();
-		  else
-		    constraint.intervals[id++] = Function::makeInterval
-		      (data_.robotModel->joint (jointId_ - 6)->q_lower (),
-		       data_.robotModel->joint (jointId_ - 6)->q_upper ());
-		}
-	    }
-	  for (std::size_t jointId = 0;
-	       jointId < static_cast<std::size_t> (data_.nDofsFull ()); ++jointId)
-	    {
-	      if (data_.disabledJointsConfiguration[jointId])
-		{
-		  int jointId_ = static_cast<int> (jointId);
-		  if (jointId < 6)
-		    constraint.intervals[id++] = Function::makeInfiniteInterval ();
-		  else
-		    constraint.intervals[id++] = Function::makeInterval
-		      (data_.robotModel->joint (jointId_ - 6)->dq_lower (),
-		       data_.robotModel->joint (jointId_ - 6)->dq_upper ());
-		}
-	    }
-	    constraint.type = Constraint<T>::CONSTRAINT_TYPE_PER_FRAME;
-	    constraint.stateFunctionOrder = 1;
-	}
       else if (name == "torque")
 	{
 	  //FIXME: this should be loaded from the outside.
@@ -348,17 +320,20 @@ namespace roboptim
 	  Function::value_type soleLength = 0.2; //FIXME:
 	  Function::value_type soleWidth = 0.1; //FIXME:
 
-	  constraint.intervals[0] =
-	    Function::makeInterval
-	    (soleX - .5 * soleLength,
-	     soleX + .5 * soleLength);
-	  constraint.intervals[1] =
-	    Function::makeInterval
-	    (soleY - .5 * soleWidth,
-	     soleY + .5 * soleWidth);
+	  // One (x, y) pair per frame.
+	  for (std::size_t i = 0; i + 1 < constraint.intervals.size (); i += 2)
+	    {
+	      constraint.intervals[i] =
+		Function::makeInterval
+		(soleX - .5 * soleLength,
+		 soleX + .5 * soleLength);
+	      constraint.intervals[i + 1] =
+		Function::makeInterval
+		(soleY - .5 * soleWidth,
+		 soleY + .5 * soleWidth);
+	    }
 
-	  constraint.type = Constraint<T>::CONSTRAINT_TYPE_PER_FRAME;
-	  constraint.stateFunctionOrder = 2;
+	  constraint.type = Constraint<T>::CONSTRAINT_TYPE_ONCE;
 	}
       else
 	throw std::runtime_error ("unknown constraint");
@@ -366,6 +341,30 @@ namespace roboptim
       return constraint;
     }
 
+    inline Function::intervals_t
+    JointFunctionFactory::jointsLimits () const
+    {
+      Function::intervals_t bounds;
+      bounds.reserve (static_cast<std::size_t> (data_.nDofsFiltered ()));
+
+      for (std::size_t jointId = 0;
+	   jointId < static_cast<std::size_t> (data_.nDofsFull ()); ++jointId)
+	{
+	  if (data_.disabledJointsConfiguration[jointId])
+	    continue;
+
+	  int jointId_ = static_cast<int> (jointId);
+	  if (jointId < 6)
+	    bounds.push_back (Function::makeInfiniteInterval ());
+	  else
+	    bounds.push_back
+	      (Function::makeInterval
+	       (data_.robotModel->joint (jointId_ - 6)->q_lower (),
+		data_.robotModel->joint (jointId_ - 6)->q_upper ()));
+	}
+      return bounds;
+    }
+
     inline std::vector<std::string>
     JointFunctionFactory::listFunctions ()
     {
@@ -380,6 +379,7 @@ namespace roboptim
 	  functions.push_back (element->name);
 	  element++;
 	}
+      functions.push_back ("joints-limits");
       return functions;
     }
   } // end of namespace retargeting.
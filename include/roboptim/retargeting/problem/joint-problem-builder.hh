@@ -42,6 +42,84 @@ namespace roboptim
       /// -1 means all frames.
       int length;
 
+      /// \brief Input frames per optimized frame.
+      ///
+      /// The (trimmed) joints trajectory is low-pass filtered and
+      /// decimated by this factor before the problem is built, the
+      /// solution is upsampled back to the input frame rate. One
+      /// means no resampling.
+      int resampling;
+
+      /// \brief Temporal decimation of the optimized trajectory.
+      ///
+      /// One frame every decimation frames of the (trimmed and
+      /// resampled) joints trajectory is optimized. One means full
+      /// resolution.
+      int decimation;
+
+      /// \brief Number of temporal multigrid levels.
+      ///
+      /// The problem is first solved on a trajectory decimated by
+      /// decimationFactor^(levels - 1), each solution is then
+      /// interpolated to start the next finer level. The last level
+      /// is the full resolution. One means a single solve.
+      int levels;
+
+      /// \brief Decimation factor between two multigrid levels.
+      int decimationFactor;
+
+      /// \brief Number of frames of each window (receding horizon).
+      ///
+      /// The motion is solved one window after the other, the
+      /// windows overlapping by windowOverlap frames. Zero means the
+      /// whole motion is solved at once.
+      int window;
+
+      /// \brief Number of frames shared by two consecutive windows.
+      int windowOverlap;
+
+      /// \brief How the overlapping frames are handled.
+      ///
+      /// Possible options are:
+      /// - fix (the frames keep the previous window solution)
+      /// - blend (the frames start from the previous window solution,
+      ///   both solutions are then cross-faded)
+      std::string windowOverlapPolicy;
+
+      /// \brief Number of segments solved concurrently.
+      ///
+      /// The motion is split into segments overlapping by
+      /// segmentOverlap frames. The segments are solved in parallel
+      /// and their shared frames are brought to agreement by
+      /// consensus ADMM iterations (see TemporalConsensus). Zero or
+      /// one means the whole motion is solved at once.
+      int segments;
+
+      /// \brief Number of frames shared by two consecutive segments.
+      int segmentOverlap;
+
+      /// \brief ADMM penalty parameter (rho).
+      ///
+      /// Weight of the proximal term pulling the shared frames of
+      /// each segment toward their consensus value.
+      double admmPenalty;
+
+      /// \brief Maximum number of ADMM iterations.
+      int admmIterations;
+
+      /// \brief ADMM stopping criterion.
+      ///
+      /// The iterations stop once the primal residual (distance of
+      /// the shared frames to their consensus) is below this value.
+      double admmTolerance;
+
+      /// \brief Also solve the whole motion at once?
+      ///
+      /// If true, the monolithic problem is solved after the
+      /// segments to report the speed-up and the deviation of the
+      /// segmented solution.
+      bool compareMonolithic;
+
       /// \brief Joints trajectory.
       ///
       /// Joints trajectories which will be used as the initial input
@@ -55,10 +133,23 @@ namespace roboptim
       /// Possible options are:
       /// - discrete
       /// - spline
+      /// - minimum-jerk
+      ///
+      /// A spline trajectory is optimized through the control points
+      /// of a cubic B-spline sampled at each frame, a minimum-jerk
+      /// trajectory through the knots states of a piecewise minimum
+      /// jerk trajectory: the functions are still evaluated on the
+      /// discrete trajectory.
       ///
       /// See roboptim-trajectory documentation for details.
       std::string trajectoryType;
 
+      /// \brief Number of frames between two spline control points
+      ///        (or minimum jerk knots).
+      ///
+      /// Not used by discrete trajectories.
+      int controlPointsSpacing;
+
       /// \brief Robot model to be used.
       ///
       /// The robot model is used to determine the segment length.
@@ -74,9 +165,36 @@ namespace roboptim
       /// \brief Solver plug-in name.
       std::string plugin;
 
+      /// \brief Build and solve a sparse problem?
+      ///
+      /// If true, functions use sparse jacobians (sparseProblem_t)
+      /// so that the solver receives their sparsity pattern. The
+      /// solver plug-in must support sparse problems.
+      bool sparse;
+
+      /// \brief Number of worker threads.
+      ///
+      /// Sizes the shared worker pool, robot-based functions get one
+      /// evaluation context per worker.
+      int jobs;
+
       /// \brief Cost function name.
       std::string cost;
 
+      /// \brief Global weight of the smoothness costs (acceleration,
+      ///        jerk).
+      ///
+      /// The squared finite differences are divided by dt^(2n): at
+      /// high frame rates, this scale keeps them comparable to the
+      /// other terms.
+      double smoothnessScale;
+
+      /// \brief Per-DOF weights of the smoothness costs.
+      ///
+      /// NAME=WEIGHT entries, NAME being a joint name. The other
+      /// DOFs are weighted by one.
+      std::vector<std::string> smoothnessWeights;
+
       /// \brief Constraints functions names.
       std::vector<std::string> constraints;
 
@@ -26,13 +26,17 @@
 # include <cnoid/BodyMotion>
 
 # include <roboptim/core/problem.hh>
-# include <roboptim/core/filter/bind.hh>
+# include <roboptim/core/filter/chain.hh>
 
-# include <roboptim/trajectory/state-function.hh>
 # include <roboptim/trajectory/vector-interpolation.hh>
 
 # include <roboptim/retargeting/morphing.hh>
+# include <roboptim/retargeting/resampling.hh>
+# include <roboptim/retargeting/temporal-multigrid.hh>
 # include <roboptim/retargeting/function/choreonoid-body-trajectory.hh>
+# include <roboptim/retargeting/function/cubic-b-spline-parametrization.hh>
+# include <roboptim/retargeting/function/piecewise-minimum-jerk-parametrization.hh>
+# include <roboptim/retargeting/function/stacked-state-function.hh>
 
 # include <roboptim/retargeting/problem/joint-function-factory.hh>
 # include <roboptim/retargeting/utility.hh>
@@ -129,40 +133,76 @@ namespace roboptim
 
       index_t nDofsFull =
 	static_cast<index_t> (disabledJointsConfiguration.size ());
-
-      index_t nDofsReduced =
-	std::count (disabledJointsConfiguration.begin (),
-		    disabledJointsConfiguration.end (),
-		    boost::none_t ());
-      if (nDofsReduced < 1)
-	  throw std::runtime_error ("all DOFs have been disabled");
       index_t nFrames =
 	static_cast<index_t> (originalTrajectory->parameters ().size ())
 	/ nDofsFull;
-      index_t reducedTrajectoryParametersSize = nDofsReduced * nFrames;
-
-      Trajectory::vector_t
-	reducedTrajectoryParameters (reducedTrajectoryParametersSize);
-      reducedTrajectoryParameters.setZero ();
 
-      index_t idx = 0;
-      index_t idxOriginal = 0;
-      while (idx < reducedTrajectoryParametersSize &&
-	     idxOriginal < originalTrajectory->parameters ().size ())
-	{
-	  if (!disabledJointsConfiguration[static_cast<std::size_t> (idxOriginal % nDofsFull)])
-	    reducedTrajectoryParameters[idx++] = originalTrajectory->parameters ()[idxOriginal];
-	  idxOriginal++;
-	}
+      ReducedCoordinatesMap map (disabledJointsConfiguration, nFrames);
 
       TrajectoryShPtr reducedTrajectory =
 	boost::make_shared<VectorInterpolation>
-	(reducedTrajectoryParameters,
-	 nDofsReduced, static_cast<index_t> (originalTrajectory->length ()) / nDofsFull);
+	(map.reduce (originalTrajectory->parameters ()),
+	 map.reducedSize () / nFrames,
+	 static_cast<index_t> (originalTrajectory->length ()) / nDofsFull);
 
       return reducedTrajectory;
     }
 
+    /// \brief Weights of the smoothness costs (acceleration, jerk).
+    ///
+    /// \param[in] weights NAME=WEIGHT entries, NAME being a joint
+    ///            name (the other DOFs are weighted by one)
+    /// \param[in] scale global weight
+    /// \param[in] disabledJointsConfiguration configuration of the
+    ///            disabled joints
+    /// \param[in] robotModel robot model loaded by Choreonoid and
+    ///            providing the joint name to index mapping
+    /// \return one weight per DOF of the reduced configuration
+    Function::vector_t
+    smoothnessWeights (const std::vector<std::string>& weights,
+		       Function::value_type scale,
+		       const std::vector<boost::optional<Function::value_type> >&
+		       disabledJointsConfiguration,
+		       cnoid::BodyPtr robotModel)
+    {
+      typedef Function::vector_t::Index index_t;
+
+      // reduced index of each DOF of the full configuration
+      std::vector<index_t> reducedIds (disabledJointsConfiguration.size (), -1);
+      index_t nEnabled = 0;
+      for (std::size_t id = 0; id < disabledJointsConfiguration.size (); ++id)
+	if (!disabledJointsConfiguration[id])
+	  reducedIds[id] = nEnabled++;
+
+      Function::vector_t result = Function::vector_t::Ones (nEnabled);
+      std::vector<std::string>::const_iterator it;
+      for (it = weights.begin (); it != weights.end (); ++it)
+	{
+	  const std::pair<std::string, Function::value_type> weight =
+	    parseWeight (*it);
+
+	  // add 6 for free-floating and remove 1 as body are labeled
+	  // starting from one in Choreonoid
+	  cnoid::Link* link = robotModel->link (weight.first);
+	  const int id = link ? 6 + link->index () - 1 : -1;
+	  if (id < 6)
+	    {
+	      boost::format fmt ("``%s'' is not a joint of robotModel ``%s''");
+	      fmt % weight.first % robotModel->modelName ();
+	      throw std::runtime_error (fmt.str ());
+	    }
+	  const index_t reducedId = reducedIds[static_cast<std::size_t> (id)];
+	  if (reducedId < 0)
+	    {
+	      boost::format fmt ("joint ``%s'' is disabled");
+	      fmt % weight.first;
+	      throw std::runtime_error (fmt.str ());
+	    }
+	  result[reducedId] = weight.second;
+	}
+      return scale * result;
+    }
+
     // Warning: be particularly cautious regarding the loading order
     // as data is inter-dependent.
     void
@@ -171,30 +211,70 @@ namespace roboptim
     {
       cnoid::BodyLoader loader;
 
-      data.jointsTrajectory = boost::make_shared<cnoid::BodyMotion> ();
-      data.jointsTrajectory->loadStandardYAMLformat (options.jointsTrajectory);
+      // The motion may have been loaded already (e.g. when solving
+      // one window of the motion after the other).
+      if (!data.jointsTrajectory)
+	{
+	  data.jointsTrajectory = boost::make_shared<cnoid::BodyMotion> ();
+	  data.jointsTrajectory->loadStandardYAMLformat
+	    (options.jointsTrajectory);
+	}
 
       data.robotModel = loader.load (options.robotModel);
+      data.evaluationContexts =
+	boost::make_shared<EvaluationContextPool> (data.robotModel);
       data.morphing = loadMorphingData (options.morphing);
       data.markerMapping = buildMarkerMappingFromMorphing (data.morphing);
 
-      // Load the trajectory
-      if (options.trajectoryType == "discrete")
+      // Load the trajectory (spline and minimum jerk trajectories
+      // are sampled at each frame, the frames are loaded the same
+      // way)
+      if (options.trajectoryType == "discrete"
+	  || options.trajectoryType == "spline"
+	  || options.trajectoryType == "minimum-jerk")
 	{
-	  // load the trajectory
-	  boost::shared_ptr<ChoreonoidBodyTrajectory> trajectory =
+	  // load the startFrame / length frames only (the motion may
+	  // be much longer than one window of it)
+	  data.trajectory =
 	    boost::make_shared<ChoreonoidBodyTrajectory>
-	    (data.jointsTrajectory, true);
-
-	  // trim it before insertion to satisfy startFrame / length
-	  // options.
-	  data.trajectory = safeGet (trajectory).trim
-	    (static_cast<Function::size_type> (options.startFrame),
-	     static_cast<Function::size_type> (options.length));
+	    (data.jointsTrajectory, true, options.startFrame, options.length);
 	}
       else
       	throw std::runtime_error ("invalid trajectory type");
 
+      data.nInputFrames = data.nFrames ();
+
+      // Resample the input trajectory (anti-aliased) to the
+      // optimized frame rate.
+      const Function::vector_t::Index resampling =
+	static_cast<Function::vector_t::Index> (options.resampling);
+      if (resampling != 1)
+	data.trajectory =
+	  boost::make_shared<VectorInterpolation>
+	  (downsampleFrames (data.trajectory->parameters (), data.nDofsFull (),
+			     resampling),
+	   data.nDofsFull (),
+	   static_cast<Function::value_type> (resampling)
+	   / data.jointsTrajectory->frameRate ());
+
+      // Keep one frame every decimation frames (temporal multigrid
+      // coarse levels).
+      const Function::vector_t::Index decimation =
+	static_cast<Function::vector_t::Index> (options.decimation);
+      data.dt =
+	static_cast<Function::value_type> (resampling * decimation)
+	/ data.jointsTrajectory->frameRate ();
+      if (decimation != 1)
+	data.trajectory =
+	  boost::make_shared<VectorInterpolation>
+	  (decimateFrames (data.trajectory->parameters (), data.nDofsFull (),
+			   decimation),
+	   data.nDofsFull (), data.dt);
+
+      data.centroidalTrajectory =
+	boost::make_shared<CentroidalTrajectory>
+	(data.evaluationContexts, data.nFrames (), data.dt);
+
       // Create the interaction mesh
       data.interactionMesh =
 	buildInteractionMeshFromMarkerMotion
@@ -204,21 +284,60 @@ namespace roboptim
 
       // Filter the trajectory (do not re-order as the initial trajectory is needed!)
 
-      data.disabledJointsConfiguration =
-	disabledJointsConfiguration
-	(options.disabledJoints, data.trajectory, data.robotModel);
-
-      for (Function::vector_t::Index frame = 0; frame < data.nFrames (); ++frame)
-	data.disabledJointsTrajectory.insert
-	  (data.disabledJointsTrajectory.end (),
-	   data.disabledJointsConfiguration.begin (),
-	   data.disabledJointsConfiguration.end ());
+      // The configuration may have been set already (e.g. when
+      // solving windows or segments of the motion, the disabled
+      // joints keep their value in the first frame of the motion).
+      if (data.disabledJointsConfiguration.empty ())
+	data.disabledJointsConfiguration =
+	  disabledJointsConfiguration
+	  (options.disabledJoints, data.trajectory, data.robotModel);
 
       data.filteredTrajectory =
 	filterTrajectory
 	(data.trajectory, data.disabledJointsConfiguration);
+
+      data.smoothnessWeights =
+	smoothnessWeights (options.smoothnessWeights, options.smoothnessScale,
+			   data.disabledJointsConfiguration, data.robotModel);
+
+      // same control points spacing (in time) at every resolution
+      const Function::vector_t::Index spacing =
+	std::max<Function::vector_t::Index>
+	(static_cast<Function::vector_t::Index> (options.controlPointsSpacing)
+	 / (resampling * decimation), 1);
+      if (options.trajectoryType == "spline")
+	data.parametrization =
+	  boost::make_shared<CubicBSplineParametrization<EigenMatrixDense> >
+	  (data.nFrames (), data.nDofsFiltered (), spacing);
+      else if (options.trajectoryType == "minimum-jerk")
+	data.parametrization =
+	  boost::make_shared<
+	    PiecewiseMinimumJerkParametrization<EigenMatrixDense> >
+	  (data.nFrames (), data.nDofsFiltered (), spacing);
     }
 
+    namespace detail
+    {
+      /// \brief Express a function of the reduced trajectory as a
+      ///        function of the optimization variables.
+      ///
+      /// The function is chained with the trajectory parametrization
+      /// (if any): its jacobian is then multiplied by the (sparse)
+      /// parameter jacobian of the trajectory.
+      template <typename T>
+      boost::shared_ptr<T>
+      reparametrize
+      (boost::shared_ptr<T> f,
+       boost::shared_ptr<
+	 LinearTrajectoryParametrization<typename T::traits_t> >
+       parametrization)
+      {
+	if (!parametrization)
+	  return f;
+	return roboptim::chain<T, T> (f, parametrization);
+      }
+    } // end of namespace detail.
+
 
     template <typename T>
     JointProblemBuilder<T>::JointProblemBuilder
@@ -237,55 +356,92 @@ namespace roboptim
     {
       buildJointDataFromOptions (data, options_);
 
-      std::size_t nConstraints =
-	static_cast<std::size_t> (data.nFrames ()) - 2;
+      // Dense or sparse functions depending on the problem type.
+      typedef typename T::function_t function_t;
+      typedef typename function_t::traits_t traits_t;
 
+      const Function::value_type dt = data.dt;
 
       JointFunctionFactory factory (data);
 
-      data.cost =
-	factory.buildFunction<DifferentiableFunction> (options_.cost);
+      boost::shared_ptr<LinearTrajectoryParametrization<traits_t> >
+	parametrization;
+      if (data.parametrization)
+	parametrization =
+	  boost::make_shared<LinearTrajectoryParametrization<traits_t> >
+	  (*data.parametrization);
+
+      boost::shared_ptr<function_t> cost =
+	detail::reparametrize
+	(factory.buildFunction<function_t> (options_.cost), parametrization);
+      if (data.proximalTerm)
+	{
+	  // An empty term is sized to the optimization variables
+	  // (zero weights).
+	  if (data.proximalTerm->weights.size () == 0)
+	    {
+	      data.proximalTerm->weights =
+		Function::vector_t::Zero (cost->inputSize ());
+	      data.proximalTerm->reference =
+		Function::vector_t::Zero (cost->inputSize ());
+	    }
+	  cost = boost::make_shared<ProximalCost<traits_t> >
+	    (cost, data.proximalTerm);
+	}
+      storeCost (data, cost);
 
-      problem = boost::make_shared<T> (*data.cost);
+      problem = boost::make_shared<T> (*cost);
 
       std::vector<std::string>::const_iterator it;
       for (it = options_.constraints.begin ();
 	   it != options_.constraints.end (); ++it)
 	{
-	  Constraint<DifferentiableFunction> constraint =
-	    factory.buildConstraint<DifferentiableFunction> (*it);
+	  // Joints limits are handled by the solver as simple bounds
+	  // of each frame configuration (or of the trajectory
+	  // parameters, see LinearTrajectoryParametrization).
+	  if (*it == "joints-limits")
+	    {
+	      const Function::intervals_t limits = factory.jointsLimits ();
+	      typename T::intervals_t& bounds = problem->argumentBounds ();
+	      if (data.parametrization)
+		bounds = data.parametrization->argumentBounds (limits);
+	      else
+		for (std::size_t i = 0; i < bounds.size (); ++i)
+		  bounds[i] = limits[i % limits.size ()];
+	      continue;
+	    }
+
+	  Constraint<function_t> constraint =
+	    factory.buildConstraint<function_t> (*it);
 
 	  switch (constraint.type)
 	    {
-	    case Constraint<T>::CONSTRAINT_TYPE_ONCE:
+	    case Constraint<function_t>::CONSTRAINT_TYPE_ONCE:
 	      {
 		problem->addConstraint
-		  (constraint.function,
+		  (detail::reparametrize
+		   (constraint.function, parametrization),
 		   constraint.intervals,
 		   constraint.scales);
 		break;
 	      }
-	    case Constraint<T>::CONSTRAINT_TYPE_PER_FRAME:
+	    case Constraint<function_t>::CONSTRAINT_TYPE_PER_FRAME:
 	      {
-		for (std::size_t i = 0; i < nConstraints; ++i)
-		  {
-		    const Function::value_type t =
-		      (static_cast<Function::value_type> (i) + 1.) /
-		      (static_cast<Function::value_type> (nConstraints) + 1.);
-		    ROBOPTIM_RETARGETING_ASSERT (t > 0. && t < 1.);
-
-		    boost::shared_ptr<DifferentiableFunction> f
-		      (new roboptim::StateFunction<Trajectory >
-		       (*data.filteredTrajectory,
-			constraint.function,
-			t * tMax,
-			static_cast<Function::size_type>
-			(constraint.stateFunctionOrder)));
-
-		    f = bind (f, data.disabledJointsTrajectory);
-		    problem->addConstraint
-		      (f, constraint.intervals, constraint.scales);
-		  }
+		// The stacked function takes the full trajectory as
+		// input, it is evaluated on the enabled joints only.
+		boost::shared_ptr<StackedStateFunction<traits_t> >
+		  stacked =
+		  boost::make_shared<StackedStateFunction<traits_t> >
+		  (constraint.function, data.nFrames (),
+		   constraint.stateFunctionOrder, dt);
+
+		boost::shared_ptr<function_t> f = stacked;
+		f = reduceCoordinates (f, data.disabledJointsConfiguration);
+		f = detail::reparametrize (f, parametrization);
+		problem->addConstraint
+		  (f,
+		   stacked->repeat (constraint.intervals),
+		   stacked->repeat (constraint.scales));
 		break;
 	      }
 	    default:
@@ -293,7 +449,11 @@ namespace roboptim
 	    }
 	}
 
-      problem->startingPoint () = data.filteredTrajectory->parameters ();
+      if (data.parametrization)
+	problem->startingPoint () =
+	  data.parametrization->fit (data.filteredTrajectory->parameters ());
+      else
+	problem->startingPoint () = data.filteredTrajectory->parameters ();
     }
   } // end of namespace retargeting.
 } // end of namespace roboptim.
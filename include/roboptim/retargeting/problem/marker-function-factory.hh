@@ -66,6 +66,24 @@ namespace roboptim
       /// \brief RobOptim trajectory
       boost::shared_ptr<roboptim::Trajectory<3> > trajectory;
 
+      /// \brief Time between two frames of the optimized trajectory
+      ///
+      /// Frame period of the markers trajectory times the resampling
+      /// factor (see MarkerProblemOptions).
+      Function::value_type dt;
+
+      /// \brief Weights of the smoothness costs (acceleration, jerk)
+      ///
+      /// One weight per coordinate of the markers positions, the
+      /// global scale included (see MarkerProblemOptions).
+      Function::vector_t smoothnessWeights;
+
+      /// \brief Number of frames of the trimmed markers trajectory
+      ///
+      /// I.e. before resampling: the solution is upsampled back to
+      /// this number of frames.
+      Function::vector_t::Index nInputFrames;
+
       /// \brief Shared pointer to cost function.
       ///
       /// The oldest part of RobOptim do not rely on shared pointers
@@ -73,6 +91,10 @@ namespace roboptim
       /// pointer manually to dellocating it.
       boost::shared_ptr<DifferentiableFunction> cost;
 
+      /// \brief Shared pointer to cost function (sparse problems).
+      boost::shared_ptr<GenericDifferentiableFunction<EigenMatrixSparse> >
+      sparseCost;
+
       Function::vector_t::Index nMarkers () const
       {
 	return
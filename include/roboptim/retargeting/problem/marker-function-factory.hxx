@@ -19,12 +19,17 @@
 # define  ROBOPTIM_RETARGETING_MARKER_FUNCTION_FACTORY_HXX
 # include <algorithm>
 # include <stdexcept>
+# include <string>
+# include <vector>
 
-# include <roboptim/core/numeric-linear-function.hh>
-# include <roboptim/core/filter/plus.hh>
+# include <boost/format.hpp>
+
+# include <cnoid/Body>
 
 # include <roboptim/retargeting/function/marker-laplacian-deformation-energy/choreonoid.hh>
-# include <roboptim/retargeting/function/bone-length.hh>
+# include <roboptim/retargeting/function/acceleration.hh>
+# include <roboptim/retargeting/function/bone-length-trajectory.hh>
+# include <roboptim/retargeting/function/selector.hh>
 
 namespace roboptim
 {
@@ -40,38 +45,90 @@ namespace roboptim
 	  throw std::runtime_error
 	    ("failed to create null function: no joint trajectory");
 
-	typename T::matrix_t A
-	  (1, data.trajectory->parameters ().size ());
-	A.setZero ();
-	typename T::vector_t b (1);
-	b.setZero ();
-
-	return boost::make_shared<
-	  GenericNumericLinearFunction<typename T::traits_t> >
-	  (A, b);
+	return boost::make_shared<Zero<typename T::traits_t> >
+	  (data.trajectory->parameters ().size ());
       }
 
       template <typename T>
       boost::shared_ptr<T>
       laplacianDeformationEnergy (const MarkerFunctionData& data)
       {
-	return boost::make_shared<MarkerLaplacianDeformationEnergyChoreonoidDense>
+	return boost::make_shared<
+	  MarkerLaplacianDeformationEnergyChoreonoid<typename T::traits_t> >
 	  (data.mapping, data.mesh, data.trajectory);
       }
 
+      template <typename T>
+      boost::shared_ptr<T>
+      squaredFiniteDifference (const MarkerFunctionData& data,
+			       Function::vector_t::Index order)
+      {
+	// smoothness of the markers positions
+	return
+	  boost::make_shared<SquaredAcceleration<typename T::traits_t> >
+	  (data.nFrames (), data.smoothnessWeights, data.dt, order);
+      }
+
+      template <typename T>
+      boost::shared_ptr<T>
+      acceleration (const MarkerFunctionData& data)
+      {
+	return squaredFiniteDifference<T> (data, 2);
+      }
+
+      template <typename T>
+      boost::shared_ptr<T>
+      jerk (const MarkerFunctionData& data)
+      {
+	return squaredFiniteDifference<T> (data, 3);
+      }
+
+      /// \brief Index of a marker in the markers trajectory.
+      inline Function::vector_t::Index
+      markerIndex (const MarkerFunctionData& data, const std::string& marker)
+      {
+	std::vector<std::string>::const_iterator it =
+	  std::find (data.markersTrajectory.markers ().begin (),
+		     data.markersTrajectory.markers ().end (),
+		     marker);
+	if (it == data.markersTrajectory.markers ().end ())
+	  throw std::runtime_error
+	    ((boost::format ("marker %s does not exist") % marker).str ());
+	return it - data.markersTrajectory.markers ().begin ();
+      }
+
+      /// \brief Distance between a robot body and its parent.
+      inline Function::value_type
+      bodyLength (const MarkerFunctionData& data, const std::string& linkName)
+      {
+	cnoid::Link* link = data.robotModel->link (linkName);
+	if (!link)
+	  throw std::runtime_error
+	    ((boost::format ("link %s not found") % linkName).str ());
+	cnoid::Link* parent = link->parent ();
+	if (!parent)
+	  throw std::runtime_error
+	    ((boost::format ("link %s has no parent") % linkName).str ());
+	return (link->position ().translation ()
+		- parent->position ().translation ()).norm ();
+      }
+
       template <typename T>
       boost::shared_ptr<T>
       boneLength (const MarkerFunctionData& data)
       {
-	typedef BoneLengthError<typename T::traits_t> fun_t;
-	typedef boost::shared_ptr<fun_t> funPtr_t;
+	typedef BoneLengthTrajectoryError<typename T::traits_t> fun_t;
 
 	typedef MorphingData::mapping_t::const_iterator
 	  body_const_iterator;
 	typedef MorphingData::mappingData_t::const_iterator
 	  marker_const_iterator;
 
-	boost::shared_ptr<T> result;
+	if (!data.robotModel)
+	  throw std::runtime_error ("null body pointer");
+
+	std::vector<typename fun_t::bone_t> bones;
+	std::vector<Function::value_type> lengths;
 
 	for (body_const_iterator it = data.morphing.mapping.begin ();
 	     it != data.morphing.mapping.end (); ++it)
@@ -89,20 +146,23 @@ namespace roboptim
 			>= itMarker - it->second.begin ())
 		      continue;
 
-		    boost::shared_ptr<T> fun =
-		      boost::make_shared<fun_t>
-		      (itMarker->marker, itMarker2->marker, it->first,
-		       data.markersTrajectory, data.robotModel);
-
-		    if (!result)
-		      result = fun;
-		    else
-		      result = result + fun;
+		    bones.push_back
+		      (std::make_pair (markerIndex (data, itMarker->marker),
+				       markerIndex (data, itMarker2->marker)));
+		    lengths.push_back (bodyLength (data, it->first));
 		  }
 	      }
 	  }
 
-	return result;
+	if (bones.empty ())
+	  throw std::runtime_error
+	    ("failed to create bone length function:"
+	     " no body holds two markers");
+
+	return boost::make_shared<fun_t>
+	  (static_cast<Function::vector_t::Index>
+	   (data.markersTrajectory.numMarkers ()),
+	   data.nFrames (), bones, lengths);
       }
 
       /// \brief Map function name to the function used to allocate
@@ -126,8 +186,10 @@ namespace roboptim
       const typename MarkerFunctionFactoryMapping<T>::Mapping
       MarkerFunctionFactoryMapping<T>::map[] = {
 	{"null", &null<T>},
+	{"acceleration", &acceleration<T>},
 	{"lde", &laplacianDeformationEnergy<T>},
 	{"bone-length", &boneLength<T>},
+	{"jerk", &jerk<T>},
 	{0, 0}
       };
 
@@ -175,7 +237,8 @@ namespace roboptim
 
       if (name == "bone-length")
 	{
-	  constraint.type = Constraint<T>::CONSTRAINT_TYPE_PER_FRAME;
+	  // all the frames are already covered by the function
+	  constraint.type = Constraint<T>::CONSTRAINT_TYPE_ONCE;
 	  std::fill (constraint.intervals.begin (),
 		     constraint.intervals.end (),
 		     Function::makeInterval (0., 0.));
@@ -39,6 +39,13 @@ namespace roboptim
       /// -1 means all frames.
       int length;
 
+      /// \brief Input frames per optimized frame.
+      ///
+      /// The (trimmed) markers trajectory is low-pass filtered and
+      /// decimated by this factor before the problem is built. One
+      /// means no resampling.
+      int resampling;
+
       /// \brief Marker set filename.
       ///
       /// Any format supported by libmocap is acceptable.
@@ -77,9 +84,37 @@ namespace roboptim
       /// \brief Solver plug-in name.
       std::string plugin;
 
+      /// \brief Build and solve a sparse problem?
+      ///
+      /// If true, functions use sparse jacobians (sparseProblem_t)
+      /// so that the solver receives their sparsity pattern. The
+      /// solver plug-in must support sparse problems.
+      bool sparse;
+
+      /// \brief Number of worker threads.
+      ///
+      /// Sizes the shared worker pool, robot-based functions get one
+      /// evaluation context per worker.
+      int jobs;
+
       /// \brief Cost function name.
       std::string cost;
 
+      /// \brief Global weight of the smoothness costs (acceleration,
+      ///        jerk).
+      ///
+      /// The squared finite differences are divided by dt^(2n): at
+      /// high frame rates, this scale keeps them comparable to the
+      /// other terms.
+      double smoothnessScale;
+
+      /// \brief Per-marker weights of the smoothness costs.
+      ///
+      /// NAME=WEIGHT entries, NAME being a marker name (the weight
+      /// applies to its three coordinates). The other markers are
+      /// weighted by one.
+      std::vector<std::string> smoothnessWeights;
+
       /// \brief Constraints functions names.
       std::vector<std::string> constraints;
 
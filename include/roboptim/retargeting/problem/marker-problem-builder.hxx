@@ -26,12 +26,13 @@
 
 # include <roboptim/core/problem.hh>
 
-# include <roboptim/trajectory/state-function.hh>
 # include <roboptim/trajectory/vector-interpolation.hh>
 
 # include <roboptim/retargeting/morphing.hh>
+# include <roboptim/retargeting/resampling.hh>
 # include <roboptim/retargeting/problem/marker-function-factory.hh>
 # include <roboptim/retargeting/function/libmocap-marker-trajectory.hh>
+# include <roboptim/retargeting/function/stacked-state-function.hh>
 
 
 namespace roboptim
@@ -68,8 +69,38 @@ namespace roboptim
       else
 	throw std::runtime_error ("invalid trajectory type");
 
+      data.nInputFrames = data.nFrames ();
+
+      // Resample the input trajectory (anti-aliased) to the
+      // optimized frame rate.
+      const Function::vector_t::Index resampling =
+	static_cast<Function::vector_t::Index> (options.resampling);
+      data.dt =
+	static_cast<Function::value_type> (resampling)
+	/ data.markersTrajectory.dataRate ();
+      if (resampling != 1)
+	data.trajectory =
+	  boost::make_shared<VectorInterpolation>
+	  (downsampleFrames (data.trajectory->parameters (), data.nMarkers (),
+			     resampling),
+	   data.nMarkers (), data.dt);
+
       data.mesh = buildInteractionMeshFromMarkerMotion
 	(data.trajectory, data.mapping);
+
+      // Smoothness costs weights (three coordinates per marker).
+      data.smoothnessWeights = Function::vector_t::Ones (data.nMarkers ());
+      std::vector<std::string>::const_iterator it;
+      for (it = options.smoothnessWeights.begin ();
+	   it != options.smoothnessWeights.end (); ++it)
+	{
+	  const std::pair<std::string, Function::value_type> weight =
+	    parseWeight (*it);
+	  data.smoothnessWeights.segment<3>
+	    (3 * detail::markerIndex (data, weight.first))
+	    .setConstant (weight.second);
+	}
+      data.smoothnessWeights *= options.smoothnessScale;
     }
 
 
@@ -91,25 +122,29 @@ namespace roboptim
     {
       buildDataFromOptions (data, options_);
 
-      std::size_t nConstraints =
-	static_cast<std::size_t> (data.nFrames ());
+      // Dense or sparse functions depending on the problem type.
+      typedef typename T::function_t function_t;
+      typedef typename function_t::traits_t traits_t;
+
+      const Function::value_type dt = data.dt;
       MarkerFunctionFactory factory (data);
 
-      data.cost =
-	factory.buildFunction<DifferentiableFunction> (options_.cost);
+      boost::shared_ptr<function_t> cost =
+	factory.buildFunction<function_t> (options_.cost);
+      storeCost (data, cost);
 
-      problem = boost::make_shared<T> (*data.cost);
+      problem = boost::make_shared<T> (*cost);
 
       std::vector<std::string>::const_iterator it;
       for (it = options_.constraints.begin ();
 	   it != options_.constraints.end (); ++it)
 	{
-	  Constraint<DifferentiableFunction> constraint =
-	    factory.buildConstraint<DifferentiableFunction> (*it);
+	  Constraint<function_t> constraint =
+	    factory.buildConstraint<function_t> (*it);
 
 	  switch (constraint.type)
 	    {
-	    case Constraint<T>::CONSTRAINT_TYPE_ONCE:
+	    case Constraint<function_t>::CONSTRAINT_TYPE_ONCE:
 	      {
 		problem->addConstraint
 		  (constraint.function,
@@ -117,25 +152,17 @@ namespace roboptim
 		   constraint.scales);
 		break;
 	      }
-	    case Constraint<T>::CONSTRAINT_TYPE_PER_FRAME:
+	    case Constraint<function_t>::CONSTRAINT_TYPE_PER_FRAME:
 	      {
-		for (std::size_t i = 0; i < nConstraints; ++i)
-		  {
-		    const Function::value_type t =
-		      (static_cast<Function::value_type> (i) + 1.) /
-		      (static_cast<Function::value_type> (nConstraints) + 1.);
-		    ROBOPTIM_RETARGETING_ASSERT (t > 0. && t < 1.);
-
-		    boost::shared_ptr<DifferentiableFunction> f
-		      (new roboptim::StateFunction<Trajectory>
-		       (*data.trajectory,
-			constraint.function,
-			t * tMax,
-			static_cast<Function::size_type>
-			(constraint.stateFunctionOrder)));
-		    problem->addConstraint
-		      (f, constraint.intervals, constraint.scales);
-		  }
+		boost::shared_ptr<StackedStateFunction<traits_t> >
+		  stacked =
+		  boost::make_shared<StackedStateFunction<traits_t> >
+		  (constraint.function, data.nFrames (),
+		   constraint.stateFunctionOrder, dt);
+		problem->addConstraint
+		  (boost::shared_ptr<function_t> (stacked),
+		   stacked->repeat (constraint.intervals),
+		   stacked->repeat (constraint.scales));
 		break;
 	      }
 	    default:
@@ -24,8 +24,10 @@
 
 # include <roboptim/trajectory/trajectory.hh>
 
+# include <roboptim/retargeting/evaluation-context.hh>
 # include <roboptim/retargeting/interaction-mesh.hh>
 # include <roboptim/retargeting/morphing.hh>
+# include <roboptim/retargeting/function/reduced-coordinates.hh>
 # include <roboptim/retargeting/problem/function-factory.hh>
 
 namespace roboptim
@@ -53,6 +55,16 @@ namespace roboptim
       /// velocities limits, etc.
       cnoid::BodyPtr robotModel;
 
+      /// \brief Evaluation contexts shared by all the robot-based
+      ///        functions
+      ///
+      /// One robot (and forward kinematics cache) per worker
+      /// thread. Functions built from the same data share these
+      /// contexts and therefore do not recompute the forward
+      /// kinematics when they are evaluated at the same
+      /// configuration.
+      EvaluationContextPoolShPtr evaluationContexts;
+
       /// \brief Morphing data
       ///
       /// Map robot bodies to markers (optionally with an offset)
@@ -71,7 +83,8 @@ namespace roboptim
 
       /// \brief Configuration of the disabled joints (one frame)
       ///
-      ///
+      /// The functions of the full configuration are evaluated on
+      /// the enabled joints through ReducedCoordinates.
       std::vector<boost::optional<Function::value_type> >
       disabledJointsConfiguration;
 
@@ -159,10 +172,20 @@ namespace roboptim
       template <typename T>
       Constraint<T> buildConstraint (const std::string& name);
 
+      /// \brief Joints limits of the optimization variables.
+      ///
+      /// The joints-limits constraint is not a function: the builders
+      /// pass these intervals to the solver as the problem argument
+      /// bounds. The free-floating DOFs are not bounded.
+      ///
+      /// \return one interval per DOF of the reduced robot configuration
+      Function::intervals_t jointsLimits () const;
+
       /// \brief List supported functions.
       ///
       /// Each element of this string can be passed to buildFunction
-      /// method to create the corresponding function.
+      /// method to create the corresponding function, except
+      /// joints-limits (see jointsLimits).
       static std::vector<std::string>
       listFunctions ();
     private:
@@ -19,11 +19,9 @@
 # define  ROBOPTIM_RETARGETING_JOINT_FUNCTION_FACTORY_HXX
 # include <stdexcept>
 
-# include <roboptim/core/numeric-linear-function.hh>
-# include <roboptim/core/filter/bind.hh>
-
 # include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
 # include <roboptim/retargeting/function/distance-to-marker.hh>
+# include <roboptim/retargeting/function/selector.hh>
 
 namespace roboptim
 {
@@ -43,15 +41,8 @@ namespace roboptim
 	    ("failed to create null function:"
 	     " empty parameters vector in reduced joint trajectory");
 
-	typename T::matrix_t A
-	  (1, data.nDofsFiltered ());
-	A.setZero ();
-	typename T::vector_t b (1);
-	b.setZero ();
-
-	return boost::make_shared<
-	  GenericNumericLinearFunction<typename T::traits_t> >
-	  (A, b);
+	return boost::make_shared<Zero<typename T::traits_t> >
+	  (data.nDofsFiltered ());
       }
 
       template <typename T>
@@ -63,31 +54,25 @@ namespace roboptim
 	  jointToMarker =
 	  boost::make_shared<
 	    JointToMarkerPositionChoreonoid<typename T::traits_t> >
-	  (data.robotModel, data.morphing);
+	  (data.evaluationContexts, data.morphing);
 
 	Function::vector_t referencePositions =
 	  data.inputTrajectory->parameters ().segment
 	  (data.frameId * jointToMarker->outputSize (),
 	   jointToMarker->outputSize ());
 
+	// markers positions as a function of the enabled joints
+	boost::shared_ptr<GenericDifferentiableFunction<typename T::traits_t> >
+	  reducedJointToMarker =
+	  reduceCoordinates
+	  (boost::shared_ptr<
+	     GenericDifferentiableFunction<typename T::traits_t> >
+	   (jointToMarker),
+	   data.disabledJointsConfiguration);
+
 	return boost::make_shared<
 	  DistanceToMarker<typename T::traits_t> >
-	  (jointToMarker, referencePositions);
-      }
-
-      template <typename T>
-      boost::shared_ptr<T>
-      jointsLimits (const MarkerToJointFunctionData& data)
-      {
-	typename T::matrix_t A
-	  (data.nDofsFiltered (), data.nDofsFiltered ());
-	A.setIdentity ();
-	typename T::vector_t b (data.nDofsFiltered ());
-	b.setZero ();
-	return
-	  boost::make_shared<
-	    GenericNumericLinearFunction<typename T::traits_t> >
-	  (A, b);
+	  (reducedJointToMarker, referencePositions);
       }
 
       template <typename T = GenericFunction<EigenMatrixDense> >
@@ -115,7 +100,6 @@ namespace roboptim
       MarkerToJointFunctionFactoryMapping<T>::map[] = {
 	{"null", &null<T>},
 	{"distance-to-marker", &distanceToMarker<T>},
-	{"joints-limits", &jointsLimits<T>},
 	{0, 0}
       };
     } // end of namespace detail.
@@ -149,6 +133,11 @@ namespace roboptim
     Constraint<T>
     MarkerToJointFunctionFactory::buildConstraint (const std::string& name)
     {
+      if (name == "joints-limits")
+	throw std::runtime_error
+	  ("joints limits are not a constraint function,"
+	   " use jointsLimits to bound the problem arguments");
+
       Constraint<T> constraint;
       constraint.function = this->buildFunction<T> (name);
 
@@ -161,27 +150,32 @@ namespace roboptim
       constraint.type = Constraint<T>::CONSTRAINT_TYPE_ONCE;
       constraint.stateFunctionOrder = 0;
 
-      if (name == "joints-limits")
+      throw std::runtime_error ("unknown constraint");
+      return constraint;
+    }
+
+    inline Function::intervals_t
+    MarkerToJointFunctionFactory::jointsLimits () const
+    {
+      Function::intervals_t bounds;
+      bounds.reserve (static_cast<std::size_t> (data_.nDofsFiltered ()));
+
+      for (std::size_t jointId = 0;
+	   jointId < static_cast<std::size_t> (data_.nDofsFull ()); ++jointId)
 	{
-	  std::size_t id = 0;
-	  for (std::size_t jointId = 0;
-	       jointId < static_cast<std::size_t> (data_.nDofsFull ()); ++jointId)
-	    {
-	      if (!data_.disabledJointsConfiguration[jointId])
-		{
-		  int jointId_ = static_cast<int> (jointId);
-		  if (jointId < 6)
-		    constraint.intervals[id++] = Function::makeInfiniteInterval ();
-		  else
-		    constraint.intervals[id++] = Function::makeInterval
-		      (data_.robotModel->joint (jointId_ - 6)->q_lower (),
-		       data_.robotModel->joint (jointId_ - 6)->q_upper ());
-		}
-	    }
+	  if (data_.disabledJointsConfiguration[jointId])
+	    continue;
+
+	  int jointId_ = static_cast<int> (jointId);
+	  if (jointId < 6)
+	    bounds.push_back (Function::makeInfiniteInterval ());
+	  else
+	    bounds.push_back
+	      (Function::makeInterval
+	       (data_.robotModel->joint (jointId_ - 6)->q_lower (),
+		data_.robotModel->joint (jointId_ - 6)->q_upper ()));
 	}
-      else
-	throw std::runtime_error ("unknown constraint");
-      return constraint;
+      return bounds;
     }
 
     inline std::vector<std::string>
@@ -197,6 +191,7 @@ namespace roboptim
 	  functions.push_back (element->name);
 	  element++;
 	}
+      functions.push_back ("joints-limits");
       return functions;
     }
   } // end of namespace retargeting.
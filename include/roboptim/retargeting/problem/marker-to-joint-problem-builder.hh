@@ -17,10 +17,15 @@
 #ifndef ROBOPTIM_RETARGETING_PROBLEM_MARKER_TO_JOINT_PROBLEM_BUILDER_HH
 # define ROBOPTIM_RETARGETING_PROBLEM_MARKER_TO_JOINT_PROBLEM_BUILDER_HH
 # include <string>
+# include <utility>
 # include <vector>
 
 # include <boost/shared_ptr.hpp>
 
+# include <roboptim/core/numeric-linear-function.hh>
+
+# include <roboptim/retargeting/function/distance-to-marker.hh>
+# include <roboptim/retargeting/function/selector.hh>
 # include <roboptim/retargeting/problem/problem-builder.hh>
 
 namespace roboptim
@@ -37,6 +42,13 @@ namespace roboptim
       int startFrame;
       int length;
 
+      /// \brief Input frames per solved frame.
+      ///
+      /// The markers trajectory is low-pass filtered and decimated
+      /// by this factor, one frame out of resampling is solved. One
+      /// means no resampling.
+      int resampling;
+
       std::string markerSet;
       std::string markersTrajectory;
 
@@ -52,12 +64,58 @@ namespace roboptim
 
       std::string plugin;
 
+      /// \brief Number of worker threads.
+      ///
+      /// Sizes the shared worker pool, robot-based functions get one
+      /// evaluation context per worker.
+      int jobs;
+
+      /// \brief How each frame starting configuration is predicted.
+      ///
+      /// previous (previous frame solution), velocity (constant
+      /// velocity extrapolation) or acceleration (constant
+      /// acceleration extrapolation).
+      std::string warmStart;
+
+      /// \brief Start IPOPT with a small barrier parameter and bound
+      ///        push once the starting configurations are
+      ///        extrapolated (see warmStart).
+      ///
+      /// The multipliers are not warm started: this is disabled by
+      /// default.
+      bool warmSolverParameters;
+
+      /// \brief Number of chunks solved concurrently.
+      ///
+      /// 0 or 1 means the frames are solved one after another. See
+      /// roboptim-retargeting-markers-to-joints.
+      int chunks;
+
       /// \brief Disabled joints
       ///
       /// Disabled DOFs will be excluded from the optimization problem
       /// and hence reduce the overall size of the problem.
       std::vector<std::string> disabledJoints;
 
+      /// \name Streaming
+      ///
+      /// See roboptim-retargeting-markers-to-joints --stream.
+      /// \{
+
+      /// \brief Markers frames source (empty means no streaming).
+      std::string stream;
+      /// \brief Time allowed to solve one frame (seconds).
+      double streamDeadline;
+      /// \brief Maximum number of solver iterations per frame.
+      int streamMaxIterations;
+      /// \brief Factor applied to the streamed positions.
+      double streamScale;
+      /// \brief The stream ends if no data is received during this
+      ///        duration (seconds, 0 means never).
+      double streamTimeout;
+
+      /// \}
+
 
       Function::vector_t::Index frameId;
     };
@@ -127,6 +185,129 @@ namespace roboptim
       /// \brief Problem description.
       const MarkerToJointProblemOptions& options_;
     };
+
+    /// \brief Build a marker to joint problem once and reuse it for
+    ///        every frame.
+    ///
+    /// Contrary to MarkerToJointProblemBuilder, the functions, the
+    /// problem and therefore the solver are allocated only once. The
+    /// problem is expressed relatively to an anchor configuration:
+    ///
+    /// x = anchor + d
+    ///
+    /// where d is the optimization variable. Switching to another
+    /// frame then only consists in updating the markers reference
+    /// positions and the anchor (the frame starting configuration)
+    /// in place. The starting point is always d = 0.
+    ///
+    /// The joints limits are bounds of x: the problem argument
+    /// bounds (lower - anchor <= d <= upper - anchor) are shifted
+    /// with the anchor, the frame is then solved by the same solver.
+    ///
+    /// Typical use:
+    /// \code
+    /// builder (problem, data);
+    /// // create the solver once
+    /// for (each frame)
+    ///   {
+    ///     builder.setFrame (frameId, data);
+    ///     solver.reset ();
+    ///     x = builder.configuration (result.x);
+    ///   }
+    /// \endcode
+    ///
+    /// \tparam T problem type
+    template <typename T>
+    class MarkerToJointIncrementalProblemBuilder : public ProblemBuilder<T>
+    {
+    public:
+      typedef Function::vector_t vector_t;
+
+      /// \brief Constructor
+      ///
+      /// \warning options are kept as a const reference so this
+      /// object lifespan much be longer than the one of this object.
+      ///
+      /// \param[in] options problem description
+      explicit MarkerToJointIncrementalProblemBuilder
+      (const MarkerToJointProblemOptions& options);
+      ~MarkerToJointIncrementalProblemBuilder ();
+
+      /// \brief Instantiate the problem for the frame options.frameId.
+      void operator () (boost::shared_ptr<T>& problem,
+			MarkerToJointFunctionData& data);
+
+      /// \brief Switch the problem to another frame.
+      ///
+      /// Update the markers reference positions and the starting
+      /// configuration (reference pose for the first frame,
+      /// previous frame solution otherwise).
+      ///
+      /// \param[in] frameId frame index
+      /// \param[in,out] data problem data
+      void setFrame (Function::vector_t::Index frameId,
+		     MarkerToJointFunctionData& data);
+
+      /// \brief Switch the problem to another frame, starting from
+      ///        a given configuration.
+      ///
+      /// \param[in] frameId frame index
+      /// \param[in,out] data problem data
+      /// \param[in] start starting configuration (reduced)
+      void setFrame (Function::vector_t::Index frameId,
+		     MarkerToJointFunctionData& data,
+		     const vector_t& start);
+
+      /// \brief Switch the problem to markers positions which do not
+      ///        belong to the input trajectory (streamed frames).
+      ///
+      /// \param[in] markers markers positions of one frame
+      /// \param[in] start starting configuration (reduced)
+      void setMarkers (const vector_t& markers, const vector_t& start);
+
+      /// \brief Convert an optimization result into a configuration.
+      ///
+      /// \param[in] x optimization variable (offset from the anchor)
+      /// \return robot configuration (reduced)
+      vector_t configuration (const vector_t& x) const;
+
+      /// \brief Starting configuration of the current frame.
+      const vector_t& anchor () const;
+
+    private:
+      typedef boost::shared_ptr<GenericNumericLinearFunction<EigenMatrixDense> >
+      numericLinearFunctionShPtr_t;
+      typedef boost::shared_ptr<DistanceToMarker<EigenMatrixDense> >
+      distanceToMarkerShPtr_t;
+      typedef boost::shared_ptr<Identity<EigenMatrixDense> >
+      identityShPtr_t;
+
+      /// \brief Express a function of x as a function of d.
+      boost::shared_ptr<DifferentiableFunction>
+      anchored (boost::shared_ptr<DifferentiableFunction> f);
+
+      /// \brief Problem description.
+      const MarkerToJointProblemOptions& options_;
+
+      /// \brief Built problem.
+      boost::shared_ptr<T> problem_;
+
+      /// \brief Affine function d -> anchor + d.
+      identityShPtr_t anchor_;
+
+      /// \brief Functions depending on the markers reference positions.
+      std::vector<distanceToMarkerShPtr_t> distances_;
+
+      /// \brief Linear constraints (original function, function of d).
+      ///
+      /// Linear constraints stay linear: only their constant term
+      /// is updated when the anchor changes.
+      std::vector<std::pair<numericLinearFunctionShPtr_t,
+			    numericLinearFunctionShPtr_t> > linearConstraints_;
+
+      /// \brief Joints limits (bounds of x, empty if disabled).
+      Function::intervals_t limits_;
+    };
   } // end of namespace retargeting.
 } // end of namespace roboptim.
 
@@ -27,11 +27,12 @@
 # include <cnoid/ValueTree>
 
 # include <roboptim/core/problem.hh>
-# include <roboptim/core/filter/bind.hh>
+# include <roboptim/core/filter/chain.hh>
 
 # include <roboptim/trajectory/state-function.hh>
 # include <roboptim/trajectory/vector-interpolation.hh>
 
+# include <roboptim/retargeting/resampling.hh>
 # include <roboptim/retargeting/function/choreonoid-body-trajectory.hh>
 # include <roboptim/retargeting/function/libmocap-marker-trajectory.hh>
 # include <roboptim/retargeting/problem/marker-to-joint-function-factory.hh>
@@ -64,6 +65,8 @@ namespace roboptim
       data.markersTrajectory =
 	libmocap::MarkerTrajectoryFactory ().load (options.markersTrajectory);
       data.robotModel = loader.load (options.robotModel);
+      data.evaluationContexts =
+	boost::make_shared<EvaluationContextPool> (data.robotModel);
       data.markersTrajectory.normalize ();
 
       if (!data.inputTrajectory)
@@ -81,26 +84,32 @@ namespace roboptim
 	    }
 	  else
 	    throw std::runtime_error ("invalid trajectory type");
+
+	  // Resample the markers (anti-aliased) to the solved frame
+	  // rate.
+	  if (options.resampling != 1)
+	    data.inputTrajectory =
+	      boost::make_shared<VectorInterpolation>
+	      (downsampleFrames (data.inputTrajectory->parameters (),
+				 data.inputTrajectory->outputSize (),
+				 options.resampling),
+	       data.inputTrajectory->outputSize (),
+	       static_cast<Function::value_type> (options.resampling)
+	       / data.markersTrajectory.dataRate ());
 	}
 
+      // One output frame per solved frame.
       Function::size_type nFrames =
-	static_cast<Function::size_type> (data.markersTrajectory.numFrames ());
+	decimatedFrameCount
+	(static_cast<Function::size_type> (data.markersTrajectory.numFrames ()),
+	 options.resampling);
       Function::value_type dt =
-	static_cast<Function::value_type>
-	(1. / data.markersTrajectory.dataRate ());
+	static_cast<Function::value_type> (options.resampling)
+	/ data.markersTrajectory.dataRate ();
 
       Function::size_type nDofsFull =
 	static_cast<Function::size_type> (6 + data.robotModel->numJoints ());
-      //FIXME: unsafe if vector is ill-formed
-      Function::size_type nDofsReduced = nDofsFull -
-	static_cast<Function::size_type>
-	(data.disabledJointsConfiguration.size ());
 
-      if (!data.outputTrajectoryReduced)
-	data.outputTrajectoryReduced =
-	  boost::make_shared<VectorInterpolation>
-	  (Function::vector_t (nDofsReduced * nFrames),
-	   nDofsReduced, dt);
       if (!data.outputTrajectory)
 	{
 	  Function::vector_t parameters (nDofsFull * nFrames);
@@ -121,15 +130,112 @@ namespace roboptim
 
 	  data.outputTrajectory =
 	    boost::make_shared<VectorInterpolation>
-	    (parameters, nDofsReduced, dt);
+	    (parameters, nDofsFull, dt);
 	}
 
       data.disabledJointsConfiguration =
 	disabledJointsConfiguration
 	(options.disabledJoints, data.outputTrajectory, data.robotModel);
+
+      // The disabled joints are known: size the reduced trajectory.
+      Function::size_type nDofsReduced =
+	ReducedCoordinatesMap (data.disabledJointsConfiguration)
+	.reducedSize ();
+      if (!data.outputTrajectoryReduced)
+	data.outputTrajectoryReduced =
+	  boost::make_shared<VectorInterpolation>
+	  (Function::vector_t (nDofsReduced * nFrames),
+	   nDofsReduced, dt);
     }
 
 
+    /// \brief Starting configuration of a frame.
+    ///
+    /// The first frame starts from the robot reference pose, the
+    /// other ones from the previous frame solution.
+    ///
+    /// \param[in] data problem data
+    /// \param[in] frameId frame index
+    /// \return reduced robot configuration
+    inline Function::vector_t
+    markerToJointStartingConfiguration
+    (const MarkerToJointFunctionData& data,
+     Function::vector_t::Index frameId)
+    {
+      Function::vector_t::Index length = data.nDofsFiltered ();
+
+      // for first frame, start from half-sitting (enabled joints
+      // of the output trajectory first frame)
+      if (frameId == 0)
+	return ReducedCoordinatesMap (data.disabledJointsConfiguration)
+	  .reduce (data.outputTrajectory->parameters ().segment
+		   (0, data.nDofsFull ()));
+
+      // for other frames, start from previous frame
+      return data.outputTrajectoryReduced->parameters ().segment
+	((frameId - 1) * length, length);
+    }
+
+    /// \brief Extrapolation order of a warm start mode.
+    ///
+    /// \param[in] warmStart previous, velocity or acceleration
+    /// \return 0, 1 or 2
+    inline int
+    markerToJointWarmStartOrder (const std::string& warmStart)
+    {
+      if (warmStart == "previous")
+	return 0;
+      if (warmStart == "velocity")
+	return 1;
+      if (warmStart == "acceleration")
+	return 2;
+      boost::format fmt ("invalid warm start mode: %s");
+      fmt % warmStart;
+      throw std::runtime_error (fmt.str ());
+    }
+
+    /// \brief Predict the configuration of a frame from the solutions
+    ///        of the previous frames.
+    ///
+    /// - order 0: q_{k-1},
+    /// - order 1: 2 q_{k-1} - q_{k-2} (constant velocity),
+    /// - order 2: 3 q_{k-1} - 3 q_{k-2} + q_{k-3} (constant
+    ///   acceleration).
+    ///
+    /// The order is reduced if not enough frames have been solved.
+    ///
+    /// \param[in] parameters trajectory parameters (reduced)
+    /// \param[in] nDofs configuration size
+    /// \param[in] frameId predicted frame
+    /// \param[in] nSolved number of solved frames before frameId
+    ///            (at least one)
+    /// \param[in] order extrapolation order
+    /// \return reduced robot configuration
+    inline Function::vector_t
+    markerToJointExtrapolatedConfiguration
+    (const Function::vector_t& parameters,
+     Function::vector_t::Index nDofs,
+     Function::vector_t::Index frameId,
+     Function::vector_t::Index nSolved,
+     int order)
+    {
+      ROBOPTIM_RETARGETING_ASSERT (nSolved >= 1 && frameId >= nSolved);
+
+      const Function::vector_t::Index n = nDofs;
+      switch (std::min<Function::vector_t::Index> (order, nSolved - 1))
+	{
+	case 0:
+	  return parameters.segment ((frameId - 1) * n, n);
+	case 1:
+	  return 2. * parameters.segment ((frameId - 1) * n, n)
+	    - parameters.segment ((frameId - 2) * n, n);
+	default:
+	  return 3. * parameters.segment ((frameId - 1) * n, n)
+	    - 3. * parameters.segment ((frameId - 2) * n, n)
+	    + parameters.segment ((frameId - 3) * n, n);
+	}
+    }
+
     template <typename T>
     MarkerToJointProblemBuilder<T>::MarkerToJointProblemBuilder
     (const MarkerToJointProblemOptions& options)
@@ -156,6 +262,13 @@ namespace roboptim
       for (it = options_.constraints.begin ();
 	   it != options_.constraints.end (); ++it)
 	{
+	  // Joints limits are handled by the solver as simple bounds.
+	  if (*it == "joints-limits")
+	    {
+	      problem->argumentBounds () = factory.jointsLimits ();
+	      continue;
+	    }
+
 	  Constraint<DifferentiableFunction> constraint =
 	    factory.buildConstraint<DifferentiableFunction> (*it);
 
@@ -174,41 +287,189 @@ namespace roboptim
 	       constraint.scales);
 	}
 
-      Function::vector_t::Index length = data.nDofsFiltered ();
+      problem->startingPoint () =
+	markerToJointStartingConfiguration (data, options_.frameId);
+    }
+    template <typename T>
+    MarkerToJointIncrementalProblemBuilder<T>::
+    MarkerToJointIncrementalProblemBuilder
+    (const MarkerToJointProblemOptions& options)
+      : options_ (options),
+	problem_ (),
+	anchor_ (),
+	distances_ (),
+	linearConstraints_ (),
+	limits_ ()
+    {}
 
-      // for first frame, start from half-sitting
-      if (options_.frameId == 0)
+    template <typename T>
+    MarkerToJointIncrementalProblemBuilder<T>::
+    ~MarkerToJointIncrementalProblemBuilder ()
+    {}
+
+    template <typename T>
+    boost::shared_ptr<DifferentiableFunction>
+    MarkerToJointIncrementalProblemBuilder<T>::anchored
+    (boost::shared_ptr<DifferentiableFunction> f)
+    {
+      distanceToMarkerShPtr_t distance =
+	boost::dynamic_pointer_cast<DistanceToMarker<EigenMatrixDense> > (f);
+      if (distance)
+	distances_.push_back (distance);
+
+      boost::shared_ptr<DifferentiableFunction> anchor = anchor_;
+      return chain (f, anchor);
+    }
+
+    template <typename T>
+    void
+    MarkerToJointIncrementalProblemBuilder<T>::operator ()
+      (boost::shared_ptr<T>& problem, MarkerToJointFunctionData& data)
+    {
+      buildMarkerToJointDataFromOptions (data, options_);
+      MarkerToJointFunctionFactory factory (data);
+
+      distances_.clear ();
+      linearConstraints_.clear ();
+      limits_.clear ();
+
+      const Function::vector_t::Index n = data.nDofsFiltered ();
+      anchor_ = boost::make_shared<Identity<EigenMatrixDense> >
+	(Function::vector_t::Zero (n));
+
+      // The problem only keeps a reference to the cost function.
+      data.cost = anchored
+	(factory.buildFunction<DifferentiableFunction> (options_.cost));
+      problem = boost::make_shared<T> (*data.cost);
+      problem_ = problem;
+
+      std::vector<std::string>::const_iterator it;
+      for (it = options_.constraints.begin ();
+	   it != options_.constraints.end (); ++it)
 	{
-	  // FIXME: this "reference pose" should be loaded and filtered correctly.
-	  const cnoid::Listing& pose =
-	    *data.robotModel->info ()->findListing ("standardPose");
-	  Function::vector_t referencePose (length);
-	  referencePose.template segment<6> (0).setZero ();
-	  for (int i = 0; i < length - 6; ++i)
+	  // Bounds of x, the bounds of d are set with the anchor.
+	  if (*it == "joints-limits")
 	    {
-	      std::stringstream stream;
-	      stream << pose.at (i)->toString ();
-	      double value;
-	      stream >> value;
+	      limits_ = factory.jointsLimits ();
+	      continue;
+	    }
 
-	      // convert degree into radian here
-	      referencePose[i + 6] = value * (M_PI / 180.);
+	  Constraint<DifferentiableFunction> constraint =
+	    factory.buildConstraint<DifferentiableFunction> (*it);
+
+	  numericLinearFunctionShPtr_t linearConstraint =
+	    boost::dynamic_pointer_cast<NumericLinearFunction>
+	    (constraint.function);
+	  if (linearConstraint)
+	    {
+	      numericLinearFunctionShPtr_t shifted =
+		boost::make_shared<NumericLinearFunction>
+		(linearConstraint->A (), linearConstraint->b ());
+	      linearConstraints_.push_back
+		(std::make_pair (linearConstraint, shifted));
+	      problem->template addConstraint<LinearFunction>
+		(shifted,
+		 constraint.intervals,
+		 constraint.scales);
 	    }
+	  else
+	    problem->addConstraint
+	      (anchored (constraint.function),
+	       constraint.intervals,
+	       constraint.scales);
+	}
+
+      problem->startingPoint () = Function::vector_t::Zero (n);
+      setFrame (options_.frameId, data);
+    }
 
-	  problem->startingPoint () = referencePose;
+    template <typename T>
+    void
+    MarkerToJointIncrementalProblemBuilder<T>::setFrame
+    (Function::vector_t::Index frameId, MarkerToJointFunctionData& data)
+    {
+      setFrame (frameId, data,
+		markerToJointStartingConfiguration (data, frameId));
+    }
+
+    template <typename T>
+    void
+    MarkerToJointIncrementalProblemBuilder<T>::setFrame
+    (Function::vector_t::Index frameId, MarkerToJointFunctionData& data,
+     const vector_t& start)
+    {
+      data.frameId = frameId;
+
+      const Function::vector_t::Index size =
+	safeGet (data.inputTrajectory).outputSize ();
+      setMarkers
+	(data.inputTrajectory->parameters ().segment (frameId * size, size),
+	 start);
+    }
+
+    template <typename T>
+    void
+    MarkerToJointIncrementalProblemBuilder<T>::setMarkers
+    (const vector_t& markers, const vector_t& start)
+    {
+      if (!anchor_)
+	throw std::runtime_error
+	  ("the problem must be built before selecting a frame");
+
+      // Markers reference positions.
+      typename std::vector<distanceToMarkerShPtr_t>::const_iterator it;
+      for (it = distances_.begin (); it != distances_.end (); ++it)
+	(*it)->setReference (markers);
+
+      // Starting configuration.
+      if (start.size () != anchor_->offset ().size ())
+	{
+	  boost::format fmt
+	    ("invalid starting configuration size (%d, %d expected)");
+	  fmt % start.size () % anchor_->offset ().size ();
+	  throw std::runtime_error (fmt.str ());
 	}
-      // for other frames, start from previous frame
-      else
+      anchor_->offset () = start;
+
+      // A (anchor + d) + b = A d + (A anchor + b)
+      typename std::vector<std::pair<numericLinearFunctionShPtr_t,
+				     numericLinearFunctionShPtr_t> >
+	::const_iterator itLinear;
+      for (itLinear = linearConstraints_.begin ();
+	   itLinear != linearConstraints_.end (); ++itLinear)
+	itLinear->second->b () =
+	  itLinear->first->A () * anchor_->offset () + itLinear->first->b ();
+
+      // lower - anchor <= d <= upper - anchor
+      if (!limits_.empty ())
 	{
-	  Function::vector_t::Index start =
-	    static_cast<Function::vector_t::Index>
-	    ((options_.frameId - 1) * length);
-
-	  problem->startingPoint () =
-	    data.outputTrajectoryReduced->parameters ().segment
-	    (start, length);
+	  typename T::intervals_t& bounds = safeGet (problem_).argumentBounds ();
+	  for (std::size_t i = 0; i < limits_.size (); ++i)
+	    {
+	      const Function::value_type offset =
+		anchor_->offset ()[static_cast<Function::vector_t::Index> (i)];
+	      bounds[i] = Function::makeInterval
+		(limits_[i].first - offset, limits_[i].second - offset);
+	    }
 	}
+    }
 
+    template <typename T>
+    typename MarkerToJointIncrementalProblemBuilder<T>::vector_t
+    MarkerToJointIncrementalProblemBuilder<T>::configuration
+    (const vector_t& x) const
+    {
+      return anchor () + x;
+    }
+
+    template <typename T>
+    const typename MarkerToJointIncrementalProblemBuilder<T>::vector_t&
+    MarkerToJointIncrementalProblemBuilder<T>::anchor () const
+    {
+      if (!anchor_)
+	throw std::runtime_error
+	  ("the problem must be built before retrieving the anchor");
+      return anchor_->offset ();
     }
   } // end of namespace retargeting.
 } // end of namespace roboptim.
@@ -16,11 +16,18 @@
 // along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef ROBOPTIM_RETARGETING_PROBLEM_PROBLEM_BUILDER_HH
 # define ROBOPTIM_RETARGETING_PROBLEM_PROBLEM_BUILDER_HH
+# include <stdexcept>
+# include <string>
+# include <utility>
+
+# include <boost/format.hpp>
+# include <boost/lexical_cast.hpp>
 # include <boost/shared_ptr.hpp>
 
 # include <roboptim/core/differentiable-function.hh>
 # include <roboptim/core/linear-function.hh>
 # include <roboptim/core/problem.hh>
+# include <roboptim/core/solver.hh>
 
 namespace roboptim
 {
@@ -46,6 +53,78 @@ namespace roboptim
       >
     sparseProblem_t;
 
+    /// \brief Define dense solver type.
+    typedef roboptim::Solver<
+      roboptim::GenericDifferentiableFunction<EigenMatrixDense>,
+      boost::mpl::vector<
+	roboptim::GenericLinearFunction<EigenMatrixDense>,
+	roboptim::GenericDifferentiableFunction<EigenMatrixDense>
+	>
+      >
+    denseSolver_t;
+
+    /// \brief Define sparse solver type.
+    ///
+    /// The solver receives the sparse jacobians of the problem
+    /// functions, i.e. their true sparsity pattern.
+    typedef roboptim::Solver<
+      roboptim::GenericDifferentiableFunction<EigenMatrixSparse>,
+      boost::mpl::vector<
+	roboptim::GenericLinearFunction<EigenMatrixSparse>,
+	roboptim::GenericDifferentiableFunction<EigenMatrixSparse>
+	>
+      >
+    sparseSolver_t;
+
+    /// \brief Keep the cost function of a dense problem alive.
+    ///
+    /// Problems only store a reference to their cost function, the
+    /// shared pointer is therefore kept in the problem data.
+    template <typename D>
+    void
+    storeCost (D& data, const boost::shared_ptr<DifferentiableFunction>& cost)
+    {
+      data.cost = cost;
+    }
+
+    /// \brief Keep the cost function of a sparse problem alive.
+    template <typename D>
+    void
+    storeCost (D& data,
+	       const boost::shared_ptr<
+		 GenericDifferentiableFunction<EigenMatrixSparse> >& cost)
+    {
+      data.sparseCost = cost;
+    }
+
+    /// \brief Parse a NAME=WEIGHT option (e.g. --smoothness-weight).
+    ///
+    /// \param[in] option option value
+    /// \return name and (non-negative) weight
+    inline std::pair<std::string, Function::value_type>
+    parseWeight (const std::string& option)
+    {
+      const std::string::size_type separator = option.rfind ('=');
+      boost::format fmt ("invalid weight ``%s'' (NAME=WEIGHT expected)");
+      fmt % option;
+      if (separator == std::string::npos || separator == 0)
+	throw std::runtime_error (fmt.str ());
+
+      Function::value_type weight = 0.;
+      try
+	{
+	  weight = boost::lexical_cast<Function::value_type>
+	    (option.substr (separator + 1));
+	}
+      catch (const boost::bad_lexical_cast&)
+	{
+	  throw std::runtime_error (fmt.str ());
+	}
+      if (weight < 0.)
+	throw std::runtime_error (fmt.str ());
+      return std::make_pair (option.substr (0, separator), weight);
+    }
+
     /// \brief Abstract Base Class for problem builders.
     ///
     /// A problem builder is a class builder a RobOptim problem.
@@ -0,0 +1,143 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_RESAMPLING_HH
+# define ROBOPTIM_RETARGETING_RESAMPLING_HH
+# include <algorithm>
+# include <cmath>
+# include <stdexcept>
+
+# include <boost/format.hpp>
+
+# include <roboptim/core/function.hh>
+
+# include <roboptim/retargeting/temporal-multigrid.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Anti-aliasing filter used before decimating by factor.
+    ///
+    /// Hamming-windowed sinc low-pass filter whose cut-off frequency
+    /// is the Nyquist frequency of the decimated trajectory (half a
+    /// cycle every factor frames). The filter has 4 factor + 1 taps,
+    /// it is symmetric (no phase shift) and its gain is one at zero
+    /// frequency (constant trajectories are preserved).
+    ///
+    /// \param[in] factor decimation factor (one means no filtering)
+    /// \return filter taps, centered on the middle one
+    inline Function::vector_t
+    lowPassFilterTaps (Function::vector_t::Index factor)
+    {
+      typedef Function::vector_t::Index index_t;
+      typedef Function::value_type value_type;
+
+      if (factor < 1)
+	{
+	  boost::format fmt ("invalid resampling factor (%d)");
+	  fmt % factor;
+	  throw std::runtime_error (fmt.str ());
+	}
+      if (factor == 1)
+	return Function::vector_t::Ones (1);
+
+      const index_t halfWidth = 2 * factor;
+      const value_type cutOff = 1. / static_cast<value_type> (factor);
+
+      Function::vector_t taps (2 * halfWidth + 1);
+      for (index_t k = -halfWidth; k <= halfWidth; ++k)
+	{
+	  const value_type x = M_PI * cutOff * static_cast<value_type> (k);
+	  const value_type sinc = k == 0 ? 1. : std::sin (x) / x;
+	  const value_type window = .54 + .46
+	    * std::cos (M_PI * static_cast<value_type> (k)
+			/ static_cast<value_type> (halfWidth));
+	  taps[k + halfWidth] = sinc * window;
+	}
+      return taps / taps.sum ();
+    }
+
+    /// \brief Low-pass filter then decimate a discrete trajectory.
+    ///
+    /// Frames 0, factor, 2 factor, ... are kept (see
+    /// decimatedFrameCount) but each one is replaced by the filtered
+    /// value at this frame, so that the motion faster than the new
+    /// frame rate does not alias. Only the kept frames are filtered.
+    /// The first and last frames are repeated beyond the trajectory
+    /// boundaries.
+    ///
+    /// Each DOF is filtered independently: angles must not wrap
+    /// around within the trajectory.
+    ///
+    /// \param[in] parameters discrete trajectory parameters (size:
+    ///            number of frames * number of DOFs)
+    /// \param[in] nDofs number of DOFs of each frame
+    /// \param[in] factor resampling factor (input frames per output
+    ///            frame)
+    /// \return resampled trajectory parameters
+    inline Function::vector_t
+    downsampleFrames (const Function::vector_t& parameters,
+		      Function::vector_t::Index nDofs,
+		      Function::vector_t::Index factor)
+    {
+      typedef Function::vector_t::Index index_t;
+
+      const Function::vector_t taps = lowPassFilterTaps (factor);
+      const index_t halfWidth = (taps.size () - 1) / 2;
+
+      const index_t nFrames = parameters.size () / nDofs;
+      const index_t nOutputFrames = decimatedFrameCount (nFrames, factor);
+
+      Function::vector_t result (nOutputFrames * nDofs);
+      result.setZero ();
+      for (index_t frame = 0; frame < nOutputFrames; ++frame)
+	for (index_t k = -halfWidth; k <= halfWidth; ++k)
+	  {
+	    const index_t input =
+	      std::min (std::max<index_t> (frame * factor + k, 0),
+			nFrames - 1);
+	    result.segment (frame * nDofs, nDofs) +=
+	      taps[k + halfWidth] * parameters.segment (input * nDofs, nDofs);
+	  }
+      return result;
+    }
+
+    /// \brief Bring a resampled trajectory back to the input frame
+    ///        rate.
+    ///
+    /// The resampled trajectory does not contain frequencies higher
+    /// than its Nyquist frequency: linear interpolation between its
+    /// frames is sufficient (see interpolateFrames).
+    ///
+    /// \param[in] parameters resampled trajectory parameters
+    /// \param[in] nDofs number of DOFs of each frame
+    /// \param[in] factor resampling factor
+    /// \param[in] nFrames number of frames of the input trajectory
+    /// \return trajectory parameters (size: nFrames * nDofs)
+    inline Function::vector_t
+    upsampleFrames (const Function::vector_t& parameters,
+		    Function::vector_t::Index nDofs,
+		    Function::vector_t::Index factor,
+		    Function::vector_t::Index nFrames)
+    {
+      return interpolateFrames (parameters, nDofs, factor, nFrames);
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_RESAMPLING_HH
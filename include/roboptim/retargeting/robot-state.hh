@@ -0,0 +1,235 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_ROBOT_STATE_HH
+# define ROBOPTIM_RETARGETING_ROBOT_STATE_HH
+# include <iostream>
+
+# include <boost/make_shared.hpp>
+# include <boost/shared_ptr.hpp>
+
+# include <cnoid/Body>
+
+# include <roboptim/core/indent.hh>
+
+# include <roboptim/retargeting/choreonoid.hh>
+# include <roboptim/retargeting/utility.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (RobotState);
+
+    /// \brief Choreonoid robot wrapper caching forward kinematics.
+    ///
+    /// Several functions (joint to marker, forward geometry, ZMP,
+    /// etc.) share the same robot model and are usually evaluated
+    /// at the same configuration during one solver iteration. This
+    /// class remembers the configuration (and optionally the
+    /// velocity and acceleration) used for the last forward
+    /// kinematics pass and skips the computation if it is requested
+    /// again for the exact same values.
+    ///
+    /// To keep the cache consistent, all the functions sharing a
+    /// robot must update it through this object and never modify
+    /// the joints values directly.
+    ///
+    /// The configuration layout is the one used by
+    /// updateRobotConfiguration: free-floating (translation, Euler
+    /// angles) followed by the joints values.
+    class RobotState
+    {
+    public:
+      typedef Eigen::Matrix<double, Eigen::Dynamic, 1> vector_t;
+
+      /// \brief Forward kinematics level stored in the cache.
+      enum Level
+	{
+	  /// \brief Nothing has been computed yet.
+	  LEVEL_NONE = -1,
+	  /// \brief Bodies positions are up-to-date.
+	  LEVEL_POSITION = 0,
+	  /// \brief Bodies positions and velocities are up-to-date.
+	  LEVEL_VELOCITY = 1,
+	  /// \brief Positions, velocities and accelerations are up-to-date.
+	  LEVEL_ACCELERATION = 2
+	};
+
+      explicit RobotState (cnoid::BodyPtr robot)
+	: robot_ (robot),
+	  level_ (LEVEL_NONE),
+	  q_ (6 + robot->numJoints ()),
+	  dq_ (robot->numJoints ()),
+	  ddq_ (robot->numJoints ()),
+	  hits_ (0),
+	  misses_ (0)
+      {
+	q_.setZero ();
+	dq_.setZero ();
+	ddq_.setZero ();
+      }
+
+      ~RobotState ()
+      {}
+
+      /// \brief Underlying Choreonoid robot.
+      ///
+      /// Bodies positions can be read from it after an update.
+      const cnoid::BodyPtr& robot () const
+      {
+	return robot_;
+      }
+
+      /// \brief Update bodies positions.
+      ///
+      /// \param x robot configuration (6 + number of joints)
+      /// \return true if the cache has been used, false if forward
+      ///         kinematics had to be computed
+      template <typename Derived>
+      bool update (const Eigen::MatrixBase<Derived>& x)
+      {
+	if (level_ >= LEVEL_POSITION && q_ == x)
+	  {
+	    ++hits_;
+	    return true;
+	  }
+	++misses_;
+
+	q_ = x;
+	updateRobotConfiguration (robot_, x);
+	robot_->calcForwardKinematics ();
+	level_ = LEVEL_POSITION;
+	return false;
+      }
+
+      /// \brief Update bodies positions, velocities and accelerations.
+      ///
+      /// The joints velocities and accelerations do not include the
+      /// free-floating part.
+      ///
+      /// \param x robot configuration (6 + number of joints)
+      /// \param dq joints velocities (number of joints)
+      /// \param ddq joints accelerations (number of joints)
+      /// \return true if the cache has been used, false if forward
+      ///         kinematics had to be computed
+      template <typename Derived, typename DerivedV, typename DerivedA>
+      bool update (const Eigen::MatrixBase<Derived>& x,
+		   const Eigen::MatrixBase<DerivedV>& dq,
+		   const Eigen::MatrixBase<DerivedA>& ddq)
+      {
+	if (level_ >= LEVEL_ACCELERATION
+	    && q_ == x && dq_ == dq && ddq_ == ddq)
+	  {
+	    ++hits_;
+	    return true;
+	  }
+	++misses_;
+
+	q_ = x;
+	dq_ = dq;
+	ddq_ = ddq;
+
+	updateRobotConfiguration (robot_, x);
+	for (int dofId = 0; dofId < robot_->numJoints (); ++dofId)
+	  {
+	    robot_->joint (dofId)->dq () = dq[dofId];
+	    robot_->joint (dofId)->ddq () = ddq[dofId];
+	  }
+	robot_->calcForwardKinematics (true, true);
+	level_ = LEVEL_ACCELERATION;
+	return false;
+      }
+
+      /// \brief Forget the cached configuration.
+      ///
+      /// Must be called if the robot has been modified without
+      /// using this object.
+      void invalidate ()
+      {
+	level_ = LEVEL_NONE;
+      }
+
+      /// \name Cache statistics.
+      /// \{
+
+      std::size_t hits () const
+      {
+	return hits_;
+      }
+
+      std::size_t misses () const
+      {
+	return misses_;
+      }
+
+      /// \brief Ratio of updates served by the cache (0 if unused).
+      double hitRate () const
+      {
+	if (hits_ + misses_ == 0)
+	  return 0.;
+	return static_cast<double> (hits_)
+	  / static_cast<double> (hits_ + misses_);
+      }
+
+      void resetStatistics ()
+      {
+	hits_ = 0;
+	misses_ = 0;
+      }
+
+      /// \}
+
+      std::ostream& print (std::ostream& o) const
+      {
+	o << "Robot state (" << robot_->modelName () << ")" << incindent
+	  << iendl << "forward kinematics cache hits: " << hits_
+	  << iendl << "forward kinematics cache misses: " << misses_
+	  << iendl << "forward kinematics cache hit rate: "
+	  << 100. * hitRate () << "%" << decindent;
+	return o;
+      }
+
+    private:
+      /// \brief Choreonoid robot.
+      cnoid::BodyPtr robot_;
+
+      /// \brief Which quantities are up-to-date?
+      Level level_;
+
+      /// \brief Configuration used for the last update.
+      vector_t q_;
+      /// \brief Joints velocities used for the last update.
+      vector_t dq_;
+      /// \brief Joints accelerations used for the last update.
+      vector_t ddq_;
+
+      /// \brief Number of updates served by the cache.
+      std::size_t hits_;
+      /// \brief Number of forward kinematics passes.
+      std::size_t misses_;
+    };
+
+    inline std::ostream&
+    operator<< (std::ostream& o, const RobotState& robotState)
+    {
+      return robotState.print (o);
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_ROBOT_STATE_HH
@@ -0,0 +1,303 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_TEMPORAL_CONSENSUS_HH
+# define ROBOPTIM_RETARGETING_TEMPORAL_CONSENSUS_HH
+# include <cmath>
+# include <stdexcept>
+# include <utility>
+# include <vector>
+
+# include <boost/format.hpp>
+
+# include <roboptim/core/function.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Split a trajectory into overlapping segments.
+    ///
+    /// Two consecutive segments share overlap frames. The frames
+    /// shared with the previous segment and the ones shared with the
+    /// next segment never intersect.
+    ///
+    /// \param[in] nFrames number of frames of the trajectory
+    /// \param[in] nSegments number of segments
+    /// \param[in] overlap number of frames shared by two consecutive
+    ///            segments
+    /// \return first and past-the-end frames of each segment
+    inline std::vector<std::pair<Function::vector_t::Index,
+				 Function::vector_t::Index> >
+    overlappingSegments (Function::vector_t::Index nFrames,
+			 Function::vector_t::Index nSegments,
+			 Function::vector_t::Index overlap)
+    {
+      typedef Function::vector_t::Index index_t;
+
+      if (nSegments < 1 || overlap < 0)
+	throw std::runtime_error ("invalid segments");
+      if ((nFrames - overlap) / nSegments < std::max<index_t> (overlap, 1))
+	{
+	  boost::format fmt
+	    ("not enough frames (%d) for %d segments overlapping by %d"
+	     " frames");
+	  fmt % nFrames % nSegments % overlap;
+	  throw std::runtime_error (fmt.str ());
+	}
+
+      std::vector<std::pair<index_t, index_t> > segments;
+      for (index_t k = 0; k < nSegments; ++k)
+	segments.push_back
+	  (std::make_pair
+	   (k * (nFrames - overlap) / nSegments,
+	    k + 1 < nSegments
+	    ? (k + 1) * (nFrames - overlap) / nSegments + overlap
+	    : nFrames));
+      return segments;
+    }
+
+    /// \brief Consensus of overlapping trajectory segments (ADMM).
+    ///
+    /// Each segment is solved separately, the frames shared by two
+    /// segments must agree. Each shared block has a consensus value
+    /// z and each segment a scaled dual variable u per shared block
+    /// (alternating direction method of multipliers, consensus
+    /// form). One iteration is:
+    ///
+    /// - each segment minimizes its cost plus the proximal term
+    ///   \f$ \frac{\rho}{2} ||x_o - (z - u)||^2 \f$ on its shared
+    ///   frames (see weights and reference),
+    /// - update: z is the average of x_o + u over the two segments
+    ///   sharing the block, then u += x_o - z.
+    ///
+    /// The primal residual is the distance between the segments
+    /// shared frames and the consensus, the dual residual the change
+    /// of the consensus (times rho).
+    class TemporalConsensus
+    {
+    public:
+      typedef Function::value_type value_type;
+      typedef Function::vector_t vector_t;
+      typedef vector_t::Index index_t;
+      typedef std::pair<index_t, index_t> segment_t;
+
+      /// \brief Constructor.
+      ///
+      /// \param segments first and past-the-end frames of each
+      ///        segment (see overlappingSegments)
+      /// \param overlap number of frames shared by two consecutive
+      ///        segments
+      /// \param nDofs number of DOFs of each frame
+      /// \param rho penalty parameter
+      /// \param initial whole trajectory parameters, the consensus
+      ///        starts from its shared frames
+      TemporalConsensus (const std::vector<segment_t>& segments,
+			 index_t overlap,
+			 index_t nDofs,
+			 value_type rho,
+			 const vector_t& initial)
+	: segments_ (segments),
+	  overlap_ (overlap),
+	  nDofs_ (nDofs),
+	  rho_ (rho),
+	  z_ (),
+	  uPrevious_ (),
+	  uNext_ (),
+	  primalResidual_ (0.),
+	  dualResidual_ (0.)
+      {
+	if (segments_.empty () || rho_ <= 0.)
+	  throw std::runtime_error ("invalid consensus");
+	if (initial.size () != segments_.back ().second * nDofs_)
+	  {
+	    boost::format fmt
+	      ("invalid trajectory size (%d, %d expected)");
+	    fmt % initial.size () % (segments_.back ().second * nDofs_);
+	    throw std::runtime_error (fmt.str ());
+	  }
+
+	for (std::size_t j = 0; j + 1 < segments_.size (); ++j)
+	  {
+	    z_.push_back
+	      (initial.segment (segments_[j + 1].first * nDofs_, blockSize ()));
+	    uPrevious_.push_back (vector_t::Zero (blockSize ()));
+	    uNext_.push_back (vector_t::Zero (blockSize ()));
+	  }
+      }
+
+      /// \brief Segments.
+      const std::vector<segment_t>& segments () const
+      {
+	return segments_;
+      }
+
+      /// \brief Penalty parameter.
+      value_type rho () const
+      {
+	return rho_;
+      }
+
+      /// \brief Weights of the proximal term of a segment.
+      ///
+      /// \param k segment id
+      /// \return rho on the shared frames, zero elsewhere (size:
+      ///         segment parameters size)
+      vector_t weights (std::size_t k) const
+      {
+	vector_t weights = vector_t::Zero (segmentSize (k));
+	if (k > 0)
+	  weights.head (blockSize ()).setConstant (rho_);
+	if (k + 1 < segments_.size ())
+	  weights.tail (blockSize ()).setConstant (rho_);
+	return weights;
+      }
+
+      /// \brief Reference of the proximal term of a segment.
+      ///
+      /// \param k segment id
+      /// \return z - u on the shared frames, zero elsewhere (size:
+      ///         segment parameters size)
+      vector_t reference (std::size_t k) const
+      {
+	vector_t reference = vector_t::Zero (segmentSize (k));
+	if (k > 0)
+	  reference.head (blockSize ()) = z_[k - 1] - uNext_[k - 1];
+	if (k + 1 < segments_.size ())
+	  reference.tail (blockSize ()) = z_[k] - uPrevious_[k];
+	return reference;
+      }
+
+      /// \brief Update the consensus and the dual variables.
+      ///
+      /// \param solutions parameters of each segment
+      /// \return primal residual
+      value_type update (const std::vector<vector_t>& solutions)
+      {
+	if (solutions.size () != segments_.size ())
+	  throw std::runtime_error ("one solution per segment is expected");
+
+	value_type primal = 0.;
+	value_type dual = 0.;
+	for (std::size_t j = 0; j < z_.size (); ++j)
+	  {
+	    // block j: tail of segment j, head of segment j + 1
+	    const vector_t& previous = solutions[j];
+	    const vector_t& next = solutions[j + 1];
+	    checkSize (previous, j);
+	    checkSize (next, j + 1);
+
+	    const vector_t z = z_[j];
+	    z_[j] =
+	      .5 * (previous.tail (blockSize ()) + uPrevious_[j]
+		    + next.head (blockSize ()) + uNext_[j]);
+	    uPrevious_[j] += previous.tail (blockSize ()) - z_[j];
+	    uNext_[j] += next.head (blockSize ()) - z_[j];
+
+	    primal += (previous.tail (blockSize ()) - z_[j]).squaredNorm ()
+	      + (next.head (blockSize ()) - z_[j]).squaredNorm ();
+	    dual += 2. * rho_ * rho_ * (z_[j] - z).squaredNorm ();
+	  }
+	primalResidual_ = std::sqrt (primal);
+	dualResidual_ = std::sqrt (dual);
+	return primalResidual_;
+      }
+
+      /// \brief Primal residual of the last update.
+      value_type primalResidual () const
+      {
+	return primalResidual_;
+      }
+
+      /// \brief Dual residual of the last update.
+      value_type dualResidual () const
+      {
+	return dualResidual_;
+      }
+
+      /// \brief Whole trajectory.
+      ///
+      /// \param solutions parameters of each segment
+      /// \return trajectory parameters, the shared frames being the
+      ///         consensus
+      vector_t assemble (const std::vector<vector_t>& solutions) const
+      {
+	if (solutions.size () != segments_.size ())
+	  throw std::runtime_error ("one solution per segment is expected");
+
+	vector_t result (segments_.back ().second * nDofs_);
+	for (std::size_t k = 0; k < segments_.size (); ++k)
+	  {
+	    checkSize (solutions[k], k);
+	    result.segment (segments_[k].first * nDofs_, segmentSize (k)) =
+	      solutions[k];
+	  }
+	for (std::size_t j = 0; j < z_.size (); ++j)
+	  result.segment (segments_[j + 1].first * nDofs_, blockSize ()) =
+	    z_[j];
+	return result;
+      }
+
+    private:
+      /// \brief Size of the shared parameters of two segments.
+      index_t blockSize () const
+      {
+	return overlap_ * nDofs_;
+      }
+
+      /// \brief Parameters size of a segment.
+      index_t segmentSize (std::size_t k) const
+      {
+	return (segments_[k].second - segments_[k].first) * nDofs_;
+      }
+
+      void checkSize (const vector_t& solution, std::size_t k) const
+      {
+	if (solution.size () != segmentSize (k))
+	  {
+	    boost::format fmt
+	      ("invalid solution size for segment %d (%d, %d expected)");
+	    fmt % k % solution.size () % segmentSize (k);
+	    throw std::runtime_error (fmt.str ());
+	  }
+      }
+
+      /// \brief First and past-the-end frames of each segment.
+      std::vector<segment_t> segments_;
+      /// \brief Frames shared by two consecutive segments.
+      index_t overlap_;
+      /// \brief Number of DOFs of each frame.
+      index_t nDofs_;
+      /// \brief Penalty parameter.
+      value_type rho_;
+      /// \brief Consensus value of each shared block.
+      std::vector<vector_t> z_;
+      /// \brief Scaled dual variables of the segment preceding each
+      ///        shared block.
+      std::vector<vector_t> uPrevious_;
+      /// \brief Scaled dual variables of the segment following each
+      ///        shared block.
+      std::vector<vector_t> uNext_;
+      /// \brief Primal residual of the last update.
+      value_type primalResidual_;
+      /// \brief Dual residual of the last update.
+      value_type dualResidual_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_TEMPORAL_CONSENSUS_HH
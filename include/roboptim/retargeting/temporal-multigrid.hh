@@ -0,0 +1,138 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_TEMPORAL_MULTIGRID_HH
+# define ROBOPTIM_RETARGETING_TEMPORAL_MULTIGRID_HH
+# include <algorithm>
+# include <stdexcept>
+
+# include <boost/format.hpp>
+
+# include <roboptim/core/function.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    /// \brief Number of frames kept when decimating a trajectory.
+    ///
+    /// Frames 0, factor, 2 factor, ... are kept: the last frames of
+    /// the trajectory are dropped if the number of intervals is not
+    /// a multiple of the factor.
+    ///
+    /// \param[in] nFrames number of frames of the trajectory
+    /// \param[in] factor decimation factor (one means no decimation)
+    /// \return number of frames of the decimated trajectory
+    inline Function::vector_t::Index
+    decimatedFrameCount (Function::vector_t::Index nFrames,
+			 Function::vector_t::Index factor)
+    {
+      if (nFrames < 1)
+	throw std::runtime_error ("empty trajectory");
+      if (factor < 1)
+	{
+	  boost::format fmt ("invalid decimation factor (%d)");
+	  fmt % factor;
+	  throw std::runtime_error (fmt.str ());
+	}
+      return (nFrames - 1) / factor + 1;
+    }
+
+    /// \brief Keep one frame every factor frames of a discrete
+    ///        trajectory.
+    ///
+    /// This is the restriction operator of the temporal multigrid:
+    /// the coarse trajectory samples the fine one every factor
+    /// frames.
+    ///
+    /// \param[in] parameters discrete trajectory parameters (size:
+    ///            number of frames * number of DOFs)
+    /// \param[in] nDofs number of DOFs of each frame
+    /// \param[in] factor decimation factor
+    /// \return decimated trajectory parameters
+    inline Function::vector_t
+    decimateFrames (const Function::vector_t& parameters,
+		    Function::vector_t::Index nDofs,
+		    Function::vector_t::Index factor)
+    {
+      typedef Function::vector_t::Index index_t;
+
+      const index_t nFrames =
+	decimatedFrameCount (parameters.size () / nDofs, factor);
+
+      Function::vector_t result (nFrames * nDofs);
+      for (index_t frame = 0; frame < nFrames; ++frame)
+	result.segment (frame * nDofs, nDofs) =
+	  parameters.segment (frame * factor * nDofs, nDofs);
+      return result;
+    }
+
+    /// \brief Linearly interpolate a decimated discrete trajectory.
+    ///
+    /// This is the prolongation operator of the temporal multigrid:
+    /// frame k of the fine trajectory lies at k / factor on the
+    /// coarse one. The fine frames following the last coarse frame
+    /// keep its value.
+    ///
+    /// \param[in] parameters coarse trajectory parameters
+    /// \param[in] nDofs number of DOFs of each frame
+    /// \param[in] factor decimation factor of the coarse trajectory
+    /// \param[in] nFrames number of frames of the fine trajectory
+    /// \return fine trajectory parameters (size: nFrames * nDofs)
+    inline Function::vector_t
+    interpolateFrames (const Function::vector_t& parameters,
+		       Function::vector_t::Index nDofs,
+		       Function::vector_t::Index factor,
+		       Function::vector_t::Index nFrames)
+    {
+      typedef Function::vector_t::Index index_t;
+
+      const index_t nCoarseFrames = parameters.size () / nDofs;
+      if (nCoarseFrames != decimatedFrameCount (nFrames, factor))
+	{
+	  boost::format fmt
+	    ("invalid number of frames (%d, %d expected"
+	     " to interpolate %d frames)");
+	  fmt % nCoarseFrames % decimatedFrameCount (nFrames, factor)
+	    % nFrames;
+	  throw std::runtime_error (fmt.str ());
+	}
+
+      Function::vector_t result (nFrames * nDofs);
+      for (index_t frame = 0; frame < nFrames; ++frame)
+	{
+	  const index_t coarse =
+	    std::min (frame / factor, nCoarseFrames - 1);
+	  const index_t next = std::min (coarse + 1, nCoarseFrames - 1);
+	  const Function::value_type alpha =
+	    static_cast<Function::value_type> (frame - coarse * factor)
+	    / static_cast<Function::value_type> (factor);
+
+	  if (next == coarse)
+	    result.segment (frame * nDofs, nDofs) =
+	      parameters.segment (coarse * nDofs, nDofs);
+	  else
+	    result.segment (frame * nDofs, nDofs) =
+	      (1. - alpha) * parameters.segment (coarse * nDofs, nDofs)
+	      + alpha * parameters.segment (next * nDofs, nDofs);
+	}
+      return result;
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_TEMPORAL_MULTIGRID_HH
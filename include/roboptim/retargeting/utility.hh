@@ -81,7 +81,7 @@
     typedef CLASS< ::roboptim::EigenMatrixDense> CLASS##Dense;		\
     typedef CLASS< ::roboptim::EigenMatrixSparse> CLASS##Sparse;	\
     typedef boost::shared_ptr<CLASS##Dense> CLASS##Dense##ShPtr;	\
-    typedef boost::shared_ptr<CLASS##Dense> CLASS##Dense##ShPtr;	\
+    typedef boost::shared_ptr<CLASS##Sparse> CLASS##Sparse##ShPtr;	\
     struct e_n_d__w_i_t_h__s_e_m_i_c_o_l_o_n
 
 
@@ -0,0 +1,137 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ROBOPTIM_RETARGETING_WORKER_POOL_HH
+# define ROBOPTIM_RETARGETING_WORKER_POOL_HH
+# include <cstddef>
+# include <string>
+
+# include <boost/function.hpp>
+# include <boost/noncopyable.hpp>
+# include <boost/shared_ptr.hpp>
+# include <boost/thread/condition_variable.hpp>
+# include <boost/thread/mutex.hpp>
+# include <boost/thread/thread.hpp>
+
+# include <roboptim/retargeting/config.hh>
+# include <roboptim/retargeting/utility.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    ROBOPTIM_RETARGETING_PREDECLARE_CLASS (WorkerPool);
+
+    /// \brief Fixed-size pool of threads executing indexed tasks.
+    ///
+    /// A pool of size N uses the calling thread plus N - 1
+    /// background threads. Each thread has a worker id in [0, N)
+    /// (the calling thread always being worker 0) which is used by
+    /// the functions to look up their evaluation context, see
+    /// EvaluationContextPool.
+    ///
+    /// Nested calls to run from a worker thread are executed
+    /// sequentially by this worker. A call from another thread
+    /// while the pool is running tasks waits until the pool is free:
+    /// both calling threads would be worker 0 otherwise.
+    ///
+    /// A process-wide pool is available through WorkerPool::shared
+    /// and is sized by the command line tools through the --jobs
+    /// option.
+    class ROBOPTIM_RETARGETING_DLLEXPORT WorkerPool : boost::noncopyable
+    {
+    public:
+      /// \brief Task type, called with the task index.
+      typedef boost::function<void (std::size_t)> task_t;
+
+      /// \brief Create a pool.
+      ///
+      /// \param nWorkers number of workers, including the calling
+      ///                 thread (0 is treated as 1)
+      explicit WorkerPool (std::size_t nWorkers);
+      ~WorkerPool ();
+
+      /// \brief Number of workers, including the calling thread.
+      std::size_t size () const;
+
+      /// \brief Run task (i) for i in [0, nTasks).
+      ///
+      /// Tasks are distributed among the workers and this call
+      /// blocks until all of them are done. If a task throws, the
+      /// first exception is rethrown (as std::runtime_error) once
+      /// all the workers are idle.
+      void run (std::size_t nTasks, const task_t& task);
+
+      /// \brief Worker id of the current thread.
+      ///
+      /// Return 0 for threads which do not belong to a pool.
+      static std::size_t workerId ();
+
+      /// \brief Process-wide pool.
+      ///
+      /// Contains only the calling thread until resized.
+      static WorkerPool& shared ();
+
+      /// \brief Change the number of workers of the shared pool.
+      ///
+      /// Must not be called while the shared pool is running
+      /// tasks. Evaluation contexts must be created after this call.
+      static void resizeShared (std::size_t nWorkers);
+
+    private:
+      void workerLoop (std::size_t workerId);
+      void consume ();
+
+      /// \brief Background threads.
+      boost::thread_group threads_;
+      /// \brief Number of workers (including the calling thread).
+      std::size_t size_;
+
+      /// \brief Protects all the following members.
+      boost::mutex mutex_;
+      /// \brief Signaled when a new batch is available.
+      boost::condition_variable wakeUp_;
+      /// \brief Signaled when the last task of a batch is done.
+      boost::condition_variable done_;
+
+      /// \brief Current task (valid while a batch is running).
+      const task_t* task_;
+      /// \brief Number of tasks of the current batch.
+      std::size_t nTasks_;
+      /// \brief Next task index to be processed.
+      std::size_t nextTask_;
+      /// \brief Number of finished tasks in the current batch.
+      std::size_t nFinished_;
+      /// \brief Batch counter, used to wake up the workers.
+      std::size_t generation_;
+      /// \brief Error message of the first failed task.
+      std::string error_;
+      /// \brief Did a task of the current batch fail?
+      bool failed_;
+      /// \brief Is a batch running?
+      bool busy_;
+      /// \brief Thread which started the running batch (worker 0).
+      boost::thread::id owner_;
+      /// \brief Signaled when the running batch is over.
+      boost::condition_variable idle_;
+      /// \brief Are the workers asked to exit?
+      bool stopping_;
+    };
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
+
+#endif //! ROBOPTIM_RETARGETING_WORKER_POOL_HH
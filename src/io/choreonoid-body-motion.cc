@@ -15,10 +15,14 @@
 // You should have received a copy of the GNU Lesser General Public License
 // along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdio>
 #include <fstream>
+#include <limits>
+#include <stdexcept>
+
 #include <boost/format.hpp>
 
-#include <yaml-cpp/yaml.h>
+#include <Eigen/Geometry>
 
 #include <roboptim/retargeting/io/choreonoid-body-motion.hh>
 
@@ -30,108 +34,143 @@ namespace roboptim
     writeBodyMotion (const std::string& filename,
 		     boost::shared_ptr<roboptim::Trajectory<3> > result)
     {
-      typedef Eigen::Quaternion<
-	roboptim::Function::value_type> quaternion_t;
-
-      std::ofstream fout (filename.c_str ());
-      if (!fout.good ())
-	throw std::runtime_error ("bad stream");
-
       int numFrames =
 	static_cast<int> (result->parameters ().size () / result->outputSize ());
       double dt = result->length () / numFrames;
 
-      int nDofs = static_cast<int> (result->outputSize ());
-
-      YAML::Emitter out;
-      out
-	<< YAML::Comment("Generated by roboptim-retargeting")
-	<< YAML::BeginMap
-	<< YAML::Key << "type"
-	<< YAML::Value << "BodyMotion"
-	<< YAML::Key << "components"
-	<< YAML::Value
-	<< YAML::BeginSeq
-
-	<< YAML::BeginMap
-	<< YAML::Key << "type"
-	<< YAML::Value << "MultiValueSeq"
-	<< YAML::Key << "content"
-	<< YAML::Value << "JointPosition"
-	<< YAML::Key << "frameRate"
-	<< YAML::Value << 1. / dt
-	<< YAML::Key << "numFrames"
-	<< YAML::Value << numFrames
-	<< YAML::Key << "numParts"
-	<< YAML::Value << nDofs - 6
-	<< YAML::Key << "frames"
-	<< YAML::Value
-
-	<< YAML::BeginSeq;
-
+      BodyMotionWriter writer
+	(filename, numFrames, static_cast<int> (result->outputSize ()),
+	 1. / dt);
       for (int frameId = 0; frameId < numFrames; ++frameId)
-	{
-	  roboptim::Function::vector_t
-	    oneFrame = (*result) (frameId * dt);
-	  out << YAML::Flow << YAML::BeginSeq;
-	  for (int dofId = 6; dofId < result->outputSize (); ++dofId)
-	    out << oneFrame[dofId];
-	  out << YAML::EndSeq;
-	}
-      out << YAML::EndSeq;
-      out << YAML::EndMap;
-
-      out
-	<< YAML::BeginMap
-	<< YAML::Key << "type"
-	<< YAML::Value << "MultiSE3Seq"
-	<< YAML::Key << "content"
-	<< YAML::Value << "LinkPosition"
-	<< YAML::Key << "frameRate"
-	<< YAML::Value << 1. / dt
-	<< YAML::Key << "numFrames"
-	<< YAML::Value << numFrames
-	<< YAML::Key << "numParts"
-	<< YAML::Value << 1
-	<< YAML::Key << "format"
-	<< YAML::Value << "XYZQWQXQYQZ"
-	<< YAML::Key << "frames"
-	<< YAML::Value
-
-	<< YAML::BeginSeq;
-      for (int frameId = 0; frameId < numFrames; ++frameId)
-	{
-	  roboptim::Function::vector_t
-	    oneFrame = (*result) (frameId * dt);
-
-	  // The free floating position (7 parameters) is considered as
-	  // one part.
-	  out << YAML::Flow << YAML::BeginSeq << YAML::BeginSeq;
-	  for (int dofId = 0; dofId < 3; ++dofId)
-	    out << oneFrame[dofId];
-
-	  roboptim::Function::value_type
-	    norm = oneFrame.segment (3, 3).norm ();
+	writer.write ((*result) (frameId * dt));
+      writer.close ();
+    }
 
-	  quaternion_t quaternion;
-	  quaternion.setIdentity ();
+    BodyMotionWriter::BodyMotionWriter (const std::string& filename,
+					int numFrames, int nDofs,
+					double frameRate)
+      : filename_ (filename),
+	baseFilename_ (filename + ".base.tmp"),
+	out_ (filename.c_str ()),
+	base_ (baseFilename_.c_str ()),
+	numFrames_ (numFrames),
+	nDofs_ (nDofs),
+	frameRate_ (frameRate),
+	numFramesWritten_ (0),
+	closed_ (false)
+    {
+      if (!out_.good () || !base_.good ())
+	throw std::runtime_error ("bad stream");
+      if (nDofs < 6)
+	throw std::runtime_error ("invalid configuration size");
+
+      out_.precision (std::numeric_limits<double>::digits10 + 2);
+      base_.precision (std::numeric_limits<double>::digits10 + 2);
+
+      out_
+	<< "# Generated by roboptim-retargeting\n"
+	<< "type: BodyMotion\n"
+	<< "components:\n"
+	<< "  - type: MultiValueSeq\n"
+	<< "    content: JointPosition\n"
+	<< "    frameRate: " << frameRate_ << "\n"
+	<< "    numFrames: " << numFrames_ << "\n"
+	<< "    numParts: " << nDofs_ - 6 << "\n"
+	<< "    frames:\n";
+    }
 
-	  if (norm >= 1e-10)
-	    quaternion = Eigen::AngleAxisd
-	      (norm, oneFrame.segment (3, 3).normalized ());
+    BodyMotionWriter::~BodyMotionWriter ()
+    {
+      if (base_.is_open ())
+	base_.close ();
+      std::remove (baseFilename_.c_str ());
+    }
 
-	  out
-	    << quaternion.w ()
-	    << quaternion.x () << quaternion.y () << quaternion.z ();
+    void
+    BodyMotionWriter::write (const vector_t& configuration)
+    {
+      typedef Eigen::Quaternion<
+	roboptim::Function::value_type> quaternion_t;
 
-	  out << YAML::EndSeq << YAML::EndSeq;
+      if (closed_)
+	throw std::runtime_error ("the body motion has been closed");
+      if (configuration.size () != nDofs_)
+	{
+	  boost::format fmt ("invalid configuration size (%d, %d expected)");
+	  fmt % configuration.size () % nDofs_;
+	  throw std::runtime_error (fmt.str ());
 	}
-      out << YAML::EndSeq;
-
-      out << YAML::EndMap;
+      if (numFramesWritten_ >= numFrames_)
+	throw std::runtime_error ("too many frames");
+
+      out_ << "      - [ ";
+      for (int dofId = 6; dofId < nDofs_; ++dofId)
+	out_ << (dofId > 6 ? ", " : "") << configuration[dofId];
+      out_ << " ]\n";
+
+      // The free floating position (7 parameters) is considered as
+      // one part.
+      roboptim::Function::value_type
+	norm = configuration.segment (3, 3).norm ();
+
+      quaternion_t quaternion;
+      quaternion.setIdentity ();
+
+      if (norm >= 1e-10)
+	quaternion = Eigen::AngleAxisd
+	  (norm, configuration.segment (3, 3).normalized ());
+
+      base_
+	<< "      - [ [ "
+	<< configuration[0] << ", "
+	<< configuration[1] << ", "
+	<< configuration[2] << ", "
+	<< quaternion.w () << ", "
+	<< quaternion.x () << ", "
+	<< quaternion.y () << ", "
+	<< quaternion.z () << " ] ]\n";
+
+      if (!out_.good () || !base_.good ())
+	throw std::runtime_error ("bad stream");
+      ++numFramesWritten_;
+    }
 
-      fout << out.c_str ();
+    void
+    BodyMotionWriter::close ()
+    {
+      if (closed_)
+	return;
+      if (numFramesWritten_ != numFrames_)
+	{
+	  boost::format fmt ("%d frames written, %d expected");
+	  fmt % numFramesWritten_ % numFrames_;
+	  throw std::runtime_error (fmt.str ());
+	}
+      closed_ = true;
+
+      base_.close ();
+      std::ifstream base (baseFilename_.c_str ());
+
+      out_
+	<< "  - type: MultiSE3Seq\n"
+	<< "    content: LinkPosition\n"
+	<< "    frameRate: " << frameRate_ << "\n"
+	<< "    numFrames: " << numFrames_ << "\n"
+	<< "    numParts: 1\n"
+	<< "    format: XYZQWQXQYQZ\n"
+	<< "    frames:\n";
+      if (numFrames_ > 0)
+	out_ << base.rdbuf ();
+      out_.close ();
+
+      if (!out_.good ())
+	throw std::runtime_error ("bad stream");
     }
 
+    int
+    BodyMotionWriter::numFramesWritten () const
+    {
+      return numFramesWritten_;
+    }
   } // end of namespace retargeting.
 } // end of namespace roboptim.
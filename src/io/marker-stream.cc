@@ -0,0 +1,290 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <roboptim/retargeting/io/marker-stream.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    namespace
+    {
+      boost::posix_time::ptime now ()
+      {
+	return boost::posix_time::microsec_clock::universal_time ();
+      }
+
+      std::runtime_error systemError (const std::string& what,
+				      const std::string& source)
+      {
+	boost::format fmt ("failed to %s marker stream %s: %s");
+	fmt % what % source % std::strerror (errno);
+	return std::runtime_error (fmt.str ());
+      }
+    } // end of anonymous namespace.
+
+    MarkerStream::MarkerStream (const std::string& source,
+				index_t nMarkers,
+				double scale,
+				double idleTimeout)
+      : fd_ (-1),
+	ownsFd_ (true),
+	follow_ (false),
+	ended_ (false),
+	nMarkers_ (nMarkers),
+	scale_ (scale),
+	idleTimeout_ (idleTimeout),
+	buffer_ (),
+	received_ (now ())
+    {
+      if (nMarkers <= 0)
+	throw std::runtime_error
+	  ("a marker stream requires at least one marker");
+
+      if (source == "-")
+	{
+	  fd_ = STDIN_FILENO;
+	  ownsFd_ = false;
+	}
+      else if (source.compare (0, 5, "unix:") == 0)
+	{
+	  const std::string path = source.substr (5);
+
+	  sockaddr_un address;
+	  std::memset (&address, 0, sizeof (address));
+	  address.sun_family = AF_UNIX;
+	  if (path.size () >= sizeof (address.sun_path))
+	    throw std::runtime_error
+	      ((boost::format ("socket path is too long: %s") % path).str ());
+	  std::strcpy (address.sun_path, path.c_str ());
+
+	  fd_ = ::socket (AF_UNIX, SOCK_STREAM, 0);
+	  if (fd_ < 0)
+	    throw systemError ("create", source);
+	  if (::connect (fd_, reinterpret_cast<sockaddr*> (&address),
+			 sizeof (address)) < 0)
+	    {
+	      std::runtime_error error = systemError ("connect", source);
+	      ::close (fd_);
+	      throw error;
+	    }
+	}
+      else
+	{
+	  fd_ = ::open (source.c_str (), O_RDONLY);
+	  if (fd_ < 0)
+	    throw systemError ("open", source);
+
+	  struct stat status;
+	  if (::fstat (fd_, &status) < 0)
+	    {
+	      std::runtime_error error = systemError ("stat", source);
+	      ::close (fd_);
+	      throw error;
+	    }
+	  follow_ = S_ISREG (status.st_mode);
+	}
+    }
+
+    MarkerStream::~MarkerStream ()
+    {
+      if (ownsFd_ && fd_ >= 0)
+	::close (fd_);
+    }
+
+    MarkerStream::index_t
+    MarkerStream::nMarkers () const
+    {
+      return nMarkers_;
+    }
+
+    bool
+    MarkerStream::read (MarkerStreamFrame& frame, bool latest)
+    {
+      std::string line;
+      bool found = false;
+
+      // Wait for one frame.
+      while (!found)
+	{
+	  while (!found && popLine (line))
+	    found = parse (line, frame);
+	  if (found)
+	    break;
+
+	  if (!fill (-1))
+	    {
+	      // The last line may not be terminated.
+	      line.swap (buffer_);
+	      buffer_.clear ();
+	      if (!parse (line, frame))
+		return false;
+	      found = true;
+	    }
+	}
+      frame.received = received_;
+      frame.dropped = 0;
+
+      if (!latest)
+	return true;
+
+      // Keep the newest frame among the ones already received.
+      MarkerStreamFrame next;
+      do
+	while (popLine (line))
+	  if (parse (line, next))
+	    {
+	      std::size_t dropped = frame.dropped + 1;
+	      frame = next;
+	      frame.received = received_;
+	      frame.dropped = dropped;
+	    }
+      while (fill (0));
+      return true;
+    }
+
+    bool
+    MarkerStream::popLine (std::string& line)
+    {
+      std::string::size_type end = buffer_.find ('\n');
+      if (end == std::string::npos)
+	return false;
+      line = buffer_.substr (0, end);
+      buffer_.erase (0, end + 1);
+      return true;
+    }
+
+    bool
+    MarkerStream::fill (int timeout)
+    {
+      if (ended_)
+	return false;
+
+      const boost::posix_time::ptime start = now ();
+      char data[4096];
+      while (true)
+	{
+	  // Milliseconds left before the idle timeout.
+	  int wait = timeout;
+	  if (timeout < 0 && idleTimeout_ > 0.)
+	    {
+	      long left = static_cast<long> (idleTimeout_ * 1e3)
+		- (now () - start).total_milliseconds ();
+	      if (left <= 0)
+		{
+		  ended_ = true;
+		  return false;
+		}
+	      wait = static_cast<int> (left);
+	    }
+
+	  if (!follow_)
+	    {
+	      pollfd request;
+	      request.fd = fd_;
+	      request.events = POLLIN;
+	      request.revents = 0;
+	      int status = ::poll (&request, 1, wait);
+	      if (status < 0 && errno == EINTR)
+		continue;
+	      if (status < 0)
+		throw systemError ("poll", "");
+	      if (status == 0)
+		{
+		  if (timeout == 0)
+		    return false;
+		  continue;
+		}
+	    }
+
+	  ssize_t size = ::read (fd_, data, sizeof (data));
+	  if (size < 0 && (errno == EINTR || errno == EAGAIN))
+	    continue;
+	  if (size < 0)
+	    throw systemError ("read", "");
+	  if (size > 0)
+	    {
+	      buffer_.append (data, static_cast<std::size_t> (size));
+	      received_ = now ();
+	      return true;
+	    }
+
+	  // End of file: pipes and sockets are closed, regular files
+	  // may still grow.
+	  if (!follow_)
+	    {
+	      ended_ = true;
+	      return false;
+	    }
+	  if (timeout == 0)
+	    return false;
+	  boost::this_thread::sleep (boost::posix_time::milliseconds (1));
+	}
+    }
+
+    bool
+    MarkerStream::parse (const std::string& line,
+			 MarkerStreamFrame& frame) const
+    {
+      std::istringstream stream (line);
+      std::vector<double> values;
+      double value;
+      while (stream >> value)
+	values.push_back (value);
+
+      // Header or empty line.
+      if (!stream.eof () || values.empty ())
+	return false;
+
+      const std::size_t size = static_cast<std::size_t> (3 * nMarkers_);
+      std::size_t offset = 0;
+      if (values.size () == size + 2)
+	offset = 1;
+      else if (values.size () != size + 1)
+	{
+	  boost::format fmt
+	    ("invalid marker frame (%d values, %d or %d expected)");
+	  fmt % values.size () % (size + 1) % (size + 2);
+	  throw std::runtime_error (fmt.str ());
+	}
+
+      frame.time = values[offset];
+      frame.positions.resize (3 * nMarkers_);
+      for (index_t i = 0; i < 3 * nMarkers_; ++i)
+	frame.positions[i] =
+	  scale_ * values[offset + 1 + static_cast<std::size_t> (i)];
+      return true;
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
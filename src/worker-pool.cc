@@ -0,0 +1,234 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/tss.hpp>
+
+#include <roboptim/retargeting/worker-pool.hh>
+
+namespace roboptim
+{
+  namespace retargeting
+  {
+    namespace
+    {
+      /// \brief Worker id of the current thread (unset means 0).
+      boost::thread_specific_ptr<std::size_t> currentWorkerId;
+
+      /// \brief Process-wide pool (see WorkerPool::shared).
+      WorkerPoolShPtr sharedPool;
+    } // end of anonymous namespace.
+
+    WorkerPool::WorkerPool (std::size_t nWorkers)
+      : threads_ (),
+	size_ (std::max<std::size_t> (nWorkers, 1)),
+	mutex_ (),
+	wakeUp_ (),
+	done_ (),
+	task_ (0),
+	nTasks_ (0),
+	nextTask_ (0),
+	nFinished_ (0),
+	generation_ (0),
+	error_ (),
+	failed_ (false),
+	busy_ (false),
+	owner_ (),
+	idle_ (),
+	stopping_ (false)
+    {
+      for (std::size_t workerId = 1; workerId < size_; ++workerId)
+	threads_.create_thread
+	  (boost::bind (&WorkerPool::workerLoop, this, workerId));
+    }
+
+    WorkerPool::~WorkerPool ()
+    {
+      {
+	boost::lock_guard<boost::mutex> lock (mutex_);
+	stopping_ = true;
+      }
+      wakeUp_.notify_all ();
+      threads_.join_all ();
+    }
+
+    std::size_t
+    WorkerPool::size () const
+    {
+      return size_;
+    }
+
+    void
+    WorkerPool::run (std::size_t nTasks, const task_t& task)
+    {
+      if (nTasks == 0)
+	return;
+
+      bool nested = false;
+      {
+	boost::unique_lock<boost::mutex> lock (mutex_);
+	nested = size_ == 1
+	  || currentWorkerId.get ()
+	  || (busy_ && owner_ == boost::this_thread::get_id ());
+	if (!nested)
+	  {
+	    // The calling thread is worker 0: wait until the thread
+	    // currently using the pool (if any) is done.
+	    while (busy_)
+	      idle_.wait (lock);
+	    busy_ = true;
+	    owner_ = boost::this_thread::get_id ();
+	    task_ = &task;
+	    nTasks_ = nTasks;
+	    nextTask_ = 0;
+	    nFinished_ = 0;
+	    failed_ = false;
+	    error_.clear ();
+	    if (nTasks > 1)
+	      ++generation_;
+	  }
+      }
+
+      // Single worker or nested call: run the tasks in the
+      // current thread, keeping its worker id.
+      if (nested)
+	{
+	  for (std::size_t taskId = 0; taskId < nTasks; ++taskId)
+	    task (taskId);
+	  return;
+	}
+
+      if (nTasks > 1)
+	wakeUp_.notify_all ();
+
+      // The calling thread takes part in the work.
+      consume ();
+
+      std::string error;
+      bool failed = false;
+      {
+	boost::unique_lock<boost::mutex> lock (mutex_);
+	while (nFinished_ < nTasks_)
+	  done_.wait (lock);
+
+	failed = failed_;
+	error = error_;
+	task_ = 0;
+	nTasks_ = 0;
+	nextTask_ = 0;
+	busy_ = false;
+	owner_ = boost::thread::id ();
+      }
+      idle_.notify_one ();
+
+      if (failed)
+	throw std::runtime_error (error);
+    }
+
+    void
+    WorkerPool::workerLoop (std::size_t workerId)
+    {
+      currentWorkerId.reset (new std::size_t (workerId));
+
+      std::size_t generation = 0;
+      while (true)
+	{
+	  {
+	    boost::unique_lock<boost::mutex> lock (mutex_);
+	    while (!stopping_ && generation == generation_)
+	      wakeUp_.wait (lock);
+	    if (stopping_)
+	      return;
+	    generation = generation_;
+	  }
+	  consume ();
+	}
+    }
+
+    void
+    WorkerPool::consume ()
+    {
+      while (true)
+	{
+	  std::size_t taskId = 0;
+	  const task_t* task = 0;
+	  {
+	    boost::lock_guard<boost::mutex> lock (mutex_);
+	    if (nextTask_ >= nTasks_)
+	      return;
+	    taskId = nextTask_++;
+	    task = task_;
+	  }
+
+	  std::string error;
+	  bool failed = false;
+	  try
+	    {
+	      (*task) (taskId);
+	    }
+	  catch (const std::exception& e)
+	    {
+	      failed = true;
+	      error = e.what ();
+	    }
+	  catch (...)
+	    {
+	      failed = true;
+	      error = "unknown exception in worker thread";
+	    }
+
+	  {
+	    boost::lock_guard<boost::mutex> lock (mutex_);
+	    if (failed && !failed_)
+	      {
+		failed_ = true;
+		error_ = error;
+	      }
+	    if (++nFinished_ == nTasks_)
+	      done_.notify_all ();
+	  }
+	}
+    }
+
+    std::size_t
+    WorkerPool::workerId ()
+    {
+      std::size_t* id = currentWorkerId.get ();
+      return id ? *id : 0;
+    }
+
+    WorkerPool&
+    WorkerPool::shared ()
+    {
+      if (!sharedPool)
+	sharedPool = boost::make_shared<WorkerPool> (1);
+      return *sharedPool;
+    }
+
+    void
+    WorkerPool::resizeShared (std::size_t nWorkers)
+    {
+      // Stop the previous pool first so that worker ids are
+      // never used by two threads at the same time.
+      sharedPool.reset ();
+      sharedPool = boost::make_shared<WorkerPool> (nWorkers);
+    }
+  } // end of namespace retargeting.
+} // end of namespace roboptim.
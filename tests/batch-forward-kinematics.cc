@@ -0,0 +1,88 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <roboptim/retargeting/batch-forward-kinematics.hh>
+#include <roboptim/retargeting/morphing.hh>
+#include <roboptim/retargeting/function/joint-to-marker/choreonoid.hh>
+
+#include <cnoid/BodyLoader>
+
+#define BOOST_TEST_MODULE batch_forward_kinematics
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+std::string modelFilePath (HRP4C_YAML_FILE);
+
+BOOST_AUTO_TEST_CASE (batch_forward_kinematics)
+{
+  cnoid::BodyLoader loader;
+  cnoid::BodyPtr robot = loader.load (modelFilePath);
+  if (!robot)
+    throw std::runtime_error ("failed to load model");
+
+  const int nConfigurations = 17;
+  BatchForwardKinematics::matrix_t configurations
+    (nConfigurations, 6 + robot->numJoints ());
+  configurations.setRandom ();
+
+  BatchForwardKinematics batch (robot);
+  batch.compute (configurations);
+  BOOST_CHECK_EQUAL (batch.size (), nConfigurations);
+
+  // Compare with Choreonoid forward kinematics.
+  for (int k = 0; k < nConfigurations; ++k)
+    {
+      updateRobotConfiguration
+	(robot, configurations.row (k).transpose ());
+      robot->calcForwardKinematics ();
+
+      for (int linkId = 0; linkId < robot->numLinks (); ++linkId)
+	{
+	  cnoid::Link* link = robot->link (linkId);
+	  BOOST_CHECK_SMALL
+	    ((batch.position (linkId, k) - link->p ())
+	     .cwiseAbs ().maxCoeff (), 1e-10);
+	  BOOST_CHECK_SMALL
+	    ((batch.rotation (linkId, k) - link->R ())
+	     .cwiseAbs ().maxCoeff (), 1e-10);
+	}
+    }
+
+  // Batched joint to marker matches the regular evaluation.
+  MorphingData morphing =
+    loadMorphingData (DATA_DIR "/human-to-hrp4c.morphing.yaml");
+  JointToMarkerPositionChoreonoid<EigenMatrixDense> jointToMarker
+    (robot, morphing);
+
+  JointToMarkerPositionChoreonoid<EigenMatrixDense>::batchMatrix_t markers;
+  jointToMarker.computeBatch (markers, configurations);
+  BOOST_CHECK_EQUAL (markers.rows (), nConfigurations);
+  BOOST_CHECK_EQUAL (markers.cols (), jointToMarker.outputSize ());
+
+  for (int k = 0; k < nConfigurations; ++k)
+    {
+      JointToMarkerPositionChoreonoid<EigenMatrixDense>::vector_t x =
+	configurations.row (k).transpose ();
+      BOOST_CHECK_SMALL
+	((markers.row (k).transpose () - jointToMarker (x))
+	 .cwiseAbs ().maxCoeff (), 1e-10);
+    }
+}
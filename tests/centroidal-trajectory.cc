@@ -0,0 +1,110 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <boost/make_shared.hpp>
+
+#include <roboptim/retargeting/centroidal-trajectory.hh>
+#include <roboptim/retargeting/parallel-finite-difference.hh>
+#include <roboptim/retargeting/function/zmp-trajectory/choreonoid.hh>
+
+#include <cnoid/BodyLoader>
+
+#define BOOST_TEST_MODULE centroidal_trajectory
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+std::string modelFilePath (HRP4C_YAML_FILE);
+
+BOOST_AUTO_TEST_CASE (centroidal_trajectory)
+{
+  cnoid::BodyLoader loader;
+  cnoid::BodyPtr robot = loader.load (modelFilePath);
+  if (!robot)
+    throw std::runtime_error ("failed to load model");
+
+  WorkerPool::resizeShared (2);
+  EvaluationContextPoolShPtr contexts =
+    boost::make_shared<EvaluationContextPool> (robot);
+
+  const CentroidalTrajectory::index_t nFrames = 6;
+  const CentroidalTrajectory::index_t nDofs = 6 + robot->numJoints ();
+  CentroidalTrajectoryShPtr centroidal =
+    boost::make_shared<CentroidalTrajectory> (contexts, nFrames, 0.01);
+
+  // Static trajectory: null momenta and ZMP equal to the CoM.
+  CentroidalTrajectory::vector_t configuration (nDofs);
+  configuration.setRandom ();
+  configuration.segment<3> (3) *= .1;
+  CentroidalTrajectory::vector_t x (nFrames * nDofs);
+  for (CentroidalTrajectory::index_t frame = 0; frame < nFrames; ++frame)
+    x.segment (frame * nDofs, nDofs) = configuration;
+
+  BOOST_CHECK (!centroidal->update (x));
+  BOOST_CHECK (centroidal->update (x));
+
+  cnoid::BodyPtr robotCopy = loader.load (modelFilePath);
+  updateRobotConfiguration (robotCopy, configuration);
+  robotCopy->calcForwardKinematics ();
+  cnoid::Vector3 com = robotCopy->calcCenterOfMass ();
+
+  for (CentroidalTrajectory::index_t frame = 0; frame < nFrames; ++frame)
+    {
+      BOOST_CHECK_SMALL
+	((centroidal->com ().row (frame).transpose () - com)
+	 .cwiseAbs ().maxCoeff (), 1e-10);
+      BOOST_CHECK_SMALL
+	(centroidal->linearMomentum ().row (frame).norm (), 1e-10);
+      BOOST_CHECK_SMALL
+	(centroidal->angularMomentum ().row (frame).norm (), 1e-10);
+    }
+
+  typedef ZMPTrajectoryChoreonoid<EigenMatrixDense> zmp_t;
+  zmp_t zmp (centroidal);
+  BOOST_CHECK_EQUAL (zmp.inputSize (), nFrames * nDofs);
+  BOOST_CHECK_EQUAL (zmp.outputSize (), 2 * (nFrames - 2));
+
+  zmp_t::vector_t res = zmp (x);
+  for (zmp_t::size_type i = 0; i < nFrames - 2; ++i)
+    {
+      BOOST_CHECK_SMALL (res[2 * i] - com[0], 1e-10);
+      BOOST_CHECK_SMALL (res[2 * i + 1] - com[1], 1e-10);
+    }
+
+  // Moving trajectory: the banded jacobian matches finite
+  // differences over the whole function (computed sequentially as
+  // the centroidal trajectory cannot be updated concurrently).
+  for (CentroidalTrajectory::index_t frame = 0; frame < nFrames; ++frame)
+    x.segment (frame * nDofs + 6, nDofs - 6).array () +=
+      .01 * static_cast<double> (frame);
+
+  zmp_t::jacobian_t jacobian (zmp.outputSize (), zmp.inputSize ());
+  zmp.jacobian (jacobian, x);
+
+  ParallelFiniteDifference<EigenMatrixDense> fd
+    (zmp, 1,
+     ParallelFiniteDifference<EigenMatrixDense>::RULE_CENTRAL, 1e-6);
+  zmp_t::jacobian_t expected (zmp.outputSize (), zmp.inputSize ());
+  fd.jacobian (expected, x);
+
+  BOOST_CHECK_SMALL ((jacobian - expected).cwiseAbs ().maxCoeff (), 1e-4);
+
+  WorkerPool::resizeShared (1);
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <boost/bind.hpp>
+#include <boost/make_shared.hpp>
+
+#include <roboptim/retargeting/evaluation-context.hh>
+#include <roboptim/retargeting/worker-pool.hh>
+#include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
+
+#include <cnoid/BodyLoader>
+
+#define BOOST_TEST_MODULE evaluation_context
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+std::string modelFilePath (HRP4C_YAML_FILE);
+
+typedef ForwardGeometryChoreonoid<EigenMatrixDense> forwardGeometry_t;
+
+namespace
+{
+  void evaluate (const forwardGeometry_t& f,
+		 const Function::matrix_t& x,
+		 Function::matrix_t& result,
+		 std::size_t i)
+  {
+    Function::size_type i_ = static_cast<Function::size_type> (i);
+    result.row (i_) = f (x.row (i_).transpose ());
+  }
+} // end of anonymous namespace.
+
+BOOST_AUTO_TEST_CASE (evaluation_context)
+{
+  cnoid::BodyLoader loader;
+  cnoid::BodyPtr robot = loader.load (modelFilePath);
+  if (!robot)
+    throw std::runtime_error ("failed to load model");
+
+  WorkerPool::resizeShared (4);
+
+  EvaluationContextPoolShPtr contexts =
+    boost::make_shared<EvaluationContextPool> (robot);
+  BOOST_CHECK_EQUAL (contexts->size (), 4u);
+  BOOST_CHECK ((*contexts)[0].robot () == robot);
+  BOOST_CHECK ((*contexts)[1].robot () != robot);
+  BOOST_CHECK_EQUAL (contexts->localId (), 0u);
+
+  forwardGeometry_t f (contexts, "L_ANKLE_R");
+
+  // Evaluate many configurations concurrently and compare with a
+  // sequential evaluation.
+  const Function::size_type nSamples = 200;
+  Function::matrix_t x (nSamples, f.inputSize ());
+  x.setRandom ();
+  Function::matrix_t result (nSamples, f.outputSize ());
+  result.setZero ();
+
+  WorkerPool::shared ().run
+    (static_cast<std::size_t> (nSamples),
+     boost::bind (&evaluate, boost::cref (f), boost::cref (x),
+		  boost::ref (result), _1));
+
+  cnoid::BodyPtr robotCopy = loader.load (modelFilePath);
+  forwardGeometry_t reference (robotCopy, "L_ANKLE_R");
+  for (Function::size_type i = 0; i < nSamples; ++i)
+    BOOST_CHECK (result.row (i).transpose ().isApprox
+		 (reference (x.row (i).transpose ())));
+
+  std::cout << *contexts << std::endl;
+
+  WorkerPool::resizeShared (1);
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE acceleration
+
+#include <cmath>
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/acceleration.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (acceleration)
+{
+  const Function::size_type nFrames = 10;
+  const Function::size_type nDofs = 3;
+  const double dt = .5;
+
+  Function::vector_t weights (nDofs);
+  weights << 1., 2., .5;
+
+  Function::vector_t x = Function::vector_t::Random (nFrames * nDofs);
+
+  for (Function::size_type order = 2; order <= 3; ++order)
+    {
+      SquaredAcceleration<EigenMatrixDense> f (nFrames, weights, dt, order);
+      BOOST_CHECK_EQUAL (f.inputSize (), nFrames * nDofs);
+      BOOST_CHECK_EQUAL (f.outputSize (), 1);
+
+      // Compare with the finite differences written explicitly.
+      double expected = 0.;
+      for (Function::size_type frame = 0; frame + order < nFrames; ++frame)
+	for (Function::size_type dof = 0; dof < nDofs; ++dof)
+	  {
+	    const double* q = x.data () + frame * nDofs + dof;
+	    double difference = order == 2
+	      ? q[2 * nDofs] - 2. * q[nDofs] + q[0]
+	      : q[3 * nDofs] - 3. * q[2 * nDofs] + 3. * q[nDofs] - q[0];
+	    difference /= std::pow (dt, static_cast<double> (order));
+	    expected += weights[dof] * difference * difference;
+	  }
+      BOOST_CHECK_CLOSE (f (x)[0], expected, 1e-8);
+
+      BOOST_CHECK_NO_THROW (checkJacobianAndThrow (f, x, 1e-4));
+
+      // Constant Hessian: the gradient is H x.
+      Function::matrix_t hessian = f.hessian (x, 0);
+      BOOST_CHECK_SMALL
+	((hessian * x - f.gradient (x, 0)).cwiseAbs ().maxCoeff (), 1e-6);
+      BOOST_CHECK_SMALL
+	((hessian - hessian.transpose ()).cwiseAbs ().maxCoeff (), 1e-12);
+
+      // Banded sparse Hessian.
+      SquaredAcceleration<EigenMatrixSparse> sparse
+	(nFrames, weights, dt, order);
+      SquaredAcceleration<EigenMatrixSparse>::hessian_t sparseHessian =
+	sparse.hessian (x, 0);
+      Function::matrix_t dense;
+      copyToDense (dense, sparseHessian);
+      BOOST_CHECK_SMALL ((dense - hessian).cwiseAbs ().maxCoeff (), 1e-8);
+      for (Function::size_type i = 0; i < dense.rows (); ++i)
+	for (Function::size_type j = 0; j < dense.cols (); ++j)
+	  if (std::abs (i / nDofs - j / nDofs) > order
+	      || i % nDofs != j % nDofs)
+	    BOOST_CHECK_EQUAL (dense (i, j), 0.);
+    }
+
+  BOOST_CHECK_THROW
+    (SquaredAcceleration<EigenMatrixDense> (2, weights, dt),
+     std::runtime_error);
+  BOOST_CHECK_THROW
+    (SquaredAcceleration<EigenMatrixDense> (nFrames, weights, 0.),
+     std::runtime_error);
+}
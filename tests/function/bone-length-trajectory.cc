@@ -0,0 +1,98 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE bone_length_trajectory
+
+#include <stdexcept>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/bone-length-trajectory.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (bone_length_trajectory)
+{
+  typedef BoneLengthTrajectoryError<EigenMatrixSparse> sparseFunction_t;
+  typedef BoneLengthTrajectoryError<EigenMatrixDense> denseFunction_t;
+
+  const Function::size_type nMarkers = 4;
+  const Function::size_type nFrames = 3;
+
+  std::vector<sparseFunction_t::bone_t> bones;
+  bones.push_back (std::make_pair (1, 0));
+  bones.push_back (std::make_pair (3, 2));
+  std::vector<Function::value_type> lengths;
+  lengths.push_back (1.);
+  lengths.push_back (.5);
+
+  sparseFunction_t f (nMarkers, nFrames, bones, lengths);
+  BOOST_CHECK_EQUAL (f.inputSize (), 3 * nMarkers * nFrames);
+  BOOST_CHECK_EQUAL (f.outputSize (), 2 * nFrames);
+  BOOST_CHECK_EQUAL (f.nBones (), 2);
+
+  Function::vector_t x = Function::vector_t::Random (f.inputSize ());
+  Function::vector_t result = f (x);
+  for (Function::size_type frame = 0; frame < nFrames; ++frame)
+    {
+      Function::size_type offset = 3 * nMarkers * frame;
+      BOOST_CHECK_CLOSE
+	(result[2 * frame],
+	 (x.segment (offset + 3, 3) - x.segment (offset, 3)).squaredNorm ()
+	 - 1., 1e-8);
+      BOOST_CHECK_CLOSE
+	(result[2 * frame + 1],
+	 (x.segment (offset + 9, 3) - x.segment (offset + 6, 3))
+	 .squaredNorm () - .25, 1e-8);
+    }
+
+  // Six non-zeros per row.
+  sparseFunction_t::jacobian_t jacobian = f.jacobian (x);
+  BOOST_CHECK_EQUAL (jacobian.nonZeros (), 6 * f.outputSize ());
+
+  // Sparse and dense jacobians match the finite differences one.
+  denseFunction_t dense (nMarkers, nFrames, bones, lengths);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (dense, x, 1e-5));
+  Function::matrix_t denseJacobian;
+  copyToDense (denseJacobian, jacobian);
+  BOOST_CHECK_SMALL
+    ((denseJacobian - dense.jacobian (x)).cwiseAbs ().maxCoeff (), 1e-12);
+  for (Function::size_type i = 0; i < dense.outputSize (); ++i)
+    BOOST_CHECK_SMALL
+      ((dense.gradient (x, i) - denseJacobian.row (i).transpose ())
+       .cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Invalid bones.
+  BOOST_CHECK_THROW
+    (denseFunction_t (nMarkers, nFrames,
+		      std::vector<denseFunction_t::bone_t> (), lengths),
+     std::runtime_error);
+  BOOST_CHECK_THROW
+    (denseFunction_t (nMarkers, nFrames, bones,
+		      std::vector<Function::value_type> (1, 1.)),
+     std::runtime_error);
+  bones.push_back (std::make_pair (0, nMarkers));
+  lengths.push_back (1.);
+  BOOST_CHECK_THROW
+    (denseFunction_t (nMarkers, nFrames, bones, lengths),
+     std::runtime_error);
+}
@@ -62,3 +62,30 @@ BOOST_AUTO_TEST_CASE (simple)
   	<< plot (trajectory, interval)
   	);
 }
+
+BOOST_AUTO_TEST_CASE (frame_range)
+{
+  cnoid::BodyMotionPtr bodyMotion = boost::make_shared<cnoid::BodyMotion> ();
+  bodyMotion->loadStandardYAMLformat
+    (DATA_DIR "/sample.body-motion.yaml");
+  BOOST_REQUIRE (bodyMotion->getNumFrames () > 3);
+
+  ChoreonoidBodyTrajectory trajectory (bodyMotion, true);
+  const Function::vector_t::Index nDofs = trajectory.outputSize ();
+
+  // Only the requested frames are copied.
+  ChoreonoidBodyTrajectory range (bodyMotion, true, 1, 2);
+  BOOST_REQUIRE_EQUAL (range.parameters ().size (), 2 * nDofs);
+  BOOST_CHECK_EQUAL (range.parameters (),
+		     trajectory.parameters ().segment (nDofs, 2 * nDofs));
+
+  // -1 (or a too long range) means up to the end of the motion.
+  const int nFrames = bodyMotion->getNumFrames ();
+  ChoreonoidBodyTrajectory tail (bodyMotion, true, 2);
+  BOOST_CHECK_EQUAL (tail.parameters ().size (), (nFrames - 2) * nDofs);
+  ChoreonoidBodyTrajectory clamped (bodyMotion, true, 2, nFrames);
+  BOOST_CHECK_EQUAL (clamped.parameters (), tail.parameters ());
+
+  BOOST_CHECK_THROW (ChoreonoidBodyTrajectory (bodyMotion, true, nFrames),
+		     std::runtime_error);
+}
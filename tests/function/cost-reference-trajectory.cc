@@ -0,0 +1,85 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE cost_reference_trajectory
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/cost-reference-trajectory.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (cost_reference_trajectory)
+{
+  const Function::size_type nFrames = 20;
+  const Function::size_type nDofs = 3;
+  const Function::size_type dofId = 1;
+  const double dt = .1;
+
+  Function::vector_t reference =
+    Function::vector_t::Random (nFrames * nDofs);
+  boost::shared_ptr<Trajectory<3> > referenceTrajectory =
+    boost::make_shared<VectorInterpolation> (reference, nDofs, dt);
+
+  Function::vector_t x = Function::vector_t::Random (nFrames * nDofs);
+
+  // The samples are the frames (except the last one).
+  CostReferenceTrajectory<EigenMatrixDense> discrete
+    (referenceTrajectory, dofId, dt);
+
+  double expected = 0.;
+  for (Function::size_type frame = 0; frame + 1 < nFrames; ++frame)
+    {
+      double error =
+	x[frame * nDofs + dofId] - reference[frame * nDofs + dofId];
+      expected += .5 * error * error;
+    }
+  BOOST_CHECK_CLOSE (discrete (x)[0], expected, 1e-8);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (discrete, x, 1e-5));
+
+  Function::matrix_t hessian = discrete.hessian (x, 0);
+  BOOST_CHECK_CLOSE
+    (hessian.trace (), static_cast<double> (nFrames - 1), 1e-8);
+  BOOST_CHECK_SMALL
+    ((hessian * (x - reference) - discrete.gradient (x, 0))
+     .cwiseAbs ().maxCoeff (), 1e-8);
+
+  CostReferenceTrajectory<EigenMatrixSparse> sparse
+    (referenceTrajectory, dofId, dt);
+  BOOST_CHECK_EQUAL (sparse.hessian (x, 0).nonZeros (), nFrames - 1);
+  BOOST_CHECK_CLOSE (sparse (x)[0], expected, 1e-8);
+
+  // Samples between the frames: generic evaluation.
+  CostReferenceTrajectory<EigenMatrixDense> generic
+    (referenceTrajectory, dofId, dt / 3.);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (generic, x, 1e-5));
+  hessian = generic.hessian (x, 0);
+  BOOST_CHECK_SMALL
+    ((hessian * (x - reference) - generic.gradient (x, 0))
+     .cwiseAbs ().maxCoeff (), 1e-8);
+
+  CostReferenceTrajectory<EigenMatrixSparse> genericSparse
+    (referenceTrajectory, dofId, dt / 3.);
+  BOOST_CHECK_SMALL
+    ((Function::matrix_t (genericSparse.hessian (x, 0)) - hessian)
+     .cwiseAbs ().maxCoeff (), 1e-8);
+}
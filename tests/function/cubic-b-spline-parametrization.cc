@@ -0,0 +1,83 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE cubic_b_spline_parametrization
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/cubic-b-spline-parametrization.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (cubic_b_spline_parametrization)
+{
+  typedef CubicBSplineParametrization<EigenMatrixDense> denseFunction_t;
+  typedef CubicBSplineParametrization<EigenMatrixSparse> sparseFunction_t;
+
+  const Function::size_type nFrames = 50;
+  const Function::size_type nDofs = 3;
+
+  denseFunction_t f (nFrames, nDofs, 10);
+  BOOST_CHECK_EQUAL (f.nFrames (), nFrames);
+  BOOST_CHECK_EQUAL (f.nControlPoints (), 5 + 3);
+  BOOST_CHECK_EQUAL (f.inputSize (), nDofs * f.nControlPoints ());
+  BOOST_CHECK_EQUAL (f.outputSize (), nDofs * nFrames);
+
+  // The basis is a partition of unity: constant control points
+  // give a constant trajectory.
+  Function::vector_t constant (nDofs);
+  constant << 1., -2., 3.;
+  Function::vector_t controlPoints =
+    constant.replicate (f.nControlPoints (), 1);
+  Function::vector_t frames = f (controlPoints);
+  for (Function::size_type frame = 0; frame < nFrames; ++frame)
+    BOOST_CHECK_SMALL
+      ((frames.segment (frame * nDofs, nDofs) - constant)
+       .cwiseAbs ().maxCoeff (), 1e-8);
+
+  // Fitting a spline trajectory retrieves its control points.
+  controlPoints = Function::vector_t::Random (f.inputSize ());
+  BOOST_CHECK_SMALL
+    ((f.fit (f (controlPoints)) - controlPoints).cwiseAbs ().maxCoeff (),
+     1e-8);
+  BOOST_CHECK_THROW (f.fit (Function::vector_t (3)), std::runtime_error);
+
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (f, controlPoints, 1e-6));
+
+  // Sparse jacobian: at most four non-zeros per row.
+  sparseFunction_t sparse (f);
+  sparseFunction_t::jacobian_t jacobian = sparse.jacobian (controlPoints);
+  BOOST_CHECK (jacobian.nonZeros () <= 4 * f.outputSize ());
+  Function::matrix_t dense;
+  copyToDense (dense, jacobian);
+  BOOST_CHECK_SMALL
+    ((dense - f.jacobian (controlPoints)).cwiseAbs ().maxCoeff (), 1e-12);
+  for (Function::size_type i = 0; i < f.outputSize (); ++i)
+    BOOST_CHECK_SMALL
+      ((f.gradient (controlPoints, i) - dense.row (i).transpose ())
+       .cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Too many control points.
+  BOOST_CHECK_THROW (denseFunction_t (5, nDofs, 1), std::runtime_error);
+  BOOST_CHECK_THROW (denseFunction_t (nFrames, nDofs, 0), std::runtime_error);
+}
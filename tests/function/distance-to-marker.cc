@@ -88,6 +88,20 @@ BOOST_AUTO_TEST_CASE (distance_to_marker)
       BOOST_CHECK_CLOSE (distance(x)[0], 0., 1e-6);
     }
 
+  // Same check, reusing one function and swapping the reference.
+  {
+    DistanceToMarker<EigenMatrixDense> distance
+      (jointToMarker, referencePositions);
+    for (std::size_t i = 0; i < 10; ++i)
+      {
+	x = Function::vector_t::Random (6 + robotModel->numJoints ());
+	distance.setReference ((*jointToMarker) (x));
+	BOOST_CHECK_CLOSE (distance(x)[0], 0., 1e-6);
+      }
+    BOOST_CHECK_THROW
+      (distance.setReference (Function::vector_t (3)), std::runtime_error);
+  }
+
   // Set configuration to zero and use a reference.
   x.setZero ();
   referencePositions = (*jointToMarker) (x);
@@ -106,4 +106,15 @@ BOOST_AUTO_TEST_CASE (simple)
 
   std::ofstream log ("/tmp/marker-laplacian-deformation-energy-jac-nodisableddofs.txt");
   log << cost->jacobian (x);
+
+  // The sparse variant computes the same gradient.
+  MarkerLaplacianDeformationEnergyChoreonoidSparseShPtr
+    sparseCost =
+    boost::make_shared<MarkerLaplacianDeformationEnergyChoreonoidSparse>
+    (mapping, mesh, trajectory);
+
+  Function::vector_t y = x + 1e-2 * Function::vector_t::Random (x.size ());
+  BOOST_CHECK_SMALL
+    ((sparseCost->gradient (y, 0).toDense () - cost->gradient (y, 0))
+     .cwiseAbs ().maxCoeff (), 1e-8);
 }
@@ -0,0 +1,149 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE piecewise_minimum_jerk
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/minimum-jerk-trajectory.hh>
+#include <roboptim/retargeting/function/piecewise-minimum-jerk-parametrization.hh>
+#include <roboptim/retargeting/function/piecewise-minimum-jerk-trajectory.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+typedef Function::vector_t vector_t;
+typedef Function::matrix_t matrix_t;
+
+BOOST_AUTO_TEST_CASE (minimum_jerk_variation)
+{
+  MinimumJerkTrajectory<EigenMatrixDense> trajectory (makeInterval (0., 2.));
+
+  vector_t x (4);
+  x << .2, 1.6, .3, -.1;
+  trajectory.setParameters (x);
+
+  // Boundary conditions.
+  BOOST_CHECK_CLOSE (trajectory (0.)[0], .2, 1e-8);
+  BOOST_CHECK_CLOSE (trajectory (2.)[0], 1.6, 1e-8);
+  BOOST_CHECK_CLOSE (trajectory.derivative (1e-12, 1)[0], .3, 1e-6);
+  BOOST_CHECK_CLOSE (trajectory.derivative (1e-12, 2)[0], -.1, 1e-6);
+  BOOST_CHECK_SMALL (trajectory.derivative (2., 1)[0], 1e-8);
+  BOOST_CHECK_SMALL (trajectory.derivative (2., 2)[0], 1e-8);
+
+  // The trajectory is linear w.r.t. its parameters.
+  for (double t = 0.; t <= 2.; t += .1)
+    for (std::size_t order = 0; order < 4; ++order)
+      {
+	matrix_t variation = trajectory.variationDerivWrtParam (t, order);
+	BOOST_CHECK_SMALL
+	  ((variation * x - trajectory.derivative (t, order))
+	   .cwiseAbs ().maxCoeff (), 1e-8);
+      }
+
+  // Singular points: the range bounds.
+  BOOST_CHECK_EQUAL (trajectory.singularPointAtRank (0), 0.);
+  BOOST_CHECK_EQUAL (trajectory.singularPointAtRank (1), 2.);
+  BOOST_CHECK_CLOSE
+    (trajectory.derivAfterSingularPoint (0, 1)[0], .3, 1e-8);
+  BOOST_CHECK_SMALL (trajectory.derivBeforeSingularPoint (0, 1)[0], 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE (piecewise_minimum_jerk)
+{
+  typedef PiecewiseMinimumJerkTrajectory<EigenMatrixDense> trajectory_t;
+
+  const Function::size_type nSegments = 3;
+  const Function::size_type dimension = 2;
+  vector_t x = vector_t::Random
+    (trajectory_t::numberOfParameters (nSegments, dimension));
+  trajectory_t trajectory (makeInterval (0., 3.), dimension, x);
+  BOOST_CHECK_EQUAL (trajectory.numberOfSegments (), nSegments);
+
+  // Knots states are interpolated.
+  for (Function::size_type knot = 0; knot <= nSegments; ++knot)
+    for (std::size_t order = 0; order < 3; ++order)
+      {
+	const double t = static_cast<double> (knot);
+	vector_t expected = x.segment
+	  ((3 * knot + static_cast<Function::size_type> (order))
+	   * dimension, dimension);
+	if (knot < nSegments)
+	  BOOST_CHECK_SMALL
+	    ((trajectory.derivAfterSingularPoint (knot, order) - expected)
+	     .cwiseAbs ().maxCoeff (), 1e-8);
+	if (knot > 0)
+	  BOOST_CHECK_SMALL
+	    ((trajectory.derivBeforeSingularPoint (knot, order) - expected)
+	     .cwiseAbs ().maxCoeff (), 1e-8);
+	BOOST_CHECK_EQUAL (trajectory.singularPointAtRank (knot), t);
+      }
+
+  // The trajectory is linear w.r.t. its parameters, each point
+  // depends on the six states of its segment.
+  for (double t = 0.; t <= 3.; t += .25)
+    for (std::size_t order = 0; order < 4; ++order)
+      {
+	matrix_t variation = trajectory.variationDerivWrtParam (t, order);
+	BOOST_CHECK_SMALL
+	  ((variation * x - trajectory.derivative (t, order))
+	   .cwiseAbs ().maxCoeff (), 1e-8);
+	BOOST_CHECK ((variation.array () != 0.).count () <= 6 * dimension);
+      }
+
+  // Velocity matches the finite differences of the position.
+  const double h = 1e-6;
+  BOOST_CHECK_SMALL
+    (((trajectory (1.3 + h) - trajectory (1.3 - h)) / (2. * h)
+      - trajectory.derivative (1.3, 1)).cwiseAbs ().maxCoeff (), 1e-5);
+
+  BOOST_CHECK_THROW
+    (trajectory_t (makeInterval (0., 1.), dimension, vector_t (3)),
+     std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE (piecewise_minimum_jerk_parametrization)
+{
+  typedef PiecewiseMinimumJerkParametrization<EigenMatrixDense>
+    function_t;
+
+  const Function::size_type nFrames = 41;
+  const Function::size_type nDofs = 2;
+
+  function_t f (nFrames, nDofs, 10);
+  BOOST_CHECK_EQUAL (f.inputSize (), 5 * 3 * nDofs);
+  BOOST_CHECK_EQUAL (f.outputSize (), nFrames * nDofs);
+
+  vector_t x = vector_t::Random (f.inputSize ());
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (f, x, 1e-6));
+  BOOST_CHECK_SMALL ((f.fit (f (x)) - x).cwiseAbs ().maxCoeff (), 1e-6);
+
+  // Knots positions only are bounded.
+  Function::intervals_t limits (2, Function::makeInterval (-1., 1.));
+  Function::intervals_t bounds = f.argumentBounds (limits);
+  BOOST_CHECK_EQUAL (bounds[0].first, -1.);
+  BOOST_CHECK_EQUAL (bounds[1].second, 1.);
+  BOOST_CHECK_EQUAL (bounds[2].first, -Function::infinity ());
+  BOOST_CHECK_EQUAL (bounds[6].first, -1.);
+
+  BOOST_CHECK_THROW (function_t (nFrames, nDofs, 2), std::runtime_error);
+}
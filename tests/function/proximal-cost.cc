@@ -0,0 +1,79 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE proximal_cost
+
+#include <stdexcept>
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/proximal-cost.hh>
+#include <roboptim/retargeting/function/squared-distance-to-reference.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (proximal_cost)
+{
+  Function::vector_t target = Function::vector_t::Random (6);
+  boost::shared_ptr<DifferentiableFunction> f =
+    boost::make_shared<SquaredDistanceToReference<EigenMatrixDense> >
+    (target);
+
+  ProximalTermShPtr term = boost::make_shared<ProximalTerm> ();
+  term->weights = Function::vector_t::Zero (6);
+  term->reference = Function::vector_t::Random (6);
+
+  ProximalCost<EigenMatrixDense> cost (f, term);
+  BOOST_CHECK_EQUAL (cost.inputSize (), 6);
+  BOOST_CHECK_EQUAL (cost.outputSize (), 1);
+
+  // Zero weights: the cost function is unchanged.
+  Function::vector_t x = Function::vector_t::Random (6);
+  BOOST_CHECK_CLOSE (cost (x)[0], (*f) (x)[0], 1e-8);
+
+  // The term is shared: changing it changes the cost.
+  term->weights.head (2).setConstant (3.);
+  const double expected = (*f) (x)[0]
+    + 1.5 * (x - term->reference).head (2).squaredNorm ();
+  BOOST_CHECK_CLOSE (cost (x)[0], expected, 1e-8);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (cost, x, 1e-5));
+
+  Function::vector_t gradient = f->gradient (x, 0);
+  gradient.head (2) += 3. * (x - term->reference).head (2);
+  BOOST_CHECK_SMALL
+    ((cost.gradient (x, 0) - gradient).cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Sparse derivatives.
+  boost::shared_ptr<GenericDifferentiableFunction<EigenMatrixSparse> >
+    sparseF =
+    boost::make_shared<SquaredDistanceToReference<EigenMatrixSparse> >
+    (target);
+  ProximalCost<EigenMatrixSparse> sparse (sparseF, term);
+  Function::matrix_t dense;
+  copyToDense (dense, sparse.jacobian (x));
+  BOOST_CHECK_SMALL
+    ((dense - gradient.transpose ()).cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Invalid term.
+  term->reference.resize (3);
+  BOOST_CHECK_THROW (cost (x), std::runtime_error);
+}
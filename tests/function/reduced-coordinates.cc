@@ -0,0 +1,141 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE reduced_coordinates
+
+#include <stdexcept>
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/acceleration.hh>
+#include <roboptim/retargeting/function/reduced-coordinates.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (reduced_coordinates)
+{
+  const Function::size_type nFrames = 6;
+  const Function::size_type nDofs = 3;
+
+  // The second DOF of each frame is fixed.
+  ReducedCoordinatesMap::configuration_t configuration
+    (static_cast<std::size_t> (nDofs));
+  configuration[1] = .5;
+
+  ReducedCoordinatesMap map (configuration, nFrames);
+  BOOST_CHECK_EQUAL (map.fullSize (), nFrames * nDofs);
+  BOOST_CHECK_EQUAL (map.reducedSize (), nFrames * (nDofs - 1));
+
+  Function::vector_t x = Function::vector_t::Random (map.reducedSize ());
+  Function::vector_t full = map.expand (x);
+  for (Function::size_type frame = 0; frame < nFrames; ++frame)
+    {
+      BOOST_CHECK_EQUAL (full[frame * nDofs], x[frame * 2]);
+      BOOST_CHECK_EQUAL (full[frame * nDofs + 1], .5);
+      BOOST_CHECK_EQUAL (full[frame * nDofs + 2], x[frame * 2 + 1]);
+    }
+  BOOST_CHECK_SMALL ((map.reduce (full) - x).cwiseAbs ().maxCoeff (), 1e-12);
+  BOOST_CHECK_THROW (map.reduce (x), std::runtime_error);
+
+  // Dense function.
+  boost::shared_ptr<DifferentiableFunction> f =
+    boost::make_shared<SquaredAcceleration<EigenMatrixDense> >
+    (nFrames, Function::vector_t::Ones (nDofs), .5);
+  boost::shared_ptr<DifferentiableFunction> reduced =
+    reduceCoordinates (f, configuration);
+
+  BOOST_CHECK_EQUAL (reduced->inputSize (), map.reducedSize ());
+  BOOST_CHECK_CLOSE ((*reduced) (x)[0], (*f) (full)[0], 1e-8);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (*reduced, x, 1e-5));
+
+  Function::matrix_t jacobian = reduced->jacobian (x);
+  Function::matrix_t fullJacobian = f->jacobian (full);
+  for (Function::size_type i = 0; i < map.reducedSize (); ++i)
+    BOOST_CHECK_EQUAL
+      (jacobian (0, i),
+       fullJacobian (0, map.indices ()[static_cast<std::size_t> (i)]));
+  BOOST_CHECK_SMALL
+    ((reduced->gradient (x, 0) - jacobian.row (0).transpose ())
+     .cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Sparse function.
+  typedef GenericDifferentiableFunction<EigenMatrixSparse> sparseFunction_t;
+  boost::shared_ptr<sparseFunction_t> sparseReduced =
+    reduceCoordinates
+    (boost::shared_ptr<sparseFunction_t>
+     (boost::make_shared<SquaredAcceleration<EigenMatrixSparse> >
+      (nFrames, Function::vector_t::Ones (nDofs), .5)),
+     configuration);
+
+  Function::matrix_t dense;
+  copyToDense (dense, sparseReduced->jacobian (x));
+  BOOST_CHECK_SMALL ((dense - jacobian).cwiseAbs ().maxCoeff (), 1e-12);
+  Function::vector_t denseGradient;
+  copyToDense (denseGradient, sparseReduced->gradient (x, 0));
+  BOOST_CHECK_SMALL
+    ((denseGradient - jacobian.row (0).transpose ())
+     .cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Twice differentiable function: the Hessian is gathered too.
+  typedef GenericTwiceDifferentiableFunction<EigenMatrixDense>
+    twiceDifferentiableFunction_t;
+  boost::shared_ptr<twiceDifferentiableFunction_t> quadratic =
+    boost::make_shared<SquaredAcceleration<EigenMatrixDense> >
+    (nFrames, Function::vector_t::Ones (nDofs), .5);
+  boost::shared_ptr<twiceDifferentiableFunction_t> reducedQuadratic =
+    reduceCoordinates (quadratic, configuration);
+
+  BOOST_CHECK_CLOSE ((*reducedQuadratic) (x)[0], (*f) (full)[0], 1e-8);
+  Function::matrix_t hessian = reducedQuadratic->hessian (x, 0);
+  Function::matrix_t fullHessian = quadratic->hessian (full, 0);
+  for (Function::size_type i = 0; i < map.reducedSize (); ++i)
+    for (Function::size_type j = 0; j < map.reducedSize (); ++j)
+      BOOST_CHECK_EQUAL
+	(hessian (i, j),
+	 fullHessian (map.indices ()[static_cast<std::size_t> (i)],
+		      map.indices ()[static_cast<std::size_t> (j)]));
+
+  typedef GenericTwiceDifferentiableFunction<EigenMatrixSparse>
+    sparseTwiceDifferentiableFunction_t;
+  boost::shared_ptr<sparseTwiceDifferentiableFunction_t>
+    sparseReducedQuadratic =
+    reduceCoordinates
+    (boost::shared_ptr<sparseTwiceDifferentiableFunction_t>
+     (boost::make_shared<SquaredAcceleration<EigenMatrixSparse> >
+      (nFrames, Function::vector_t::Ones (nDofs), .5)),
+     configuration);
+  copyToDense (dense, sparseReducedQuadratic->hessian (x, 0));
+  BOOST_CHECK_SMALL ((dense - hessian).cwiseAbs ().maxCoeff (), 1e-12);
+
+  // No fixed DOF: the function is not wrapped.
+  BOOST_CHECK_EQUAL
+    (reduceCoordinates
+     (f, ReducedCoordinatesMap::configuration_t
+      (static_cast<std::size_t> (nDofs))),
+     f);
+
+  // The configuration must cover the function input.
+  BOOST_CHECK_THROW
+    (reduceCoordinates
+     (f, ReducedCoordinatesMap::configuration_t (4)),
+     std::runtime_error);
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE selector
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/selector.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (selector)
+{
+  Selector<EigenMatrixDense> selector (10, 3, 4);
+  BOOST_CHECK_EQUAL (selector.inputSize (), 10);
+  BOOST_CHECK_EQUAL (selector.outputSize (), 4);
+  BOOST_CHECK_EQUAL (selector.start (), 3);
+
+  Function::vector_t x = Function::vector_t::Random (10);
+  BOOST_CHECK_SMALL
+    ((selector (x) - x.segment (3, 4)).cwiseAbs ().maxCoeff (), 1e-12);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (selector, x, 1e-6));
+
+  Function::matrix_t jacobian = selector.jacobian (x);
+  for (Function::size_type i = 0; i < selector.outputSize (); ++i)
+    BOOST_CHECK_SMALL
+      ((selector.gradient (x, i) - jacobian.row (i).transpose ())
+       .cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Sparse jacobian: one non-zero per row.
+  Selector<EigenMatrixSparse> sparseSelector (10, 3, 4);
+  Selector<EigenMatrixSparse>::jacobian_t sparseJacobian =
+    sparseSelector.jacobian (x);
+  BOOST_CHECK_EQUAL (sparseJacobian.nonZeros (), 4);
+  Function::matrix_t dense;
+  copyToDense (dense, sparseJacobian);
+  BOOST_CHECK_SMALL ((dense - jacobian).cwiseAbs ().maxCoeff (), 1e-12);
+
+  BOOST_CHECK_THROW (Selector<EigenMatrixDense> (10, 8, 4),
+		     std::runtime_error);
+  BOOST_CHECK_THROW (Selector<EigenMatrixDense> (10, -1, 4),
+		     std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE (zero)
+{
+  Zero<EigenMatrixDense> zero (10, 2);
+  Function::vector_t x = Function::vector_t::Random (10);
+  BOOST_CHECK_EQUAL (zero (x).size (), 2);
+  BOOST_CHECK_SMALL (zero (x).cwiseAbs ().maxCoeff (), 1e-12);
+  BOOST_CHECK_SMALL (zero.jacobian (x).cwiseAbs ().maxCoeff (), 1e-12);
+
+  Zero<EigenMatrixSparse> sparseZero (10);
+  BOOST_CHECK_EQUAL (sparseZero.jacobian (x).nonZeros (), 0);
+}
+
+BOOST_AUTO_TEST_CASE (identity)
+{
+  Function::vector_t offset = Function::vector_t::Random (5);
+  Identity<EigenMatrixDense> identity (offset);
+  Function::vector_t x = Function::vector_t::Random (5);
+  BOOST_CHECK_SMALL
+    ((identity (x) - x - offset).cwiseAbs ().maxCoeff (), 1e-12);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (identity, x, 1e-6));
+
+  // The offset is modified in place.
+  identity.offset ().setZero ();
+  BOOST_CHECK_SMALL ((identity (x) - x).cwiseAbs ().maxCoeff (), 1e-12);
+
+  Identity<EigenMatrixSparse> sparseIdentity (offset);
+  BOOST_CHECK_EQUAL (sparseIdentity.jacobian (x).nonZeros (), 5);
+}
@@ -0,0 +1,73 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE squared_distance_to_reference
+
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/function/squared-distance-to-reference.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (squared_distance_to_reference)
+{
+  Function::vector_t reference = Function::vector_t::Random (6);
+  SquaredDistanceToReference<EigenMatrixDense> f (reference);
+  BOOST_CHECK_EQUAL (f.inputSize (), 6);
+  BOOST_CHECK_EQUAL (f.outputSize (), 1);
+
+  // Zero at the reference.
+  BOOST_CHECK_SMALL (f (reference)[0], 1e-12);
+
+  Function::vector_t x = Function::vector_t::Random (6);
+  BOOST_CHECK_CLOSE (f (x)[0], (x - reference).squaredNorm (), 1e-8);
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (f, x, 1e-5));
+  BOOST_CHECK_SMALL
+    ((f.gradient (x, 0) - 2. * (x - reference)).cwiseAbs ().maxCoeff (),
+     1e-12);
+
+  Function::matrix_t hessian = f.hessian (x, 0);
+  BOOST_CHECK_SMALL
+    ((hessian - 2. * Function::matrix_t::Identity (6, 6))
+     .cwiseAbs ().maxCoeff (), 1e-12);
+
+  // Swap the reference in place.
+  f.setReference (x);
+  BOOST_CHECK_SMALL (f (x)[0], 1e-12);
+  BOOST_CHECK_SMALL ((f.reference () - x).cwiseAbs ().maxCoeff (), 1e-12);
+  BOOST_CHECK_THROW (f.setReference (Function::vector_t (3)),
+		     std::runtime_error);
+
+  // Sparse derivatives.
+  SquaredDistanceToReference<EigenMatrixSparse> sparse (reference);
+  Function::matrix_t dense;
+  copyToDense (dense, sparse.jacobian (x));
+  BOOST_CHECK_SMALL
+    ((dense - 2. * (x - reference).transpose ()).cwiseAbs ().maxCoeff (),
+     1e-12);
+  BOOST_CHECK_EQUAL (sparse.hessian (x, 0).nonZeros (), 6);
+
+  // The sparsity pattern does not depend on the argument (the
+  // jacobian is zero at the reference).
+  BOOST_CHECK_EQUAL (sparse.jacobian (reference).nonZeros (), 6);
+}
@@ -0,0 +1,148 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE stacked_state_function
+
+#include <cmath>
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/core/finite-difference-gradient.hh>
+
+#include <roboptim/retargeting/function/stacked-state-function.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+namespace
+{
+  /// \brief f(q, dq, ddq) = (q0 dq1 + ddq0, sin (q1) ddq1)
+  template <typename T>
+  class TestStateFunction : public GenericDifferentiableFunction<T>
+  {
+  public:
+    ROBOPTIM_DIFFERENTIABLE_FUNCTION_FWD_TYPEDEFS_
+    (GenericDifferentiableFunction<T>);
+
+    TestStateFunction ()
+      : GenericDifferentiableFunction<T> (6, 2, "test state function")
+    {}
+
+    void
+    impl_compute (result_t& result, const argument_t& x) const
+    {
+      result[0] = x[0] * x[3] + x[4];
+      result[1] = std::sin (x[1]) * x[5];
+    }
+
+    void
+    impl_gradient (gradient_t& gradient, const argument_t& x,
+		   size_type functionId) const
+    {
+      Function::vector_t g (6);
+      g.setZero ();
+      if (functionId == 0)
+	{
+	  g[0] = x[3];
+	  g[3] = x[0];
+	  g[4] = 1.;
+	}
+      else
+	{
+	  g[1] = std::cos (x[1]) * x[5];
+	  g[5] = std::sin (x[1]);
+	}
+      assignDense (gradient, g);
+    }
+  };
+
+  typedef StackedStateFunction<EigenMatrixDense> stacked_t;
+  typedef StackedStateFunction<EigenMatrixSparse> sparseStacked_t;
+} // end of anonymous namespace.
+
+BOOST_AUTO_TEST_CASE (stacked_state_function)
+{
+  const Function::vector_t::Index nFrames = 5;
+  const Function::value_type dt = .1;
+
+  stacked_t::stateFunctionShPtr_t f =
+    boost::make_shared<TestStateFunction<EigenMatrixDense> > ();
+  stacked_t stacked (f, nFrames, 2, dt);
+
+  BOOST_CHECK_EQUAL (stacked.inputSize (), nFrames * 2);
+  BOOST_CHECK_EQUAL (stacked.outputSize (), (nFrames - 2) * 2);
+  BOOST_CHECK_EQUAL (stacked.firstFrame (), 1);
+  BOOST_CHECK_EQUAL (stacked.repeat (std::vector<double> (2, 1.)).size (),
+		     static_cast<std::size_t> ((nFrames - 2) * 2));
+
+  Function::vector_t x = Function::vector_t::Random (stacked.inputSize ());
+
+  // Compare with the state built by hand.
+  Function::vector_t result = stacked (x);
+  Function::vector_t state (6);
+  for (Function::vector_t::Index frame = 1; frame < nFrames - 1; ++frame)
+    {
+      state.segment (0, 2) = x.segment (frame * 2, 2);
+      state.segment (2, 2) =
+	(x.segment ((frame + 1) * 2, 2) - x.segment ((frame - 1) * 2, 2))
+	/ (2. * dt);
+      state.segment (4, 2) =
+	(x.segment ((frame + 1) * 2, 2) - 2. * x.segment (frame * 2, 2)
+	 + x.segment ((frame - 1) * 2, 2)) / (dt * dt);
+      BOOST_CHECK_SMALL
+	(((*f) (state) - result.segment ((frame - 1) * 2, 2))
+	 .cwiseAbs ().maxCoeff (), 1e-10);
+    }
+
+  // Derivatives.
+  BOOST_CHECK_NO_THROW (checkJacobianAndThrow (stacked, x, 1e-3));
+
+  stacked_t::jacobian_t jacobian = stacked.jacobian (x);
+  for (Function::size_type i = 0; i < stacked.outputSize (); ++i)
+    BOOST_CHECK_SMALL
+      ((stacked.gradient (x, i) - jacobian.row (i).transpose ())
+       .cwiseAbs ().maxCoeff (), 1e-10);
+
+  // Frame 1 does not depend on frames 3 and 4.
+  BOOST_CHECK_EQUAL (jacobian.block (0, 6, 2, 4).cwiseAbs ().maxCoeff (), 0.);
+
+  // Order 0 functions are evaluated on all the frames.
+  stacked_t positions (f, 3 * nFrames, 0, dt);
+  BOOST_CHECK_EQUAL (positions.outputSize (), 3 * nFrames * 2);
+  BOOST_CHECK_EQUAL (positions.firstFrame (), 0);
+
+  // Sparse jacobians hold the same values.
+  sparseStacked_t::stateFunctionShPtr_t sparseF =
+    boost::make_shared<TestStateFunction<EigenMatrixSparse> > ();
+  sparseStacked_t sparseStacked (sparseF, nFrames, 2, dt);
+  sparseStacked_t::jacobian_t sparseJacobian = sparseStacked.jacobian (x);
+  BOOST_CHECK_SMALL
+    ((Function::matrix_t (sparseJacobian.toDense ()) - jacobian)
+     .cwiseAbs ().maxCoeff (), 1e-10);
+  BOOST_CHECK (sparseJacobian.nonZeros () < jacobian.size ());
+
+  // The sparsity pattern does not depend on the argument.
+  BOOST_CHECK_EQUAL
+    (sparseStacked.jacobian (Function::vector_t::Zero (x.size ())).nonZeros (),
+     sparseJacobian.nonZeros ());
+
+  // Invalid orders and sizes.
+  BOOST_CHECK_THROW (stacked_t (f, nFrames, 3, dt), std::runtime_error);
+  BOOST_CHECK_THROW (stacked_t (f, 2, 2, dt), std::runtime_error);
+  BOOST_CHECK_THROW (stacked_t (f, nFrames, 2, 0.), std::runtime_error);
+}
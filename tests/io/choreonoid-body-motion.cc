@@ -19,6 +19,7 @@
 
 #include <sstream>
 #include <fstream>
+#include <stdexcept>
 
 #include <boost/make_shared.hpp>
 #include <boost/test/unit_test.hpp>
@@ -77,3 +78,41 @@ BOOST_AUTO_TEST_CASE (simple)
       BOOST_CHECK_EQUAL (str1, str2);
     }
 }
+
+BOOST_AUTO_TEST_CASE (writer)
+{
+  const int numFrames = 5;
+  const int nDofs = 6 + 2;
+
+  {
+    BodyMotionWriter writer ("/tmp/test-writer.yaml", numFrames, nDofs, 50.);
+    for (int frameId = 0; frameId < numFrames; ++frameId)
+      {
+	BOOST_CHECK_EQUAL (writer.numFramesWritten (), frameId);
+	writer.write (Function::vector_t::Constant (nDofs, .1 * frameId));
+      }
+    BOOST_CHECK_THROW (writer.write (Function::vector_t::Zero (nDofs)),
+		       std::runtime_error);
+    writer.close ();
+  }
+
+  cnoid::BodyMotionPtr bodyMotion = boost::make_shared<cnoid::BodyMotion> ();
+  bodyMotion->loadStandardYAMLformat ("/tmp/test-writer.yaml");
+  BOOST_CHECK_EQUAL (bodyMotion->numFrames (), numFrames);
+  BOOST_CHECK_CLOSE (bodyMotion->frameRate (), 50., 1e-10);
+
+  ChoreonoidBodyTrajectory trajectory (bodyMotion, true);
+  BOOST_REQUIRE_EQUAL (trajectory.outputSize (), nDofs);
+  for (int frameId = 0; frameId < numFrames; ++frameId)
+    for (int dofId = 0; dofId < nDofs; ++dofId)
+      BOOST_CHECK_CLOSE
+	(trajectory.parameters ()[frameId * nDofs + dofId] + 1.,
+	 .1 * frameId + 1., 1e-6);
+
+  // All the frames must be written.
+  BodyMotionWriter incomplete ("/tmp/test-writer.yaml", numFrames, nDofs, 50.);
+  incomplete.write (Function::vector_t::Zero (nDofs));
+  BOOST_CHECK_THROW (incomplete.close (), std::runtime_error);
+  BOOST_CHECK_THROW (incomplete.write (Function::vector_t::Zero (nDofs + 1)),
+		     std::runtime_error);
+}
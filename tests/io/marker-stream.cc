@@ -0,0 +1,91 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE marker_stream
+
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/retargeting/io/marker-stream.hh>
+
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (file)
+{
+  const std::string filename = "/tmp/test-marker-stream.trc";
+  {
+    std::ofstream file (filename.c_str ());
+    file
+      << "PathFileType\t4\t(X/Y/Z)\ttest.trc\n"
+      << "DataRate\tCameraRate\tNumFrames\tNumMarkers\tUnits\n"
+      << "200\t200\t3\t2\tmm\n"
+      << "Frame#\tTime\tA\t\t\tB\n"
+      << "\t\tX1\tY1\tZ1\tX2\tY2\tZ2\n"
+      << "\n"
+      << "1\t0.000\t1\t2\t3\t4\t5\t6\t\n"
+      << "2\t0.005\t2\t3\t4\t5\t6\t7\t\n"
+      // Without frame number.
+      << "0.010 3 4 5 6 7 8\n"
+      << "4\t0.015\t4\t5\t6\t7\t8\t9";
+  }
+
+  MarkerStream stream (filename, 2, 1e-3, .05);
+  BOOST_CHECK_EQUAL (stream.nMarkers (), 2);
+
+  MarkerStreamFrame frame;
+  BOOST_REQUIRE (stream.read (frame));
+  BOOST_CHECK_CLOSE (frame.time, 0., 1e-8);
+  BOOST_CHECK_EQUAL (frame.positions.size (), 6);
+  BOOST_CHECK_CLOSE (frame.positions[0], 1e-3, 1e-8);
+  BOOST_CHECK_CLOSE (frame.positions[5], 6e-3, 1e-8);
+  BOOST_CHECK_EQUAL (frame.dropped, 0u);
+
+  // Skip to the newest frame: frame 2 is dropped, the last (not
+  // terminated) line is only read once the file stops growing.
+  BOOST_REQUIRE (stream.read (frame, true));
+  BOOST_CHECK_CLOSE (frame.time, .010, 1e-8);
+  BOOST_CHECK_CLOSE (frame.positions[0], 3e-3, 1e-8);
+  BOOST_CHECK_EQUAL (frame.dropped, 1u);
+
+  BOOST_REQUIRE (stream.read (frame));
+  BOOST_CHECK_CLOSE (frame.time, .015, 1e-8);
+  BOOST_CHECK_CLOSE (frame.positions[5], 9e-3, 1e-8);
+
+  BOOST_CHECK (!stream.read (frame));
+  BOOST_CHECK (!stream.read (frame));
+}
+
+BOOST_AUTO_TEST_CASE (errors)
+{
+  const std::string filename = "/tmp/test-marker-stream-invalid.trc";
+  {
+    std::ofstream file (filename.c_str ());
+    file << "1\t0.000\t1\t2\t3\t4\n";
+  }
+
+  MarkerStream stream (filename, 2, 1., .05);
+  MarkerStreamFrame frame;
+  BOOST_CHECK_THROW (stream.read (frame), std::runtime_error);
+
+  BOOST_CHECK_THROW (MarkerStream ("/tmp/does-not-exist.trc", 2),
+		     std::runtime_error);
+  BOOST_CHECK_THROW (MarkerStream (filename, 0), std::runtime_error);
+  BOOST_CHECK_THROW (MarkerStream ("unix:/tmp/does-not-exist.sock", 2),
+		     std::runtime_error);
+}
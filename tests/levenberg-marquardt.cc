@@ -0,0 +1,132 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#define BOOST_TEST_MODULE levenberg_marquardt
+
+#include <cmath>
+#include <limits>
+
+#include <boost/make_shared.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <roboptim/retargeting/jacobian.hh>
+#include <roboptim/retargeting/levenberg-marquardt.hh>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+namespace
+{
+  /// \brief Planar arm with three unit links: position of the
+  ///        elbow, wrist and hand "markers".
+  class PlanarArm : public DifferentiableFunction
+  {
+  public:
+    PlanarArm ()
+      : DifferentiableFunction (3, 6, "planar arm")
+    {}
+
+    void
+    impl_compute (result_t& result, const argument_t& x) const
+    {
+      double angle = 0.;
+      double px = 0.;
+      double py = 0.;
+      for (size_type i = 0; i < 3; ++i)
+	{
+	  angle += x[i];
+	  px += std::cos (angle);
+	  py += std::sin (angle);
+	  result[2 * i] = px;
+	  result[2 * i + 1] = py;
+	}
+    }
+
+    void
+    impl_gradient (gradient_t& gradient, const argument_t& x,
+		   size_type functionId) const
+    {
+      // Marker m depends on the joints 0 to m.
+      const size_type m = functionId / 2;
+      const bool y = functionId % 2 == 1;
+      Function::vector_t g (3);
+      g.setZero ();
+      for (size_type j = 0; j <= m; ++j)
+	{
+	  double angle = 0.;
+	  for (size_type i = 0; i < 3; ++i)
+	    {
+	      angle += x[i];
+	      if (i >= j && i <= m)
+		g[j] += y ? std::cos (angle) : -std::sin (angle);
+	    }
+	}
+      assignDense (gradient, g);
+    }
+  };
+} // end of anonymous namespace.
+
+BOOST_AUTO_TEST_CASE (levenberg_marquardt)
+{
+  boost::shared_ptr<PlanarArm> arm = boost::make_shared<PlanarArm> ();
+  const double inf = std::numeric_limits<double>::infinity ();
+
+  // Unbounded: reach a pose exactly.
+  Function::vector_t lower = Function::vector_t::Constant (3, -inf);
+  Function::vector_t upper = Function::vector_t::Constant (3, inf);
+  LevenbergMarquardt solver (arm, lower, upper);
+
+  Function::vector_t solution (3);
+  solution << .3, .5, -.4;
+  solver.target () = (*arm) (solution);
+
+  Function::vector_t x = Function::vector_t::Zero (3);
+  BOOST_CHECK (solver.solve (x));
+  BOOST_CHECK_SMALL (solver.cost (), 1e-12);
+  BOOST_CHECK_SMALL ((x - solution).lpNorm<Eigen::Infinity> (), 1e-5);
+  BOOST_CHECK (solver.iterations () > 0);
+
+  // Starting from the solution of a close target is fast.
+  const int coldIterations = solver.iterations ();
+  solution[0] += 1e-2;
+  solver.target () = (*arm) (solution);
+  BOOST_CHECK (solver.solve (x));
+  BOOST_CHECK_SMALL ((x - solution).lpNorm<Eigen::Infinity> (), 1e-5);
+  BOOST_CHECK (solver.iterations () <= coldIterations);
+
+  // Bounded: the elbow cannot bend enough.
+  upper[1] = .2;
+  LevenbergMarquardt bounded (arm, lower, upper);
+  bounded.target () = (*arm) (solution);
+  x.setZero ();
+  BOOST_CHECK (bounded.solve (x));
+  BOOST_CHECK_CLOSE (x[1], .2, 1e-8);
+  BOOST_CHECK (bounded.cost () > 1e-6);
+
+  // Starting points are projected.
+  x << 0., 1., 0.;
+  bounded.setMaxIterations (0);
+  BOOST_CHECK (!bounded.solve (x));
+  BOOST_CHECK_CLOSE (x[1], .2, 1e-8);
+
+  // Invalid sizes.
+  BOOST_CHECK_THROW
+    (LevenbergMarquardt (arm, Function::vector_t::Zero (2), upper),
+     std::runtime_error);
+  Function::vector_t y (2);
+  BOOST_CHECK_THROW (solver.solve (y), std::runtime_error);
+}
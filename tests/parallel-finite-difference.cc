@@ -0,0 +1,129 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+
+#include <roboptim/core/differentiable-function.hh>
+
+#include <roboptim/retargeting/parallel-finite-difference.hh>
+#include <roboptim/retargeting/worker-pool.hh>
+
+#define BOOST_TEST_MODULE parallel_finite_difference
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+namespace
+{
+  /// \brief f(x) = (sin (x0) x1, x0^2 + x1 x2, exp (x2))
+  class TestFunction : public DifferentiableFunction
+  {
+  public:
+    TestFunction ()
+      : DifferentiableFunction (3, 3, "test function")
+    {}
+
+    void
+    impl_compute (result_t& result, const argument_t& x) const
+    {
+      result[0] = std::sin (x[0]) * x[1];
+      result[1] = x[0] * x[0] + x[1] * x[2];
+      result[2] = std::exp (x[2]);
+    }
+
+    void
+    impl_gradient (gradient_t& gradient, const argument_t& x,
+		   size_type functionId) const
+    {
+      gradient.setZero ();
+      switch (functionId)
+	{
+	case 0:
+	  gradient[0] = std::cos (x[0]) * x[1];
+	  gradient[1] = std::sin (x[0]);
+	  break;
+	case 1:
+	  gradient[0] = 2. * x[0];
+	  gradient[1] = x[2];
+	  gradient[2] = x[1];
+	  break;
+	case 2:
+	  gradient[2] = std::exp (x[2]);
+	  break;
+	}
+    }
+  };
+
+  typedef ParallelFiniteDifference<EigenMatrixDense> fd_t;
+
+  /// \brief Max error between the finite difference and the
+  ///        analytical jacobians.
+  double jacobianError (const TestFunction& f, fd_t& fd,
+			const TestFunction::argument_t& x)
+  {
+    TestFunction::jacobian_t expected = f.jacobian (x);
+    TestFunction::jacobian_t jacobian (3, 3);
+    fd.jacobian (jacobian, x);
+    return (jacobian - expected).cwiseAbs ().maxCoeff ();
+  }
+} // end of anonymous namespace.
+
+BOOST_AUTO_TEST_CASE (parallel_finite_difference)
+{
+  TestFunction f;
+  TestFunction::argument_t x (3);
+  x << .3, -1.2, .5;
+
+  for (std::size_t nWorkers = 1; nWorkers <= 4; nWorkers += 3)
+    {
+      WorkerPool::resizeShared (nWorkers);
+
+      fd_t simple (f, nWorkers);
+      BOOST_CHECK_EQUAL (simple.rule (), fd_t::RULE_SIMPLE);
+      BOOST_CHECK_SMALL (jacobianError (f, simple, x), 1e-6);
+
+      fd_t central (f, nWorkers, fd_t::RULE_CENTRAL, 1e-5);
+      BOOST_CHECK_SMALL (jacobianError (f, central, x), 1e-8);
+
+      fd_t fivePoints (f, nWorkers, fd_t::RULE_FIVE_POINTS, 1e-3);
+      BOOST_CHECK_SMALL (jacobianError (f, fivePoints, x), 1e-10);
+
+      // Gradients reuse the last jacobian.
+      TestFunction::gradient_t gradient (3);
+      for (TestFunction::size_type i = 0; i < 3; ++i)
+	{
+	  fivePoints.gradient (gradient, x, i);
+	  BOOST_CHECK_SMALL
+	    ((gradient - f.gradient (x, i)).cwiseAbs ().maxCoeff (), 1e-10);
+	}
+
+      // A different point invalidates the cached jacobian.
+      x[0] += .1;
+      BOOST_CHECK_SMALL (jacobianError (f, fivePoints, x), 1e-10);
+    }
+
+  // Workspaces are missing if the pool is larger than expected,
+  // columns are then computed sequentially.
+  WorkerPool::resizeShared (4);
+  fd_t sequential (f, 1, fd_t::RULE_CENTRAL, 1e-5);
+  BOOST_CHECK_SMALL (jacobianError (f, sequential, x), 1e-8);
+
+  WorkerPool::resizeShared (1);
+}
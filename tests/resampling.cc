@@ -0,0 +1,80 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <stdexcept>
+
+#include <roboptim/retargeting/resampling.hh>
+
+#define BOOST_TEST_MODULE resampling
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (resampling)
+{
+  typedef Function::vector_t::Index index_t;
+
+  const index_t nFrames = 201;
+  const index_t nDofs = 2;
+  const index_t factor = 4;
+
+  // Symmetric taps, unit gain at zero frequency.
+  Function::vector_t taps = lowPassFilterTaps (factor);
+  BOOST_REQUIRE_EQUAL (taps.size (), 4 * factor + 1);
+  BOOST_CHECK_CLOSE (taps.sum (), 1., 1e-10);
+  for (index_t k = 0; k < taps.size (); ++k)
+    BOOST_CHECK_CLOSE (taps[k] + 1., taps[taps.size () - 1 - k] + 1., 1e-10);
+  BOOST_CHECK_EQUAL (lowPassFilterTaps (1), Function::vector_t::Ones (1));
+  BOOST_CHECK_THROW (lowPassFilterTaps (0), std::runtime_error);
+
+  // DOF 0 is constant, DOF 1 oscillates at the input Nyquist
+  // frequency: plain decimation would keep it entirely.
+  Function::vector_t trajectory (nFrames * nDofs);
+  for (index_t frame = 0; frame < nFrames; ++frame)
+    {
+      trajectory[frame * nDofs] = 3.;
+      trajectory[frame * nDofs + 1] = frame % 2 == 0 ? 1. : -1.;
+    }
+
+  Function::vector_t resampled =
+    downsampleFrames (trajectory, nDofs, factor);
+  BOOST_REQUIRE_EQUAL
+    (resampled.size (), decimatedFrameCount (nFrames, factor) * nDofs);
+  for (index_t frame = 0; frame < resampled.size () / nDofs; ++frame)
+    BOOST_CHECK_CLOSE (resampled[frame * nDofs], 3., 1e-10);
+  // (away from the boundaries, where the frames are repeated)
+  for (index_t frame = 2; frame < resampled.size () / nDofs - 2; ++frame)
+    BOOST_CHECK_SMALL (resampled[frame * nDofs + 1], 1e-2);
+
+  // A slow motion goes through the filter.
+  for (index_t frame = 0; frame < nFrames; ++frame)
+    trajectory[frame * nDofs + 1] =
+      std::sin (2. * M_PI * static_cast<double> (frame) / 100.);
+  resampled = downsampleFrames (trajectory, nDofs, factor);
+  Function::vector_t upsampled =
+    upsampleFrames (resampled, nDofs, factor, nFrames);
+  BOOST_REQUIRE_EQUAL (upsampled.size (), trajectory.size ());
+  for (index_t frame = 10; frame < nFrames - 10; ++frame)
+    BOOST_CHECK_SMALL
+      (upsampled[frame * nDofs + 1] - trajectory[frame * nDofs + 1], 1e-2);
+
+  // No resampling.
+  BOOST_CHECK_EQUAL (downsampleFrames (trajectory, nDofs, 1), trajectory);
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <boost/make_shared.hpp>
+
+#include <roboptim/retargeting/robot-state.hh>
+#include <roboptim/retargeting/function/forward-geometry/choreonoid.hh>
+
+#include <cnoid/BodyLoader>
+
+#define BOOST_TEST_MODULE robot_state
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+std::string modelFilePath (HRP4C_YAML_FILE);
+
+BOOST_AUTO_TEST_CASE (robot_state)
+{
+  cnoid::BodyLoader loader;
+  cnoid::BodyPtr robot = loader.load (modelFilePath);
+  if (!robot)
+    throw std::runtime_error ("failed to load model");
+
+  RobotStateShPtr robotState = boost::make_shared<RobotState> (robot);
+
+  RobotState::vector_t x (6 + robot->numJoints ());
+  x.setZero ();
+
+  // First update computes, second one uses the cache.
+  BOOST_CHECK (!robotState->update (x));
+  BOOST_CHECK (robotState->update (x));
+  BOOST_CHECK_EQUAL (robotState->hits (), 1u);
+  BOOST_CHECK_EQUAL (robotState->misses (), 1u);
+
+  // A different configuration invalidates the cache.
+  x[6] = 0.1;
+  BOOST_CHECK (!robotState->update (x));
+  BOOST_CHECK_EQUAL (robot->joint (0)->q (), 0.1);
+
+  // Positions are not enough when accelerations are requested.
+  RobotState::vector_t dq (robot->numJoints ());
+  dq.setZero ();
+  BOOST_CHECK (!robotState->update (x, dq, dq));
+  BOOST_CHECK (robotState->update (x, dq, dq));
+  BOOST_CHECK (robotState->update (x));
+
+  robotState->invalidate ();
+  BOOST_CHECK (!robotState->update (x));
+
+  // Two functions sharing the state return the same values as
+  // functions using their own copy of the robot.
+  cnoid::BodyPtr robotCopy = loader.load (modelFilePath);
+  ForwardGeometryChoreonoid<EigenMatrixDense> leftShared
+    (robotState, "L_ANKLE_R");
+  ForwardGeometryChoreonoid<EigenMatrixDense> rightShared
+    (robotState, "R_ANKLE_R");
+  ForwardGeometryChoreonoid<EigenMatrixDense> left (robotCopy, "L_ANKLE_R");
+  ForwardGeometryChoreonoid<EigenMatrixDense> right (robotCopy, "R_ANKLE_R");
+
+  robotState->resetStatistics ();
+  for (int trial = 0; trial < 10; ++trial)
+    {
+      x.setRandom ();
+      BOOST_CHECK (leftShared (x).isApprox (left (x)));
+      BOOST_CHECK (rightShared (x).isApprox (right (x)));
+    }
+  BOOST_CHECK_EQUAL (robotState->misses (), 10u);
+  BOOST_CHECK_EQUAL (robotState->hits (), 10u);
+
+  std::cout << *robotState << std::endl;
+}
@@ -0,0 +1,118 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <stdexcept>
+#include <vector>
+
+#include <roboptim/retargeting/temporal-consensus.hh>
+
+#define BOOST_TEST_MODULE temporal_consensus
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (overlapping_segments)
+{
+  typedef Function::vector_t::Index index_t;
+  typedef std::pair<index_t, index_t> segment_t;
+
+  std::vector<segment_t> segments = overlappingSegments (20, 3, 2);
+  BOOST_REQUIRE_EQUAL (segments.size (), 3u);
+  BOOST_CHECK_EQUAL (segments[0].first, 0);
+  BOOST_CHECK_EQUAL (segments[0].second, 8);
+  BOOST_CHECK_EQUAL (segments[1].first, 6);
+  BOOST_CHECK_EQUAL (segments[1].second, 14);
+  BOOST_CHECK_EQUAL (segments[2].first, 12);
+  BOOST_CHECK_EQUAL (segments[2].second, 20);
+
+  segments = overlappingSegments (20, 1, 2);
+  BOOST_REQUIRE_EQUAL (segments.size (), 1u);
+  BOOST_CHECK_EQUAL (segments[0].first, 0);
+  BOOST_CHECK_EQUAL (segments[0].second, 20);
+
+  // The shared blocks of a segment must not intersect.
+  BOOST_CHECK_THROW (overlappingSegments (20, 6, 4), std::runtime_error);
+  BOOST_CHECK_THROW (overlappingSegments (20, 0, 2), std::runtime_error);
+  BOOST_CHECK_THROW (overlappingSegments (20, 2, -1), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE (temporal_consensus)
+{
+  typedef Function::vector_t::Index index_t;
+  typedef Function::vector_t vector_t;
+
+  const index_t nFrames = 20;
+  const index_t nDofs = 2;
+  const index_t overlap = 2;
+
+  TemporalConsensus consensus
+    (overlappingSegments (nFrames, 3, overlap), overlap, nDofs, 1.,
+     vector_t::Zero (nFrames * nDofs));
+  const std::size_t nSegments = consensus.segments ().size ();
+
+  // Each segment minimizes 1/2 ||x - d_k||^2: the targets of two
+  // consecutive segments disagree on their shared frames.
+  std::vector<vector_t> targets;
+  for (std::size_t k = 0; k < nSegments; ++k)
+    {
+      const index_t size =
+	(consensus.segments ()[k].second - consensus.segments ()[k].first)
+	* nDofs;
+      targets.push_back (vector_t::Constant (size, static_cast<double> (k)));
+    }
+
+  BOOST_CHECK_EQUAL (consensus.weights (0).head (nDofs).sum (), 0.);
+  BOOST_CHECK_EQUAL (consensus.weights (0).tail (overlap * nDofs).sum (),
+		     static_cast<double> (overlap * nDofs));
+  BOOST_CHECK_EQUAL (consensus.weights (1).sum (),
+		     static_cast<double> (2 * overlap * nDofs));
+
+  std::vector<vector_t> solutions (nSegments);
+  double residual = 0.;
+  for (int iteration = 0; iteration < 200; ++iteration)
+    {
+      // Closed-form proximal step.
+      for (std::size_t k = 0; k < nSegments; ++k)
+	{
+	  const vector_t w = consensus.weights (k);
+	  solutions[k] =
+	    (targets[k].array () + w.array () * consensus.reference (k).array ())
+	    / (1. + w.array ());
+	}
+      residual = consensus.update (solutions);
+    }
+  BOOST_CHECK_SMALL (residual, 1e-8);
+  BOOST_CHECK_SMALL (consensus.dualResidual (), 1e-8);
+
+  // The shared frames reach the average of the two targets.
+  const vector_t trajectory = consensus.assemble (solutions);
+  BOOST_REQUIRE_EQUAL (trajectory.size (), nFrames * nDofs);
+  BOOST_CHECK_SMALL (trajectory[0], 1e-8);
+  BOOST_CHECK_CLOSE (trajectory[6 * nDofs], .5, 1e-6);
+  BOOST_CHECK_CLOSE (trajectory[10 * nDofs], 1., 1e-6);
+  BOOST_CHECK_CLOSE (trajectory[13 * nDofs + 1], 1.5, 1e-6);
+  BOOST_CHECK_CLOSE (trajectory[19 * nDofs + 1], 2., 1e-6);
+
+  solutions.pop_back ();
+  BOOST_CHECK_THROW (consensus.update (solutions), std::runtime_error);
+  BOOST_CHECK_THROW
+    (TemporalConsensus (overlappingSegments (nFrames, 3, overlap), overlap,
+			nDofs, 1., vector_t::Zero (3)),
+     std::runtime_error);
+}
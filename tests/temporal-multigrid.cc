@@ -0,0 +1,80 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <roboptim/retargeting/temporal-multigrid.hh>
+
+#define BOOST_TEST_MODULE temporal_multigrid
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+BOOST_AUTO_TEST_CASE (temporal_multigrid)
+{
+  typedef Function::vector_t::Index index_t;
+
+  const index_t nFrames = 11;
+  const index_t nDofs = 2;
+  const index_t factor = 3;
+
+  // Linear trajectory: DOF 0 is the frame index, DOF 1 its opposite.
+  Function::vector_t trajectory (nFrames * nDofs);
+  for (index_t frame = 0; frame < nFrames; ++frame)
+    {
+      trajectory[frame * nDofs] = static_cast<double> (frame);
+      trajectory[frame * nDofs + 1] = -static_cast<double> (frame);
+    }
+
+  BOOST_CHECK_EQUAL (decimatedFrameCount (nFrames, factor), 4);
+  BOOST_CHECK_EQUAL (decimatedFrameCount (nFrames, 1), nFrames);
+  BOOST_CHECK_EQUAL (decimatedFrameCount (10, factor), 4);
+  BOOST_CHECK_THROW (decimatedFrameCount (nFrames, 0), std::runtime_error);
+
+  // Frames 0, 3, 6 and 9 are kept.
+  Function::vector_t coarse = decimateFrames (trajectory, nDofs, factor);
+  BOOST_REQUIRE_EQUAL (coarse.size (), 4 * nDofs);
+  for (index_t frame = 0; frame < 4; ++frame)
+    {
+      BOOST_CHECK_EQUAL (coarse[frame * nDofs], 3. * frame);
+      BOOST_CHECK_EQUAL (coarse[frame * nDofs + 1], -3. * frame);
+    }
+
+  // The interpolation of a linear trajectory is exact, the frames
+  // following the last coarse frame keep its value.
+  Function::vector_t fine =
+    interpolateFrames (coarse, nDofs, factor, nFrames);
+  BOOST_REQUIRE_EQUAL (fine.size (), trajectory.size ());
+  for (index_t frame = 0; frame < nFrames; ++frame)
+    {
+      const double expected =
+	static_cast<double> (std::min<index_t> (frame, 9));
+      BOOST_CHECK_CLOSE (fine[frame * nDofs] + 1., expected + 1., 1e-10);
+      BOOST_CHECK_CLOSE (fine[frame * nDofs + 1] - 1., -expected - 1., 1e-10);
+    }
+
+  // No decimation.
+  BOOST_CHECK_EQUAL (decimateFrames (trajectory, nDofs, 1), trajectory);
+  BOOST_CHECK_EQUAL (interpolateFrames (trajectory, nDofs, 1, nFrames),
+		     trajectory);
+
+  BOOST_CHECK_THROW (interpolateFrames (coarse, nDofs, factor, 20),
+		     std::runtime_error);
+}
@@ -0,0 +1,135 @@
+// Copyright (C) 2014 by Thomas Moulard, AIST, CNRS.
+//
+// This file is part of the roboptim.
+//
+// roboptim is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// roboptim is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with roboptim.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <stdexcept>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <roboptim/retargeting/worker-pool.hh>
+
+#define BOOST_TEST_MODULE worker_pool
+
+#include <boost/test/unit_test.hpp>
+
+using namespace roboptim;
+using namespace roboptim::retargeting;
+
+namespace
+{
+  void square (std::vector<std::size_t>& result,
+	       std::vector<std::size_t>& workers,
+	       std::size_t i)
+  {
+    result[i] = i * i;
+    workers[i] = WorkerPool::workerId ();
+  }
+
+  void failIfFive (std::size_t i)
+  {
+    if (i == 5)
+      throw std::runtime_error ("task 5 failed");
+  }
+
+  /// \brief Workers currently running a task.
+  struct Occupancy
+  {
+    explicit Occupancy (std::size_t nWorkers)
+      : mutex (),
+	running (nWorkers, false),
+	clashes (0)
+    {}
+
+    boost::mutex mutex;
+    std::vector<bool> running;
+    std::size_t clashes;
+  };
+
+  void occupy (Occupancy& occupancy, std::size_t)
+  {
+    const std::size_t id = WorkerPool::workerId ();
+    {
+      boost::lock_guard<boost::mutex> lock (occupancy.mutex);
+      if (occupancy.running[id])
+	++occupancy.clashes;
+      occupancy.running[id] = true;
+    }
+    boost::this_thread::sleep (boost::posix_time::microseconds (100));
+    {
+      boost::lock_guard<boost::mutex> lock (occupancy.mutex);
+      occupancy.running[id] = false;
+    }
+  }
+
+  void runOccupy (WorkerPool& pool, Occupancy& occupancy)
+  {
+    for (int trial = 0; trial < 20; ++trial)
+      {
+	pool.run (8, boost::bind (&occupy, boost::ref (occupancy), _1));
+	pool.run (1, boost::bind (&occupy, boost::ref (occupancy), _1));
+      }
+  }
+} // end of anonymous namespace.
+
+BOOST_AUTO_TEST_CASE (worker_pool)
+{
+  const std::size_t nTasks = 1000;
+  std::vector<std::size_t> result (nTasks, 0);
+  std::vector<std::size_t> workers (nTasks, 0);
+
+  WorkerPool pool (4);
+  BOOST_CHECK_EQUAL (pool.size (), 4u);
+  BOOST_CHECK_EQUAL (WorkerPool::workerId (), 0u);
+
+  for (int trial = 0; trial < 10; ++trial)
+    {
+      pool.run (nTasks, boost::bind
+		(&square, boost::ref (result), boost::ref (workers), _1));
+      for (std::size_t i = 0; i < nTasks; ++i)
+	{
+	  BOOST_CHECK_EQUAL (result[i], i * i);
+	  BOOST_CHECK (workers[i] < pool.size ());
+	}
+    }
+
+  // Errors are forwarded to the caller.
+  BOOST_CHECK_THROW (pool.run (10, &failIfFive), std::runtime_error);
+
+  // The pool is still usable after a failure.
+  pool.run (nTasks, boost::bind
+	    (&square, boost::ref (result), boost::ref (workers), _1));
+  BOOST_CHECK_EQUAL (result[nTasks - 1], (nTasks - 1) * (nTasks - 1));
+
+  // Two threads share the pool: a worker id is never used by both
+  // at the same time.
+  Occupancy occupancy (pool.size ());
+  boost::thread_group callers;
+  for (int callerId = 0; callerId < 3; ++callerId)
+    callers.create_thread
+      (boost::bind (&runOccupy, boost::ref (pool), boost::ref (occupancy)));
+  callers.join_all ();
+  BOOST_CHECK_EQUAL (occupancy.clashes, 0u);
+
+  // Shared pool.
+  BOOST_CHECK_EQUAL (WorkerPool::shared ().size (), 1u);
+  WorkerPool::resizeShared (3);
+  BOOST_CHECK_EQUAL (WorkerPool::shared ().size (), 3u);
+  WorkerPool::resizeShared (1);
+}